@@ -5,43 +5,62 @@ from __future__ import division, print_function, absolute_import
 
 import numpy as np
 
-from .numpy_quaternion import (quaternion, _eps,
+from .numpy_quaternion import (quaternion, quaternionf, _eps,
+                               zero, one, x, y, z,
                                slerp_evaluate, squad_evaluate,
+                               _cpu_features, _dispatch_info, _set_dispatch,
+                               get_accuracy, set_accuracy,
+                               get_num_threads, set_num_threads, _threads_after_fork,
+                               _euler_angle_gufuncs,
                                # slerp_vectorized, squad_vectorized,
                                # slerp, squad,
                                )
-from .quaternion_time_series import slerp, squad, integrate_angular_velocity, minimal_rotation
+from .quaternion_time_series import (slerp, squad, squad_coefficients, SquadInterpolator,
+                                     angular_velocity, integrate_angular_velocity, integrate_angular_velocity_rkmk4,
+                                     GyroIntegrator, integrate_gyro_increments, minimal_rotation)
 from .calculus import derivative, definite_integral, indefinite_integral
+from .quaternion_array import QuaternionArray
+from .rotor_encoding import encode_rotors, decode_rotors, EncodedRotorArray
+from .rotor_time_series_file import RotorTimeSeriesWriter, RotorTimeSeriesFile, write_rotor_time_series
 from ._version import __version__
 
 __doc_title__ = "Quaternion dtype for NumPy"
 __doc__ = "Adds a quaternion dtype to NumPy."
 
-__all__ = ['quaternion',
+__all__ = ['quaternion', 'quaternionf', 'QuaternionArray', 'EncodedRotorArray',
+           'encode_rotors', 'decode_rotors',
            'as_quat_array', 'as_spinor_array',
            'as_float_array', 'from_float_array',
            'as_rotation_matrix', 'from_rotation_matrix',
            'as_rotation_vector', 'from_rotation_vector',
            'as_euler_angles', 'from_euler_angles',
            'as_spherical_coords', 'from_spherical_coords',
-           'rotate_vectors', 'allclose',
+           'rotate_vectors', 'allclose', 'product', 'cumulative_product',
            'rotor_intrinsic_distance', 'rotor_chordal_distance',
            'rotation_intrinsic_distance', 'rotation_chordal_distance',
            'slerp_evaluate', 'squad_evaluate',
-           'zero', 'one', 'x', 'y', 'z', 'integrate_angular_velocity',
-           'squad', 'slerp', 'derivative', 'definite_integral', 'indefinite_integral']
+           'zero', 'one', 'x', 'y', 'z', 'angular_velocity',
+           'integrate_angular_velocity', 'integrate_angular_velocity_rkmk4',
+           'GyroIntegrator', 'integrate_gyro_increments',
+           'squad', 'squad_coefficients', 'SquadInterpolator', 'slerp',
+           'RotorTimeSeriesWriter', 'RotorTimeSeriesFile', 'write_rotor_time_series',
+           'derivative', 'definite_integral', 'indefinite_integral']
 
 if 'quaternion' in np.__dict__:
     raise RuntimeError('The NumPy package already has a quaternion type')
 
 np.quaternion = quaternion
 np.typeDict['quaternion'] = np.dtype(quaternion)
+np.quaternionf = quaternionf
+np.typeDict['quaternionf'] = np.dtype(quaternionf)
+
+# The worker threads do not survive `fork`, so they are restarted in the child
+try:
+    from os import register_at_fork as _register_at_fork
+    _register_at_fork(after_in_child=_threads_after_fork)
+except ImportError:
+    pass
 
-zero = np.quaternion(0, 0, 0, 0)
-one = np.quaternion(1, 0, 0, 0)
-x = np.quaternion(0, 1, 0, 0)
-y = np.quaternion(0, 0, 1, 0)
-z = np.quaternion(0, 0, 0, 1)
 
 rotor_intrinsic_distance = np.rotor_intrinsic_distance
 rotor_chordal_distance = np.rotor_chordal_distance
@@ -56,9 +75,14 @@ def as_float_array(a):
     copied; the returned quantity is just a "view" of the original.
 
     The output view has one more dimension (of size 4) than the input
-    array, but is otherwise the same shape.
+    array, but is otherwise the same shape.  Arrays of `quaternionf` are
+    viewed as float32 arrays; anything else is converted to `quaternion`
+    and viewed as float64.
 
     """
+    a = np.asarray(a)
+    if a.dtype == np.dtype(quaternionf):
+        return a.view((np.float32, 4))
     return np.asarray(a, dtype=np.quaternion).view((np.double, 4))
 
 
@@ -85,8 +109,14 @@ def as_quat_array(a):
     process of swapping columns required for useful definitions of
     the two-spinors.
 
+    A float32 input array is viewed as an array of `quaternionf`, which
+    stores the components in single precision.  Any other input is
+    converted to float64, and viewed as an array of `quaternion`.
+
     """
-    a = np.asarray(a, dtype=np.double)
+    a = np.asarray(a)
+    if a.dtype != np.float32:
+        a = np.asarray(a, dtype=np.double)
 
     # fast path
     if a.shape == (4,):
@@ -96,7 +126,7 @@ def as_quat_array(a):
     if not a.flags['C_CONTIGUOUS'] or a.strides[-1] != a.itemsize:
         a = a.copy(order='C')
     try:
-        av = a.view(np.quaternion)
+        av = a.view(quaternionf if a.dtype == np.float32 else np.quaternion)
     except ValueError as e:
         message = (str(e) + '\n            '
                    + 'Failed to view input data as a series of quaternions.  '
@@ -168,40 +198,31 @@ def as_rotation_matrix(q):
                 [2*(q.x*q.z - q.y*q.w)/n,     2*(q.y*q.z + q.x*q.w)/n,      1 - 2*(q.x**2 + q.y**2)/n]
             ])
     else:  # This is an array of quaternions
-        n = np.norm(q)
-        if np.any(n == 0.0):
-            raise ZeroDivisionError("Array input to `as_rotation_matrix` has at least one element with zero norm")
-        else:  # Assume input q is not normalized
-            m = np.empty(q.shape + (3, 3))
-            q = as_float_array(q)
-            m[..., 0, 0] = 1.0 - 2*(q[..., 2]**2 + q[..., 3]**2)/n
-            m[..., 0, 1] = 2*(q[..., 1]*q[..., 2] - q[..., 3]*q[..., 0])/n
-            m[..., 0, 2] = 2*(q[..., 1]*q[..., 3] + q[..., 2]*q[..., 0])/n
-            m[..., 1, 0] = 2*(q[..., 1]*q[..., 2] + q[..., 3]*q[..., 0])/n
-            m[..., 1, 1] = 1.0 - 2*(q[..., 1]**2 + q[..., 3]**2)/n
-            m[..., 1, 2] = 2*(q[..., 2]*q[..., 3] - q[..., 1]*q[..., 0])/n
-            m[..., 2, 0] = 2*(q[..., 1]*q[..., 3] - q[..., 2]*q[..., 0])/n
-            m[..., 2, 1] = 2*(q[..., 2]*q[..., 3] + q[..., 1]*q[..., 0])/n
-            m[..., 2, 2] = 1.0 - 2*(q[..., 1]**2 + q[..., 2]**2)/n
-            return m
+        # The conversion divides by the norm of each quaternion, so a zero
+        # norm shows up as a floating-point division by zero
+        with np.errstate(divide='raise'):
+            try:
+                return np.as_rotation_matrix_vectorized(as_float_array(q))
+            except FloatingPointError:
+                raise ZeroDivisionError("Array input to `as_rotation_matrix` has at least one element with zero norm")
 
 
 def from_rotation_matrix(rot, nonorthogonal=True):
     """Convert input 3x3 rotation matrix to unit quaternion
 
-    By default, if scipy.linalg is available, this function uses
-    Bar-Itzhack's algorithm to allow for non-orthogonal matrices.
+    By default, this function uses Bar-Itzhack's algorithm to allow for
+    non-orthogonal matrices.
     [J. Guidance, Vol. 23, No. 6, p. 1085 <http://dx.doi.org/10.2514/2.4654>]
-    This will almost certainly be quite a bit slower than simpler versions,
-    though it will be more robust to numerical errors in the rotation matrix.
-    Also note that Bar-Itzhack uses some pretty weird conventions.  The last
-    component of the quaternion appears to represent the scalar, and the
-    quaternion itself is conjugated relative to the convention used
-    throughout this module.
-
-    If scipy.linalg is not available or if the optional
-    `nonorthogonal` parameter is set to `False`, this function falls
-    back to the possibly faster, but less robust, algorithm of Markley
+    This finds the rotor as the eigenvector of a symmetric 4x4 matrix, which
+    is solved for each input matrix by Jacobi rotations in compiled code.  It
+    is somewhat slower than simpler versions, though it will be more robust to
+    numerical errors in the rotation matrix.  Also note that Bar-Itzhack uses
+    some pretty weird conventions.  The last component of the quaternion
+    appears to represent the scalar, and the quaternion itself is conjugated
+    relative to the convention used throughout this module.
+
+    If the optional `nonorthogonal` parameter is set to `False`, this
+    function uses the faster, but less robust, algorithm of Markley
     [J. Guidance, Vol. 31, No. 2, p. 440
     <http://dx.doi.org/10.2514/1.31730>].
 
@@ -213,8 +234,7 @@ def from_rotation_matrix(rot, nonorthogonal=True):
         input may actually have ndims>3; it is just assumed that the last
         two dimensions have size 3, representing the matrix.
     nonorthogonal: bool, optional
-        If scipy.linalg is available, use the more robust algorithm of
-        Bar-Itzhack.  Default value is True.
+        Use the more robust algorithm of Bar-Itzhack.  Default value is True.
 
     Returns
     -------
@@ -222,107 +242,13 @@ def from_rotation_matrix(rot, nonorthogonal=True):
         Unit quaternions resulting in rotations corresponding to input
         rotations.  Output shape is rot.shape[:-2].
 
-    Raises
-    ------
-    LinAlgError
-        If any of the eigenvalue solutions does not converge
-
     """
-    try:
-        from scipy import linalg
-    except ImportError:
-        linalg = False
-
     rot = np.array(rot, copy=False)
-    shape = rot.shape[:-2]
-
-    if linalg and nonorthogonal:
-        from operator import mul
-        from functools import reduce
-
-        K3 = np.empty(shape+(4, 4))
-        K3[..., 0, 0] = (rot[..., 0, 0] - rot[..., 1, 1] - rot[..., 2, 2])/3.0
-        K3[..., 0, 1] = (rot[..., 1, 0] + rot[..., 0, 1])/3.0
-        K3[..., 0, 2] = (rot[..., 2, 0] + rot[..., 0, 2])/3.0
-        K3[..., 0, 3] = (rot[..., 1, 2] - rot[..., 2, 1])/3.0
-        K3[..., 1, 0] = K3[..., 0, 1]
-        K3[..., 1, 1] = (rot[..., 1, 1] - rot[..., 0, 0] - rot[..., 2, 2])/3.0
-        K3[..., 1, 2] = (rot[..., 2, 1] + rot[..., 1, 2])/3.0
-        K3[..., 1, 3] = (rot[..., 2, 0] - rot[..., 0, 2])/3.0
-        K3[..., 2, 0] = K3[..., 0, 2]
-        K3[..., 2, 1] = K3[..., 1, 2]
-        K3[..., 2, 2] = (rot[..., 2, 2] - rot[..., 0, 0] - rot[..., 1, 1])/3.0
-        K3[..., 2, 3] = (rot[..., 0, 1] - rot[..., 1, 0])/3.0
-        K3[..., 3, 0] = K3[..., 0, 3]
-        K3[..., 3, 1] = K3[..., 1, 3]
-        K3[..., 3, 2] = K3[..., 2, 3]
-        K3[..., 3, 3] = (rot[..., 0, 0] + rot[..., 1, 1] + rot[..., 2, 2])/3.0
-
-        if not shape:
-            q = zero.copy()
-            eigvals, eigvecs = linalg.eigh(K3.T, eigvals=(3, 3))
-            q.components[0] = eigvecs[-1]
-            q.components[1:] = -eigvecs[:-1].flatten()
-            return q
-        else:
-            q = np.empty(shape+(4,), dtype=np.float)
-            for flat_index in range(reduce(mul, shape)):
-                multi_index = np.unravel_index(flat_index, shape)
-                eigvals, eigvecs = linalg.eigh(K3[multi_index], eigvals=(3, 3))
-                q[multi_index+(0,)] = eigvecs[-1]
-                q[multi_index+(slice(1,None),)] = -eigvecs[:-1].flatten()
-            return as_quat_array(q)
-
-    else:  # No scipy.linalg or not `nonorthogonal`
-        diagonals = np.empty(shape+(4,))
-        diagonals[..., 0] = rot[..., 0, 0]
-        diagonals[..., 1] = rot[..., 1, 1]
-        diagonals[..., 2] = rot[..., 2, 2]
-        diagonals[..., 3] = rot[..., 0, 0] + rot[..., 1, 1] + rot[..., 2, 2]
-
-        indices = np.argmax(diagonals, axis=-1)
-
-        q = diagonals  # reuse storage space
-        indices_i = (indices == 0)
-        if np.any(indices_i):
-            if indices_i.shape == ():
-                indices_i = Ellipsis
-            rot_i = rot[indices_i, :, :]
-            q[indices_i, 0] = rot_i[..., 2, 1] - rot_i[..., 1, 2]
-            q[indices_i, 1] = 1 + rot_i[..., 0, 0] - rot_i[..., 1, 1] - rot_i[..., 2, 2]
-            q[indices_i, 2] = rot_i[..., 0, 1] + rot_i[..., 1, 0]
-            q[indices_i, 3] = rot_i[..., 0, 2] + rot_i[..., 2, 0]
-        indices_i = (indices == 1)
-        if np.any(indices_i):
-            if indices_i.shape == ():
-                indices_i = Ellipsis
-            rot_i = rot[indices_i, :, :]
-            q[indices_i, 0] = rot_i[..., 0, 2] - rot_i[..., 2, 0]
-            q[indices_i, 1] = rot_i[..., 1, 0] + rot_i[..., 0, 1]
-            q[indices_i, 2] = 1 - rot_i[..., 0, 0] + rot_i[..., 1, 1] - rot_i[..., 2, 2]
-            q[indices_i, 3] = rot_i[..., 1, 2] + rot_i[..., 2, 1]
-        indices_i = (indices == 2)
-        if np.any(indices_i):
-            if indices_i.shape == ():
-                indices_i = Ellipsis
-            rot_i = rot[indices_i, :, :]
-            q[indices_i, 0] = rot_i[..., 1, 0] - rot_i[..., 0, 1]
-            q[indices_i, 1] = rot_i[..., 2, 0] + rot_i[..., 0, 2]
-            q[indices_i, 2] = rot_i[..., 2, 1] + rot_i[..., 1, 2]
-            q[indices_i, 3] = 1 - rot_i[..., 0, 0] - rot_i[..., 1, 1] + rot_i[..., 2, 2]
-        indices_i = (indices == 3)
-        if np.any(indices_i):
-            if indices_i.shape == ():
-                indices_i = Ellipsis
-            rot_i = rot[indices_i, :, :]
-            q[indices_i, 0] = 1 + rot_i[..., 0, 0] + rot_i[..., 1, 1] + rot_i[..., 2, 2]
-            q[indices_i, 1] = rot_i[..., 2, 1] - rot_i[..., 1, 2]
-            q[indices_i, 2] = rot_i[..., 0, 2] - rot_i[..., 2, 0]
-            q[indices_i, 3] = rot_i[..., 1, 0] - rot_i[..., 0, 1]
-
-        q /= np.linalg.norm(q, axis=-1)[..., np.newaxis]
-
-        return as_quat_array(q)
+
+    if nonorthogonal:
+        return as_quat_array(np.from_nonorthogonal_rotation_matrix_vectorized(rot))
+    else:
+        return as_quat_array(np.from_rotation_matrix_vectorized(rot))
 
 
 def as_rotation_vector(q):
@@ -344,7 +270,7 @@ def as_rotation_vector(q):
         radians.
 
     """
-    return as_float_array(2*np.log(np.normalized(q)))[..., 1:]
+    return np.as_rotation_vector_vectorized(as_float_array(q))
 
 
 def from_rotation_vector(rot):
@@ -363,14 +289,19 @@ def from_rotation_vector(rot):
         rotations.  Output shape is rot.shape[:-1].
 
     """
-    rot = np.array(rot, copy=False)
-    quats = np.zeros(rot.shape[:-1]+(4,))
-    quats[..., 1:] = rot[...]/2
-    quats = as_quat_array(quats)
-    return np.exp(quats)
+    return as_quat_array(np.from_rotation_vector_vectorized(rot))
+
 
+def _euler_angle_gufunc(convention, inverse):
+    """Return the gufunc converting from (inverse=0) or to (inverse=1) Euler angles"""
+    try:
+        return _euler_angle_gufuncs[convention][inverse]
+    except (KeyError, TypeError):
+        raise ValueError("Unknown Euler-angle convention {0!r}; expected one of {1}".format(
+            convention, ", ".join(sorted(_euler_angle_gufuncs))))
 
-def as_euler_angles(q):
+
+def as_euler_angles(q, convention='zyz'):
     """Open Pandora's Box
 
     If somebody is trying to make you use Euler angles, tell them no, and
@@ -385,7 +316,10 @@ def as_euler_angles(q):
 
         R = exp(alpha*z/2) * exp(beta*y/2) * exp(gamma*z/2)
 
-    The angles are naturally in radians.
+    The angles are naturally in radians.  Other conventions may be chosen
+    with the `convention` argument, which names the axes of the three
+    factors in that order; for example, 'zyx' represents the Tait-Bryan
+    angles R = exp(alpha*z/2) * exp(beta*y/2) * exp(gamma*x/2).
 
     NOTE: Before opening an issue reporting something "wrong" with this
     function, be sure to read all of the following page, *especially* the
@@ -396,6 +330,9 @@ def as_euler_angles(q):
     ----------
     q: quaternion or array of quaternions
         The quaternion(s) need not be normalized, but must all be nonzero
+    convention: str, optional
+        One of the twelve sequences of three axes, each differing from the
+        next, such as 'zyz' (the default), 'zxz', 'xyz', or 'zyx'.
 
     Returns
     -------
@@ -411,16 +348,10 @@ def as_euler_angles(q):
         been using quaternions like a sensible person.
 
     """
-    alpha_beta_gamma = np.empty(q.shape + (3,), dtype=np.float)
-    n = np.norm(q)
-    q = as_float_array(q)
-    alpha_beta_gamma[..., 0] = np.arctan2(q[..., 3], q[..., 0]) + np.arctan2(-q[..., 1], q[..., 2])
-    alpha_beta_gamma[..., 1] = 2*np.arccos(np.sqrt((q[..., 0]**2 + q[..., 3]**2)/n))
-    alpha_beta_gamma[..., 2] = np.arctan2(q[..., 3], q[..., 0]) - np.arctan2(-q[..., 1], q[..., 2])
-    return alpha_beta_gamma
+    return _euler_angle_gufunc(convention, 1)(as_float_array(q))
 
 
-def from_euler_angles(alpha_beta_gamma, beta=None, gamma=None):
+def from_euler_angles(alpha_beta_gamma, beta=None, gamma=None, convention='zyz'):
     """Improve your life drastically
 
     Assumes the Euler angles correspond to the quaternion R via
@@ -428,6 +359,10 @@ def from_euler_angles(alpha_beta_gamma, beta=None, gamma=None):
         R = exp(alpha*z/2) * exp(beta*y/2) * exp(gamma*z/2)
 
     The angles naturally must be in radians for this to make any sense.
+    Other conventions may be chosen with the `convention` argument, which
+    names the axes of the three factors in that order; for example, 'zyx'
+    represents the Tait-Bryan angles R = exp(alpha*z/2) * exp(beta*y/2) *
+    exp(gamma*x/2).
 
     NOTE: Before opening an issue reporting something "wrong" with this
     function, be sure to read all of the following page, *especially* the
@@ -447,6 +382,9 @@ def from_euler_angles(alpha_beta_gamma, beta=None, gamma=None):
     gamma: None, float, or array of floats
         If this array is given, it must be able to broadcast against the
         first and second arguments.
+    convention: str, optional
+        One of the twelve sequences of three axes, each differing from the
+        next, such as 'zyz' (the default), 'zxz', 'xyz', or 'zyx'.
 
     Returns
     -------
@@ -458,24 +396,9 @@ def from_euler_angles(alpha_beta_gamma, beta=None, gamma=None):
     # Figure out the input angles from either type of input
     if gamma is None:
         alpha_beta_gamma = np.asarray(alpha_beta_gamma, dtype=np.double)
-        alpha = alpha_beta_gamma[..., 0]
-        beta  = alpha_beta_gamma[..., 1]
-        gamma = alpha_beta_gamma[..., 2]
     else:
-        alpha = np.asarray(alpha_beta_gamma, dtype=np.double)
-        beta  = np.asarray(beta, dtype=np.double)
-        gamma = np.asarray(gamma, dtype=np.double)
-
-    # Set up the output array
-    R = np.empty(np.broadcast(alpha, beta, gamma).shape + (4,), dtype=np.double)
-
-    # Compute the actual values of the quaternion components
-    R[..., 0] =  np.cos(beta/2)*np.cos((alpha+gamma)/2)  # scalar quaternion components
-    R[..., 1] = -np.sin(beta/2)*np.sin((alpha-gamma)/2)  # x quaternion components
-    R[..., 2] =  np.sin(beta/2)*np.cos((alpha-gamma)/2)  # y quaternion components
-    R[..., 3] =  np.cos(beta/2)*np.sin((alpha+gamma)/2)  # z quaternion components
-
-    return as_quat_array(R)
+        alpha_beta_gamma = np.stack(np.broadcast_arrays(alpha_beta_gamma, beta, gamma), axis=-1)
+    return as_quat_array(_euler_angle_gufunc(convention, 0)(alpha_beta_gamma))
 
 
 def as_spherical_coords(q):
@@ -500,7 +423,7 @@ def as_spherical_coords(q):
         rotation about `z`.
 
     """
-    return as_euler_angles(q)[..., 1::-1]
+    return np.as_spherical_coords_vectorized(as_float_array(q))
 
 
 def from_spherical_coords(theta_phi, phi=None):
@@ -540,43 +463,31 @@ def from_spherical_coords(theta_phi, phi=None):
     # Figure out the input angles from either type of input
     if phi is None:
         theta_phi = np.asarray(theta_phi, dtype=np.double)
-        theta = theta_phi[..., 0]
-        phi  = theta_phi[..., 1]
     else:
-        theta = np.asarray(theta_phi, dtype=np.double)
-        phi = np.asarray(phi, dtype=np.double)
-
-    # Set up the output array
-    R = np.empty(np.broadcast(theta, phi).shape + (4,), dtype=np.double)
-
-    # Compute the actual values of the quaternion components
-    R[..., 0] =  np.cos(phi/2)*np.cos(theta/2)  # scalar quaternion components
-    R[..., 1] = -np.sin(phi/2)*np.sin(theta/2)  # x quaternion components
-    R[..., 2] =  np.cos(phi/2)*np.sin(theta/2)  # y quaternion components
-    R[..., 3] =  np.sin(phi/2)*np.cos(theta/2)  # z quaternion components
-
-    return as_quat_array(R)
+        theta_phi = np.stack(np.broadcast_arrays(theta_phi, phi), axis=-1)
+    return as_quat_array(np.from_spherical_coords_vectorized(theta_phi))
 
 
 def rotate_vectors(R, v, axis=-1):
     """Rotate vectors by given quaternions
 
-    For simplicity, this function simply converts the input
-    quaternion(s) to a matrix, and rotates the input vector(s) by the
-    usual matrix multiplication.  However, it should be noted that if
-    each input quaternion is only used to rotate a single vector, it
-    is more efficient (in terms of operation counts) to use the
+    If each input quaternion is only used to rotate a single vector
+    (that is, `v` contains just one vector), this function uses the
     formula
 
       v' = v + 2 * r x (s * v + r x v) / m
 
     where x represents the cross product, s and r are the scalar and
     vector parts of the quaternion, respectively, and m is the sum of
-    the squares of the components of the quaternion.  If you are
-    looping over a very large number of quaternions, and just rotating
-    a single vector each time, you might want to implement that
-    alternative algorithm using numba (or something that doesn't use
-    python).
+    the squares of the components of the quaternion.  This is
+    implemented in C as `numpy.rotate_vector_and_normalize`, which is
+    more efficient (in terms of operation counts and memory) than
+    constructing the rotation matrix.  Otherwise, this function
+    converts the input quaternion(s) to matrices, and rotates the
+    input vector(s) by the usual matrix multiplication.  If you have
+    arrays of quaternions and vectors that should be rotated pairwise,
+    use `numpy.rotate_vector_and_normalize` directly; it broadcasts
+    over all but the final axis of the vector array.
 
 
     Parameters
@@ -601,6 +512,13 @@ def rotate_vectors(R, v, axis=-1):
         raise ValueError("Input `v` does not have at least one dimension of length 3")
     if v.shape[axis] != 3:
         raise ValueError("Input `v` axis {0} has length {1}, not 3.".format(axis, v.shape[axis]))
+    if v.size == 3:  # Each rotor is used exactly once, so don't bother with matrices
+        try:
+            with np.errstate(divide='raise'):
+                vprime = np.rotate_vector_and_normalize(R, v.reshape(3))
+        except FloatingPointError:
+            raise ZeroDivisionError("Array input to `rotate_vectors` has at least one element with zero norm")
+        return vprime.reshape(R.shape + v.shape)
     m = as_rotation_matrix(R)
     m_axes = list(range(m.ndim))
     v_axes = list(range(m.ndim, m.ndim+v.ndim))
@@ -611,6 +529,76 @@ def rotate_vectors(R, v, axis=-1):
     return np.einsum(m, m_axes, v, v_axes, mv_axes)
 
 
+def product(q, axis=-1, renormalize=0, tree=False):
+    """Ordered product of quaternions along an axis
+
+    For input elements q[0], q[1], ..., q[n-1] along the given axis,
+    this returns q[0] * q[1] * ... * q[n-1], in that order, as needed to
+    compose a chain of incremental rotations.  The product of an empty
+    axis is 1.  This is equivalent to `np.multiply.reduce(q, axis=axis)`,
+    which is also computed in order, but offers two options for very
+    long chains.
+
+    Parameters
+    ==========
+    q: quaternion array
+    axis: int, optional
+        Axis along which to multiply.  The default is the last axis.
+    renormalize: int, optional
+        If positive, the running product is normalized after every
+        `renormalize` multiplications.  For chains of rotors, this
+        controls the slow drift of the norm away from 1 due to roundoff.
+        The default is 0, meaning never.
+    tree: bool or int, optional
+        If true, the input is split into blocks of 1024 elements (or of
+        the given number of elements, if an integer greater than 1), the
+        product of each block is found independently, and the block
+        products are multiplied in order.  The blocks are shared among
+        threads, as chosen by `set_num_threads`.  The grouping depends
+        only on the block size, so the result is the same for any number
+        of threads, though it may differ by roundoff from the sequential
+        product.
+
+    Returns
+    =======
+    quaternion array with the shape of `q` without `axis`
+
+    """
+    q = np.asarray(q, dtype=np.quaternion)
+    return np.product_vectorized(np.moveaxis(q, axis, -1), renormalize, _product_block_size(tree))
+
+
+def cumulative_product(q, axis=-1, renormalize=0, tree=False):
+    """Ordered partial products of quaternions along an axis
+
+    For input elements q[0], q[1], ..., q[n-1] along the given axis, the
+    output elements are q[0], q[0] * q[1], ..., q[0] * q[1] * ... * q[n-1].
+    This is equivalent to `np.multiply.accumulate(q, axis=axis)`, with
+    the options for long chains described in `product`.  In the tree
+    mode, the partial products within each block are found
+    independently, and then multiplied on the left by the product of
+    all preceding blocks.
+
+    Returns
+    =======
+    quaternion array with the shape of `q`
+
+    """
+    q = np.asarray(q, dtype=np.quaternion)
+    return np.moveaxis(np.cumulative_product_vectorized(np.moveaxis(q, axis, -1), renormalize,
+                                                        _product_block_size(tree)), -1, axis)
+
+
+def _product_block_size(tree):
+    if tree is True:
+        return 1024
+    if not tree:
+        return 0
+    if int(tree) < 2:
+        raise ValueError("The block size for the tree mode must be at least 2; got {0}".format(tree))
+    return int(tree)
+
+
 def isclose(a, b, rtol=4*np.finfo(float).eps, atol=0.0, equal_nan=False):
     """
     Returns a boolean array where two arrays are element-wise equal within a
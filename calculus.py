@@ -3,322 +3,90 @@
 
 from __future__ import division, print_function, absolute_import
 import numpy as np
-from quaternion.numba_wrapper import njit, jit, xrange
+from .numpy_quaternion import quaternion, _derivative, _indefinite_integral, _definite_integral
 
 
-def derivative(f, t):
+def _calculus_kernel(kernel, f, t, axis, reduce, out=None):
+    """Apply one of the C kernels along `axis` of `f`
+
+    Quaternion arrays are handled through their float view, and complex
+    arrays through their real and imaginary parts, so neither is
+    copied.  The result is written to `out` if given, and otherwise to
+    a new array with the memory layout of the input, with the time axis
+    removed if `reduce` is True.
+
+    """
+    f = np.asarray(f)
+    t = np.asarray(t, dtype=float)
+    if t.ndim != 1:
+        raise ValueError("Input `t` must be one-dimensional; it has shape {0}".format(t.shape))
+    if f.ndim == 0:
+        raise ValueError("Input `f` must have at least one dimension")
+    axis = axis % f.ndim
+    if f.shape[axis] != t.shape[0]:
+        raise ValueError("Input `f` has {0} points along axis {1}, but `t` has {2}".format(f.shape[axis], axis,
+                                                                                      t.shape[0]))
+    if f.dtype == quaternion:
+        from . import as_float_array, as_quat_array
+        if out is None:
+            return as_quat_array(_calculus_kernel(kernel, as_float_array(f), t, axis, reduce))
+        if out.dtype != quaternion:
+            raise TypeError("Output for quaternion input must have quaternion dtype, not {0}".format(out.dtype))
+        _calculus_kernel(kernel, as_float_array(f), t, axis, reduce, as_float_array(out))
+        return out
+    if np.iscomplexobj(f):
+        if out is None:
+            shape = f.shape[:axis] + f.shape[axis+1:] if reduce else f.shape
+            out = np.empty(shape, dtype=complex)
+        _calculus_kernel(kernel, f.real, t, axis, reduce, out.real)
+        _calculus_kernel(kernel, f.imag, t, axis, reduce, out.imag)
+        return out
+    f = np.moveaxis(f, axis, -1)
+    if reduce:
+        return kernel(f, t, out=out)
+    if out is None:
+        out = np.empty_like(np.moveaxis(f, -1, axis), dtype=float)
+    kernel(f, t, out=np.moveaxis(out, axis, -1))
+    return out
+
+
+def derivative(f, t, axis=0, out=None):
     """Fourth-order finite-differencing with non-uniform time steps
 
     The formula for this finite difference comes from Eq. (A 5b) of "Derivative formulas and errors for non-uniformly
     spaced points" by M. K. Bowen and Ronald Smith.  As explained in their Eqs. (B 9b) and (B 10b), this is a
-    fourth-order formula -- though that's a squishy concept with non-uniform time steps.
+    fourth-order formula -- though that's a squishy concept with non-uniform time steps.  The two points at each end,
+    and every point of series with fewer than five points, use the derivative of the interpolating polynomial through
+    the nearest (up to) five points instead.
 
-    TODO: If there are fewer than five points, the function should revert to simpler (lower-order) formulas.
+    The input `f` may have any number of dimensions, with time along `axis`; float, complex, and quaternion arrays are
+    all accepted.  The loops run in C, and independent series are shared among threads, as chosen by
+    `quaternion.set_num_threads`.  The result is written to `out`, if given, which must then have the shape of `f`.
 
     """
-    dfdt = np.empty_like(f)
-    if (f.ndim == 1):
-        _derivative(f, t, dfdt)
-    elif (f.ndim == 2):
-        _derivative_2d(f, t, dfdt)
-    elif (f.ndim == 3):
-        _derivative_3d(f, t, dfdt)
-    else:
-        raise NotImplementedError("Taking derivatives of {0}-dimensional arrays is not yet implemented".format(f.ndim))
-    return dfdt
-
-
-@njit
-def _derivative(f, t, dfdt):
-    for i in xrange(2):
-        t_i = t[i]
-        t1 = t[0]
-        t2 = t[1]
-        t3 = t[2]
-        t4 = t[3]
-        t5 = t[4]
-        h1 = t1 - t_i
-        h2 = t2 - t_i
-        h3 = t3 - t_i
-        h4 = t4 - t_i
-        h5 = t5 - t_i
-        h12 = t1 - t2
-        h13 = t1 - t3
-        h14 = t1 - t4
-        h15 = t1 - t5
-        h23 = t2 - t3
-        h24 = t2 - t4
-        h25 = t2 - t5
-        h34 = t3 - t4
-        h35 = t3 - t5
-        h45 = t4 - t5
-        dfdt[i] = (-((h2 * h3 * h4 + h2 * h3 * h5 + h2 * h4 * h5 + h3 * h4 * h5) / (h12 * h13 * h14 * h15)) * f[0]
-                   + ((h1 * h3 * h4 + h1 * h3 * h5 + h1 * h4 * h5 + h3 * h4 * h5) / (h12 * h23 * h24 * h25)) * f[1]
-                   - ((h1 * h2 * h4 + h1 * h2 * h5 + h1 * h4 * h5 + h2 * h4 * h5) / (h13 * h23 * h34 * h35)) * f[2]
-                   + ((h1 * h2 * h3 + h1 * h2 * h5 + h1 * h3 * h5 + h2 * h3 * h5) / (h14 * h24 * h34 * h45)) * f[3]
-                   - ((h1 * h2 * h3 + h1 * h2 * h4 + h1 * h3 * h4 + h2 * h3 * h4) / (h15 * h25 * h35 * h45)) * f[4])
-
-    for i in xrange(2, len(t) - 2):
-        t1 = t[i - 2]
-        t2 = t[i - 1]
-        t3 = t[i]
-        t4 = t[i + 1]
-        t5 = t[i + 2]
-        h1 = t1 - t3
-        h2 = t2 - t3
-        h4 = t4 - t3
-        h5 = t5 - t3
-        h12 = t1 - t2
-        h13 = t1 - t3
-        h14 = t1 - t4
-        h15 = t1 - t5
-        h23 = t2 - t3
-        h24 = t2 - t4
-        h25 = t2 - t5
-        h34 = t3 - t4
-        h35 = t3 - t5
-        h45 = t4 - t5
-        dfdt[i] = (-((h2 * h4 * h5) / (h12 * h13 * h14 * h15)) * f[i - 2]
-                   + ((h1 * h4 * h5) / (h12 * h23 * h24 * h25)) * f[i - 1]
-                   - ((h1 * h2 * h4 + h1 * h2 * h5 + h1 * h4 * h5 + h2 * h4 * h5) / (h13 * h23 * h34 * h35)) * f[i]
-                   + ((h1 * h2 * h5) / (h14 * h24 * h34 * h45)) * f[i + 1]
-                   - ((h1 * h2 * h4) / (h15 * h25 * h35 * h45)) * f[i + 2])
-
-    for i in xrange(len(t) - 2, len(t)):
-        t_i = t[i]
-        t1 = t[-5]
-        t2 = t[-4]
-        t3 = t[-3]
-        t4 = t[-2]
-        t5 = t[-1]
-        h1 = t1 - t_i
-        h2 = t2 - t_i
-        h3 = t3 - t_i
-        h4 = t4 - t_i
-        h5 = t5 - t_i
-        h12 = t1 - t2
-        h13 = t1 - t3
-        h14 = t1 - t4
-        h15 = t1 - t5
-        h23 = t2 - t3
-        h24 = t2 - t4
-        h25 = t2 - t5
-        h34 = t3 - t4
-        h35 = t3 - t5
-        h45 = t4 - t5
-        dfdt[i] = (-((h2 * h3 * h4 + h2 * h3 * h5 + h2 * h4 * h5 + h3 * h4 * h5) / (h12 * h13 * h14 * h15)) * f[-5]
-                   + ((h1 * h3 * h4 + h1 * h3 * h5 + h1 * h4 * h5 + h3 * h4 * h5) / (h12 * h23 * h24 * h25)) * f[-4]
-                   - ((h1 * h2 * h4 + h1 * h2 * h5 + h1 * h4 * h5 + h2 * h4 * h5) / (h13 * h23 * h34 * h35)) * f[-3]
-                   + ((h1 * h2 * h3 + h1 * h2 * h5 + h1 * h3 * h5 + h2 * h3 * h5) / (h14 * h24 * h34 * h45)) * f[-2]
-                   - ((h1 * h2 * h3 + h1 * h2 * h4 + h1 * h3 * h4 + h2 * h3 * h4) / (h15 * h25 * h35 * h45)) * f[-1])
-
-    return
+    return _calculus_kernel(_derivative, f, t, axis, False, out)
 
 
-@njit
-def _derivative_2d(f, t, dfdt):
-    for i in xrange(2):
-        t_i = t[i]
-        t1 = t[0]
-        t2 = t[1]
-        t3 = t[2]
-        t4 = t[3]
-        t5 = t[4]
-        h1 = t1 - t_i
-        h2 = t2 - t_i
-        h3 = t3 - t_i
-        h4 = t4 - t_i
-        h5 = t5 - t_i
-        h12 = t1 - t2
-        h13 = t1 - t3
-        h14 = t1 - t4
-        h15 = t1 - t5
-        h23 = t2 - t3
-        h24 = t2 - t4
-        h25 = t2 - t5
-        h34 = t3 - t4
-        h35 = t3 - t5
-        h45 = t4 - t5
-        for k in xrange(f.shape[1]):
-            dfdt[i, k] = (
-            -((h2 * h3 * h4 + h2 * h3 * h5 + h2 * h4 * h5 + h3 * h4 * h5) / (h12 * h13 * h14 * h15)) * f[0, k]
-            + ((h1 * h3 * h4 + h1 * h3 * h5 + h1 * h4 * h5 + h3 * h4 * h5) / (h12 * h23 * h24 * h25)) * f[1, k]
-            - ((h1 * h2 * h4 + h1 * h2 * h5 + h1 * h4 * h5 + h2 * h4 * h5) / (h13 * h23 * h34 * h35)) * f[2, k]
-            + ((h1 * h2 * h3 + h1 * h2 * h5 + h1 * h3 * h5 + h2 * h3 * h5) / (h14 * h24 * h34 * h45)) * f[3, k]
-            - ((h1 * h2 * h3 + h1 * h2 * h4 + h1 * h3 * h4 + h2 * h3 * h4) / (h15 * h25 * h35 * h45)) * f[4, k])
+def indefinite_integral(f, t, axis=0, out=None):
+    """Cumulative trapezoidal integral of `f` with respect to `t`
 
-    for i in xrange(2, len(t) - 2):
-        t1 = t[i - 2]
-        t2 = t[i - 1]
-        t3 = t[i]
-        t4 = t[i + 1]
-        t5 = t[i + 2]
-        h1 = t1 - t3
-        h2 = t2 - t3
-        h4 = t4 - t3
-        h5 = t5 - t3
-        h12 = t1 - t2
-        h13 = t1 - t3
-        h14 = t1 - t4
-        h15 = t1 - t5
-        h23 = t2 - t3
-        h24 = t2 - t4
-        h25 = t2 - t5
-        h34 = t3 - t4
-        h35 = t3 - t5
-        h45 = t4 - t5
-        for k in xrange(f.shape[1]):
-            dfdt[i, k] = (-((h2 * h4 * h5) / (h12 * h13 * h14 * h15)) * f[i - 2, k]
-                          + ((h1 * h4 * h5) / (h12 * h23 * h24 * h25)) * f[i - 1, k]
-                          - ((h1 * h2 * h4 + h1 * h2 * h5 + h1 * h4 * h5 + h2 * h4 * h5) / (h13 * h23 * h34 * h35))
-                            * f[i, k]
-                          + ((h1 * h2 * h5) / (h14 * h24 * h34 * h45)) * f[i + 1, k]
-                          - ((h1 * h2 * h4) / (h15 * h25 * h35 * h45)) * f[i + 2, k])
+    The result has the shape of `f`, with the integral from `t[0]` to `t[i]` at index `i` along `axis`.  It is written
+    to `out`, if given, which must then have the shape of `f` (and quaternion dtype for quaternion `f`).  See
+    `derivative` for the accepted inputs.
 
-    for i in xrange(len(t) - 2, len(t)):
-        t_i = t[i]
-        t1 = t[-5]
-        t2 = t[-4]
-        t3 = t[-3]
-        t4 = t[-2]
-        t5 = t[-1]
-        h1 = t1 - t_i
-        h2 = t2 - t_i
-        h3 = t3 - t_i
-        h4 = t4 - t_i
-        h5 = t5 - t_i
-        h12 = t1 - t2
-        h13 = t1 - t3
-        h14 = t1 - t4
-        h15 = t1 - t5
-        h23 = t2 - t3
-        h24 = t2 - t4
-        h25 = t2 - t5
-        h34 = t3 - t4
-        h35 = t3 - t5
-        h45 = t4 - t5
-        for k in xrange(f.shape[1]):
-            dfdt[i, k] = (
-            -((h2 * h3 * h4 + h2 * h3 * h5 + h2 * h4 * h5 + h3 * h4 * h5) / (h12 * h13 * h14 * h15)) * f[-5, k]
-            + ((h1 * h3 * h4 + h1 * h3 * h5 + h1 * h4 * h5 + h3 * h4 * h5) / (h12 * h23 * h24 * h25)) * f[-4, k]
-            - ((h1 * h2 * h4 + h1 * h2 * h5 + h1 * h4 * h5 + h2 * h4 * h5) / (h13 * h23 * h34 * h35)) * f[-3, k]
-            + ((h1 * h2 * h3 + h1 * h2 * h5 + h1 * h3 * h5 + h2 * h3 * h5) / (h14 * h24 * h34 * h45)) * f[-2, k]
-            - ((h1 * h2 * h3 + h1 * h2 * h4 + h1 * h3 * h4 + h2 * h3 * h4) / (h15 * h25 * h35 * h45)) * f[-1, k])
+    Series whose elements lie next to each other in memory (such as the components of quaternions) are integrated
+    together in a single pass.  Long series are summed in blocks of a fixed size, which are shared among threads; the
+    results are identical for any number of threads.
 
-    return
-
-
-@njit
-def _derivative_3d(f, t, dfdt):
-    for i in xrange(2):
-        t_i = t[i]
-        t1 = t[0]
-        t2 = t[1]
-        t3 = t[2]
-        t4 = t[3]
-        t5 = t[4]
-        h1 = t1 - t_i
-        h2 = t2 - t_i
-        h3 = t3 - t_i
-        h4 = t4 - t_i
-        h5 = t5 - t_i
-        h12 = t1 - t2
-        h13 = t1 - t3
-        h14 = t1 - t4
-        h15 = t1 - t5
-        h23 = t2 - t3
-        h24 = t2 - t4
-        h25 = t2 - t5
-        h34 = t3 - t4
-        h35 = t3 - t5
-        h45 = t4 - t5
-        for k in xrange(f.shape[1]):
-            for m in xrange(f.shape[1]):
-                dfdt[i, k, m] = (
-                -((h2 * h3 * h4 + h2 * h3 * h5 + h2 * h4 * h5 + h3 * h4 * h5) / (h12 * h13 * h14 * h15)) * f[0, k, m]
-                + ((h1 * h3 * h4 + h1 * h3 * h5 + h1 * h4 * h5 + h3 * h4 * h5) / (h12 * h23 * h24 * h25)) * f[1, k, m]
-                - ((h1 * h2 * h4 + h1 * h2 * h5 + h1 * h4 * h5 + h2 * h4 * h5) / (h13 * h23 * h34 * h35)) * f[2, k, m]
-                + ((h1 * h2 * h3 + h1 * h2 * h5 + h1 * h3 * h5 + h2 * h3 * h5) / (h14 * h24 * h34 * h45)) * f[3, k, m]
-                - ((h1 * h2 * h3 + h1 * h2 * h4 + h1 * h3 * h4 + h2 * h3 * h4) / (h15 * h25 * h35 * h45)) * f[4, k, m])
-
-    for i in xrange(2, len(t) - 2):
-        t1 = t[i - 2]
-        t2 = t[i - 1]
-        t3 = t[i]
-        t4 = t[i + 1]
-        t5 = t[i + 2]
-        h1 = t1 - t3
-        h2 = t2 - t3
-        h4 = t4 - t3
-        h5 = t5 - t3
-        h12 = t1 - t2
-        h13 = t1 - t3
-        h14 = t1 - t4
-        h15 = t1 - t5
-        h23 = t2 - t3
-        h24 = t2 - t4
-        h25 = t2 - t5
-        h34 = t3 - t4
-        h35 = t3 - t5
-        h45 = t4 - t5
-        for k in xrange(f.shape[1]):
-            for m in xrange(f.shape[1]):
-                dfdt[i, k, m] = (-((h2 * h4 * h5) / (h12 * h13 * h14 * h15)) * f[i - 2, k, m]
-                              + ((h1 * h4 * h5) / (h12 * h23 * h24 * h25)) * f[i - 1, k, m]
-                              - ((h1 * h2 * h4 + h1 * h2 * h5 + h1 * h4 * h5 + h2 * h4 * h5) / (h13 * h23 * h34 * h35))
-                                 * f[i, k, m]
-                              + ((h1 * h2 * h5) / (h14 * h24 * h34 * h45)) * f[i + 1, k, m]
-                              - ((h1 * h2 * h4) / (h15 * h25 * h35 * h45)) * f[i + 2, k, m])
-
-    for i in xrange(len(t) - 2, len(t)):
-        t_i = t[i]
-        t1 = t[-5]
-        t2 = t[-4]
-        t3 = t[-3]
-        t4 = t[-2]
-        t5 = t[-1]
-        h1 = t1 - t_i
-        h2 = t2 - t_i
-        h3 = t3 - t_i
-        h4 = t4 - t_i
-        h5 = t5 - t_i
-        h12 = t1 - t2
-        h13 = t1 - t3
-        h14 = t1 - t4
-        h15 = t1 - t5
-        h23 = t2 - t3
-        h24 = t2 - t4
-        h25 = t2 - t5
-        h34 = t3 - t4
-        h35 = t3 - t5
-        h45 = t4 - t5
-        for k in xrange(f.shape[1]):
-            for m in xrange(f.shape[1]):
-                dfdt[i, k, m] = (
-                -((h2 * h3 * h4 + h2 * h3 * h5 + h2 * h4 * h5 + h3 * h4 * h5) / (h12 * h13 * h14 * h15)) * f[-5, k, m]
-                + ((h1 * h3 * h4 + h1 * h3 * h5 + h1 * h4 * h5 + h3 * h4 * h5) / (h12 * h23 * h24 * h25)) * f[-4, k, m]
-                - ((h1 * h2 * h4 + h1 * h2 * h5 + h1 * h4 * h5 + h2 * h4 * h5) / (h13 * h23 * h34 * h35)) * f[-3, k, m]
-                + ((h1 * h2 * h3 + h1 * h2 * h5 + h1 * h3 * h5 + h2 * h3 * h5) / (h14 * h24 * h34 * h45)) * f[-2, k, m]
-                - ((h1 * h2 * h3 + h1 * h2 * h4 + h1 * h3 * h4 + h2 * h3 * h4) / (h15 * h25 * h35 * h45)) * f[-1, k, m])
-
-    return
+    """
+    return _calculus_kernel(_indefinite_integral, f, t, axis, False, out)
 
 
-# @njit('void(f8[:,:], f8[:], f8[:,:])')
-@jit
-def indefinite_integral(f, t):
-    Sfdt = np.empty_like(f)
-    Sfdt[0] = 0.0
-    for i in xrange(1, len(t)):
-        for j in xrange(f.shape[1]):
-            Sfdt[i, j] = Sfdt[i - 1, j] + (f[i, j] + f[i - 1, j]) * ((t[i] - t[i - 1]) / 2.0)
-    return Sfdt
+def definite_integral(f, t, axis=0, out=None):
+    """Trapezoidal integral of `f` with respect to `t` over the full range of `t`
 
+    The result has the shape of `f` with `axis` removed, and is written to `out` if given.  This is the last value of
+    `indefinite_integral` along `axis`, computed without storing the others.
 
-#@njit('void(f8[:,:], f8[:], f8[:])')
-@jit
-def definite_integral(f, t):
-    Sfdt = np.zeros_like(f)
-    for i in xrange(1, f.shape[0]):
-        Sfdt[i, ...] += (f[i, ...] + f[i - 1, ...]) * ((t[i] - t[i - 1]) / 2.0)
-    return Sfdt
+    """
+    return _calculus_kernel(_definite_integral, f, t, axis, True, out)
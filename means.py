@@ -3,6 +3,7 @@
 
 from __future__ import division, print_function, absolute_import
 
+import warnings
 import numpy as np
 
 from .calculus import definite_integral
@@ -22,11 +23,11 @@ def mean_rotor_in_chordal_metric(R, t=None):
     faster).
 
     """
-    if not t:
-        return np.quaternion(*(np.sum(as_float_array(R)))).normalized()
-    mean = np.empty((4,), dtype=float)
-    definite_integral(as_float_array(R), t, mean)
-    return np.quaternion(*mean).normalized()
+    from . import as_float_array
+    if t is None:
+        return np.quaternion(*(np.sum(as_float_array(R), axis=0))).normalized()
+    mean = definite_integral(R, t)
+    return mean.normalized()
 
 
 def optimal_alignment_in_chordal_metric(Ra, Rb, t=None):
@@ -43,5 +44,81 @@ def optimal_alignment_in_chordal_metric(Ra, Rb, t=None):
     return mean_rotor_in_chordal_metric(Ra / Rb, t)
 
 
-def mean_rotor_in_intrinsic_metric(R, t=None):
-    raise NotImplementedError()
+def mean_rotor_in_intrinsic_metric(R, t=None, weights=None, axis=0, tolerance=1e-12, max_iterations=100):
+    """Return rotor minimizing the sum of squared intrinsic distances to all R
+
+    This is the Karcher (or Frechet) mean of the rotors in the metric
+    of `rotor_intrinsic_distance`.  It has no closed form, so it is
+    found iteratively, starting from the chordal mean: each iteration
+    takes the weighted average of the logarithms of all R relative to
+    the current mean, and moves the mean along that tangent vector with
+    the exponential map.  When the input rotors are all within a
+    half-turn of each other, this converges rapidly to the unique
+    mean.  The iteration is done in C, and independent means (for
+    N-dimensional inputs) are shared among threads, as chosen by
+    `quaternion.set_num_threads`.
+
+    Note that rotors differing only in sign are far apart in this
+    metric, so the inputs should be chosen with consistent signs if
+    they represent rotations.
+
+    Parameters
+    ==========
+    R: quaternion array
+        Unit quaternions to average
+    t: array of float, optional
+        If present, the times corresponding to the elements of R along
+        `axis`, which are used to weight each input by the trapezoidal
+        rule, approximating the time average of the rotor function.
+    weights: array of float, optional
+        If present, weights of the elements of R, broadcast against R
+        along `axis` if one-dimensional, and otherwise against R with
+        the same axes.  If both `t` and `weights` are given, the
+        weights multiply the trapezoidal weights.  By default, all
+        elements are weighted equally.
+    axis: int, optional
+        Axis of R along which to average.  The default is 0.
+    tolerance: float, optional
+        The iteration stops when the size of a step (in radians of the
+        rotor logarithm) is no larger than this.  The default is 1e-12.
+    max_iterations: int, optional
+        If this many iterations do not converge, a RuntimeWarning is
+        issued and the last iterate is returned.  The default is 100.
+
+    Returns
+    =======
+    quaternion or quaternion array with the shape of R without `axis`
+
+    Raises
+    ======
+    ValueError
+        If R is empty along `axis`, `t` does not match R, or the total
+        weight of any mean is zero.
+
+    """
+    R = np.moveaxis(np.asarray(R, dtype=np.quaternion), axis, -1)
+    n = R.shape[-1]
+    if n == 0:
+        raise ValueError("Cannot average the empty axis {0} of R".format(axis))
+    w = np.ones((n,), dtype=float)
+    if t is not None:
+        t = np.asarray(t, dtype=float)
+        if t.shape != (n,):
+            raise ValueError("Input `t` has shape {0}, but R has length {1} along axis {2}".format(t.shape, n, axis))
+        if n > 1:
+            w = np.empty_like(t)
+            w[0] = (t[1] - t[0]) / 2.0
+            w[1:-1] = (t[2:] - t[:-2]) / 2.0
+            w[-1] = (t[-1] - t[-2]) / 2.0
+    if weights is not None:
+        weights = np.asarray(weights, dtype=float)
+        if weights.ndim > 1:
+            weights = np.moveaxis(weights, axis, -1)
+        w = w * weights
+    if np.any(np.sum(w * np.ones((n,)), axis=-1) == 0):
+        raise ValueError("The total weight of the rotors to average must not be zero")
+    mean, iterations = np.karcher_mean_vectorized(R, w, tolerance, max_iterations)
+    if np.any(iterations < 0):
+        warnings.warn("The Karcher mean did not converge to tolerance {0} in {1} iterations".format(tolerance, max_iterations),
+                      RuntimeWarning)
+    return mean
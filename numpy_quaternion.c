@@ -10,6 +10,8 @@
 #include "structmember.h"
 
 #include "quaternion.h"
+#include "quaternion_simd.h"
+#include "quaternion_threads.h"
 
 // The following definitions, along with `#define NPY_PY3K 1`, can
 // also be found in the header <numpy/npy_3kcompat.h>.
@@ -44,12 +46,43 @@ PyArray_Descr* quaternion_descr;
 
 static NPY_INLINE int
 PyQuaternion_Check(PyObject* object) {
-  return PyObject_IsInstance(object,(PyObject*)&PyQuaternion_Type);
+  return PyObject_TypeCheck(object, &PyQuaternion_Type);
+}
+
+// Python-level code that works with one quaternion at a time creates
+// and destroys a scalar object for nearly every operation, so we keep
+// the memory of recently destroyed quaternions (of exactly this type,
+// not subclasses) on a list, and reuse it rather than going back to
+// the allocator.  Like the interpreter's own freelists, this relies on
+// the GIL for thread safety.
+#define _QUATERNION_FREELIST_SIZE 256
+static PyQuaternion* pyquaternion_freelist[_QUATERNION_FREELIST_SIZE];
+static int pyquaternion_freelist_count = 0;
+
+static NPY_INLINE PyQuaternion*
+pyquaternion_alloc(void) {
+  PyQuaternion* p;
+  if (pyquaternion_freelist_count > 0) {
+    p = pyquaternion_freelist[--pyquaternion_freelist_count];
+    (void)PyObject_INIT(p, &PyQuaternion_Type);
+    return p;
+  }
+  return (PyQuaternion*)PyQuaternion_Type.tp_alloc(&PyQuaternion_Type, 0);
+}
+
+static void
+pyquaternion_dealloc(PyObject* self) {
+  if (Py_TYPE(self) == &PyQuaternion_Type
+      && pyquaternion_freelist_count < _QUATERNION_FREELIST_SIZE) {
+    pyquaternion_freelist[pyquaternion_freelist_count++] = (PyQuaternion*)self;
+    return;
+  }
+  Py_TYPE(self)->tp_free(self);
 }
 
 static PyObject*
 PyQuaternion_FromQuaternion(quaternion q) {
-  PyQuaternion* p = (PyQuaternion*)PyQuaternion_Type.tp_alloc(&PyQuaternion_Type,0);
+  PyQuaternion* p = pyquaternion_alloc();
   if (p) { p->obval = q; }
   return (PyObject*)p;
 }
@@ -79,6 +112,10 @@ static PyObject *
 pyquaternion_new(PyTypeObject *type, PyObject *NPY_UNUSED(args), PyObject *NPY_UNUSED(kwds))
 {
   PyQuaternion* self;
+  if (type == &PyQuaternion_Type) {
+    quaternion zero = {0.0, 0.0, 0.0, 0.0};
+    return PyQuaternion_FromQuaternion(zero);
+  }
   self = (PyQuaternion *)type->tp_alloc(type, 0);
   return (PyObject *)self;
 }
@@ -113,6 +150,47 @@ pyquaternion_init(PyObject *self, PyObject *args, PyObject *kwds)
   return 0;
 }
 
+#if PY_VERSION_HEX >= 0x03090000
+// Calling the `quaternion` type itself (but not a subclass, which does
+// not inherit `tp_vectorcall`) goes through this function, which
+// skips the tuple and dict that `tp_new` and `tp_init` need, and
+// converts the arguments directly.  It accepts exactly what
+// `pyquaternion_init` accepts, and raises the same errors.
+static PyObject*
+pyquaternion_vectorcall(PyObject* NPY_UNUSED(type), PyObject* const* args, size_t nargsf, PyObject* kwnames)
+{
+  Py_ssize_t size = PyVectorcall_NARGS(nargsf);
+  double c[4] = {0.0, 0.0, 0.0, 0.0};
+  Py_ssize_t i, offset = 4 - size;
+  if (kwnames && PyTuple_GET_SIZE(kwnames)) {
+    PyErr_SetString(PyExc_TypeError,
+                    "quaternion constructor takes no keyword arguments");
+    return NULL;
+  }
+  if ((size < 3) || (size > 4)) {
+    goto fail;
+  }
+  for (i = 0; i < size; ++i) {
+    if (PyFloat_CheckExact(args[i])) {
+      c[offset+i] = PyFloat_AS_DOUBLE(args[i]);
+    } else {
+      c[offset+i] = PyFloat_AsDouble(args[i]);
+      if (c[offset+i] == -1.0 && PyErr_Occurred()) {
+        goto fail;
+      }
+    }
+  }
+  {
+    quaternion q = {c[0], c[1], c[2], c[3]};
+    return PyQuaternion_FromQuaternion(q);
+  }
+ fail:
+  PyErr_SetString(PyExc_TypeError,
+                  "quaternion constructor takes three or four float arguments");
+  return NULL;
+}
+#endif
+
 #define UNARY_BOOL_RETURNER(name)                                       \
   static PyObject*                                                      \
   pyquaternion_##name(PyObject* a, PyObject* NPY_UNUSED(b)) {           \
@@ -264,6 +342,16 @@ QQ_BINARY_QUATERNION_RETURNER(copysign)
     npy_int64 val64;                                                    \
     npy_int32 val32;                                                    \
     quaternion p = {0.0, 0.0, 0.0, 0.0};                                \
+    /* Fast paths for the most common exact types */                    \
+    if(Py_TYPE(a) == &PyQuaternion_Type) {                              \
+      if(Py_TYPE(b) == &PyQuaternion_Type) {                            \
+        return PyQuaternion_FromQuaternion(quaternion_##name(((PyQuaternion*)a)->obval, ((PyQuaternion*)b)->obval)); \
+      } else if(PyFloat_CheckExact(b)) {                                \
+        return PyQuaternion_FromQuaternion(quaternion_##name##_scalar(((PyQuaternion*)a)->obval, PyFloat_AS_DOUBLE(b))); \
+      }                                                                 \
+    } else if(PyFloat_CheckExact(a) && Py_TYPE(b) == &PyQuaternion_Type) { \
+      return PyQuaternion_FromQuaternion(quaternion_scalar_##name(PyFloat_AS_DOUBLE(a), ((PyQuaternion*)b)->obval)); \
+    }                                                                   \
     if(PyArray_Check(b)) { return pyquaternion_##fake_name##_array_operator(a, b); } \
     if(PyFloat_Check(a) && PyQuaternion_Check(b)) {                     \
       return PyQuaternion_FromQuaternion(quaternion_scalar_##name(PyFloat_AsDouble(a), ((PyQuaternion*)b)->obval)); \
@@ -304,6 +392,8 @@ QQ_BINARY_QUATERNION_RETURNER(copysign)
     /* Py_DECREF(b_repr);                                                  \ */ \
     /* Py_DECREF(a_repr2);                                                 \ */ \
     /* Py_DECREF(b_repr2);                                                 \ */ \
+    /* Let objects that override ufuncs, like `QuaternionArray`, try */ \
+    if(PyObject_HasAttrString(b, "__array_ufunc__")) { Py_RETURN_NOTIMPLEMENTED; } \
     PyErr_SetString(PyExc_TypeError, "Binary operation involving quaternion and \\neither float nor quaternion."); \
     return NULL;                                                        \
   }
@@ -790,7 +880,7 @@ static PyTypeObject PyQuaternion_Type = {
   "quaternion",                               // tp_name
   sizeof(PyQuaternion),                       // tp_basicsize
   0,                                          // tp_itemsize
-  0,                                          // tp_dealloc
+  pyquaternion_dealloc,                       // tp_dealloc
   0,                                          // tp_print
   0,                                          // tp_getattr
   0,                                          // tp_setattr
@@ -848,6 +938,148 @@ static PyTypeObject PyQuaternion_Type = {
 #endif
 };
 
+// The single-precision quaternion type, `quaternionf`, exists to store
+// quaternions compactly in numpy arrays.  Its scalar objects hold the
+// four float components, and can be used to create arrays, but no
+// arithmetic is defined for them: elements extracted from arrays of
+// this type are returned as (double-precision) `quaternion` objects,
+// which represent them exactly.
+typedef struct {
+  PyObject_HEAD
+  quaternionf obval;
+} PyQuaternionF;
+
+static PyTypeObject PyQuaternionF_Type;
+
+PyArray_Descr* quaternionf_descr;
+
+static NPY_INLINE int
+PyQuaternionF_Check(PyObject* object) {
+  return PyObject_TypeCheck(object, &PyQuaternionF_Type);
+}
+
+static int
+pyquaternionf_init(PyObject *self, PyObject *args, PyObject *kwds)
+{
+  Py_ssize_t size = PyTuple_Size(args);
+  quaternionf* q = &(((PyQuaternionF*)self)->obval);
+  if (kwds && PyDict_Size(kwds)) {
+    PyErr_SetString(PyExc_TypeError,
+                    "quaternionf constructor takes no keyword arguments");
+    return -1;
+  }
+  if (((size == 3) && (!PyArg_ParseTuple(args, "fff", &q->x, &q->y, &q->z)))
+      || ((size == 4) && (!PyArg_ParseTuple(args, "ffff", &q->w, &q->x, &q->y, &q->z)))
+      || ((size<3) || (size>4))) {
+    PyErr_SetString(PyExc_TypeError,
+                    "quaternionf constructor takes three or four float arguments");
+    return -1;
+  } else if(size == 3) {
+    q->w = 0.0f;
+  }
+  return 0;
+}
+
+static PyObject *
+pyquaternionf_repr(PyObject *o)
+{
+  char str[128];
+  quaternionf q = ((PyQuaternionF *)o)->obval;
+  sprintf(str, "quaternionf(%.9g, %.9g, %.9g, %.9g)", q.w, q.x, q.y, q.z);
+  return PyUString_FromString(str);
+}
+
+static PyObject *
+pyquaternionf_as_quaternion(PyObject *self, PyObject *NPY_UNUSED(args))
+{
+  return PyQuaternion_FromQuaternion(quaternion_create_from_quaternionf(((PyQuaternionF *)self)->obval));
+}
+
+static PyMethodDef pyquaternionf_methods[] = {
+  {"as_quaternion", pyquaternionf_as_quaternion, METH_NOARGS,
+   "Return the equivalent double-precision quaternion"},
+  {NULL, NULL, 0, NULL}
+};
+
+PyMemberDef pyquaternionf_members[] = {
+  {"w", T_FLOAT, offsetof(PyQuaternionF, obval.w), 0,
+   "The real component of the quaternion"},
+  {"x", T_FLOAT, offsetof(PyQuaternionF, obval.x), 0,
+   "The first imaginary component of the quaternion"},
+  {"y", T_FLOAT, offsetof(PyQuaternionF, obval.y), 0,
+   "The second imaginary component of the quaternion"},
+  {"z", T_FLOAT, offsetof(PyQuaternionF, obval.z), 0,
+   "The third imaginary component of the quaternion"},
+  {NULL, 0, 0, 0, NULL}
+};
+
+static PyTypeObject PyQuaternionF_Type = {
+#if PY_MAJOR_VERSION >= 3
+  PyVarObject_HEAD_INIT(NULL, 0)
+#else
+  PyObject_HEAD_INIT(NULL)
+  0,                                          // ob_size
+#endif
+  "quaternionf",                              // tp_name
+  sizeof(PyQuaternionF),                      // tp_basicsize
+  0,                                          // tp_itemsize
+  0,                                          // tp_dealloc
+  0,                                          // tp_print
+  0,                                          // tp_getattr
+  0,                                          // tp_setattr
+#if PY_MAJOR_VERSION >= 3
+  0,                                          // tp_reserved
+#else
+  0,                                          // tp_compare
+#endif
+  pyquaternionf_repr,                         // tp_repr
+  0,                                          // tp_as_number
+  0,                                          // tp_as_sequence
+  0,                                          // tp_as_mapping
+  0,                                          // tp_hash
+  0,                                          // tp_call
+  pyquaternionf_repr,                         // tp_str
+  0,                                          // tp_getattro
+  0,                                          // tp_setattro
+  0,                                          // tp_as_buffer
+  Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,   // tp_flags
+  "Single-precision quaternion, used as the numpy dtype `quaternionf`", // tp_doc
+  0,                                          // tp_traverse
+  0,                                          // tp_clear
+  0,                                          // tp_richcompare
+  0,                                          // tp_weaklistoffset
+  0,                                          // tp_iter
+  0,                                          // tp_iternext
+  pyquaternionf_methods,                      // tp_methods
+  pyquaternionf_members,                      // tp_members
+  0,                                          // tp_getset
+  0,                                          // tp_base; will be reset to &PyGenericArrType_Type after numpy import
+  0,                                          // tp_dict
+  0,                                          // tp_descr_get
+  0,                                          // tp_descr_set
+  0,                                          // tp_dictoffset
+  pyquaternionf_init,                         // tp_init
+  0,                                          // tp_alloc
+  pyquaternion_new,                           // tp_new
+  0,                                          // tp_free
+  0,                                          // tp_is_gc
+  0,                                          // tp_bases
+  0,                                          // tp_mro
+  0,                                          // tp_cache
+  0,                                          // tp_subclasses
+  0,                                          // tp_weaklist
+  0,                                          // tp_del
+#if PY_VERSION_HEX >= 0x02060000
+  0,                                          // tp_version_tag
+#endif
+#if PY_VERSION_HEX >= 0x030400a1
+  0,                                          // tp_finalize
+#endif
+#if PY_VERSION_HEX >= 0x030800b1
+  0,                                          // tp_vectorcall
+#endif
+};
+
 // Functions implementing internal features. Not all of these function
 // pointers must be defined for a given type. The required members are
 // nonzero, copyswap, copyswapn, setitem, getitem, and cast.
@@ -862,13 +1094,7 @@ QUATERNION_nonzero (char *ip, PyArrayObject *ap)
     q = *(quaternion *)ip;
   }
   else {
-    PyArray_Descr *descr;
-    descr = PyArray_DescrFromType(NPY_DOUBLE);
-    descr->f->copyswap(&q.w, ip, !PyArray_ISNOTSWAPPED(ap), NULL);
-    descr->f->copyswap(&q.x, ip+8, !PyArray_ISNOTSWAPPED(ap), NULL);
-    descr->f->copyswap(&q.y, ip+16, !PyArray_ISNOTSWAPPED(ap), NULL);
-    descr->f->copyswap(&q.z, ip+24, !PyArray_ISNOTSWAPPED(ap), NULL);
-    Py_DECREF(descr);
+    quaternion_copyswap_batch((char *)&q, sizeof(q), ip, sizeof(q), 1, !PyArray_ISNOTSWAPPED(ap), sizeof(double));
   }
   return (npy_bool) !quaternion_equal(q, zero);
 }
@@ -877,10 +1103,8 @@ static void
 QUATERNION_copyswap(quaternion *dst, quaternion *src,
                     int swap, void *NPY_UNUSED(arr))
 {
-  PyArray_Descr *descr;
-  descr = PyArray_DescrFromType(NPY_DOUBLE);
-  descr->f->copyswapn(dst, sizeof(double), src, sizeof(double), 4, swap, NULL);
-  Py_DECREF(descr);
+  quaternion_copyswap_batch((char *)dst, sizeof(quaternion), (const char *)src, sizeof(quaternion), 1, swap,
+                            sizeof(double));
 }
 
 static void
@@ -888,13 +1112,8 @@ QUATERNION_copyswapn(quaternion *dst, npy_intp dstride,
                      quaternion *src, npy_intp sstride,
                      npy_intp n, int swap, void *NPY_UNUSED(arr))
 {
-  PyArray_Descr *descr;
-  descr = PyArray_DescrFromType(NPY_DOUBLE);
-  descr->f->copyswapn(&dst->w, dstride, &src->w, sstride, n, swap, NULL);
-  descr->f->copyswapn(&dst->x, dstride, &src->x, sstride, n, swap, NULL);
-  descr->f->copyswapn(&dst->y, dstride, &src->y, sstride, n, swap, NULL);
-  descr->f->copyswapn(&dst->z, dstride, &src->z, sstride, n, swap, NULL);
-  Py_DECREF(descr);
+  // `src` is NULL when the data are swapped in place
+  quaternion_copyswap_batch((char *)dst, dstride, (const char *)src, sstride, n, swap, sizeof(double));
 }
 
 static int QUATERNION_setitem(PyObject* item, quaternion* qp, void* NPY_UNUSED(ap))
@@ -1002,6 +1221,106 @@ QUATERNION_fillwithscalar(quaternion *buffer, npy_intp length, quaternion *value
   }
 }
 
+// The corresponding functions for the `quaternionf` dtype, which widen
+// the elements to `quaternion` wherever they need to be interpreted
+static PyArray_ArrFuncs _PyQuaternionF_ArrFuncs;
+
+static npy_bool
+QUATERNIONF_nonzero (char *ip, PyArrayObject *ap)
+{
+  quaternionf q;
+  quaternion zero = {0,0,0,0};
+  if (ap == NULL || PyArray_ISBEHAVED_RO(ap)) {
+    q = *(quaternionf *)ip;
+  }
+  else {
+    quaternion_copyswap_batch((char *)&q, sizeof(q), ip, sizeof(q), 1, !PyArray_ISNOTSWAPPED(ap), sizeof(float));
+  }
+  return (npy_bool) !quaternion_equal(quaternion_create_from_quaternionf(q), zero);
+}
+
+static void
+QUATERNIONF_copyswap(quaternionf *dst, quaternionf *src,
+                     int swap, void *NPY_UNUSED(arr))
+{
+  quaternion_copyswap_batch((char *)dst, sizeof(quaternionf), (const char *)src, sizeof(quaternionf), 1, swap,
+                            sizeof(float));
+}
+
+static void
+QUATERNIONF_copyswapn(quaternionf *dst, npy_intp dstride,
+                      quaternionf *src, npy_intp sstride,
+                      npy_intp n, int swap, void *NPY_UNUSED(arr))
+{
+  // `src` is NULL when the data are swapped in place
+  quaternion_copyswap_batch((char *)dst, dstride, (const char *)src, sstride, n, swap, sizeof(float));
+}
+
+static int QUATERNIONF_setitem(PyObject* item, quaternionf* qp, void* ap)
+{
+  quaternion q;
+  if(PyQuaternionF_Check(item)) {
+    memcpy(qp,&(((PyQuaternionF *)item)->obval),sizeof(quaternionf));
+    return 0;
+  }
+  if(QUATERNION_setitem(item, &q, ap) < 0) {
+    return -1;
+  }
+  *qp = quaternionf_create_from_quaternion(q);
+  return 0;
+}
+
+static PyObject *
+QUATERNIONF_getitem(void* data, void* NPY_UNUSED(arr))
+{
+  quaternionf q;
+  memcpy(&q,data,sizeof(quaternionf));
+  return PyQuaternion_FromQuaternion(quaternion_create_from_quaternionf(q));
+}
+
+static int
+QUATERNIONF_compare(quaternionf *pa, quaternionf *pb, PyArrayObject *ap)
+{
+  quaternion a = quaternion_create_from_quaternionf(*pa), b = quaternion_create_from_quaternionf(*pb);
+  return QUATERNION_compare(&a, &b, ap);
+}
+
+static int
+QUATERNIONF_argmax(quaternionf *ip, npy_intp n, npy_intp *max_ind, PyArrayObject *NPY_UNUSED(aip))
+{
+  npy_intp i;
+  quaternion mp = quaternion_create_from_quaternionf(*ip);
+
+  *max_ind = 0;
+
+  if (quaternion_isnan(mp)) {
+    return 0;
+  }
+
+  for (i = 1; i < n; i++) {
+    const quaternion q = quaternion_create_from_quaternionf(*(++ip));
+    if (!(quaternion_less_equal(q, mp))) {
+      mp = q;
+      *max_ind = i;
+      if (quaternion_isnan(mp)) {
+        break;
+      }
+    }
+  }
+  return 0;
+}
+
+static void
+QUATERNIONF_fillwithscalar(quaternionf *buffer, npy_intp length, quaternionf *value, void *NPY_UNUSED(ignored))
+{
+  npy_intp i;
+  quaternionf val = *value;
+
+  for (i = 0; i < length; ++i) {
+    buffer[i] = val;
+  }
+}
+
 // This is a macro (followed by applications of the macro) that cast
 // the input types to standard quaternions with only a nonzero scalar
 // part.
@@ -1053,6 +1372,52 @@ MAKE_CT_TO_QUATERNION(CFLOAT, npy_float);
 MAKE_CT_TO_QUATERNION(CDOUBLE, npy_double);
 MAKE_CT_TO_QUATERNION(CLONGDOUBLE, npy_longdouble);
 
+// The same casts to `quaternionf`, and the casts between the two
+// quaternion types
+#define MAKE_T_TO_QUATERNIONF(TYPE, type)                               \
+  static void                                                           \
+  TYPE ## _to_quaternionf(type *ip, quaternionf *op, npy_intp n,        \
+                          PyArrayObject *NPY_UNUSED(aip), PyArrayObject *NPY_UNUSED(aop)) \
+  {                                                                     \
+    while (n--) {                                                       \
+      op->w = (float)(*ip++);                                           \
+      op->x = 0;                                                        \
+      op->y = 0;                                                        \
+      op->z = 0;                                                        \
+      op++;                                                             \
+    }                                                                   \
+  }
+MAKE_T_TO_QUATERNIONF(FLOAT, npy_float);
+MAKE_T_TO_QUATERNIONF(DOUBLE, npy_double);
+MAKE_T_TO_QUATERNIONF(LONGDOUBLE, npy_longdouble);
+MAKE_T_TO_QUATERNIONF(BOOL, npy_bool);
+MAKE_T_TO_QUATERNIONF(BYTE, npy_byte);
+MAKE_T_TO_QUATERNIONF(UBYTE, npy_ubyte);
+MAKE_T_TO_QUATERNIONF(SHORT, npy_short);
+MAKE_T_TO_QUATERNIONF(USHORT, npy_ushort);
+MAKE_T_TO_QUATERNIONF(INT, npy_int);
+MAKE_T_TO_QUATERNIONF(UINT, npy_uint);
+MAKE_T_TO_QUATERNIONF(LONG, npy_long);
+MAKE_T_TO_QUATERNIONF(ULONG, npy_ulong);
+MAKE_T_TO_QUATERNIONF(LONGLONG, npy_longlong);
+MAKE_T_TO_QUATERNIONF(ULONGLONG, npy_ulonglong);
+static void
+QUATERNIONF_to_quaternion(quaternionf *ip, quaternion *op, npy_intp n,
+                          PyArrayObject *NPY_UNUSED(aip), PyArrayObject *NPY_UNUSED(aop))
+{
+  while (n--) {
+    *op++ = quaternion_create_from_quaternionf(*ip++);
+  }
+}
+static void
+QUATERNION_to_quaternionf(quaternion *ip, quaternionf *op, npy_intp n,
+                          PyArrayObject *NPY_UNUSED(aip), PyArrayObject *NPY_UNUSED(aop))
+{
+  while (n--) {
+    *op++ = quaternionf_create_from_quaternion(*ip++);
+  }
+}
+
 static void register_cast_function(int sourceType, int destType, PyArray_VectorUnaryFunc *castfunc)
 {
   PyArray_Descr *descr = PyArray_DescrFromType(sourceType);
@@ -1083,16 +1448,14 @@ static void register_cast_function(int sourceType, int destType, PyArray_VectorU
 UNARY_UFUNC(isnan, npy_bool)
 UNARY_UFUNC(isinf, npy_bool)
 UNARY_UFUNC(isfinite, npy_bool)
-UNARY_UFUNC(norm, npy_double)
-UNARY_UFUNC(absolute, npy_double)
+UNARY_GEN_UFUNC(norm_strided, norm, npy_double)
+UNARY_GEN_UFUNC(absolute_strided, absolute, npy_double)
 UNARY_UFUNC(angle, npy_double)
 UNARY_UFUNC(sqrt, quaternion)
-UNARY_UFUNC(log, quaternion)
-UNARY_UFUNC(exp, quaternion)
 UNARY_UFUNC(negative, quaternion)
-UNARY_UFUNC(conjugate, quaternion)
+UNARY_GEN_UFUNC(conjugate_strided, conjugate, quaternion)
 UNARY_GEN_UFUNC(invert, inverse, quaternion)
-UNARY_UFUNC(normalized, quaternion)
+UNARY_GEN_UFUNC(normalized_strided, normalized, quaternion)
 UNARY_UFUNC(x_parity_conjugate, quaternion)
 UNARY_UFUNC(x_parity_symmetric_part, quaternion)
 UNARY_UFUNC(x_parity_antisymmetric_part, quaternion)
@@ -1132,13 +1495,11 @@ UNARY_UFUNC(parity_antisymmetric_part, quaternion)
   BINARY_GEN_UFUNC(name##_scalar, name##_scalar, quaternion, npy_double, ret_type) \
   BINARY_GEN_UFUNC(scalar_##name, scalar_##name, npy_double, quaternion, ret_type)
 // And these all do the work mentioned above, using the macros
-BINARY_UFUNC(add, quaternion)
+BINARY_GEN_UFUNC(add_strided, add, quaternion, quaternion, quaternion)
 BINARY_UFUNC(subtract, quaternion)
-BINARY_UFUNC(multiply, quaternion)
-BINARY_UFUNC(divide, quaternion)
-BINARY_GEN_UFUNC(true_divide, divide, quaternion, quaternion, quaternion)
-BINARY_GEN_UFUNC(floor_divide, divide, quaternion, quaternion, quaternion)
-BINARY_UFUNC(power, quaternion)
+BINARY_GEN_UFUNC(multiply_strided, multiply, quaternion, quaternion, quaternion)
+BINARY_GEN_UFUNC(divide_strided, divide, quaternion, quaternion, quaternion)
+BINARY_GEN_UFUNC(power_strided, power, quaternion, quaternion, quaternion)
 BINARY_UFUNC(copysign, quaternion)
 BINARY_UFUNC(equal, npy_bool)
 BINARY_UFUNC(not_equal, npy_bool)
@@ -1152,131 +1513,1953 @@ BINARY_GEN_UFUNC(true_divide_scalar, divide_scalar, quaternion, npy_double, quat
 BINARY_GEN_UFUNC(floor_divide_scalar, divide_scalar, quaternion, npy_double, quaternion)
 BINARY_GEN_UFUNC(scalar_true_divide, scalar_divide, npy_double, quaternion, quaternion)
 BINARY_GEN_UFUNC(scalar_floor_divide, scalar_divide, npy_double, quaternion, quaternion)
-BINARY_SCALAR_UFUNC(power, quaternion)
+BINARY_GEN_UFUNC(power_scalar_strided, power_scalar, quaternion, npy_double, quaternion)
+BINARY_GEN_UFUNC(scalar_power, scalar_power, npy_double, quaternion, quaternion)
 BINARY_UFUNC(rotor_intrinsic_distance, npy_double)
 BINARY_UFUNC(rotor_chordal_distance, npy_double)
 BINARY_UFUNC(rotation_intrinsic_distance, npy_double)
 BINARY_UFUNC(rotation_chordal_distance, npy_double)
 
 
-// Interface to the module-level slerp function
-static PyObject*
-pyquaternion_slerp_evaluate(PyObject *NPY_UNUSED(self), PyObject *args)
+// Loops over large arrays may be shared among the threads of the pool
+// in `quaternion_threads.h`, by calling the serial loop on contiguous
+// pieces of the outer dimension.  This must only be done when the
+// output does not partially overlap the inputs, so that the pieces are
+// independent.  Each piece holds at least `grain` elements, which are
+// chosen so that the cost of waking the threads is negligible: the
+// arithmetic is limited by memory bandwidth, and only large arrays
+// benefit, while the transcendental functions benefit much sooner.
+#define _QUATERNION_GRAIN_ARITHMETIC 32768
+#define _QUATERNION_GRAIN_TRANSCENDENTAL 1024
+#define _QUATERNION_PARALLEL_MAX_ARGS 12
+#define _QUATERNION_PARALLEL_MAX_CORE_DIMS 4
+// The loops in this file take non-const `dimensions` and `steps`, while
+// numpy's `PyUFuncGenericFunction` takes them as const in recent
+// versions; loops are handled with their own type, and converted with
+// `_QUATERNION_LOOP` only where they are given to numpy.
+typedef void (*_quaternion_loop_function)(char**, npy_intp*, npy_intp*, void*);
+#define _QUATERNION_LOOP(loop) ((PyUFuncGenericFunction)(loop))
+typedef struct {
+  _quaternion_loop_function loop;
+  int nargs;
+  int ncore;
+  char** args;
+  npy_intp* dimensions;
+  npy_intp* steps;
+  void* data;
+} _quaternion_parallel_ufunc;
+static void
+_quaternion_parallel_ufunc_task(void* context, ptrdiff_t start, ptrdiff_t stop)
 {
-  double tau;
-  PyObject* Q1 = {0};
-  PyObject* Q2 = {0};
-  PyQuaternion* Q = (PyQuaternion*)PyQuaternion_Type.tp_alloc(&PyQuaternion_Type,0);
-  if (!PyArg_ParseTuple(args, "OOd", &Q1, &Q2, &tau)) {
-    return NULL;
+  const _quaternion_parallel_ufunc* ufunc = (const _quaternion_parallel_ufunc*)context;
+  char* args[_QUATERNION_PARALLEL_MAX_ARGS];
+  npy_intp dimensions[1 + _QUATERNION_PARALLEL_MAX_CORE_DIMS];
+  int k;
+  dimensions[0] = stop - start;
+  for(k = 0; k < ufunc->ncore; k++) {
+    dimensions[1+k] = ufunc->dimensions[1+k];
   }
-  Q->obval = slerp(((PyQuaternion*)Q1)->obval, ((PyQuaternion*)Q2)->obval, tau);
-  return (PyObject*)Q;
-}
-
-// Interface to the evaluate a squad interpolant at a particular time
-static PyObject*
-pyquaternion_squad_evaluate(PyObject *NPY_UNUSED(self), PyObject *args)
-{
-  double tau_i;
-  PyObject* q_i = {0};
-  PyObject* a_i = {0};
-  PyObject* b_ip1 = {0};
-  PyObject* q_ip1 = {0};
-  PyQuaternion* Q = (PyQuaternion*)PyQuaternion_Type.tp_alloc(&PyQuaternion_Type,0);
-  if (!PyArg_ParseTuple(args, "dOOOO", &tau_i, &q_i, &a_i, &b_ip1, &q_ip1)) {
-    return NULL;
+  for(k = 0; k < ufunc->nargs; k++) {
+    args[k] = ufunc->args[k] + start*ufunc->steps[k];
   }
-  Q->obval = squad_evaluate(tau_i,
-                        ((PyQuaternion*)q_i)->obval, ((PyQuaternion*)a_i)->obval,
-                        ((PyQuaternion*)b_ip1)->obval, ((PyQuaternion*)q_ip1)->obval);
-  return (PyObject*)Q;
+  ufunc->loop(args, dimensions, ufunc->steps, ufunc->data);
 }
-
-// This will be used to create the ufunc needed for `slerp`, which
-// evaluates the interpolant at a point.  The method for doing this
-// was pieced together from examples given on the page
-// <https://docs.scipy.org/doc/numpy/user/c-info.ufunc-tutorial.html>
+// Generalized ufuncs whose loops read the sizes of `ncore` core
+// dimensions pass them through to each piece
 static void
-slerp_loop(char **args, npy_intp *dimensions, npy_intp* steps, void* NPY_UNUSED(data))
+_quaternion_parallel_gufunc_loop(_quaternion_loop_function loop, int nargs, int ncore, npy_intp grain,
+                                 char** args, npy_intp* dimensions, npy_intp* steps, void* data)
 {
-  npy_intp i;
-  double tau_i;
-  quaternion *q_1, *q_2;
-
-  npy_intp is1=steps[0];
-  npy_intp is2=steps[1];
-  npy_intp is3=steps[2];
-  npy_intp os=steps[3];
-  npy_intp n=dimensions[0];
-
-  char *i1=args[0];
-  char *i2=args[1];
-  char *i3=args[2];
-  char *op=args[3];
-
-  for (i = 0; i < n; i++) {
-    q_1 = (quaternion*)i1;
-    q_2 = (quaternion*)i2;
-    tau_i = *(double *)i3;
-
-    *((quaternion *)op) = slerp(*q_1, *q_2, tau_i);
-
-    i1 += is1;
-    i2 += is2;
-    i3 += is3;
-    op += os;
+  _quaternion_parallel_ufunc ufunc;
+  if(dimensions[0] < 2*grain) {
+    loop(args, dimensions, steps, data);
+    return;
   }
+  ufunc.loop = loop;
+  ufunc.nargs = nargs;
+  ufunc.ncore = ncore;
+  ufunc.args = args;
+  ufunc.dimensions = dimensions;
+  ufunc.steps = steps;
+  ufunc.data = data;
+  quaternion_parallel_for(dimensions[0], grain, _quaternion_parallel_ufunc_task, &ufunc);
 }
-
-// This will be used to create the ufunc needed for `squad`, which
-// evaluates the interpolant at a point.  The method for doing this
-// was pieced together from examples given on the page
-// <https://docs.scipy.org/doc/numpy/user/c-info.ufunc-tutorial.html>
 static void
-squad_loop(char **args, npy_intp *dimensions, npy_intp* steps, void* NPY_UNUSED(data))
+_quaternion_parallel_loop(_quaternion_loop_function loop, int nargs, npy_intp grain,
+                          char** args, npy_intp* dimensions, npy_intp* steps, void* data)
 {
-  npy_intp i;
-  double tau_i;
-  quaternion *q_i, *a_i, *b_ip1, *q_ip1;
-
-  npy_intp is1=steps[0];
-  npy_intp is2=steps[1];
-  npy_intp is3=steps[2];
-  npy_intp is4=steps[3];
-  npy_intp is5=steps[4];
-  npy_intp os=steps[5];
-  npy_intp n=dimensions[0];
-
-  char *i1=args[0];
-  char *i2=args[1];
-  char *i3=args[2];
-  char *i4=args[3];
-  char *i5=args[4];
-  char *op=args[5];
-
-  for (i = 0; i < n; i++) {
-    tau_i = *(double *)i1;
-    q_i = (quaternion*)i2;
-    a_i = (quaternion*)i3;
-    b_ip1 = (quaternion*)i4;
-    q_ip1 = (quaternion*)i5;
-
-    *((quaternion *)op) = squad_evaluate(tau_i, *q_i, *a_i, *b_ip1, *q_ip1);
-
-    i1 += is1;
-    i2 += is2;
-    i3 += is3;
-    i4 += is4;
-    i5 += is5;
-    op += os;
-  }
+  _quaternion_parallel_gufunc_loop(loop, nargs, 0, grain, args, dimensions, steps, data);
 }
 
 
-// This contains assorted other top-level methods for the module
-static PyMethodDef QuaternionMethods[] = {
-  {"slerp_evaluate", pyquaternion_slerp_evaluate, METH_VARARGS,
+// These macros define the ufunc loops for the most common operations
+// as dispatchers: when the operands are contiguous and the output does
+// not partially overlap an input (as it does for `accumulate`), the
+// work is handed to the block-wise kernels in `quaternion_simd.h`;
+// otherwise, the `_strided` loops defined above are used.
+#define _QUATERNION_NO_PARTIAL_OVERLAP(ip, op, n, size)                 \
+  ((ip) == (op) || (ip) + (n)*(size) <= (op) || (op) + (n)*(size) <= (ip))
+// numpy calls the binary loops for `reduce` with the output in place
+// of the first input, both with zero stride, and for `accumulate` with
+// the first input one element behind the output.  These patterns are
+// handled by loops that keep the running result in registers, rather
+// than storing and reloading it for each element.  The operations are
+// done in the same order as in the generic loops, so the results are
+// identical, and the order of the (non-commuting) products is preserved.
+#define _QUATERNION_IS_REDUCE(args, steps)                              \
+  ((args)[0] == (args)[2] && (steps)[0] == 0 && (steps)[2] == 0)
+#define _QUATERNION_IS_ACCUMULATE(args, steps)                          \
+  ((steps)[0] != 0 && (steps)[0] == (steps)[2] && (args)[0] + (steps)[0] == (args)[2])
+#define BINARY_REDUCE_UFUNC(ufunc_name, func_name)                      \
+  static void                                                           \
+  quaternion_##ufunc_name##_reduce_ufunc(char** args, npy_intp* dimensions, \
+                                         npy_intp* steps, void* NPY_UNUSED(data)) { \
+    char *ip2 = args[1];                                                \
+    npy_intp i, is2 = steps[1], n = dimensions[0];                      \
+    quaternion result = *(quaternion *)args[0];                         \
+    for(i = 0; i < n; i++, ip2 += is2) {                                \
+      result = quaternion_##func_name(result, *(quaternion *)ip2);      \
+    }                                                                   \
+    *(quaternion *)args[2] = result;                                    \
+  }                                                                     \
+  static void                                                           \
+  quaternion_##ufunc_name##_accumulate_ufunc(char** args, npy_intp* dimensions, \
+                                             npy_intp* steps, void* NPY_UNUSED(data)) { \
+    char *ip2 = args[1], *op1 = args[2];                                \
+    npy_intp i, is2 = steps[1], os1 = steps[2], n = dimensions[0];      \
+    quaternion result = *(quaternion *)args[0];                         \
+    for(i = 0; i < n; i++, ip2 += is2, op1 += os1) {                    \
+      result = quaternion_##func_name(result, *(quaternion *)ip2);      \
+      *(quaternion *)op1 = result;                                      \
+    }                                                                   \
+  }
+#define UNARY_CONTIGUOUS_UFUNC(ufunc_name, func_name, ret_type)         \
+  static void                                                           \
+  quaternion_##ufunc_name##_contiguous_ufunc(char** args, npy_intp* dimensions, \
+                                             npy_intp* NPY_UNUSED(steps), void* NPY_UNUSED(data)) { \
+    quaternion_##func_name##_contiguous((quaternion *)args[0], (ret_type *)args[1], dimensions[0]); \
+  }                                                                     \
+  static void                                                           \
+  quaternion_##ufunc_name##_ufunc(char** args, npy_intp* dimensions,    \
+                                  npy_intp* steps, void* data) {        \
+    char *ip1 = args[0], *op1 = args[1];                                \
+    npy_intp n = dimensions[0];                                         \
+    if(steps[0] == sizeof(quaternion) && steps[1] == sizeof(ret_type)   \
+       && _QUATERNION_NO_PARTIAL_OVERLAP(ip1, op1, n, sizeof(quaternion))) { \
+      _quaternion_parallel_loop(&quaternion_##ufunc_name##_contiguous_ufunc, 2, \
+                                _QUATERNION_GRAIN_ARITHMETIC, args, dimensions, steps, data); \
+    } else {                                                            \
+      quaternion_##ufunc_name##_strided_ufunc(args, dimensions, steps, data); \
+    }                                                                   \
+  }
+#define BINARY_CONTIGUOUS_UFUNC(ufunc_name, func_name)                  \
+  BINARY_REDUCE_UFUNC(ufunc_name, func_name)                            \
+  static void                                                           \
+  quaternion_##ufunc_name##_contiguous_ufunc(char** args, npy_intp* dimensions, \
+                                             npy_intp* NPY_UNUSED(steps), void* NPY_UNUSED(data)) { \
+    quaternion_##func_name##_contiguous((quaternion *)args[0], (quaternion *)args[1], \
+                                        (quaternion *)args[2], dimensions[0]); \
+  }                                                                     \
+  static void                                                           \
+  quaternion_##ufunc_name##_ufunc(char** args, npy_intp* dimensions,    \
+                                  npy_intp* steps, void* data) {        \
+    char *ip1 = args[0], *ip2 = args[1], *op1 = args[2];                \
+    npy_intp n = dimensions[0];                                         \
+    if(_QUATERNION_IS_REDUCE(args, steps)) {                            \
+      quaternion_##ufunc_name##_reduce_ufunc(args, dimensions, steps, data); \
+    } else if(_QUATERNION_IS_ACCUMULATE(args, steps)) {                 \
+      quaternion_##ufunc_name##_accumulate_ufunc(args, dimensions, steps, data); \
+    } else if(steps[0] == sizeof(quaternion) && steps[1] == sizeof(quaternion) \
+       && steps[2] == sizeof(quaternion)                                \
+       && _QUATERNION_NO_PARTIAL_OVERLAP(ip1, op1, n, sizeof(quaternion)) \
+       && _QUATERNION_NO_PARTIAL_OVERLAP(ip2, op1, n, sizeof(quaternion))) { \
+      _quaternion_parallel_loop(&quaternion_##ufunc_name##_contiguous_ufunc, 3, \
+                                _QUATERNION_GRAIN_ARITHMETIC, args, dimensions, steps, data); \
+    } else {                                                            \
+      quaternion_##func_name##_strided_ufunc(args, dimensions, steps, data); \
+    }                                                                   \
+  }
+UNARY_CONTIGUOUS_UFUNC(norm, norm, npy_double)
+UNARY_CONTIGUOUS_UFUNC(absolute, absolute, npy_double)
+UNARY_CONTIGUOUS_UFUNC(conjugate, conjugate, quaternion)
+UNARY_CONTIGUOUS_UFUNC(normalized, normalized, quaternion)
+BINARY_CONTIGUOUS_UFUNC(add, add)
+BINARY_CONTIGUOUS_UFUNC(multiply, multiply)
+BINARY_CONTIGUOUS_UFUNC(divide, divide)
+BINARY_CONTIGUOUS_UFUNC(true_divide, divide)
+BINARY_CONTIGUOUS_UFUNC(floor_divide, divide)
+
+
+// The transcendental functions are evaluated in blocks by the batched
+// kernels in `quaternion_simd.h`, whatever the strides.  Those kernels
+// allow the output to coincide with an input, but not to partially
+// overlap it, so the binary loops check for that (as happens in
+// `accumulate`) and fall back to the `_strided` loops.  Only loops
+// without partial overlap are shared among threads.
+static NPY_INLINE int
+_quaternion_batch_no_partial_overlap(const char* ip, npy_intp is, const char* op, npy_intp os,
+                                     npy_intp n, npy_intp size)
+{
+  const char *ip_lo = ip, *ip_hi = ip, *op_lo = op, *op_hi = op;
+  if(ip == op && is == os) {
+    return 1;
+  }
+  if(n > 0) {
+    if(is < 0) { ip_lo += (n-1)*is; } else { ip_hi += (n-1)*is; }
+    if(os < 0) { op_lo += (n-1)*os; } else { op_hi += (n-1)*os; }
+  }
+  return (ip_hi + size <= op_lo) || (op_hi + size <= ip_lo);
+}
+#define UNARY_BATCH_UFUNC(name)                                         \
+  static void                                                           \
+  quaternion_##name##_batch_ufunc(char** args, npy_intp* dimensions,    \
+                                  npy_intp* steps, void* NPY_UNUSED(data)) { \
+    quaternion_##name##_batch(args[0], steps[0], args[1], steps[1], dimensions[0]); \
+  }                                                                     \
+  static void                                                           \
+  quaternion_##name##_ufunc(char** args, npy_intp* dimensions,          \
+                            npy_intp* steps, void* data) {              \
+    if(_quaternion_batch_no_partial_overlap(args[0], steps[0], args[1], steps[1], \
+                                            dimensions[0], sizeof(quaternion))) { \
+      _quaternion_parallel_loop(&quaternion_##name##_batch_ufunc, 2,    \
+                                _QUATERNION_GRAIN_TRANSCENDENTAL, args, dimensions, steps, data); \
+    } else {                                                            \
+      quaternion_##name##_batch_ufunc(args, dimensions, steps, data);   \
+    }                                                                   \
+  }
+#define BINARY_BATCH_UFUNC(name, arg_type2)                             \
+  static void                                                           \
+  quaternion_##name##_batch_ufunc(char** args, npy_intp* dimensions,    \
+                                  npy_intp* steps, void* NPY_UNUSED(data)) { \
+    quaternion_##name##_batch(args[0], steps[0], args[1], steps[1], args[2], steps[2], dimensions[0]); \
+  }                                                                     \
+  static void                                                           \
+  quaternion_##name##_ufunc(char** args, npy_intp* dimensions,          \
+                            npy_intp* steps, void* data) {              \
+    char *ip1 = args[0], *ip2 = args[1], *op1 = args[2];                \
+    npy_intp n = dimensions[0];                                         \
+    if(_quaternion_batch_no_partial_overlap(ip1, steps[0], op1, steps[2], n, sizeof(quaternion)) \
+       && _quaternion_batch_no_partial_overlap(ip2, steps[1], op1, steps[2], n, sizeof(arg_type2))) { \
+      _quaternion_parallel_loop(&quaternion_##name##_batch_ufunc, 3,    \
+                                _QUATERNION_GRAIN_TRANSCENDENTAL, args, dimensions, steps, data); \
+    } else {                                                            \
+      quaternion_##name##_strided_ufunc(args, dimensions, steps, data); \
+    }                                                                   \
+  }
+UNARY_BATCH_UFUNC(log)
+UNARY_BATCH_UFUNC(exp)
+BINARY_BATCH_UFUNC(power, quaternion)
+BINARY_BATCH_UFUNC(power_scalar, npy_double)
+
+
+// Interface to the module-level slerp function
+static PyObject*
+pyquaternion_slerp_evaluate(PyObject *NPY_UNUSED(self), PyObject *args)
+{
+  double tau;
+  PyObject* Q1 = {0};
+  PyObject* Q2 = {0};
+  if (!PyArg_ParseTuple(args, "OOd", &Q1, &Q2, &tau)) {
+    return NULL;
+  }
+  return PyQuaternion_FromQuaternion(slerp(((PyQuaternion*)Q1)->obval, ((PyQuaternion*)Q2)->obval, tau));
+}
+
+// Interface to the evaluate a squad interpolant at a particular time
+static PyObject*
+pyquaternion_squad_evaluate(PyObject *NPY_UNUSED(self), PyObject *args)
+{
+  double tau_i;
+  PyObject* q_i = {0};
+  PyObject* a_i = {0};
+  PyObject* b_ip1 = {0};
+  PyObject* q_ip1 = {0};
+  if (!PyArg_ParseTuple(args, "dOOOO", &tau_i, &q_i, &a_i, &b_ip1, &q_ip1)) {
+    return NULL;
+  }
+  return PyQuaternion_FromQuaternion(squad_evaluate(tau_i,
+                                                    ((PyQuaternion*)q_i)->obval, ((PyQuaternion*)a_i)->obval,
+                                                    ((PyQuaternion*)b_ip1)->obval, ((PyQuaternion*)q_ip1)->obval));
+}
+
+// This will be used to create the ufunc needed for `slerp`, which
+// evaluates the interpolant at a point.  The method for doing this
+// was pieced together from examples given on the page
+// <https://docs.scipy.org/doc/numpy/user/c-info.ufunc-tutorial.html>
+static void
+slerp_batch_loop(char **args, npy_intp *dimensions, npy_intp* steps, void* NPY_UNUSED(data))
+{
+  quaternion_slerp_batch(args[0], steps[0], args[1], steps[1], args[2], steps[2],
+                         args[3], steps[3], dimensions[0]);
+}
+static void
+slerp_loop(char **args, npy_intp *dimensions, npy_intp* steps, void* data)
+{
+  const npy_intp n = dimensions[0];
+  if(_quaternion_batch_no_partial_overlap(args[0], steps[0], args[3], steps[3], n, sizeof(quaternion))
+     && _quaternion_batch_no_partial_overlap(args[1], steps[1], args[3], steps[3], n, sizeof(quaternion))
+     && _quaternion_batch_no_partial_overlap(args[2], steps[2], args[3], steps[3], n, sizeof(double))) {
+    _quaternion_parallel_loop(&slerp_batch_loop, 4, _QUATERNION_GRAIN_TRANSCENDENTAL, args, dimensions, steps, data);
+  } else {
+    slerp_batch_loop(args, dimensions, steps, data);
+  }
+}
+
+// The closed-form version of `slerp` for unit rotors.  When the same
+// pair of rotors is broadcast against an array of tau (as in
+// `quaternion.slerp`), the angle between them is found just once.
+static void
+slerp_unit_loop(char **args, npy_intp *dimensions, npy_intp* steps, void* NPY_UNUSED(data))
+{
+  if(steps[0] == 0 && steps[1] == 0) {
+    quaternion_slerp_unit_segment_batch(args[0], args[1], args[2], steps[2], args[3], steps[3], dimensions[0]);
+  } else {
+    quaternion_slerp_unit_batch(args[0], steps[0], args[1], steps[1], args[2], steps[2],
+                                args[3], steps[3], dimensions[0]);
+  }
+}
+
+// The generalized ufunc with signature `(),(),(n)->(n)`, evaluating
+// each segment between a pair of unit rotors at many values of tau
+static void
+slerp_unit_segment_loop(char **args, npy_intp *dimensions, npy_intp* steps, void* NPY_UNUSED(data))
+{
+  npy_intp i;
+  npy_intp n_outer = dimensions[0], n = dimensions[1];
+  npy_intp is1 = steps[0], is2 = steps[1], is3 = steps[2], os = steps[3];
+  npy_intp is3_n = steps[4], os_n = steps[5];
+  char *i1 = args[0], *i2 = args[1], *i3 = args[2], *op = args[3];
+  for(i = 0; i < n_outer; i++, i1 += is1, i2 += is2, i3 += is3, op += os) {
+    quaternion_slerp_unit_segment_batch(i1, i2, i3, is3_n, op, os_n, n);
+  }
+}
+
+// This will be used to create the ufunc needed for `squad`, which
+// evaluates the interpolant at a point.  The method for doing this
+// was pieced together from examples given on the page
+// <https://docs.scipy.org/doc/numpy/user/c-info.ufunc-tutorial.html>
+static void
+squad_batch_loop(char **args, npy_intp *dimensions, npy_intp* steps, void* NPY_UNUSED(data))
+{
+  quaternion_squad_batch(args[0], steps[0], args[1], steps[1], args[2], steps[2],
+                         args[3], steps[3], args[4], steps[4], args[5], steps[5], dimensions[0]);
+}
+static void
+squad_loop(char **args, npy_intp *dimensions, npy_intp* steps, void* data)
+{
+  const npy_intp n = dimensions[0];
+  int k, independent = _quaternion_batch_no_partial_overlap(args[0], steps[0], args[5], steps[5], n, sizeof(double));
+  for(k = 1; k < 5 && independent; k++) {
+    independent = _quaternion_batch_no_partial_overlap(args[k], steps[k], args[5], steps[5], n, sizeof(quaternion));
+  }
+  if(independent) {
+    _quaternion_parallel_loop(&squad_batch_loop, 6, _QUATERNION_GRAIN_TRANSCENDENTAL, args, dimensions, steps, data);
+  } else {
+    squad_batch_loop(args, dimensions, steps, data);
+  }
+}
+
+// The generalized ufunc with signature `(n),(n)->(n),(n)`, computing
+// the control points `A_i` and `B_ip1` used by `squad` in a single pass.
+// Each log(~R[i] * R[i+1]) is needed for four control points, so the two
+// most recent are kept as the loop moves along the series.  The first
+// and last two points are the values obtained by extending R_in past
+// its ends, as described in `quaternion.squad`.
+static void
+squad_coefficients_loop(char **args, npy_intp *dimensions, npy_intp* steps, void* NPY_UNUSED(data))
+{
+  npy_intp i_outer, i;
+  npy_intp n_outer = dimensions[0], n = dimensions[1];
+  npy_intp is1 = steps[0], is2 = steps[1], os1 = steps[2], os2 = steps[3];
+  npy_intp is1_n = steps[4], is2_n = steps[5], os1_n = steps[6], os2_n = steps[7];
+  char *i1 = args[0], *i2 = args[1], *o1 = args[2], *o2 = args[3];
+  #define _R(i) (*(quaternion *)(i1 + (i)*is1_n))
+  #define _T(i) (*(double *)(i2 + (i)*is2_n))
+  #define _A(i) (*(quaternion *)(o1 + (i)*os1_n))
+  #define _B(i) (*(quaternion *)(o2 + (i)*os2_n))
+  for(i_outer = 0; i_outer < n_outer; i_outer++, i1 += is1, i2 += is2, o1 += os1, o2 += os2) {
+    quaternion log_prev, log_next, R_i, R_next;
+    double t_prev, t_i, t_next;
+    if(n < 2) {
+      if(n == 1) {
+        R_i = _R(0);
+        _A(0) = R_i;
+        _B(0) = R_i;
+      }
+      continue;
+    }
+    R_i = _R(0);
+    R_next = _R(1);
+    t_i = _T(0);
+    t_next = _T(1);
+    log_next = quaternion_log(quaternion_multiply(quaternion_inverse(R_i), R_next));
+    _A(0) = R_i;
+    for(i = 1; i < n-1; i++) {
+      R_i = R_next;
+      R_next = _R(i+1);
+      t_prev = t_i;
+      t_i = t_next;
+      t_next = _T(i+1);
+      log_prev = log_next;
+      log_next = quaternion_log(quaternion_multiply(quaternion_inverse(R_i), R_next));
+      _A(i) = quaternion_multiply(R_i, quaternion_exp(quaternion_multiply_scalar(
+          quaternion_add(quaternion_negative(log_next),
+                         quaternion_multiply_scalar(log_prev, (t_next - t_i) / (t_i - t_prev))),
+          0.25)));
+      _B(i-1) = quaternion_multiply(R_i, quaternion_exp(quaternion_multiply_scalar(
+          quaternion_subtract(quaternion_multiply_scalar(log_next, (t_i - t_prev) / (t_next - t_i)),
+                              log_prev),
+          -0.25)));
+    }
+    _A(n-1) = R_next;
+    _B(n-2) = R_next;
+    _B(n-1) = quaternion_multiply(quaternion_multiply(R_next, quaternion_inverse(R_i)), R_next);
+  }
+  #undef _B
+  #undef _A
+  #undef _T
+  #undef _R
+}
+
+// These are the generalized ufuncs with signatures
+// `(n),(n),(n),(n),(m)->(m)` and `(n),(n),(n),(n),(m)->(m,3)`, which
+// evaluate the squad interpolant of (R_in, t_in), with control points
+// (A, B) from `squad_coefficients`, and its angular velocity, at the
+// times t_out.  Each t_out is placed in the segment i with
+// t_in[i] <= t_out < t_in[i+1], or the first or last segment for times
+// outside t_in, with the last segment extended as in `quaternion.squad`.
+// When t_out is sorted, the segments are found by walking along t_in;
+// otherwise, by bisection.  Points are gathered in chunks, so that the
+// values can be evaluated by the batched kernels.
+#define _SQUAD_INTERPOLATION_CHUNK 64
+typedef struct {
+  const char *R, *t, *A, *B;
+  npy_intp R_step, t_step, A_step, B_step;
+  npy_intp n;
+  npy_intp segment;
+  int sorted;
+} _squad_interpolation_state;
+static void
+_squad_interpolation_points(_squad_interpolation_state* s, const char* t_out, npy_intp t_out_step, npy_intp m,
+                            double* tau, double* dt, quaternion* q_i, quaternion* a_i, quaternion* b_ip1,
+                            quaternion* q_ip1)
+{
+  #define _T(i) (*(const double *)(s->t + (i)*s->t_step))
+  #define _Q(p, i) (*(const quaternion *)(s->p + (i)*s->p##_step))
+  npy_intp k, i = s->segment, n = s->n;
+  for(k = 0; k < m; k++) {
+    const double t = *(const double *)(t_out + k*t_out_step);
+    double t_i, t_ip1;
+    if(s->sorted) {
+      while(i < n-1 && _T(i+1) <= t) {
+        i++;
+      }
+    } else {
+      npy_intp lo = 0, hi = n;
+      while(lo < hi) {
+        const npy_intp mid = lo + (hi-lo)/2;
+        if(_T(mid) <= t) {
+          lo = mid+1;
+        } else {
+          hi = mid;
+        }
+      }
+      i = (lo > 0) ? lo-1 : 0;
+    }
+    t_i = _T(i);
+    q_i[k] = _Q(R, i);
+    a_i[k] = _Q(A, i);
+    b_ip1[k] = _Q(B, i);
+    if(i < n-1) {
+      q_ip1[k] = _Q(R, i+1);
+      t_ip1 = _T(i+1);
+    } else {
+      q_ip1[k] = _Q(B, n-1);
+      t_ip1 = t_i + (t_i - _T(n-2));
+    }
+    dt[k] = t_ip1 - t_i;
+    tau[k] = (t - t_i) / dt[k];
+  }
+  s->segment = i;
+  #undef _Q
+  #undef _T
+}
+static int
+_squad_interpolation_init(_squad_interpolation_state* s, char** args, npy_intp* dimensions, npy_intp* steps)
+{
+  npy_intp k;
+  const npy_intp m = dimensions[2];
+  const char* t_out = args[4];
+  s->R = args[0];
+  s->t = args[1];
+  s->A = args[2];
+  s->B = args[3];
+  s->R_step = steps[6];
+  s->t_step = steps[7];
+  s->A_step = steps[8];
+  s->B_step = steps[9];
+  s->n = dimensions[1];
+  s->segment = 0;
+  s->sorted = 1;
+  if(s->n < 2) {
+    return 0;
+  }
+  for(k = 1; k < m && s->sorted; k++) {
+    s->sorted = (*(const double *)(t_out + k*steps[10]) >= *(const double *)(t_out + (k-1)*steps[10]));
+  }
+  return 1;
+}
+static void
+squad_interpolate_loop(char **args, npy_intp *dimensions, npy_intp* steps, void* NPY_UNUSED(data))
+{
+  npy_intp i_outer, k, m = dimensions[2];
+  _squad_interpolation_state s;
+  double tau[_SQUAD_INTERPOLATION_CHUNK], dt[_SQUAD_INTERPOLATION_CHUNK];
+  quaternion q_i[_SQUAD_INTERPOLATION_CHUNK], a_i[_SQUAD_INTERPOLATION_CHUNK];
+  quaternion b_ip1[_SQUAD_INTERPOLATION_CHUNK], q_ip1[_SQUAD_INTERPOLATION_CHUNK];
+  for(i_outer = 0; i_outer < dimensions[0]; i_outer++) {
+    char *t_out = args[4], *op = args[5];
+    if(!_squad_interpolation_init(&s, args, dimensions, steps)) {
+      const quaternion nan = {NPY_NAN, NPY_NAN, NPY_NAN, NPY_NAN};
+      for(k = 0; k < m; k++) {
+        *(quaternion *)(op + k*steps[11]) = nan;
+      }
+    } else {
+      for(k = 0; k < m; k += _SQUAD_INTERPOLATION_CHUNK) {
+        const npy_intp chunk = (m-k < _SQUAD_INTERPOLATION_CHUNK) ? m-k : _SQUAD_INTERPOLATION_CHUNK;
+        _squad_interpolation_points(&s, t_out + k*steps[10], steps[10], chunk, tau, dt, q_i, a_i, b_ip1, q_ip1);
+        quaternion_squad_batch((char *)tau, sizeof(double), (char *)q_i, sizeof(quaternion),
+                               (char *)a_i, sizeof(quaternion), (char *)b_ip1, sizeof(quaternion),
+                               (char *)q_ip1, sizeof(quaternion), op + k*steps[11], steps[11], chunk);
+      }
+    }
+    for(k = 0; k < 6; k++) {
+      args[k] += steps[k];
+    }
+  }
+}
+static void
+squad_angular_velocity_loop(char **args, npy_intp *dimensions, npy_intp* steps, void* NPY_UNUSED(data))
+{
+  npy_intp i_outer, k, j, m = dimensions[2];
+  _squad_interpolation_state s;
+  double tau[_SQUAD_INTERPOLATION_CHUNK], dt[_SQUAD_INTERPOLATION_CHUNK];
+  quaternion q_i[_SQUAD_INTERPOLATION_CHUNK], a_i[_SQUAD_INTERPOLATION_CHUNK];
+  quaternion b_ip1[_SQUAD_INTERPOLATION_CHUNK], q_ip1[_SQUAD_INTERPOLATION_CHUNK];
+  for(i_outer = 0; i_outer < dimensions[0]; i_outer++) {
+    char *t_out = args[4], *op = args[5];
+    if(!_squad_interpolation_init(&s, args, dimensions, steps)) {
+      for(k = 0; k < m; k++) {
+        for(j = 0; j < 3; j++) {
+          *(double *)(op + k*steps[11] + j*steps[12]) = NPY_NAN;
+        }
+      }
+    } else {
+      for(k = 0; k < m; k += _SQUAD_INTERPOLATION_CHUNK) {
+        const npy_intp chunk = (m-k < _SQUAD_INTERPOLATION_CHUNK) ? m-k : _SQUAD_INTERPOLATION_CHUNK;
+        _squad_interpolation_points(&s, t_out + k*steps[10], steps[10], chunk, tau, dt, q_i, a_i, b_ip1, q_ip1);
+        for(j = 0; j < chunk; j++) {
+          const quaternion omega = squad_angular_velocity(tau[j], q_i[j], a_i[j], b_ip1[j], q_ip1[j]);
+          char *o = op + (k+j)*steps[11];
+          *(double *)(o) = omega.x / dt[j];
+          *(double *)(o + steps[12]) = omega.y / dt[j];
+          *(double *)(o + 2*steps[12]) = omega.z / dt[j];
+        }
+      }
+    }
+    for(k = 0; k < 6; k++) {
+      args[k] += steps[k];
+    }
+  }
+}
+
+// These are the generalized ufuncs with signatures `(n),(),()->()` and
+// `(n),(),()->(n)`, computing the ordered product q[0]*q[1]*...*q[n-1]
+// along the final axis, and its partial products.  The second input is
+// the number of multiplications after which the running product is
+// normalized (to control the drift of long chains of rotors away from
+// unit norm), or 0 for never.  The third is the size of the blocks for
+// the tree mode, or 0 for a simple sequential product.  In the tree
+// mode, the product of each block is computed independently -- by
+// several threads, when the pool is enabled -- and the block products
+// are then combined in order; for the partial products, the product of
+// all preceding blocks is then multiplied onto each partial product
+// within the block.  The grouping depends only on the block size, so
+// the results do not depend on the number of threads.
+typedef struct {
+  const char* ip;
+  npy_intp is;
+  char* op;
+  npy_intp os;
+  npy_intp n;
+  npy_intp block;
+  npy_intp renormalize;
+  quaternion* prefix;
+} _quaternion_product_state;
+static quaternion
+_quaternion_product(const char* ip, npy_intp is, char* op, npy_intp os, npy_intp n, npy_intp renormalize,
+                    const quaternion* prefix)
+{
+  npy_intp i, count = 0;
+  quaternion result = *(const quaternion *)ip;
+  if(op != NULL) {
+    *(quaternion *)op = (prefix != NULL) ? quaternion_multiply(*prefix, result) : result;
+  }
+  for(i = 1; i < n; i++) {
+    result = quaternion_multiply(result, *(const quaternion *)(ip + i*is));
+    if(renormalize > 0 && ++count == renormalize) {
+      result = quaternion_normalized(result);
+      count = 0;
+    }
+    if(op != NULL) {
+      *(quaternion *)(op + i*os) = (prefix != NULL) ? quaternion_multiply(*prefix, result) : result;
+    }
+  }
+  return result;
+}
+static void
+_quaternion_product_blocks_task(void* context, ptrdiff_t start, ptrdiff_t stop)
+{
+  _quaternion_product_state* s = (_quaternion_product_state*)context;
+  ptrdiff_t k;
+  for(k = start; k < stop; k++) {
+    const npy_intp begin = k*s->block;
+    const npy_intp size = (s->n - begin < s->block) ? s->n - begin : s->block;
+    s->prefix[k] = _quaternion_product(s->ip + begin*s->is, s->is, NULL, 0, size, s->renormalize, NULL);
+  }
+}
+static void
+_quaternion_partial_products_blocks_task(void* context, ptrdiff_t start, ptrdiff_t stop)
+{
+  _quaternion_product_state* s = (_quaternion_product_state*)context;
+  ptrdiff_t k;
+  for(k = start; k < stop; k++) {
+    const npy_intp begin = k*s->block;
+    const npy_intp size = (s->n - begin < s->block) ? s->n - begin : s->block;
+    _quaternion_product(s->ip + begin*s->is, s->is, s->op + begin*s->os, s->os, size, s->renormalize,
+                        (k > 0) ? &s->prefix[k] : NULL);
+  }
+}
+// Combine the products of the blocks in place, so that prefix[k] holds
+// the product of blocks 0 through k-1 (for k > 0); returns the total
+static quaternion
+_quaternion_product_combine_blocks(quaternion* prefix, npy_intp n_blocks, npy_intp renormalize)
+{
+  npy_intp k, count = 0;
+  quaternion result = prefix[0];
+  for(k = 1; k < n_blocks; k++) {
+    const quaternion block = prefix[k];
+    prefix[k] = result;
+    result = quaternion_multiply(result, block);
+    if(renormalize > 0 && ++count == renormalize) {
+      result = quaternion_normalized(result);
+      count = 0;
+    }
+  }
+  return result;
+}
+// Set up the tree mode, with blocks of `block` elements, or return 0 if
+// the sequential product should be used instead
+static int
+_quaternion_product_blocks(_quaternion_product_state* s, npy_intp block, npy_intp* n_blocks)
+{
+  if(block <= 0 || s->n <= block) {
+    return 0;
+  }
+  s->block = block;
+  *n_blocks = (s->n + block - 1) / block;
+  s->prefix = (quaternion *)malloc((*n_blocks) * sizeof(quaternion));
+  return (s->prefix != NULL);
+}
+#define _QUATERNION_GRAIN_PRODUCT 8192
+static void
+product_loop(char **args, npy_intp *dimensions, npy_intp* steps, void* NPY_UNUSED(data))
+{
+  npy_intp i_outer, n_blocks;
+  _quaternion_product_state s;
+  for(i_outer = 0; i_outer < dimensions[0]; i_outer++) {
+    const npy_intp renormalize = *(npy_int64 *)args[1], block = *(npy_int64 *)args[2];
+    s.ip = args[0];
+    s.is = steps[4];
+    s.n = dimensions[1];
+    s.renormalize = renormalize;
+    if(s.n == 0) {
+      quaternion one = {1.0, 0.0, 0.0, 0.0};
+      *(quaternion *)args[3] = one;
+    } else if(_quaternion_product_blocks(&s, block, &n_blocks)) {
+      quaternion_parallel_for(n_blocks, 1 + _QUATERNION_GRAIN_PRODUCT/s.block, _quaternion_product_blocks_task, &s);
+      *(quaternion *)args[3] = _quaternion_product_combine_blocks(s.prefix, n_blocks, renormalize);
+      free(s.prefix);
+    } else {
+      *(quaternion *)args[3] = _quaternion_product(s.ip, s.is, NULL, 0, s.n, renormalize, NULL);
+    }
+    args[0] += steps[0];
+    args[1] += steps[1];
+    args[2] += steps[2];
+    args[3] += steps[3];
+  }
+}
+static void
+cumulative_product_loop(char **args, npy_intp *dimensions, npy_intp* steps, void* NPY_UNUSED(data))
+{
+  npy_intp i_outer, n_blocks;
+  _quaternion_product_state s;
+  for(i_outer = 0; i_outer < dimensions[0]; i_outer++) {
+    const npy_intp renormalize = *(npy_int64 *)args[1], block = *(npy_int64 *)args[2];
+    s.ip = args[0];
+    s.is = steps[4];
+    s.op = args[3];
+    s.os = steps[5];
+    s.n = dimensions[1];
+    s.renormalize = renormalize;
+    if(s.n == 0) {
+      // Nothing to do
+    } else if(_quaternion_product_blocks(&s, block, &n_blocks)) {
+      quaternion_parallel_for(n_blocks, 1 + _QUATERNION_GRAIN_PRODUCT/s.block, _quaternion_product_blocks_task, &s);
+      _quaternion_product_combine_blocks(s.prefix, n_blocks, renormalize);
+      quaternion_parallel_for(n_blocks, 1 + _QUATERNION_GRAIN_PRODUCT/s.block,
+                              _quaternion_partial_products_blocks_task, &s);
+      free(s.prefix);
+    } else {
+      _quaternion_product(s.ip, s.is, s.op, s.os, s.n, renormalize, NULL);
+    }
+    args[0] += steps[0];
+    args[1] += steps[1];
+    args[2] += steps[2];
+    args[3] += steps[3];
+  }
+}
+
+// The Karcher mean of rotors is the rotor minimizing the weighted sum
+// of squared intrinsic distances to the inputs.  Starting from the
+// chordal mean (the normalized weighted sum), each iteration averages
+// the logarithms of the inputs relative to the current mean, and moves
+// the mean along that average tangent vector with the exponential map.
+// This stops when the step is no larger than `tolerance`, and returns
+// the number of iterations taken, or -1 if `max_iterations` steps did
+// not converge.  The mean of no rotors, or with zero total weight, is
+// NaN.
+static npy_int64
+_quaternion_karcher_mean(const char* ip, npy_intp is, const char* wp, npy_intp ws, npy_intp n,
+                         double tolerance, npy_int64 max_iterations, quaternion* mean)
+{
+  npy_intp i;
+  npy_int64 iteration;
+  double total_weight = 0.0;
+  quaternion sum = {0.0, 0.0, 0.0, 0.0};
+  for(i = 0; i < n; i++) {
+    const double w = *(const double *)(wp + i*ws);
+    const quaternion q = *(const quaternion *)(ip + i*is);
+    sum.w += w*q.w;
+    sum.x += w*q.x;
+    sum.y += w*q.y;
+    sum.z += w*q.z;
+    total_weight += w;
+  }
+  if(n == 0 || total_weight == 0.0) {
+    mean->w = mean->x = mean->y = mean->z = NPY_NAN;
+    return 0;
+  }
+  if(quaternion_norm(sum) == 0.0) {
+    // The inputs cancel exactly, so any input is as good a start as any
+    sum = *(const quaternion *)ip;
+  }
+  *mean = quaternion_normalized(sum);
+  for(iteration = 1; iteration <= max_iterations; iteration++) {
+    const quaternion mean_bar = quaternion_conjugate(*mean);
+    quaternion step = {0.0, 0.0, 0.0, 0.0};
+    for(i = 0; i < n; i++) {
+      const double w = *(const double *)(wp + i*ws);
+      const quaternion l = quaternion_log(quaternion_multiply(mean_bar, *(const quaternion *)(ip + i*is)));
+      step.x += w*l.x;
+      step.y += w*l.y;
+      step.z += w*l.z;
+    }
+    step.x /= total_weight;
+    step.y /= total_weight;
+    step.z /= total_weight;
+    *mean = quaternion_normalized(quaternion_multiply(*mean, quaternion_exp(step)));
+    if(sqrt(step.x*step.x + step.y*step.y + step.z*step.z) <= tolerance) {
+      return iteration;
+    }
+  }
+  return -1;
+}
+static void
+karcher_mean_serial_loop(char **args, npy_intp *dimensions, npy_intp* steps, void* NPY_UNUSED(data))
+{
+  // Steps are indexed as: 0-5 for the outer loop over R, weights,
+  // tolerance, max_iterations, mean, and iterations; 6 and 7 for R and
+  // weights along the core dimension
+  npy_intp i_outer;
+  for(i_outer = 0; i_outer < dimensions[0]; i_outer++) {
+    *(npy_int64 *)args[5] = _quaternion_karcher_mean(args[0], steps[6], args[1], steps[7], dimensions[1],
+                                                     *(double *)args[2], *(npy_int64 *)args[3],
+                                                     (quaternion *)args[4]);
+    args[0] += steps[0];
+    args[1] += steps[1];
+    args[2] += steps[2];
+    args[3] += steps[3];
+    args[4] += steps[4];
+    args[5] += steps[5];
+  }
+}
+static void
+karcher_mean_loop(char **args, npy_intp *dimensions, npy_intp* steps, void* data)
+{
+  // Independent means are shared among threads; each costs a few
+  // transcendental functions per input rotor per iteration
+  _quaternion_parallel_gufunc_loop(&karcher_mean_serial_loop, 6, 1,
+                                   1 + _QUATERNION_GRAIN_TRANSCENDENTAL/(dimensions[1]+1),
+                                   args, dimensions, steps, data);
+}
+
+// Integrate dR/dt = Omega R / 2 from R0 at t[0] through the times t,
+// with one step of the fourth-order Runge-Kutta-Munthe-Kaas method per
+// interval, given the angular velocity at the times t and at the
+// midpoints of the intervals.  If no midpoints are given, the angular
+// velocity is interpolated to each midpoint by the cubic through the
+// two samples on each side (or the four samples nearest the interval,
+// at the ends), or averaged if there are fewer than four samples.
+// Each step multiplies by a rotor, so the norm of R is preserved.
+// Independent trajectories are shared among threads.
+static quaternion
+_quaternion_angular_velocity_midpoint(const char* t, npy_intp t_step, const char* Omega, npy_intp Omega_step,
+                                      npy_intp Omega_component_step, npy_intp n, npy_intp i)
+{
+  quaternion r = {0.0, 0.0, 0.0, 0.0};
+  if(n < 4) {
+    const char* a = Omega + i*Omega_step;
+    const char* b = a + Omega_step;
+    r.x = (*(double *)a + *(double *)b) / 2;
+    r.y = (*(double *)(a + Omega_component_step) + *(double *)(b + Omega_component_step)) / 2;
+    r.z = (*(double *)(a + 2*Omega_component_step) + *(double *)(b + 2*Omega_component_step)) / 2;
+  } else {
+    const npy_intp first = (i < 1) ? 0 : ((i-1 > n-4) ? n-4 : i-1);
+    const double t_mid = (*(double *)(t + i*t_step) + *(double *)(t + (i+1)*t_step)) / 2;
+    double nodes[4];
+    int j, k;
+    for(j = 0; j < 4; j++) {
+      nodes[j] = *(double *)(t + (first+j)*t_step);
+    }
+    for(j = 0; j < 4; j++) {
+      const char* a = Omega + (first+j)*Omega_step;
+      double numerator = 1.0, denominator = 1.0, w;
+      for(k = 0; k < 4; k++) {
+        if(k != j) {
+          numerator *= t_mid - nodes[k];
+          denominator *= nodes[j] - nodes[k];
+        }
+      }
+      w = numerator / denominator;
+      r.x += w * *(double *)a;
+      r.y += w * *(double *)(a + Omega_component_step);
+      r.z += w * *(double *)(a + 2*Omega_component_step);
+    }
+  }
+  return r;
+}
+static void
+integrate_angular_velocity_serial_loop(char **args, npy_intp *dimensions, npy_intp* steps, void* NPY_UNUSED(data))
+{
+  // Steps are indexed as: 0-4 for the outer loop over t, Omega,
+  // Omega_mid, R0, and R; 5 for t; 6 and 7 for Omega; 8 and 9 for
+  // Omega_mid; 10 for R
+  npy_intp i_outer, i;
+  const npy_intp n = dimensions[1], m = dimensions[3];
+  for(i_outer = 0; i_outer < dimensions[0]; i_outer++) {
+    const char *t = args[0], *Omega = args[1], *Omega_mid = args[2];
+    char *R = args[4];
+    quaternion R_i = *(quaternion *)args[3];
+    quaternion Omega_i, Omega_half, Omega_ip1 = {0.0, 0.0, 0.0, 0.0};
+    if(n > 0) {
+      Omega_ip1.x = *(double *)Omega;
+      Omega_ip1.y = *(double *)(Omega + steps[7]);
+      Omega_ip1.z = *(double *)(Omega + 2*steps[7]);
+      *(quaternion *)R = R_i;
+    }
+    for(i = 1; i < n; i++) {
+      const double h = *(double *)(t + i*steps[5]) - *(double *)(t + (i-1)*steps[5]);
+      const char* Omega_mid_i = Omega_mid + (i-1)*steps[8];
+      const char* Omega_next = Omega + i*steps[6];
+      Omega_i = Omega_ip1;
+      if(m == 0) {
+        Omega_half = _quaternion_angular_velocity_midpoint(t, steps[5], Omega, steps[6], steps[7], n, i-1);
+      } else {
+        Omega_half.w = 0.0;
+        Omega_half.x = *(double *)Omega_mid_i;
+        Omega_half.y = *(double *)(Omega_mid_i + steps[9]);
+        Omega_half.z = *(double *)(Omega_mid_i + 2*steps[9]);
+      }
+      Omega_ip1.x = *(double *)Omega_next;
+      Omega_ip1.y = *(double *)(Omega_next + steps[7]);
+      Omega_ip1.z = *(double *)(Omega_next + 2*steps[7]);
+      R_i = quaternion_rkmk4_step(R_i, h, Omega_i, Omega_half, Omega_ip1);
+      *(quaternion *)(R + i*steps[10]) = R_i;
+    }
+    args[0] += steps[0];
+    args[1] += steps[1];
+    args[2] += steps[2];
+    args[3] += steps[3];
+    args[4] += steps[4];
+  }
+}
+static void
+integrate_angular_velocity_loop(char **args, npy_intp *dimensions, npy_intp* steps, void* data)
+{
+  _quaternion_parallel_gufunc_loop(&integrate_angular_velocity_serial_loop, 5, 3,
+                                   1 + _QUATERNION_GRAIN_TRANSCENDENTAL/(dimensions[1]+1),
+                                   args, dimensions, steps, data);
+}
+// Propagate attitudes through streams of body-frame gyro samples at a
+// fixed rate, by `quaternion_gyro_propagate_block`.  The blocks are
+// counted from the first of the `pending` samples -- those left over
+// from a partial block at the end of a previous chunk, whose outputs
+// have already been returned -- so that a stream processed in chunks
+// gives exactly the same results as the whole stream.  `R0` is the
+// attitude before the first pending sample, and `previous` is the
+// sample before that.
+static void
+gyro_propagate_serial_loop(char **args, npy_intp *dimensions, npy_intp* steps, void* NPY_UNUSED(data))
+{
+  // Steps are indexed as: 0-6 for the outer loop over pending, samples,
+  // previous, R0, dt, coning, and R; 7 and 8 for pending; 9 and 10 for
+  // samples; 11 for previous; 12 for R
+  npy_intp i_outer, begin, j;
+  const npy_intp p = dimensions[1], n = dimensions[3];
+  double buffer[QUATERNION_GYRO_BLOCK][3], before[3];
+  quaternion out[QUATERNION_GYRO_BLOCK];
+  for(i_outer = 0; i_outer < dimensions[0]; i_outer++) {
+    const char *pending = args[0], *samples = args[1], *previous = args[2];
+    const double dt = *(double *)args[4];
+    const int coning = *(npy_bool *)args[5];
+    char *R = args[6];
+    quaternion R_i = *(quaternion *)args[3];
+    for(begin = 0; begin < p + n; begin += QUATERNION_GYRO_BLOCK) {
+      const npy_intp m = (p + n - begin < QUATERNION_GYRO_BLOCK) ? p + n - begin : QUATERNION_GYRO_BLOCK;
+      int a;
+      for(a=0; a<3; a++) {
+        before[a] = (begin == 0) ? *(double *)(previous + a*steps[11])
+          : (begin <= p) ? *(double *)(pending + (begin-1)*steps[7] + a*steps[8])
+          : *(double *)(samples + (begin-1-p)*steps[9] + a*steps[10]);
+      }
+      if(begin < p) {
+        for(j=0; j<m; j++) {
+          for(a=0; a<3; a++) {
+            buffer[j][a] = (begin+j < p) ? *(double *)(pending + (begin+j)*steps[7] + a*steps[8])
+              : *(double *)(samples + (begin+j-p)*steps[9] + a*steps[10]);
+          }
+        }
+        quaternion_gyro_propagate_block((const char *)buffer, 3*sizeof(double), sizeof(double), m, before,
+                                        dt, coning, &R_i, (char *)out, sizeof(quaternion));
+        for(j=p-begin; j<m; j++) {
+          *(quaternion *)(R + (begin+j-p)*steps[12]) = out[j];
+        }
+      } else {
+        quaternion_gyro_propagate_block(samples + (begin-p)*steps[9], steps[9], steps[10], m, before,
+                                        dt, coning, &R_i, R + (begin-p)*steps[12], steps[12]);
+      }
+    }
+    args[0] += steps[0];
+    args[1] += steps[1];
+    args[2] += steps[2];
+    args[3] += steps[3];
+    args[4] += steps[4];
+    args[5] += steps[5];
+    args[6] += steps[6];
+  }
+}
+static void
+gyro_propagate_loop(char **args, npy_intp *dimensions, npy_intp* steps, void* data)
+{
+  _quaternion_parallel_gufunc_loop(&gyro_propagate_serial_loop, 7, 3,
+                                   1 + _QUATERNION_GRAIN_ARITHMETIC/(dimensions[1]+dimensions[3]+1),
+                                   args, dimensions, steps, data);
+}
+// Weights of the fourth-order finite-difference derivative at sample
+// `i` of `n` times, applied to the `*m` samples starting at the
+// returned index.  Away from the ends, these are the weights of Eq.
+// (A 5b) of "Derivative formulas and errors for non-uniformly spaced
+// points" by Bowen and Smith -- or the usual centered weights, if
+// `h` is the (nonzero) uniform step.  Near the ends, or if there are
+// fewer than five samples, they are the derivatives of the Lagrange
+// polynomials through the nearest five (or all) samples.
+static npy_intp
+_quaternion_derivative_weights(const char* t, npy_intp t_step, npy_intp n, npy_intp i, double h,
+                               double* w, int* m)
+{
+  #define T(j) (*(double *)(t + (j)*t_step))
+  if(n >= 5 && i >= 2 && i < n-2) {
+    if(h != 0.0) {
+      w[0] = 1 / (12 * h);
+      w[1] = -8 / (12 * h);
+      w[2] = 0.0;
+      w[3] = 8 / (12 * h);
+      w[4] = -1 / (12 * h);
+    } else {
+      const double t1 = T(i-2), t2 = T(i-1), t3 = T(i), t4 = T(i+1), t5 = T(i+2);
+      const double h1 = t1 - t3, h2 = t2 - t3, h4 = t4 - t3, h5 = t5 - t3;
+      const double h12 = t1 - t2, h13 = t1 - t3, h14 = t1 - t4, h15 = t1 - t5;
+      const double h23 = t2 - t3, h24 = t2 - t4, h25 = t2 - t5;
+      const double h34 = t3 - t4, h35 = t3 - t5, h45 = t4 - t5;
+      w[0] = -((h2 * h4 * h5) / (h12 * h13 * h14 * h15));
+      w[1] = ((h1 * h4 * h5) / (h12 * h23 * h24 * h25));
+      w[2] = -((h1 * h2 * h4 + h1 * h2 * h5 + h1 * h4 * h5 + h2 * h4 * h5) / (h13 * h23 * h34 * h35));
+      w[3] = ((h1 * h2 * h5) / (h14 * h24 * h34 * h45));
+      w[4] = -((h1 * h2 * h4) / (h15 * h25 * h35 * h45));
+    }
+    *m = 5;
+    return i-2;
+  } else {
+    const int size = (n < 5) ? (int)n : 5;
+    const npy_intp first = (i < 2) ? 0 : ((i-2 > n-size) ? n-size : i-2);
+    const double x = T(i);
+    int j, k, l;
+    for(j = 0; j < size; j++) {
+      w[j] = 0.0;
+      for(k = 0; k < size; k++) {
+        if(k != j) {
+          double term = 1 / (T(first+j) - T(first+k));
+          for(l = 0; l < size; l++) {
+            if(l != j && l != k) {
+              term *= (x - T(first+l)) / (T(first+j) - T(first+l));
+            }
+          }
+          w[j] += term;
+        }
+      }
+    }
+    *m = size;
+    return first;
+  }
+  #undef T
+}
+// The uniform step of `n` times, or 0 if any step differs from it by
+// more than the roundoff in the times
+static double
+_quaternion_uniform_step(const char* t, npy_intp t_step, npy_intp n)
+{
+  npy_intp i;
+  double h;
+  if(n < 2) {
+    return 0.0;
+  }
+  h = (*(double *)(t + (n-1)*t_step) - *(double *)t) / (n-1);
+  for(i = 1; i < n; i++) {
+    const double h_i = *(double *)(t + i*t_step) - *(double *)(t + (i-1)*t_step);
+    if(!(fabs(h_i - h) <= _QUATERNION_EPS * (fabs(*(double *)(t + i*t_step)) + fabs(h)))) {
+      return 0.0;
+    }
+  }
+  return h;
+}
+// The angular velocity of a rotor time series, by differentiating R
+// with the weights above and multiplying by its conjugate in the same
+// pass: Omega = 2 dR/dt Rbar, or 2 Rbar dR/dt in the body frame.
+// Independent time series are shared among threads.
+static void
+angular_velocity_serial_loop(char **args, npy_intp *dimensions, npy_intp* steps, void* NPY_UNUSED(data))
+{
+  // Steps are indexed as: 0-3 for the outer loop over R, t, body, and
+  // Omega; 4 for R; 5 for t; 6 and 7 for Omega
+  npy_intp i_outer, i;
+  const npy_intp n = dimensions[1];
+  for(i_outer = 0; i_outer < dimensions[0]; i_outer++) {
+    const char *R = args[0], *t = args[1];
+    const int body = *(npy_bool *)args[2];
+    char *Omega = args[3];
+    const double h = _quaternion_uniform_step(t, steps[5], n);
+    for(i = 0; i < n; i++) {
+      double w[5];
+      int m, j;
+      const npy_intp first = _quaternion_derivative_weights(t, steps[5], n, i, h, w, &m);
+      const quaternion R_i = *(quaternion *)(R + i*steps[4]);
+      quaternion Rdot = {0.0, 0.0, 0.0, 0.0}, Omega_i;
+      char *Omega_out = Omega + i*steps[6];
+      for(j = 0; j < m; j++) {
+        const quaternion R_j = *(quaternion *)(R + (first+j)*steps[4]);
+        Rdot.w += w[j] * R_j.w;
+        Rdot.x += w[j] * R_j.x;
+        Rdot.y += w[j] * R_j.y;
+        Rdot.z += w[j] * R_j.z;
+      }
+      Omega_i = body ? quaternion_multiply(quaternion_conjugate(R_i), Rdot)
+                     : quaternion_multiply(Rdot, quaternion_conjugate(R_i));
+      *(double *)Omega_out = 2 * Omega_i.x;
+      *(double *)(Omega_out + steps[7]) = 2 * Omega_i.y;
+      *(double *)(Omega_out + 2*steps[7]) = 2 * Omega_i.z;
+    }
+    args[0] += steps[0];
+    args[1] += steps[1];
+    args[2] += steps[2];
+    args[3] += steps[3];
+  }
+}
+static void
+angular_velocity_loop(char **args, npy_intp *dimensions, npy_intp* steps, void* data)
+{
+  _quaternion_parallel_gufunc_loop(&angular_velocity_serial_loop, 4, 2,
+                                   1 + _QUATERNION_GRAIN_ARITHMETIC/(dimensions[1]+1),
+                                   args, dimensions, steps, data);
+}
+// The functions of `quaternion.calculus`, on float arrays with time
+// along the last axis: the fourth-order derivative by the weights
+// above, and the cumulative and total trapezoidal integrals.
+// Independent series are shared among threads.
+static void
+derivative_serial_loop(char **args, npy_intp *dimensions, npy_intp* steps, void* NPY_UNUSED(data))
+{
+  // Steps are indexed as: 0-2 for the outer loop over f, t, and dfdt;
+  // 3 for f; 4 for t; 5 for dfdt
+  npy_intp i_outer, i;
+  const npy_intp n = dimensions[1];
+  for(i_outer = 0; i_outer < dimensions[0]; i_outer++) {
+    const char *f = args[0], *t = args[1];
+    char *dfdt = args[2];
+    const double h = _quaternion_uniform_step(t, steps[4], n);
+    for(i = 0; i < n; i++) {
+      double w[5], sum = 0.0;
+      int m, j;
+      const npy_intp first = _quaternion_derivative_weights(t, steps[4], n, i, h, w, &m);
+      for(j = 0; j < m; j++) {
+        sum += w[j] * *(double *)(f + (first+j)*steps[3]);
+      }
+      *(double *)(dfdt + i*steps[5]) = sum;
+    }
+    args[0] += steps[0];
+    args[1] += steps[1];
+    args[2] += steps[2];
+  }
+}
+static void
+derivative_loop(char **args, npy_intp *dimensions, npy_intp* steps, void* data)
+{
+  _quaternion_parallel_gufunc_loop(&derivative_serial_loop, 3, 1,
+                                   1 + _QUATERNION_GRAIN_ARITHMETIC/(dimensions[1]+1),
+                                   args, dimensions, steps, data);
+}
+static PyUFuncGenericFunction derivative_loops[] = { _QUATERNION_LOOP(&derivative_loop) };
+// The trapezoidal integrals work on groups of up to
+// _QUATERNION_TRAPEZOID_GROUP series sharing the same times, stepping
+// through time in the outer loop and across the group in the inner
+// loop, so that series lying next to each other in memory (such as
+// the components of quaternions, or the columns of a 2-d array
+// integrated along axis 0) are read in a single pass.  The intervals
+// are summed in blocks of _QUATERNION_TRAPEZOID_BLOCK, each starting
+// from zero, and the values in each block are offset by the sum of
+// all earlier blocks.  Long series are then integrated in parallel: a
+// first pass finds the sum of each block, those sums are accumulated
+// in order, and a second pass writes the values.  The additions are
+// the same however the blocks are shared among threads, so the
+// results are identical for any number of threads.  To save one pass,
+// the first thread writes its values directly in the first pass.
+#define _QUATERNION_TRAPEZOID_GROUP 16
+#define _QUATERNION_TRAPEZOID_BLOCK 8192
+typedef struct {
+  const char* f;
+  npy_intp f_step;
+  npy_intp f_series_step;
+  const char* t;
+  npy_intp t_step;
+  char* out;  // NULL for the definite integral
+  npy_intp out_step;
+  npy_intp out_series_step;
+  npy_intp n;
+  npy_intp g;
+  npy_intp n_blocks;
+  npy_intp written;
+  double* sums;
+} _quaternion_trapezoid_state;
+// Integrate blocks [k_start, k_stop), starting from `offset` (which is
+// updated), and optionally writing the values or storing block sums
+static void
+_quaternion_trapezoid_blocks(const _quaternion_trapezoid_state* s, npy_intp k_start, npy_intp k_stop,
+                             double* offset, int write, double* sums)
+{
+  npy_intp k, i, j;
+  #define F(i, j) (*(const double *)(s->f + (i)*s->f_step + (j)*s->f_series_step))
+  for(k = k_start; k < k_stop; k++) {
+    const npy_intp i_start = 1 + k*_QUATERNION_TRAPEZOID_BLOCK;
+    const npy_intp i_stop = (s->n - i_start < _QUATERNION_TRAPEZOID_BLOCK) ? s->n : i_start + _QUATERNION_TRAPEZOID_BLOCK;
+    double sum[_QUATERNION_TRAPEZOID_GROUP];
+    for(j = 0; j < s->g; j++) {
+      sum[j] = 0.0;
+    }
+    for(i = i_start; i < i_stop; i++) {
+      const double half_dt = (*(const double *)(s->t + i*s->t_step) - *(const double *)(s->t + (i-1)*s->t_step)) / 2.0;
+      for(j = 0; j < s->g; j++) {
+        sum[j] += (F(i, j) + F(i-1, j)) * half_dt;
+      }
+      if(write) {
+        for(j = 0; j < s->g; j++) {
+          *(double *)(s->out + i*s->out_step + j*s->out_series_step) = offset[j] + sum[j];
+        }
+      }
+    }
+    for(j = 0; j < s->g; j++) {
+      if(sums != NULL) {
+        sums[k*s->g + j] = sum[j];
+      }
+      offset[j] += sum[j];
+    }
+  }
+  #undef F
+}
+static void
+_quaternion_trapezoid_sums_task(void* context, ptrdiff_t start, ptrdiff_t stop)
+{
+  _quaternion_trapezoid_state* s = (_quaternion_trapezoid_state*)context;
+  double offset[_QUATERNION_TRAPEZOID_GROUP] = {0.0};
+  const int write = (start == 0 && s->out != NULL);
+  _quaternion_trapezoid_blocks(s, start, stop, offset, write, s->sums);
+  if(write) {
+    s->written = stop;
+  }
+}
+static void
+_quaternion_trapezoid_values_task(void* context, ptrdiff_t start, ptrdiff_t stop)
+{
+  _quaternion_trapezoid_state* s = (_quaternion_trapezoid_state*)context;
+  double offset[_QUATERNION_TRAPEZOID_GROUP];
+  npy_intp j;
+  start += s->written;
+  stop += s->written;
+  for(j = 0; j < s->g; j++) {
+    offset[j] = s->sums[start*s->g + j];
+  }
+  _quaternion_trapezoid_blocks(s, start, stop, offset, 1, NULL);
+}
+// Integrate one group, leaving the totals in `total`
+static void
+_quaternion_trapezoid_group(_quaternion_trapezoid_state* s, int parallel, double* total)
+{
+  const npy_intp grain = 1 + _QUATERNION_GRAIN_ARITHMETIC/(s->g*_QUATERNION_TRAPEZOID_BLOCK);
+  npy_intp j, k;
+  for(j = 0; j < s->g; j++) {
+    total[j] = 0.0;
+    if(s->out != NULL && s->n > 0) {
+      *(double *)(s->out + j*s->out_series_step) = 0.0;
+    }
+  }
+  s->n_blocks = (s->n > 1) ? (s->n - 2) / _QUATERNION_TRAPEZOID_BLOCK + 1 : 0;
+  s->sums = NULL;
+  if(parallel && s->n_blocks >= 2*grain) {
+    s->sums = (double *)malloc(s->n_blocks * s->g * sizeof(double));
+  }
+  if(s->sums == NULL) {
+    _quaternion_trapezoid_blocks(s, 0, s->n_blocks, total, (s->out != NULL), NULL);
+    return;
+  }
+  s->written = 0;
+  quaternion_parallel_for(s->n_blocks, grain, _quaternion_trapezoid_sums_task, s);
+  // Replace the sum of each block with the sum of all earlier blocks
+  for(k = 0; k < s->n_blocks; k++) {
+    for(j = 0; j < s->g; j++) {
+      const double sum = s->sums[k*s->g + j];
+      s->sums[k*s->g + j] = total[j];
+      total[j] += sum;
+    }
+  }
+  if(s->out != NULL && s->written < s->n_blocks) {
+    quaternion_parallel_for(s->n_blocks - s->written, grain, _quaternion_trapezoid_values_task, s);
+  }
+  free(s->sums);
+}
+static NPY_INLINE npy_intp
+_quaternion_abs_step(npy_intp step)
+{
+  return (step < 0) ? -step : step;
+}
+// Steps are indexed as: 0-2 for the outer loop over f, t, and the
+// result; 3 for f; 4 for t; 5 for the cumulative result
+static void
+_quaternion_trapezoid_loop(char **args, npy_intp *dimensions, npy_intp* steps, int cumulative, int parallel)
+{
+  _quaternion_trapezoid_state s;
+  npy_intp i_outer, j;
+  // Series are grouped if they share the times, and lie closer to each
+  // other in memory than successive times do
+  const int group = (steps[1] == 0 && _quaternion_abs_step(steps[0]) < _quaternion_abs_step(steps[3])
+                     && (!cumulative || _quaternion_abs_step(steps[2]) < _quaternion_abs_step(steps[5])));
+  s.f_step = steps[3];
+  s.f_series_step = steps[0];
+  s.t_step = steps[4];
+  s.out_step = cumulative ? steps[5] : 0;
+  s.out_series_step = cumulative ? steps[2] : 0;
+  s.n = dimensions[1];
+  for(i_outer = 0; i_outer < dimensions[0]; i_outer += s.g) {
+    double total[_QUATERNION_TRAPEZOID_GROUP];
+    s.g = group ? dimensions[0] - i_outer : 1;
+    if(s.g > _QUATERNION_TRAPEZOID_GROUP) {
+      s.g = _QUATERNION_TRAPEZOID_GROUP;
+    }
+    s.f = args[0] + i_outer*steps[0];
+    s.t = args[1] + i_outer*steps[1];
+    s.out = cumulative ? args[2] + i_outer*steps[2] : NULL;
+    _quaternion_trapezoid_group(&s, parallel, total);
+    if(!cumulative) {
+      for(j = 0; j < s.g; j++) {
+        *(double *)(args[2] + (i_outer+j)*steps[2]) = total[j];
+      }
+    }
+  }
+}
+static void
+indefinite_integral_serial_loop(char **args, npy_intp *dimensions, npy_intp* steps, void* NPY_UNUSED(data))
+{
+  _quaternion_trapezoid_loop(args, dimensions, steps, 1, 0);
+}
+static void
+definite_integral_serial_loop(char **args, npy_intp *dimensions, npy_intp* steps, void* NPY_UNUSED(data))
+{
+  _quaternion_trapezoid_loop(args, dimensions, steps, 0, 0);
+}
+// Long series are split into blocks shared among threads; otherwise,
+// the series themselves are shared
+static void
+indefinite_integral_loop(char **args, npy_intp *dimensions, npy_intp* steps, void* data)
+{
+  if(dimensions[1] > 2*_QUATERNION_TRAPEZOID_BLOCK) {
+    _quaternion_trapezoid_loop(args, dimensions, steps, 1, 1);
+  } else {
+    _quaternion_parallel_gufunc_loop(&indefinite_integral_serial_loop, 3, 1,
+                                     1 + _QUATERNION_GRAIN_ARITHMETIC/(dimensions[1]+1),
+                                     args, dimensions, steps, data);
+  }
+}
+static void
+definite_integral_loop(char **args, npy_intp *dimensions, npy_intp* steps, void* data)
+{
+  if(dimensions[1] > 2*_QUATERNION_TRAPEZOID_BLOCK) {
+    _quaternion_trapezoid_loop(args, dimensions, steps, 0, 1);
+  } else {
+    _quaternion_parallel_gufunc_loop(&definite_integral_serial_loop, 3, 1,
+                                     1 + _QUATERNION_GRAIN_ARITHMETIC/(dimensions[1]+1),
+                                     args, dimensions, steps, data);
+  }
+}
+static PyUFuncGenericFunction indefinite_integral_loops[] = { _QUATERNION_LOOP(&indefinite_integral_loop) };
+static PyUFuncGenericFunction definite_integral_loops[] = { _QUATERNION_LOOP(&definite_integral_loop) };
+// The integrand of the differential equation for the rotation vector
+// rfrak of a frame with angular velocity Omega, for
+// `quaternion.quaternion_time_series.frame_from_angular_velocity_integrand`
+static void
+frame_from_angular_velocity_integrand_loop(char **args, npy_intp *dimensions, npy_intp* steps,
+                                           void* NPY_UNUSED(data))
+{
+  npy_intp i;
+  for(i = 0; i < dimensions[0]; i++) {
+    const char *rfrak = args[0] + i*steps[0], *Omega = args[1] + i*steps[1];
+    char *r = args[2] + i*steps[2];
+    const double r0 = *(double *)rfrak, r1 = *(double *)(rfrak + steps[3]), r2 = *(double *)(rfrak + 2*steps[3]);
+    const double o0 = *(double *)Omega / 2, o1 = *(double *)(Omega + steps[4]) / 2;
+    const double o2 = *(double *)(Omega + 2*steps[4]) / 2;
+    const double rfrakMag = sqrt(r0*r0 + r1*r1 + r2*r2);
+    const double OmegaMag = 2 * sqrt(o0*o0 + o1*o1 + o2*o2);
+    double v0 = o0, v1 = o1, v2 = o2;
+    // Close to the identity, or to a singular matrix (which is
+    // equivalent to the identity), the integrand is just Omega/2
+    if(!(rfrakMag < _QUATERNION_EPS * OmegaMag) && !(fabs(sin(rfrakMag)) < _QUATERNION_EPS)) {
+      const double h0 = r0 / rfrakMag, h1 = r1 / rfrakMag, h2 = r2 / rfrakMag;
+      const double dot = h0*o0 + h1*o1 + h2*o2;
+      const double cot = rfrakMag / tan(rfrakMag);
+      v0 = (o0 - h0*dot) * cot + h0*dot + (o1*r2 - o2*r1);
+      v1 = (o1 - h1*dot) * cot + h1*dot + (o2*r0 - o0*r2);
+      v2 = (o2 - h2*dot) * cot + h2*dot + (o0*r1 - o1*r0);
+    }
+    *(double *)r = v0;
+    *(double *)(r + steps[5]) = v1;
+    *(double *)(r + 2*steps[5]) = v2;
+  }
+}
+static PyUFuncGenericFunction frame_from_angular_velocity_integrand_loops[] = {
+  _QUATERNION_LOOP(&frame_from_angular_velocity_integrand_loop)
+};
+
+// The inverse derivative of the exponential map, on 3-vectors, as
+// needed for Runge-Kutta-Munthe-Kaas steps with general angular
+// velocities, which are driven from python
+static void
+dexp_inverse_loop(char **args, npy_intp *dimensions, npy_intp* steps, void* NPY_UNUSED(data))
+{
+  npy_intp i;
+  for(i = 0; i < dimensions[0]; i++) {
+    const char *L = args[0] + i*steps[0], *w = args[1] + i*steps[1];
+    char *r = args[2] + i*steps[2];
+    const quaternion Lq = {0.0, *(double *)L, *(double *)(L + steps[3]), *(double *)(L + 2*steps[3])};
+    const quaternion wq = {0.0, *(double *)w, *(double *)(w + steps[4]), *(double *)(w + 2*steps[4])};
+    const quaternion rq = quaternion_dexp_inverse(Lq, wq);
+    *(double *)r = rq.x;
+    *(double *)(r + steps[5]) = rq.y;
+    *(double *)(r + 2*steps[5]) = rq.z;
+  }
+}
+static PyUFuncGenericFunction dexp_inverse_loops[] = { _QUATERNION_LOOP(&dexp_inverse_loop) };
+
+// Addition, subtraction, and multiplication of `quaternionf` arrays are
+// computed directly in single precision, so that they use twice the
+// SIMD width (and half the bandwidth) of the double-precision loops.
+// Contiguous arrays get their own loop so that the compiler can
+// vectorize it.
+#define QUATERNIONF_BINARY_GEN_UFUNC(name, arg_type1, arg_type2)        \
+  static void                                                           \
+  quaternionf_##name##_ufunc(char** args, npy_intp* dimensions,         \
+                             npy_intp* steps, void* NPY_UNUSED(data)) { \
+    char *ip1 = args[0], *ip2 = args[1], *op1 = args[2];                \
+    npy_intp is1 = steps[0], is2 = steps[1], os1 = steps[2];            \
+    npy_intp n = dimensions[0];                                         \
+    npy_intp i;                                                         \
+    if(is1 == sizeof(arg_type1) && is2 == sizeof(arg_type2) && os1 == sizeof(quaternionf) \
+       && _quaternion_batch_no_partial_overlap(ip1, is1, op1, os1, n, sizeof(arg_type1)) \
+       && _quaternion_batch_no_partial_overlap(ip2, is2, op1, os1, n, sizeof(arg_type2))) { \
+      const arg_type1* in1 = (const arg_type1 *)ip1;                    \
+      const arg_type2* in2 = (const arg_type2 *)ip2;                    \
+      quaternionf* out = (quaternionf *)op1;                            \
+      for(i = 0; i < n; i++) {                                          \
+        out[i] = quaternionf_##name(in1[i], in2[i]);                    \
+      }                                                                 \
+      return;                                                           \
+    }                                                                   \
+    for(i = 0; i < n; i++, ip1 += is1, ip2 += is2, op1 += os1) {        \
+      const arg_type1 in1 = *(arg_type1 *)ip1;                          \
+      const arg_type2 in2 = *(arg_type2 *)ip2;                          \
+      *((quaternionf *)op1) = quaternionf_##name(in1, in2);             \
+    }                                                                   \
+  }
+#define QUATERNIONF_BINARY_UFUNC(name)                                  \
+  QUATERNIONF_BINARY_GEN_UFUNC(name, quaternionf, quaternionf)          \
+  QUATERNIONF_BINARY_GEN_UFUNC(scalar_##name, npy_float, quaternionf)   \
+  QUATERNIONF_BINARY_GEN_UFUNC(name##_scalar, quaternionf, npy_float)
+QUATERNIONF_BINARY_UFUNC(add)
+QUATERNIONF_BINARY_UFUNC(subtract)
+QUATERNIONF_BINARY_UFUNC(multiply)
+
+// The remaining ufunc loops for `quaternionf` arrays are the loops for
+// `quaternion` arrays above, applied to blocks of elements that are
+// widened into buffers on the stack, and rounded back to single
+// precision afterwards.  In this way, every operation on the two types
+// is computed by the same code (including the vectorized kernels), and
+// the results for `quaternionf` are exactly those of casting to
+// `quaternion`, computing, and casting back -- but without temporary
+// arrays.  Each loop is described by the double-precision loop and a
+// string with one character per argument, the last being the output:
+// 'q' for quaternionf (widened to quaternion), 'f' for float32
+// (widened to double), and 'b' or 'd' for bool or float64 arguments,
+// which are passed through unchanged.  When the output partially
+// overlaps an input, as it does for `accumulate`, or is a single
+// element written repeatedly, as it is for `reduce`, the elements are
+// processed one at a time.
+#define _QUATERNIONF_BLOCK 128
+#define _QUATERNIONF_MAX_ARGS 6
+#define _QUATERNIONF_MAX_LOOPS 96
+typedef struct {
+  _quaternion_loop_function loop;
+  const char* kinds;
+} _quaternionf_loop_data;
+static _quaternionf_loop_data _quaternionf_loops[_QUATERNIONF_MAX_LOOPS];
+static int _quaternionf_num_loops = 0;
+static NPY_INLINE npy_intp
+_quaternionf_kind_size(char kind)
+{
+  return (kind == 'q') ? sizeof(quaternionf) : (kind == 'f') ? sizeof(npy_float)
+    : (kind == 'd') ? sizeof(npy_double) : sizeof(npy_bool);
+}
+static void
+quaternionf_loop(char **args, npy_intp *dimensions, npy_intp* steps, void* data)
+{
+  const _quaternionf_loop_data* loop = (const _quaternionf_loop_data*)data;
+  const int nargs = (int)strlen(loop->kinds), out = nargs-1;
+  const npy_intp n = dimensions[0];
+  quaternion buffer[_QUATERNIONF_MAX_ARGS][_QUATERNIONF_BLOCK];
+  char* buffer_args[_QUATERNIONF_MAX_ARGS];
+  npy_intp buffer_steps[_QUATERNIONF_MAX_ARGS];
+  npy_intp i, j, m, block = _QUATERNIONF_BLOCK;
+  int k;
+  if(steps[out] == 0) {
+    block = 1;
+  }
+  for(k = 0; k < out; k++) {
+    if(!_quaternion_batch_no_partial_overlap(args[k], steps[k], args[out], steps[out], n,
+                                             _quaternionf_kind_size(loop->kinds[k]))) {
+      block = 1;
+    }
+  }
+  for(i = 0; i < n; i += m) {
+    m = (n-i < block) ? n-i : block;
+    for(k = 0; k < nargs; k++) {
+      const char* p = args[k] + i*steps[k];
+      if(loop->kinds[k] == 'q') {
+        buffer_args[k] = (char *)buffer[k];
+        buffer_steps[k] = sizeof(quaternion);
+        if(k < out) {
+          for(j = 0; j < m; j++) {
+            buffer[k][j] = quaternion_create_from_quaternionf(*(const quaternionf *)(p + j*steps[k]));
+          }
+        }
+      } else if(loop->kinds[k] == 'f') {
+        buffer_args[k] = (char *)buffer[k];
+        buffer_steps[k] = sizeof(double);
+        if(k < out) {
+          for(j = 0; j < m; j++) {
+            ((double *)buffer[k])[j] = *(const npy_float *)(p + j*steps[k]);
+          }
+        }
+      } else {
+        buffer_args[k] = (char *)p;
+        buffer_steps[k] = steps[k];
+      }
+    }
+    loop->loop(buffer_args, &m, buffer_steps, NULL);
+    if(loop->kinds[out] == 'q') {
+      for(j = 0; j < m; j++) {
+        *(quaternionf *)(args[out] + (i+j)*steps[out]) = quaternionf_create_from_quaternion(buffer[out][j]);
+      }
+    } else if(loop->kinds[out] == 'f') {
+      for(j = 0; j < m; j++) {
+        *(npy_float *)(args[out] + (i+j)*steps[out]) = (npy_float)((double *)buffer[out])[j];
+      }
+    }
+  }
+}
+// Register the `quaternionf` version of a loop with the given ufunc
+static int
+_quaternionf_register_loop(PyObject* ufunc, int quaternionf_type_num,
+                           _quaternion_loop_function loop, const char* kinds)
+{
+  int k, arg_types[_QUATERNIONF_MAX_ARGS];
+  _quaternionf_loop_data* data;
+  if(ufunc == NULL || _quaternionf_num_loops >= _QUATERNIONF_MAX_LOOPS) {
+    return -1;
+  }
+  data = &_quaternionf_loops[_quaternionf_num_loops++];
+  data->loop = loop;
+  data->kinds = kinds;
+  for(k = 0; kinds[k] != '\0'; k++) {
+    arg_types[k] = (kinds[k] == 'q') ? quaternionf_type_num : (kinds[k] == 'f') ? NPY_FLOAT
+      : (kinds[k] == 'd') ? NPY_DOUBLE : NPY_BOOL;
+  }
+  return PyUFunc_RegisterLoopForType((PyUFuncObject *)ufunc, quaternionf_type_num,
+                                     _QUATERNION_LOOP(quaternionf_loop), arg_types, data);
+}
+
+// This is a macro that will be used to define the generalized ufuncs
+// that rotate vectors by quaternions, with signature `(),(3)->(3)`.
+// Each rotor is used for exactly one vector, so the direct formula
+// in `quaternion_rotate_vector` is cheaper than building a matrix.
+#define ROTATE_VECTOR_GUFUNC(name)                                      \
+  static void                                                           \
+  name##_loop(char **args, npy_intp *dimensions, npy_intp* steps, void* NPY_UNUSED(data)) \
+  {                                                                     \
+    npy_intp i;                                                         \
+    double v[3], vprime[3];                                             \
+    npy_intp n = dimensions[0];                                         \
+    npy_intp is1 = steps[0], is2 = steps[1], os = steps[2];             \
+    npy_intp is2_core = steps[3], os_core = steps[4];                   \
+    char *i1 = args[0], *i2 = args[1], *op = args[2];                   \
+    for (i = 0; i < n; i++, i1 += is1, i2 += is2, op += os) {           \
+      v[0] = *(double *)(i2);                                           \
+      v[1] = *(double *)(i2 + is2_core);                                \
+      v[2] = *(double *)(i2 + 2*is2_core);                              \
+      quaternion_##name(*(quaternion *)i1, v, vprime);                  \
+      *(double *)(op) = vprime[0];                                      \
+      *(double *)(op + os_core) = vprime[1];                            \
+      *(double *)(op + 2*os_core) = vprime[2];                          \
+    }                                                                   \
+  }
+ROTATE_VECTOR_GUFUNC(rotate_vector)
+ROTATE_VECTOR_GUFUNC(rotate_vector_and_normalize)
+
+// Generalized ufuncs converting between quaternions (as the final axis
+// of a float array, so that `as_float_array` views can be passed
+// directly) and rotation matrices, with signatures `(4)->(3,3)` and
+// `(3,3)->(4)`.  Each element is converted entirely in registers,
+// rather than by a separate pass over the array for each component.
+static void
+as_rotation_matrix_loop(char **args, npy_intp *dimensions, npy_intp* steps, void* NPY_UNUSED(data))
+{
+  npy_intp i;
+  int j;
+  double m[9];
+  quaternion q;
+  npy_intp n = dimensions[0];
+  npy_intp is = steps[0], os = steps[1];
+  npy_intp is_core = steps[2], os_row = steps[3], os_column = steps[4];
+  char *ip = args[0], *op = args[1];
+  for(i = 0; i < n; i++, ip += is, op += os) {
+    q.w = *(double *)(ip);
+    q.x = *(double *)(ip + is_core);
+    q.y = *(double *)(ip + 2*is_core);
+    q.z = *(double *)(ip + 3*is_core);
+    quaternion_as_rotation_matrix(q, m);
+    for(j = 0; j < 9; j++) {
+      *(double *)(op + (j/3)*os_row + (j%3)*os_column) = m[j];
+    }
+  }
+}
+#define FROM_ROTATION_MATRIX_GUFUNC(name, create)                       \
+  static void                                                           \
+  name##_loop(char **args, npy_intp *dimensions, npy_intp* steps, void* NPY_UNUSED(data)) \
+  {                                                                     \
+    npy_intp i;                                                         \
+    int j;                                                              \
+    double m[9];                                                        \
+    quaternion q;                                                       \
+    npy_intp n = dimensions[0];                                         \
+    npy_intp is = steps[0], os = steps[1];                              \
+    npy_intp is_row = steps[2], is_column = steps[3], os_core = steps[4]; \
+    char *ip = args[0], *op = args[1];                                  \
+    for(i = 0; i < n; i++, ip += is, op += os) {                        \
+      for(j = 0; j < 9; j++) {                                          \
+        m[j] = *(double *)(ip + (j/3)*is_row + (j%3)*is_column);        \
+      }                                                                 \
+      q = quaternion_##create(m);                                       \
+      *(double *)(op) = q.w;                                            \
+      *(double *)(op + os_core) = q.x;                                  \
+      *(double *)(op + 2*os_core) = q.y;                                \
+      *(double *)(op + 3*os_core) = q.z;                                \
+    }                                                                   \
+  }
+FROM_ROTATION_MATRIX_GUFUNC(from_rotation_matrix, create_from_rotation_matrix)
+FROM_ROTATION_MATRIX_GUFUNC(from_nonorthogonal_rotation_matrix_serial, create_from_nonorthogonal_rotation_matrix)
+// The eigenvector solution is costly enough to use the threads even for
+// modest batches.  numpy copies any operand that overlaps the output
+// before calling a gufunc loop, so the pieces are independent.
+static void
+from_nonorthogonal_rotation_matrix_loop(char **args, npy_intp *dimensions, npy_intp* steps, void* data)
+{
+  _quaternion_parallel_loop(&from_nonorthogonal_rotation_matrix_serial_loop, 2,
+                            _QUATERNION_GRAIN_TRANSCENDENTAL, args, dimensions, steps, data);
+}
+// Generalized ufuncs converting between quaternions (again as the final
+// axis of a float array) and rotation vectors, with signatures `(3)->(4)`
+// and `(4)->(3)`.  These are the exponential and logarithmic maps, done
+// in one pass by the batched kernels in `quaternion_simd.h`.
+static void
+from_rotation_vector_serial_loop(char **args, npy_intp *dimensions, npy_intp* steps, void* NPY_UNUSED(data))
+{
+  quaternion_from_rotation_vector_batch(args[0], steps[0], steps[2], args[1], steps[1], steps[3], dimensions[0]);
+}
+static void
+from_rotation_vector_loop(char **args, npy_intp *dimensions, npy_intp* steps, void* data)
+{
+  _quaternion_parallel_loop(&from_rotation_vector_serial_loop, 2,
+                            _QUATERNION_GRAIN_TRANSCENDENTAL, args, dimensions, steps, data);
+}
+static void
+as_rotation_vector_serial_loop(char **args, npy_intp *dimensions, npy_intp* steps, void* NPY_UNUSED(data))
+{
+  quaternion_as_rotation_vector_batch(args[0], steps[0], steps[2], args[1], steps[1], steps[3], dimensions[0]);
+}
+static void
+as_rotation_vector_loop(char **args, npy_intp *dimensions, npy_intp* steps, void* data)
+{
+  _quaternion_parallel_loop(&as_rotation_vector_serial_loop, 2,
+                            _QUATERNION_GRAIN_TRANSCENDENTAL, args, dimensions, steps, data);
+}
+static PyUFuncGenericFunction from_rotation_vector_loops[] = { _QUATERNION_LOOP(&from_rotation_vector_loop) };
+static PyUFuncGenericFunction as_rotation_vector_loops[] = { _QUATERNION_LOOP(&as_rotation_vector_loop) };
+
+// Generalized ufuncs packing quaternions (as the final axis of a float
+// array) into unsigned integers, with signature `(4)->()`, and
+// unpacking them again, with `()->(4)`.  Each encoding is named by the
+// size of its code, which holds two bits of index and `bits` bits for
+// each of three components; see `quaternion_encode_rotors_batch`.
+#define ROTOR_ENCODING_GUFUNCS(name, code_type, npy_code_type, bits)    \
+  static void                                                           \
+  encode_##name##_serial_loop(char **args, npy_intp *dimensions, npy_intp* steps, void* NPY_UNUSED(data)) \
+  {                                                                     \
+    quaternion_encode_rotors_batch(args[0], steps[0], steps[2], args[1], steps[1], sizeof(code_type), \
+                                   dimensions[0], bits);                \
+  }                                                                     \
+  static void                                                           \
+  encode_##name##_loop(char **args, npy_intp *dimensions, npy_intp* steps, void* data) \
+  {                                                                     \
+    _quaternion_parallel_loop(&encode_##name##_serial_loop, 2,          \
+                              _QUATERNION_GRAIN_ARITHMETIC, args, dimensions, steps, data); \
+  }                                                                     \
+  static void                                                           \
+  decode_##name##_serial_loop(char **args, npy_intp *dimensions, npy_intp* steps, void* NPY_UNUSED(data)) \
+  {                                                                     \
+    quaternion_decode_rotors_batch(args[0], steps[0], sizeof(code_type), args[1], steps[1], steps[2], \
+                                   dimensions[0], bits);                \
+  }                                                                     \
+  static void                                                           \
+  decode_##name##_loop(char **args, npy_intp *dimensions, npy_intp* steps, void* data) \
+  {                                                                     \
+    _quaternion_parallel_loop(&decode_##name##_serial_loop, 2,          \
+                              _QUATERNION_GRAIN_ARITHMETIC, args, dimensions, steps, data); \
+  }                                                                     \
+  static PyUFuncGenericFunction encode_##name##_loops[] = { _QUATERNION_LOOP(&encode_##name##_loop) }; \
+  static PyUFuncGenericFunction decode_##name##_loops[] = { _QUATERNION_LOOP(&decode_##name##_loop) }; \
+  static char encode_##name##_types[] = { NPY_DOUBLE, npy_code_type };  \
+  static char decode_##name##_types[] = { npy_code_type, NPY_DOUBLE };
+ROTOR_ENCODING_GUFUNCS(rotor32, npy_uint32, NPY_UINT32, 10)
+ROTOR_ENCODING_GUFUNCS(rotor48, npy_uint64, NPY_UINT64, 15)
+ROTOR_ENCODING_GUFUNCS(rotor64, npy_uint64, NPY_UINT64, 20)
+
+// Ufuncs acting on quaternions stored as separate arrays of components,
+// as in `QuaternionArray`: the arguments are the four components of each
+// operand, followed by the four components of the result.  When every
+// argument is contiguous, the work is handed to the kernels in
+// `quaternion_simd.h`, which load each component directly into a vector.
+#define SOA_BINARY_UFUNC(name, func)                                    \
+  static void                                                           \
+  soa_##name##_serial_loop(char **args, npy_intp *dimensions, npy_intp* steps, void* NPY_UNUSED(data)) \
+  {                                                                     \
+    npy_intp i, n = dimensions[0];                                      \
+    int k, contiguous = 1;                                              \
+    for(k = 0; k < 12; k++) {                                           \
+      contiguous = contiguous && (steps[k] == sizeof(double));          \
+    }                                                                   \
+    if(contiguous) {                                                    \
+      const double* a[4] = {(double *)args[0], (double *)args[1], (double *)args[2], (double *)args[3]}; \
+      const double* b[4] = {(double *)args[4], (double *)args[5], (double *)args[6], (double *)args[7]}; \
+      double* r[4] = {(double *)args[8], (double *)args[9], (double *)args[10], (double *)args[11]}; \
+      quaternion_##name##_components(a, b, r, n);                       \
+      return;                                                           \
+    }                                                                   \
+    for(i = 0; i < n; i++) {                                            \
+      const quaternion a = {*(double *)(args[0] + i*steps[0]), *(double *)(args[1] + i*steps[1]), \
+                            *(double *)(args[2] + i*steps[2]), *(double *)(args[3] + i*steps[3])}; \
+      const quaternion b = {*(double *)(args[4] + i*steps[4]), *(double *)(args[5] + i*steps[5]), \
+                            *(double *)(args[6] + i*steps[6]), *(double *)(args[7] + i*steps[7])}; \
+      const quaternion r = func(a, b);                                  \
+      *(double *)(args[8] + i*steps[8]) = r.w;                          \
+      *(double *)(args[9] + i*steps[9]) = r.x;                          \
+      *(double *)(args[10] + i*steps[10]) = r.y;                        \
+      *(double *)(args[11] + i*steps[11]) = r.z;                        \
+    }                                                                   \
+  }                                                                     \
+  static void                                                           \
+  soa_##name##_loop(char **args, npy_intp *dimensions, npy_intp* steps, void* data) \
+  {                                                                     \
+    _quaternion_parallel_loop(&soa_##name##_serial_loop, 12,            \
+                              _QUATERNION_GRAIN_ARITHMETIC, args, dimensions, steps, data); \
+  }                                                                     \
+  static PyUFuncGenericFunction soa_##name##_loops[] = { _QUATERNION_LOOP(&soa_##name##_loop) };
+SOA_BINARY_UFUNC(multiply, quaternion_multiply)
+SOA_BINARY_UFUNC(divide, quaternion_divide)
+static char soa_binary_types[] = {
+  NPY_DOUBLE, NPY_DOUBLE, NPY_DOUBLE, NPY_DOUBLE, NPY_DOUBLE, NPY_DOUBLE,
+  NPY_DOUBLE, NPY_DOUBLE, NPY_DOUBLE, NPY_DOUBLE, NPY_DOUBLE, NPY_DOUBLE
+};
+
+// Generalized ufuncs converting between quaternions (again as the final
+// axis of a float array) and Euler angles or spherical coordinates, with
+// signatures `(3)->(4)` and `(4)->(3)`, or `(2)->(4)` and `(4)->(2)`.
+// Each convention gets its own loops, in which the axes are constants;
+// the batched kernels in `quaternion_simd.h` do the work.  The angles
+// are given as pointers into the core dimension of the `angles` array,
+// and spherical coordinates `(vartheta, varphi)` are the `zyz` Euler
+// angles `(varphi, vartheta, 0)`.  The trigonometric functions make
+// these costly enough to use the threads for modest batches.
+#define ANGLES_GUFUNCS(name, alpha, beta, gamma, i, j, k)               \
+  static void                                                           \
+  from_##name##_serial_loop(char **args, npy_intp *dimensions, npy_intp* steps, void* NPY_UNUSED(data)) \
+  {                                                                     \
+    char *angles = args[0];                                             \
+    npy_intp angles_core = steps[2];                                    \
+    quaternion_from_euler_angles_batch(alpha, beta, gamma, steps[0], args[1], steps[1], steps[3], \
+                                       dimensions[0], i, j, k);         \
+  }                                                                     \
+  static void                                                           \
+  from_##name##_loop(char **args, npy_intp *dimensions, npy_intp* steps, void* data) \
+  {                                                                     \
+    _quaternion_parallel_loop(&from_##name##_serial_loop, 2,            \
+                              _QUATERNION_GRAIN_TRANSCENDENTAL, args, dimensions, steps, data); \
+  }                                                                     \
+  static void                                                           \
+  as_##name##_serial_loop(char **args, npy_intp *dimensions, npy_intp* steps, void* NPY_UNUSED(data)) \
+  {                                                                     \
+    char *angles = args[1];                                             \
+    npy_intp angles_core = steps[3];                                    \
+    quaternion_as_euler_angles_batch(args[0], steps[0], steps[2], alpha, beta, gamma, steps[1], \
+                                     dimensions[0], i, j, k);           \
+  }                                                                     \
+  static void                                                           \
+  as_##name##_loop(char **args, npy_intp *dimensions, npy_intp* steps, void* data) \
+  {                                                                     \
+    _quaternion_parallel_loop(&as_##name##_serial_loop, 2,              \
+                              _QUATERNION_GRAIN_TRANSCENDENTAL, args, dimensions, steps, data); \
+  }                                                                     \
+  static PyUFuncGenericFunction from_##name##_loops[] = { _QUATERNION_LOOP(&from_##name##_loop) }; \
+  static PyUFuncGenericFunction as_##name##_loops[] = { _QUATERNION_LOOP(&as_##name##_loop) };
+#define EULER_ANGLES_GUFUNCS(name, i, j, k) \
+  ANGLES_GUFUNCS(euler_angles_##name, angles, angles + angles_core, angles + 2*angles_core, i, j, k)
+ANGLES_GUFUNCS(spherical_coords, angles + angles_core, angles, NULL, 3, 2, 3)
+EULER_ANGLES_GUFUNCS(zyz, 3, 2, 3)
+EULER_ANGLES_GUFUNCS(xyx, 1, 2, 1)
+EULER_ANGLES_GUFUNCS(xzx, 1, 3, 1)
+EULER_ANGLES_GUFUNCS(yxy, 2, 1, 2)
+EULER_ANGLES_GUFUNCS(yzy, 2, 3, 2)
+EULER_ANGLES_GUFUNCS(zxz, 3, 1, 3)
+EULER_ANGLES_GUFUNCS(xyz, 1, 2, 3)
+EULER_ANGLES_GUFUNCS(xzy, 1, 3, 2)
+EULER_ANGLES_GUFUNCS(yxz, 2, 1, 3)
+EULER_ANGLES_GUFUNCS(yzx, 2, 3, 1)
+EULER_ANGLES_GUFUNCS(zxy, 3, 1, 2)
+EULER_ANGLES_GUFUNCS(zyx, 3, 2, 1)
+
+static PyUFuncGenericFunction as_rotation_matrix_loops[] = { _QUATERNION_LOOP(&as_rotation_matrix_loop) };
+static PyUFuncGenericFunction from_rotation_matrix_loops[] = { _QUATERNION_LOOP(&from_rotation_matrix_loop) };
+static PyUFuncGenericFunction from_nonorthogonal_rotation_matrix_loops[] = {
+  _QUATERNION_LOOP(&from_nonorthogonal_rotation_matrix_loop)
+};
+// Each of these float gufuncs has a single loop, for doubles
+static void* float_gufunc_data[] = { NULL };
+static char float_gufunc_types[] = { NPY_DOUBLE, NPY_DOUBLE };
+static char float_binary_gufunc_types[] = { NPY_DOUBLE, NPY_DOUBLE, NPY_DOUBLE };
+
+
+// Report the CPU features relevant to the dispatched kernels
+static PyObject*
+pyquaternion_cpu_features(PyObject *NPY_UNUSED(self), PyObject *NPY_UNUSED(args))
+{
+  const quaternion_cpu_features features = quaternion_simd_cpu_features();
+  return Py_BuildValue("{s:N,s:N,s:N,s:N,s:N}",
+                       "sse2", PyBool_FromLong(features.sse2),
+                       "avx", PyBool_FromLong(features.avx),
+                       "avx2", PyBool_FromLong(features.avx2),
+                       "fma", PyBool_FromLong(features.fma),
+                       "avx512f", PyBool_FromLong(features.avx512f));
+}
+
+// Report the kernels used by each ufunc with dispatched loops
+static const char* _dispatched_ufunc_names[] = {
+  "norm", "absolute", "conjugate", "normalized",
+  "add", "multiply", "divide", "true_divide", "floor_divide",
+  "exp", "log", "power", "slerp_vectorized", "squad_vectorized",
+  "slerp_unit_vectorized", "slerp_unit_segment_vectorized", "squad_interpolate_vectorized",
+  "from_spherical_coords_vectorized", "as_spherical_coords_vectorized",
+  "from_euler_angles_zyz_vectorized", "as_euler_angles_zyz_vectorized",
+  "from_euler_angles_xyx_vectorized", "as_euler_angles_xyx_vectorized",
+  "from_euler_angles_xzx_vectorized", "as_euler_angles_xzx_vectorized",
+  "from_euler_angles_yxy_vectorized", "as_euler_angles_yxy_vectorized",
+  "from_euler_angles_yzy_vectorized", "as_euler_angles_yzy_vectorized",
+  "from_euler_angles_zxz_vectorized", "as_euler_angles_zxz_vectorized",
+  "from_euler_angles_xyz_vectorized", "as_euler_angles_xyz_vectorized",
+  "from_euler_angles_xzy_vectorized", "as_euler_angles_xzy_vectorized",
+  "from_euler_angles_yxz_vectorized", "as_euler_angles_yxz_vectorized",
+  "from_euler_angles_yzx_vectorized", "as_euler_angles_yzx_vectorized",
+  "from_euler_angles_zxy_vectorized", "as_euler_angles_zxy_vectorized",
+  "from_euler_angles_zyx_vectorized", "as_euler_angles_zyx_vectorized",
+  "from_rotation_vector_vectorized", "as_rotation_vector_vectorized",
+  "_soa_multiply", "_soa_divide",
+  "encode_rotor32", "decode_rotor32", "encode_rotor48", "decode_rotor48",
+  "encode_rotor64", "decode_rotor64", "gyro_propagate_vectorized", NULL
+};
+static PyObject*
+pyquaternion_dispatch_info(PyObject *NPY_UNUSED(self), PyObject *NPY_UNUSED(args))
+{
+  int i;
+  PyObject* info = PyDict_New();
+  PyObject* level;
+  if(info == NULL) {
+    return NULL;
+  }
+  level = PyUString_FromString(quaternion_simd_level_name(quaternion_simd_get_level()));
+  if(level == NULL) {
+    Py_DECREF(info);
+    return NULL;
+  }
+  for(i=0; _dispatched_ufunc_names[i]!=NULL; ++i) {
+    if(PyDict_SetItemString(info, _dispatched_ufunc_names[i], level) < 0) {
+      Py_DECREF(level);
+      Py_DECREF(info);
+      return NULL;
+    }
+  }
+  Py_DECREF(level);
+  return info;
+}
+
+// Change the kernels used by the dispatched ufuncs
+static PyObject*
+pyquaternion_set_dispatch(PyObject *NPY_UNUSED(self), PyObject *args)
+{
+  const char* name;
+  int level, previous = quaternion_simd_get_level();
+  if (!PyArg_ParseTuple(args, "s", &name)) {
+    return NULL;
+  }
+  for(level=QUATERNION_SIMD_BASELINE; level<=QUATERNION_SIMD_AVX512; ++level) {
+    if(strcmp(name, quaternion_simd_level_name(level)) == 0) {
+      break;
+    }
+  }
+  if(level > QUATERNION_SIMD_AVX512) {
+    PyErr_Format(PyExc_ValueError, "Unknown dispatch level '%s'", name);
+    return NULL;
+  }
+  if(quaternion_simd_set_level(level) < 0) {
+    PyErr_Format(PyExc_ValueError, "Dispatch level '%s' is not supported on this machine", name);
+    return NULL;
+  }
+  return PyUString_FromString(quaternion_simd_level_name(previous));
+}
+
+// Choose between the accurate and fast polynomials in the batched kernels
+static PyObject*
+pyquaternion_get_accuracy(PyObject *NPY_UNUSED(self), PyObject *NPY_UNUSED(args))
+{
+  return PyUString_FromString(quaternion_simd_get_fast() ? "fast" : "accurate");
+}
+static PyObject*
+pyquaternion_set_accuracy(PyObject *NPY_UNUSED(self), PyObject *args)
+{
+  const char* mode;
+  int previous = quaternion_simd_get_fast();
+  if (!PyArg_ParseTuple(args, "s", &mode)) {
+    return NULL;
+  }
+  if(strcmp(mode, "accurate") == 0) {
+    quaternion_simd_set_fast(0);
+  } else if(strcmp(mode, "fast") == 0) {
+    quaternion_simd_set_fast(1);
+  } else {
+    PyErr_Format(PyExc_ValueError, "Unknown accuracy mode '%s'; use 'accurate' or 'fast'", mode);
+    return NULL;
+  }
+  return PyUString_FromString(previous ? "fast" : "accurate");
+}
+
+
+// Number of threads sharing the loops over large arrays
+static PyObject*
+pyquaternion_get_num_threads(PyObject *NPY_UNUSED(self), PyObject *NPY_UNUSED(args))
+{
+  return Py_BuildValue("i", quaternion_threads_get_num());
+}
+static PyObject*
+pyquaternion_set_num_threads(PyObject *NPY_UNUSED(self), PyObject *args)
+{
+  int num_threads;
+  int previous = quaternion_threads_get_num();
+  if (!PyArg_ParseTuple(args, "i", &num_threads)) {
+    return NULL;
+  }
+  if(num_threads < 1 || num_threads > QUATERNION_MAX_THREADS) {
+    PyErr_Format(PyExc_ValueError, "The number of threads must be between 1 and %d; got %d",
+                 QUATERNION_MAX_THREADS, num_threads);
+    return NULL;
+  }
+  if(quaternion_threads_set_num(num_threads) < 0) {
+    PyErr_Format(PyExc_RuntimeError, "Could not start %d threads", num_threads);
+    return NULL;
+  }
+  return Py_BuildValue("i", previous);
+}
+static PyObject*
+pyquaternion_threads_after_fork(PyObject *NPY_UNUSED(self), PyObject *NPY_UNUSED(args))
+{
+  quaternion_threads_after_fork();
+  Py_RETURN_NONE;
+}
+
+
+// This contains assorted other top-level methods for the module
+static PyMethodDef QuaternionMethods[] = {
+  {"slerp_evaluate", pyquaternion_slerp_evaluate, METH_VARARGS,
    "Interpolate linearly along the geodesic between two rotors \n\n"
    "See also `numpy.slerp_vectorized` for a vectorized version of this function, and\n"
    "`quaternion.slerp` for the most useful form, which automatically finds the correct\n"
@@ -1286,6 +3469,43 @@ static PyMethodDef QuaternionMethods[] = {
    "See also `numpy.squad_vectorized` for a vectorized version of this function, and\n"
    "`quaternion.squad` for the most useful form, which automatically finds the correct\n"
    "rotors to interpolate and the relative time to which they must be interpolated."},
+  {"_cpu_features", pyquaternion_cpu_features, METH_NOARGS,
+   "Return a dict of the CPU features relevant to the quaternion kernels"},
+  {"_dispatch_info", pyquaternion_dispatch_info, METH_NOARGS,
+   "Return a dict mapping ufunc names to the kernels they use\n\n"
+   "The values are 'baseline', 'avx2', or 'avx512'.  Ufuncs not listed here always\n"
+   "use the baseline loops, as do the arithmetic ufuncs (including the private\n"
+   "`_soa_multiply` and `_soa_divide`) for non-contiguous inputs; the\n"
+   "transcendental ufuncs use the selected kernels for any layout.  The level is\n"
+   "chosen at import from the CPU features, and may be lowered by setting the\n"
+   "environment variable QUATERNION_SIMD to one of these names."},
+  {"_set_dispatch", pyquaternion_set_dispatch, METH_VARARGS,
+   "Select the kernels used by the ufuncs in `_dispatch_info`, and return the previous level\n\n"
+   "This is intended for testing and benchmarking.  A ValueError is raised if the\n"
+   "level is unknown or not supported on this machine.  Loops already running in\n"
+   "other threads may finish with the previous kernels."},
+  {"get_accuracy", pyquaternion_get_accuracy, METH_NOARGS,
+   "Return the accuracy mode of `exp`, `log`, `power`, `slerp`, and `squad`\n\n"
+   "See `set_accuracy` for details."},
+  {"set_accuracy", pyquaternion_set_accuracy, METH_VARARGS,
+   "Choose the accuracy of `exp`, `log`, `power`, `slerp`, and `squad`, and return the previous mode\n\n"
+   "In the default 'accurate' mode, the vectorized elementary functions used by these\n"
+   "ufuncs are within a few ulp of the C library's.  In 'fast' mode, shorter polynomials\n"
+   "are used, with relative errors up to about 2e-13.  A ValueError is raised for any\n"
+   "other mode."},
+  {"get_num_threads", pyquaternion_get_num_threads, METH_NOARGS,
+   "Return the number of threads used by the ufunc loops over large arrays\n\n"
+   "See `set_num_threads` for details."},
+  {"set_num_threads", pyquaternion_set_num_threads, METH_VARARGS,
+   "Set the number of threads used by the ufunc loops over large arrays, and return the previous number\n\n"
+   "By default, one thread is used.  With more, the arithmetic ufuncs on contiguous arrays,\n"
+   "and `exp`, `log`, `power`, `slerp_vectorized`, and `squad_vectorized`, split loops that\n"
+   "are large enough into pieces computed by a pool of worker threads, which are started\n"
+   "once and then reused.  The results are identical for any number of threads.  The initial\n"
+   "number may be set with the environment variable QUATERNION_NUM_THREADS.  A ValueError\n"
+   "is raised if the number is less than 1 or more than 256."},
+  {"_threads_after_fork", pyquaternion_threads_after_fork, METH_NOARGS,
+   "Restart the worker threads in a child process after `os.fork`"},
   {NULL, NULL, 0, NULL}
 };
 
@@ -1319,12 +3539,13 @@ PyMODINIT_FUNC initnumpy_quaternion(void) {
 #endif
 
   PyObject *module;
-  PyObject *tmp_ufunc;
+  PyObject *tmp_ufunc, *tmp_ufunc2, *euler_angle_gufuncs, *rotor_encoding_gufuncs;
   PyObject *slerp_evaluate_ufunc;
   PyObject *squad_evaluate_ufunc;
   int quaternionNum;
+  int quaternionfNum;
   int arg_types[3];
-  PyArray_Descr* arg_dtypes[6];
+  PyArray_Descr* arg_dtypes[7];
   PyObject* numpy;
   PyObject* numpy_dict;
 
@@ -1339,6 +3560,10 @@ PyMODINIT_FUNC initnumpy_quaternion(void) {
     INITERROR;
   }
 
+  // Choose the kernels to use for this CPU, and the number of threads
+  quaternion_simd_init();
+  quaternion_threads_init();
+
   // Initialize numpy
   import_array();
   if (PyErr_Occurred()) {
@@ -1360,12 +3585,22 @@ PyMODINIT_FUNC initnumpy_quaternion(void) {
   // Register the quaternion array base type.  Couldn't do this until
   // after we imported numpy (above)
   PyQuaternion_Type.tp_base = &PyGenericArrType_Type;
+#if PY_VERSION_HEX >= 0x03090000
+  PyQuaternion_Type.tp_vectorcall = pyquaternion_vectorcall;
+#endif
   if (PyType_Ready(&PyQuaternion_Type) < 0) {
     PyErr_Print();
     PyErr_SetString(PyExc_SystemError, "Could not initialize PyQuaternion_Type.");
     INITERROR;
   }
 
+  PyQuaternionF_Type.tp_base = &PyGenericArrType_Type;
+  if (PyType_Ready(&PyQuaternionF_Type) < 0) {
+    PyErr_Print();
+    PyErr_SetString(PyExc_SystemError, "Could not initialize PyQuaternionF_Type.");
+    INITERROR;
+  }
+
   // The array functions, to be used below.  This InitArrFuncs
   // function is a convenient way to set all the fields to zero
   // initially, so we don't get undefined behavior.
@@ -1421,21 +3656,85 @@ PyMODINIT_FUNC initnumpy_quaternion(void) {
   register_cast_function(NPY_CDOUBLE, quaternionNum, (PyArray_VectorUnaryFunc*)CDOUBLE_to_quaternion);
   register_cast_function(NPY_CLONGDOUBLE, quaternionNum, (PyArray_VectorUnaryFunc*)CLONGDOUBLE_to_quaternion);
 
+  // The single-precision quaternion array descr.  Its elements are
+  // returned as `quaternion` objects, so `getitem` must always be used.
+  PyArray_InitArrFuncs(&_PyQuaternionF_ArrFuncs);
+  _PyQuaternionF_ArrFuncs.nonzero = (PyArray_NonzeroFunc*)QUATERNIONF_nonzero;
+  _PyQuaternionF_ArrFuncs.copyswap = (PyArray_CopySwapFunc*)QUATERNIONF_copyswap;
+  _PyQuaternionF_ArrFuncs.copyswapn = (PyArray_CopySwapNFunc*)QUATERNIONF_copyswapn;
+  _PyQuaternionF_ArrFuncs.setitem = (PyArray_SetItemFunc*)QUATERNIONF_setitem;
+  _PyQuaternionF_ArrFuncs.getitem = (PyArray_GetItemFunc*)QUATERNIONF_getitem;
+  _PyQuaternionF_ArrFuncs.compare = (PyArray_CompareFunc*)QUATERNIONF_compare;
+  _PyQuaternionF_ArrFuncs.argmax = (PyArray_ArgFunc*)QUATERNIONF_argmax;
+  _PyQuaternionF_ArrFuncs.fillwithscalar = (PyArray_FillWithScalarFunc*)(void(*)(void))QUATERNIONF_fillwithscalar;
+  quaternionf_descr = PyObject_New(PyArray_Descr, &PyArrayDescr_Type);
+  quaternionf_descr->typeobj = &PyQuaternionF_Type;
+  quaternionf_descr->kind = 'V';
+  quaternionf_descr->type = 'Q';
+  quaternionf_descr->byteorder = '=';
+  quaternionf_descr->flags = NPY_USE_GETITEM;
+  quaternionf_descr->type_num = 0; // assigned at registration
+  quaternionf_descr->elsize = 4*4;
+  quaternionf_descr->alignment = 4;
+  quaternionf_descr->subarray = NULL;
+  quaternionf_descr->fields = NULL;
+  quaternionf_descr->names = NULL;
+  quaternionf_descr->f = &_PyQuaternionF_ArrFuncs;
+  quaternionf_descr->metadata = NULL;
+  quaternionf_descr->c_metadata = NULL;
+
+  Py_INCREF(&PyQuaternionF_Type);
+  quaternionfNum = PyArray_RegisterDataType(quaternionf_descr);
+
+  if (quaternionfNum < 0) {
+    INITERROR;
+  }
+
+  // Casts that are exact are registered as safe, so that (for example)
+  // operations mixing the two quaternion types are done in double
+  // precision; the others are only available explicitly, as with `astype`.
+  register_cast_function(quaternionfNum, quaternionNum, (PyArray_VectorUnaryFunc*)QUATERNIONF_to_quaternion);
+  PyArray_RegisterCastFunc(quaternion_descr, quaternionfNum, (PyArray_VectorUnaryFunc*)QUATERNION_to_quaternionf);
+  register_cast_function(NPY_BOOL, quaternionfNum, (PyArray_VectorUnaryFunc*)BOOL_to_quaternionf);
+  register_cast_function(NPY_BYTE, quaternionfNum, (PyArray_VectorUnaryFunc*)BYTE_to_quaternionf);
+  register_cast_function(NPY_UBYTE, quaternionfNum, (PyArray_VectorUnaryFunc*)UBYTE_to_quaternionf);
+  register_cast_function(NPY_SHORT, quaternionfNum, (PyArray_VectorUnaryFunc*)SHORT_to_quaternionf);
+  register_cast_function(NPY_USHORT, quaternionfNum, (PyArray_VectorUnaryFunc*)USHORT_to_quaternionf);
+  register_cast_function(NPY_FLOAT, quaternionfNum, (PyArray_VectorUnaryFunc*)FLOAT_to_quaternionf);
+  #define REGISTER_UNSAFE_CAST_TO_QUATERNIONF(TYPE)                     \
+    {                                                                   \
+      PyArray_Descr *descr = PyArray_DescrFromType(NPY_##TYPE);         \
+      PyArray_RegisterCastFunc(descr, quaternionfNum, (PyArray_VectorUnaryFunc*)TYPE##_to_quaternionf); \
+      Py_DECREF(descr);                                                 \
+    }
+  REGISTER_UNSAFE_CAST_TO_QUATERNIONF(INT);
+  REGISTER_UNSAFE_CAST_TO_QUATERNIONF(UINT);
+  REGISTER_UNSAFE_CAST_TO_QUATERNIONF(LONG);
+  REGISTER_UNSAFE_CAST_TO_QUATERNIONF(ULONG);
+  REGISTER_UNSAFE_CAST_TO_QUATERNIONF(LONGLONG);
+  REGISTER_UNSAFE_CAST_TO_QUATERNIONF(ULONGLONG);
+  REGISTER_UNSAFE_CAST_TO_QUATERNIONF(DOUBLE);
+  REGISTER_UNSAFE_CAST_TO_QUATERNIONF(LONGDOUBLE);
+
   // These macros will be used below
   #define REGISTER_UFUNC(name)                                          \
     PyUFunc_RegisterLoopForType((PyUFuncObject *)PyDict_GetItemString(numpy_dict, #name), \
-                                quaternion_descr->type_num, quaternion_##name##_ufunc, arg_types, NULL)
+                                quaternion_descr->type_num, _QUATERNION_LOOP(quaternion_##name##_ufunc), \
+                                arg_types, NULL)
   #define REGISTER_SCALAR_UFUNC(name)                                   \
     PyUFunc_RegisterLoopForType((PyUFuncObject *)PyDict_GetItemString(numpy_dict, #name), \
-                                quaternion_descr->type_num, quaternion_scalar_##name##_ufunc, arg_types, NULL)
+                                quaternion_descr->type_num, _QUATERNION_LOOP(quaternion_scalar_##name##_ufunc), \
+                                arg_types, NULL)
   #define REGISTER_UFUNC_SCALAR(name)                                   \
     PyUFunc_RegisterLoopForType((PyUFuncObject *)PyDict_GetItemString(numpy_dict, #name), \
-                                quaternion_descr->type_num, quaternion_##name##_scalar_ufunc, arg_types, NULL)
+                                quaternion_descr->type_num, _QUATERNION_LOOP(quaternion_##name##_scalar_ufunc), \
+                                arg_types, NULL)
   #define REGISTER_NEW_UFUNC_GENERAL(pyname, cname, nargin, nargout, doc) \
     tmp_ufunc = PyUFunc_FromFuncAndData(NULL, NULL, NULL, 0, nargin, nargout, \
                                         PyUFunc_None, #pyname, doc, 0); \
     PyUFunc_RegisterLoopForType((PyUFuncObject *)tmp_ufunc,             \
-                                quaternion_descr->type_num, quaternion_##cname##_ufunc, arg_types, NULL); \
+                                quaternion_descr->type_num, _QUATERNION_LOOP(quaternion_##cname##_ufunc), \
+                                arg_types, NULL);                       \
     PyDict_SetItemString(numpy_dict, #pyname, tmp_ufunc);               \
     Py_DECREF(tmp_ufunc)
   #define REGISTER_NEW_UFUNC(name, nargin, nargout, doc)                \
@@ -1576,7 +3875,7 @@ PyMODINIT_FUNC initnumpy_quaternion(void) {
                                                   0);
   PyUFunc_RegisterLoopForDescr((PyUFuncObject*)squad_evaluate_ufunc,
                                quaternion_descr,
-                               &squad_loop,
+                               _QUATERNION_LOOP(&squad_loop),
                                arg_dtypes,
                                NULL);
   PyDict_SetItemString(numpy_dict, "squad_vectorized", squad_evaluate_ufunc);
@@ -1595,18 +3894,482 @@ PyMODINIT_FUNC initnumpy_quaternion(void) {
                                                   0);
   PyUFunc_RegisterLoopForDescr((PyUFuncObject*)slerp_evaluate_ufunc,
                                quaternion_descr,
-                               &slerp_loop,
+                               _QUATERNION_LOOP(&slerp_loop),
                                arg_dtypes,
                                NULL);
   PyDict_SetItemString(numpy_dict, "slerp_vectorized", slerp_evaluate_ufunc);
   Py_DECREF(slerp_evaluate_ufunc);
 
+  // The same, for unit rotors only, and the segment-wise version
+  tmp_ufunc = PyUFunc_FromFuncAndData(NULL, NULL, NULL, 0, 3, 1,
+                                      PyUFunc_None, "slerp_unit_vectorized",
+                                      "Calculate slerp from arrays of unit rotors (q_1, q_2) and tau\n\n"
+                                      "The input quaternions are assumed to be normalized, in which case the\n"
+                                      "result agrees with `numpy.slerp_vectorized` to within rounding, but is\n"
+                                      "found more quickly.  See `quaternion.slerp` for an easier-to-use version.",
+                                      0);
+  PyUFunc_RegisterLoopForDescr((PyUFuncObject*)tmp_ufunc, quaternion_descr,
+                               _QUATERNION_LOOP(&slerp_unit_loop), arg_dtypes, NULL);
+  PyDict_SetItemString(numpy_dict, "slerp_unit_vectorized", tmp_ufunc);
+  Py_DECREF(tmp_ufunc);
+  tmp_ufunc = PyUFunc_FromFuncAndDataAndSignature(NULL, NULL, NULL, 0, 3, 1,
+                                                  PyUFunc_None, "slerp_unit_segment_vectorized",
+                                                  "Calculate slerp between unit rotors q_1 and q_2 at each tau along the final axis\n\n"
+                                                  "This is equivalent to `numpy.slerp_unit_vectorized(q_1[..., np.newaxis],\n"
+                                                  "q_2[..., np.newaxis], tau)`, but the angle between each pair of rotors is\n"
+                                                  "found just once.",
+                                                  0, "(),(),(n)->(n)");
+  PyUFunc_RegisterLoopForDescr((PyUFuncObject*)tmp_ufunc, quaternion_descr,
+                               _QUATERNION_LOOP(&slerp_unit_segment_loop), arg_dtypes, NULL);
+  PyDict_SetItemString(numpy_dict, "slerp_unit_segment_vectorized", tmp_ufunc);
+  Py_DECREF(tmp_ufunc);
+
+  // Create the generalized ufunc that computes the control points of `squad`
+  arg_dtypes[0] = quaternion_descr;
+  arg_dtypes[1] = PyArray_DescrFromType(NPY_DOUBLE);
+  arg_dtypes[2] = quaternion_descr;
+  arg_dtypes[3] = quaternion_descr;
+  tmp_ufunc = PyUFunc_FromFuncAndDataAndSignature(NULL, NULL, NULL, 0, 2, 2,
+                                                  PyUFunc_None, "squad_coefficients_vectorized",
+                                                  "Calculate the squad control points (A, B) from arrays (R_in, t_in)\n\n"
+                                                  "See `quaternion.squad_coefficients` for details.",
+                                                  0, "(n),(n)->(n),(n)");
+  PyUFunc_RegisterLoopForDescr((PyUFuncObject*)tmp_ufunc, quaternion_descr,
+                               _QUATERNION_LOOP(&squad_coefficients_loop), arg_dtypes, NULL);
+  PyDict_SetItemString(numpy_dict, "squad_coefficients_vectorized", tmp_ufunc);
+  Py_DECREF(tmp_ufunc);
+
+  // Create the generalized ufuncs that evaluate `squad`, and its angular
+  // velocity, from precomputed control points
+  arg_dtypes[0] = quaternion_descr;
+  arg_dtypes[1] = PyArray_DescrFromType(NPY_DOUBLE);
+  arg_dtypes[2] = quaternion_descr;
+  arg_dtypes[3] = quaternion_descr;
+  arg_dtypes[4] = PyArray_DescrFromType(NPY_DOUBLE);
+  arg_dtypes[5] = quaternion_descr;
+  tmp_ufunc = PyUFunc_FromFuncAndDataAndSignature(NULL, NULL, NULL, 0, 5, 1,
+                                                  PyUFunc_None, "squad_interpolate_vectorized",
+                                                  "Evaluate squad of (R_in, t_in) with control points (A, B) at t_out\n\n"
+                                                  "See `quaternion.SquadInterpolator` for details.",
+                                                  0, "(n),(n),(n),(n),(m)->(m)");
+  PyUFunc_RegisterLoopForDescr((PyUFuncObject*)tmp_ufunc, quaternion_descr,
+                               _QUATERNION_LOOP(&squad_interpolate_loop), arg_dtypes, NULL);
+  PyDict_SetItemString(numpy_dict, "squad_interpolate_vectorized", tmp_ufunc);
+  Py_DECREF(tmp_ufunc);
+  arg_dtypes[5] = PyArray_DescrFromType(NPY_DOUBLE);
+  tmp_ufunc = PyUFunc_FromFuncAndDataAndSignature(NULL, NULL, NULL, 0, 5, 1,
+                                                  PyUFunc_None, "squad_angular_velocity_vectorized",
+                                                  "Evaluate the angular velocity of squad of (R_in, t_in) with control\n"
+                                                  "points (A, B) at t_out\n\n"
+                                                  "See `quaternion.SquadInterpolator` for details.",
+                                                  0, "(n),(n),(n),(n),(m)->(m,3)");
+  PyUFunc_RegisterLoopForDescr((PyUFuncObject*)tmp_ufunc, quaternion_descr,
+                               _QUATERNION_LOOP(&squad_angular_velocity_loop), arg_dtypes, NULL);
+  PyDict_SetItemString(numpy_dict, "squad_angular_velocity_vectorized", tmp_ufunc);
+  Py_DECREF(tmp_ufunc);
+
+  // Create the generalized ufuncs for ordered products along an axis
+  arg_dtypes[0] = quaternion_descr;
+  arg_dtypes[1] = PyArray_DescrFromType(NPY_INT64);
+  arg_dtypes[2] = PyArray_DescrFromType(NPY_INT64);
+  arg_dtypes[3] = quaternion_descr;
+  tmp_ufunc = PyUFunc_FromFuncAndDataAndSignature(NULL, NULL, NULL, 0, 3, 1,
+                                                  PyUFunc_None, "product_vectorized",
+                                                  "Calculate the ordered product of quaternions along the final axis\n\n"
+                                                  "See `quaternion.product` for details.",
+                                                  0, "(n),(),()->()");
+  PyUFunc_RegisterLoopForDescr((PyUFuncObject*)tmp_ufunc, quaternion_descr,
+                               _QUATERNION_LOOP(&product_loop), arg_dtypes, NULL);
+  PyDict_SetItemString(numpy_dict, "product_vectorized", tmp_ufunc);
+  Py_DECREF(tmp_ufunc);
+  tmp_ufunc = PyUFunc_FromFuncAndDataAndSignature(NULL, NULL, NULL, 0, 3, 1,
+                                                  PyUFunc_None, "cumulative_product_vectorized",
+                                                  "Calculate the ordered partial products of quaternions along the final axis\n\n"
+                                                  "See `quaternion.cumulative_product` for details.",
+                                                  0, "(n),(),()->(n)");
+  PyUFunc_RegisterLoopForDescr((PyUFuncObject*)tmp_ufunc, quaternion_descr,
+                               _QUATERNION_LOOP(&cumulative_product_loop), arg_dtypes, NULL);
+  PyDict_SetItemString(numpy_dict, "cumulative_product_vectorized", tmp_ufunc);
+  Py_DECREF(tmp_ufunc);
+
+  // Create the generalized ufunc for the Karcher mean along an axis
+  arg_dtypes[0] = quaternion_descr;
+  arg_dtypes[1] = PyArray_DescrFromType(NPY_DOUBLE);
+  arg_dtypes[2] = PyArray_DescrFromType(NPY_DOUBLE);
+  arg_dtypes[3] = PyArray_DescrFromType(NPY_INT64);
+  arg_dtypes[4] = quaternion_descr;
+  arg_dtypes[5] = PyArray_DescrFromType(NPY_INT64);
+  tmp_ufunc = PyUFunc_FromFuncAndDataAndSignature(NULL, NULL, NULL, 0, 4, 2,
+                                                  PyUFunc_None, "karcher_mean_vectorized",
+                                                  "Calculate the weighted Karcher mean of rotors along the final axis\n\n"
+                                                  "The outputs are the mean and the number of iterations taken (or -1 if\n"
+                                                  "the iteration did not converge).  See\n"
+                                                  "`quaternion.means.mean_rotor_in_intrinsic_metric` for details.",
+                                                  0, "(n),(n),(),()->(),()");
+  PyUFunc_RegisterLoopForDescr((PyUFuncObject*)tmp_ufunc, quaternion_descr,
+                               _QUATERNION_LOOP(&karcher_mean_loop), arg_dtypes, NULL);
+  PyDict_SetItemString(numpy_dict, "karcher_mean_vectorized", tmp_ufunc);
+  Py_DECREF(tmp_ufunc);
+
+  // Create the generalized ufunc integrating tabulated angular velocities
+  arg_dtypes[0] = PyArray_DescrFromType(NPY_DOUBLE);
+  arg_dtypes[1] = PyArray_DescrFromType(NPY_DOUBLE);
+  arg_dtypes[2] = PyArray_DescrFromType(NPY_DOUBLE);
+  arg_dtypes[3] = quaternion_descr;
+  arg_dtypes[4] = quaternion_descr;
+  tmp_ufunc = PyUFunc_FromFuncAndDataAndSignature(NULL, NULL, NULL, 0, 4, 1,
+                                                  PyUFunc_None, "integrate_angular_velocity_vectorized",
+                                                  "Integrate angular velocities tabulated at times t and their midpoints\n\n"
+                                                  "The inputs are t, Omega at t, Omega at the midpoints of t (or an empty\n"
+                                                  "array, to interpolate them with cubics), and R0.\n"
+                                                  "See `quaternion.integrate_angular_velocity_rkmk4` for details.",
+                                                  0, "(n),(n,3),(m,3),()->(n)");
+  PyUFunc_RegisterLoopForDescr((PyUFuncObject*)tmp_ufunc, quaternion_descr,
+                               _QUATERNION_LOOP(&integrate_angular_velocity_loop), arg_dtypes, NULL);
+  PyDict_SetItemString(numpy_dict, "integrate_angular_velocity_vectorized", tmp_ufunc);
+  Py_DECREF(tmp_ufunc);
+
+  // Create the generalized ufunc for angular velocities of rotor time series
+  arg_dtypes[0] = quaternion_descr;
+  arg_dtypes[1] = PyArray_DescrFromType(NPY_DOUBLE);
+  arg_dtypes[2] = PyArray_DescrFromType(NPY_BOOL);
+  arg_dtypes[3] = PyArray_DescrFromType(NPY_DOUBLE);
+  tmp_ufunc = PyUFunc_FromFuncAndDataAndSignature(NULL, NULL, NULL, 0, 3, 1,
+                                                  PyUFunc_None, "angular_velocity_vectorized",
+                                                  "Angular velocity of a rotor time series\n\n"
+                                                  "The inputs are R, t, and whether to return the body-frame angular\n"
+                                                  "velocity.  See `quaternion.angular_velocity` for details.",
+                                                  0, "(n),(n),()->(n,3)");
+  PyUFunc_RegisterLoopForDescr((PyUFuncObject*)tmp_ufunc, quaternion_descr,
+                               _QUATERNION_LOOP(&angular_velocity_loop), arg_dtypes, NULL);
+  PyDict_SetItemString(numpy_dict, "angular_velocity_vectorized", tmp_ufunc);
+  Py_DECREF(tmp_ufunc);
+
+  // Create the generalized ufunc propagating gyro samples
+  arg_dtypes[0] = PyArray_DescrFromType(NPY_DOUBLE);
+  arg_dtypes[1] = PyArray_DescrFromType(NPY_DOUBLE);
+  arg_dtypes[2] = PyArray_DescrFromType(NPY_DOUBLE);
+  arg_dtypes[3] = quaternion_descr;
+  arg_dtypes[4] = PyArray_DescrFromType(NPY_DOUBLE);
+  arg_dtypes[5] = PyArray_DescrFromType(NPY_BOOL);
+  arg_dtypes[6] = quaternion_descr;
+  tmp_ufunc = PyUFunc_FromFuncAndDataAndSignature(NULL, NULL, NULL, 0, 6, 1,
+                                                  PyUFunc_None, "gyro_propagate_vectorized",
+                                                  "Propagate an attitude through fixed-rate gyro samples\n\n"
+                                                  "The inputs are the pending samples, the new samples, the sample before\n"
+                                                  "the pending ones, the attitude before the pending ones, dt, and whether\n"
+                                                  "to correct for coning.  See `quaternion.GyroIntegrator` for details.",
+                                                  0, "(p,3),(n,3),(3),(),(),()->(n)");
+  PyUFunc_RegisterLoopForDescr((PyUFuncObject*)tmp_ufunc, quaternion_descr,
+                               _QUATERNION_LOOP(&gyro_propagate_loop), arg_dtypes, NULL);
+  PyDict_SetItemString(numpy_dict, "gyro_propagate_vectorized", tmp_ufunc);
+  Py_DECREF(tmp_ufunc);
+
+  // Register the `quaternionf` versions of the elementwise ufuncs above
+  #define REGISTER_QUATERNIONF_UFUNC(pyname, cname, kinds)              \
+    if(_quaternionf_register_loop(PyDict_GetItemString(numpy_dict, #pyname), quaternionfNum, \
+                                  cname, kinds) < 0) {                  \
+      PyErr_SetString(PyExc_RuntimeError, "Could not register quaternionf loop for " #pyname); \
+      INITERROR;                                                        \
+    }
+  REGISTER_QUATERNIONF_UFUNC(isnan, quaternion_isnan_ufunc, "qb");
+  REGISTER_QUATERNIONF_UFUNC(isinf, quaternion_isinf_ufunc, "qb");
+  REGISTER_QUATERNIONF_UFUNC(isfinite, quaternion_isfinite_ufunc, "qb");
+  REGISTER_QUATERNIONF_UFUNC(norm, quaternion_norm_ufunc, "qf");
+  REGISTER_QUATERNIONF_UFUNC(absolute, quaternion_absolute_ufunc, "qf");
+  REGISTER_QUATERNIONF_UFUNC(angle_of_rotor, quaternion_angle_ufunc, "qf");
+  REGISTER_QUATERNIONF_UFUNC(sqrt_of_rotor, quaternion_sqrt_ufunc, "qq");
+  REGISTER_QUATERNIONF_UFUNC(log, quaternion_log_ufunc, "qq");
+  REGISTER_QUATERNIONF_UFUNC(exp, quaternion_exp_ufunc, "qq");
+  REGISTER_QUATERNIONF_UFUNC(normalized, quaternion_normalized_ufunc, "qq");
+  REGISTER_QUATERNIONF_UFUNC(x_parity_conjugate, quaternion_x_parity_conjugate_ufunc, "qq");
+  REGISTER_QUATERNIONF_UFUNC(x_parity_symmetric_part, quaternion_x_parity_symmetric_part_ufunc, "qq");
+  REGISTER_QUATERNIONF_UFUNC(x_parity_antisymmetric_part, quaternion_x_parity_antisymmetric_part_ufunc, "qq");
+  REGISTER_QUATERNIONF_UFUNC(y_parity_conjugate, quaternion_y_parity_conjugate_ufunc, "qq");
+  REGISTER_QUATERNIONF_UFUNC(y_parity_symmetric_part, quaternion_y_parity_symmetric_part_ufunc, "qq");
+  REGISTER_QUATERNIONF_UFUNC(y_parity_antisymmetric_part, quaternion_y_parity_antisymmetric_part_ufunc, "qq");
+  REGISTER_QUATERNIONF_UFUNC(z_parity_conjugate, quaternion_z_parity_conjugate_ufunc, "qq");
+  REGISTER_QUATERNIONF_UFUNC(z_parity_symmetric_part, quaternion_z_parity_symmetric_part_ufunc, "qq");
+  REGISTER_QUATERNIONF_UFUNC(z_parity_antisymmetric_part, quaternion_z_parity_antisymmetric_part_ufunc, "qq");
+  REGISTER_QUATERNIONF_UFUNC(parity_conjugate, quaternion_parity_conjugate_ufunc, "qq");
+  REGISTER_QUATERNIONF_UFUNC(parity_symmetric_part, quaternion_parity_symmetric_part_ufunc, "qq");
+  REGISTER_QUATERNIONF_UFUNC(parity_antisymmetric_part, quaternion_parity_antisymmetric_part_ufunc, "qq");
+  REGISTER_QUATERNIONF_UFUNC(negative, quaternion_negative_ufunc, "qq");
+  REGISTER_QUATERNIONF_UFUNC(conjugate, quaternion_conjugate_ufunc, "qq");
+  REGISTER_QUATERNIONF_UFUNC(invert, quaternion_invert_ufunc, "qq");
+  REGISTER_QUATERNIONF_UFUNC(equal, quaternion_equal_ufunc, "qqb");
+  REGISTER_QUATERNIONF_UFUNC(not_equal, quaternion_not_equal_ufunc, "qqb");
+  REGISTER_QUATERNIONF_UFUNC(less, quaternion_less_ufunc, "qqb");
+  REGISTER_QUATERNIONF_UFUNC(less_equal, quaternion_less_equal_ufunc, "qqb");
+  // A `quaternionf` combined with a double-precision real promotes to
+  // `quaternion`.  Numpy only searches the loops registered for user
+  // types that appear among the inputs, so these mixed loops must also
+  // be registered for `quaternionf` itself.
+  #define REGISTER_QUATERNIONF_MIXED_UFUNC(name)                        \
+    arg_types[0] = NPY_DOUBLE;                                          \
+    arg_types[1] = quaternion_descr->type_num;                          \
+    arg_types[2] = quaternion_descr->type_num;                          \
+    PyUFunc_RegisterLoopForType((PyUFuncObject *)PyDict_GetItemString(numpy_dict, #name), \
+                                quaternionfNum, _QUATERNION_LOOP(quaternion_scalar_##name##_ufunc), \
+                                arg_types, NULL);                       \
+    arg_types[0] = quaternion_descr->type_num;                          \
+    arg_types[1] = NPY_DOUBLE;                                          \
+    PyUFunc_RegisterLoopForType((PyUFuncObject *)PyDict_GetItemString(numpy_dict, #name), \
+                                quaternionfNum, _QUATERNION_LOOP(quaternion_##name##_scalar_ufunc), \
+                                arg_types, NULL)
+  #define REGISTER_QUATERNIONF_BINARY_UFUNC(name)                       \
+    REGISTER_QUATERNIONF_UFUNC(name, quaternion_##name##_ufunc, "qqq"); \
+    REGISTER_QUATERNIONF_UFUNC(name, quaternion_scalar_##name##_ufunc, "fqq"); \
+    REGISTER_QUATERNIONF_UFUNC(name, quaternion_##name##_scalar_ufunc, "qfq"); \
+    REGISTER_QUATERNIONF_MIXED_UFUNC(name)
+  #define REGISTER_QUATERNIONF_NATIVE_UFUNC(name)                       \
+    arg_types[0] = quaternionfNum;                                      \
+    arg_types[1] = quaternionfNum;                                      \
+    arg_types[2] = quaternionfNum;                                      \
+    PyUFunc_RegisterLoopForType((PyUFuncObject *)PyDict_GetItemString(numpy_dict, #name), \
+                                quaternionfNum, _QUATERNION_LOOP(quaternionf_##name##_ufunc), \
+                                arg_types, NULL);                       \
+    arg_types[0] = NPY_FLOAT;                                           \
+    PyUFunc_RegisterLoopForType((PyUFuncObject *)PyDict_GetItemString(numpy_dict, #name), \
+                                quaternionfNum, _QUATERNION_LOOP(quaternionf_scalar_##name##_ufunc), \
+                                arg_types, NULL);                       \
+    arg_types[0] = quaternionfNum;                                      \
+    arg_types[1] = NPY_FLOAT;                                           \
+    PyUFunc_RegisterLoopForType((PyUFuncObject *)PyDict_GetItemString(numpy_dict, #name), \
+                                quaternionfNum, _QUATERNION_LOOP(quaternionf_##name##_scalar_ufunc), \
+                                arg_types, NULL);                       \
+    REGISTER_QUATERNIONF_MIXED_UFUNC(name)
+  REGISTER_QUATERNIONF_NATIVE_UFUNC(add);
+  REGISTER_QUATERNIONF_NATIVE_UFUNC(subtract);
+  REGISTER_QUATERNIONF_NATIVE_UFUNC(multiply);
+  REGISTER_QUATERNIONF_BINARY_UFUNC(divide);
+  REGISTER_QUATERNIONF_BINARY_UFUNC(true_divide);
+  REGISTER_QUATERNIONF_BINARY_UFUNC(floor_divide);
+  REGISTER_QUATERNIONF_BINARY_UFUNC(power);
+  REGISTER_QUATERNIONF_UFUNC(copysign, quaternion_copysign_ufunc, "qqq");
+  REGISTER_QUATERNIONF_UFUNC(rotor_intrinsic_distance, quaternion_rotor_intrinsic_distance_ufunc, "qqf");
+  REGISTER_QUATERNIONF_UFUNC(rotor_chordal_distance, quaternion_rotor_chordal_distance_ufunc, "qqf");
+  REGISTER_QUATERNIONF_UFUNC(rotation_intrinsic_distance, quaternion_rotation_intrinsic_distance_ufunc, "qqf");
+  REGISTER_QUATERNIONF_UFUNC(rotation_chordal_distance, quaternion_rotation_chordal_distance_ufunc, "qqf");
+  REGISTER_QUATERNIONF_UFUNC(slerp_vectorized, slerp_loop, "qqdq");
+  REGISTER_QUATERNIONF_UFUNC(slerp_unit_vectorized, slerp_unit_loop, "qqdq");
+  REGISTER_QUATERNIONF_UFUNC(squad_vectorized, squad_loop, "dqqqqq");
+
+  // Create the generalized ufuncs that rotate vectors by quaternions.
+  // These broadcast over everything except the final axis of the
+  // vector array, which must have length 3.
+  arg_dtypes[0] = quaternion_descr;
+  arg_dtypes[1] = PyArray_DescrFromType(NPY_DOUBLE);
+  arg_dtypes[2] = PyArray_DescrFromType(NPY_DOUBLE);
+  #define REGISTER_ROTATE_VECTOR_GUFUNC(name, doc)                      \
+    tmp_ufunc = PyUFunc_FromFuncAndDataAndSignature(NULL, NULL, NULL, 0, 2, 1, \
+                                                    PyUFunc_None, #name, doc, 0, "(),(3)->(3)"); \
+    PyUFunc_RegisterLoopForDescr((PyUFuncObject*)tmp_ufunc, quaternion_descr, \
+                                 _QUATERNION_LOOP(&name##_loop), arg_dtypes, NULL); \
+    PyDict_SetItemString(numpy_dict, #name, tmp_ufunc);                 \
+    Py_DECREF(tmp_ufunc)
+  REGISTER_ROTATE_VECTOR_GUFUNC(rotate_vector,
+                                "Rotate 3-vectors (along the final axis) by unit rotors\n\n"
+                                "The input quaternions are assumed to be normalized.  See\n"
+                                "`numpy.rotate_vector_and_normalize` for general nonzero quaternions,\n"
+                                "and `quaternion.rotate_vectors` for the most useful form.");
+  REGISTER_ROTATE_VECTOR_GUFUNC(rotate_vector_and_normalize,
+                                "Rotate 3-vectors (along the final axis) by nonzero quaternions\n\n"
+                                "The input quaternions need not be normalized.  See\n"
+                                "`quaternion.rotate_vectors` for the most useful form.");
+
+  // Create the generalized ufuncs that convert to and from rotation
+  // matrices.  These act on plain float arrays, so numpy's own casts
+  // apply to the inputs, including float32 views of `quaternionf`.
+  tmp_ufunc = PyUFunc_FromFuncAndDataAndSignature(as_rotation_matrix_loops, float_gufunc_data,
+                                                  float_gufunc_types, 1, 1, 1, PyUFunc_None,
+                                                  "as_rotation_matrix_vectorized",
+                                                  "Convert quaternions (along the final axis) to rotation matrices\n\n"
+                                                  "The quaternions need not be normalized, but must be nonzero.  See\n"
+                                                  "`quaternion.as_rotation_matrix` for the most useful form.",
+                                                  0, "(4)->(3,3)");
+  PyDict_SetItemString(numpy_dict, "as_rotation_matrix_vectorized", tmp_ufunc);
+  Py_DECREF(tmp_ufunc);
+  tmp_ufunc = PyUFunc_FromFuncAndDataAndSignature(from_rotation_matrix_loops, float_gufunc_data,
+                                                  float_gufunc_types, 1, 1, 1, PyUFunc_None,
+                                                  "from_rotation_matrix_vectorized",
+                                                  "Convert rotation matrices (along the final two axes) to unit quaternions\n\n"
+                                                  "This uses Markley's algorithm.  See `quaternion.from_rotation_matrix`\n"
+                                                  "for the most useful form.",
+                                                  0, "(3,3)->(4)");
+  PyDict_SetItemString(numpy_dict, "from_rotation_matrix_vectorized", tmp_ufunc);
+  Py_DECREF(tmp_ufunc);
+  tmp_ufunc = PyUFunc_FromFuncAndDataAndSignature(from_nonorthogonal_rotation_matrix_loops, float_gufunc_data,
+                                                  float_gufunc_types, 1, 1, 1, PyUFunc_None,
+                                                  "from_nonorthogonal_rotation_matrix_vectorized",
+                                                  "Convert approximate rotation matrices (along the final two axes) to unit quaternions\n\n"
+                                                  "This uses Bar-Itzhack's algorithm, which finds the nearest rotation.\n"
+                                                  "See `quaternion.from_rotation_matrix` for the most useful form.",
+                                                  0, "(3,3)->(4)");
+  PyDict_SetItemString(numpy_dict, "from_nonorthogonal_rotation_matrix_vectorized", tmp_ufunc);
+  Py_DECREF(tmp_ufunc);
+  // Create the generalized ufuncs that convert to and from rotation
+  // vectors
+  tmp_ufunc = PyUFunc_FromFuncAndDataAndSignature(as_rotation_vector_loops, float_gufunc_data,
+                                                  float_gufunc_types, 1, 1, 1, PyUFunc_None,
+                                                  "as_rotation_vector_vectorized",
+                                                  "Convert quaternions (along the final axis) to rotation vectors\n\n"
+                                                  "The quaternions need not be normalized, but must be nonzero.  See\n"
+                                                  "`quaternion.as_rotation_vector` for the most useful form.",
+                                                  0, "(4)->(3)");
+  PyDict_SetItemString(numpy_dict, "as_rotation_vector_vectorized", tmp_ufunc);
+  Py_DECREF(tmp_ufunc);
+  tmp_ufunc = PyUFunc_FromFuncAndDataAndSignature(from_rotation_vector_loops, float_gufunc_data,
+                                                  float_gufunc_types, 1, 1, 1, PyUFunc_None,
+                                                  "from_rotation_vector_vectorized",
+                                                  "Convert rotation vectors (along the final axis) to unit quaternions\n\n"
+                                                  "See `quaternion.from_rotation_vector` for the most useful form.",
+                                                  0, "(3)->(4)");
+  PyDict_SetItemString(numpy_dict, "from_rotation_vector_vectorized", tmp_ufunc);
+  Py_DECREF(tmp_ufunc);
+  // Create the generalized ufuncs that convert to and from Euler angles
+  // and spherical coordinates.  The standard `zyz` Euler angles and the
+  // spherical coordinates are added to numpy; all the conventions for
+  // Euler angles are collected in `quaternion._euler_angle_gufuncs`,
+  // keyed by the axes of the factors, with values (from, as).
+  #define REGISTER_ANGLES_GUFUNC(direction, name, signature, doc)       \
+    tmp_ufunc = PyUFunc_FromFuncAndDataAndSignature(direction##_##name##_loops, float_gufunc_data, \
+                                                    float_gufunc_types, 1, 1, 1, PyUFunc_None, \
+                                                    #direction "_" #name "_vectorized", doc, 0, signature)
+  REGISTER_ANGLES_GUFUNC(from, spherical_coords, "(2)->(4)",
+                         "Convert spherical coordinates (along the final axis) to quaternions\n\n"
+                         "See `quaternion.from_spherical_coords` for the most useful form.");
+  PyDict_SetItemString(numpy_dict, "from_spherical_coords_vectorized", tmp_ufunc);
+  Py_DECREF(tmp_ufunc);
+  REGISTER_ANGLES_GUFUNC(as, spherical_coords, "(4)->(2)",
+                         "Convert quaternions (along the final axis) to spherical coordinates\n\n"
+                         "See `quaternion.as_spherical_coords` for the most useful form.");
+  PyDict_SetItemString(numpy_dict, "as_spherical_coords_vectorized", tmp_ufunc);
+  Py_DECREF(tmp_ufunc);
+  euler_angle_gufuncs = PyDict_New();
+  if(euler_angle_gufuncs == NULL) {
+    INITERROR;
+  }
+  #define REGISTER_EULER_ANGLES_GUFUNCS(name)                           \
+    REGISTER_ANGLES_GUFUNC(from, euler_angles_##name, "(3)->(4)",       \
+                           "Convert " #name " Euler angles (along the final axis) to quaternions\n\n" \
+                           "See `quaternion.from_euler_angles` for the most useful form."); \
+    tmp_ufunc2 = tmp_ufunc;                                             \
+    REGISTER_ANGLES_GUFUNC(as, euler_angles_##name, "(4)->(3)",         \
+                           "Convert quaternions (along the final axis) to " #name " Euler angles\n\n" \
+                           "See `quaternion.as_euler_angles` for the most useful form."); \
+    PyDict_SetItemString(euler_angle_gufuncs, #name, Py_BuildValue("(NN)", tmp_ufunc2, tmp_ufunc))
+  REGISTER_EULER_ANGLES_GUFUNCS(zyz);
+  REGISTER_EULER_ANGLES_GUFUNCS(xyx);
+  REGISTER_EULER_ANGLES_GUFUNCS(xzx);
+  REGISTER_EULER_ANGLES_GUFUNCS(yxy);
+  REGISTER_EULER_ANGLES_GUFUNCS(yzy);
+  REGISTER_EULER_ANGLES_GUFUNCS(zxz);
+  REGISTER_EULER_ANGLES_GUFUNCS(xyz);
+  REGISTER_EULER_ANGLES_GUFUNCS(xzy);
+  REGISTER_EULER_ANGLES_GUFUNCS(yxz);
+  REGISTER_EULER_ANGLES_GUFUNCS(yzx);
+  REGISTER_EULER_ANGLES_GUFUNCS(zxy);
+  REGISTER_EULER_ANGLES_GUFUNCS(zyx);
+  PyDict_SetItemString(numpy_dict, "from_euler_angles_vectorized",
+                       PyTuple_GET_ITEM(PyDict_GetItemString(euler_angle_gufuncs, "zyz"), 0));
+  PyDict_SetItemString(numpy_dict, "as_euler_angles_vectorized",
+                       PyTuple_GET_ITEM(PyDict_GetItemString(euler_angle_gufuncs, "zyz"), 1));
+  PyModule_AddObject(module, "_euler_angle_gufuncs", euler_angle_gufuncs);
+  // Create the generalized ufuncs that pack and unpack rotors, collected
+  // in `quaternion._rotor_encoding_gufuncs`, keyed by the number of bits
+  // in the code, with values (encode, decode)
+  rotor_encoding_gufuncs = PyDict_New();
+  if(rotor_encoding_gufuncs == NULL) {
+    INITERROR;
+  }
+  #define REGISTER_ROTOR_ENCODING_GUFUNCS(name, size)                   \
+    tmp_ufunc = PyUFunc_FromFuncAndDataAndSignature(encode_##name##_loops, float_gufunc_data, \
+                                                    encode_##name##_types, 1, 1, 1, PyUFunc_None, \
+                                                    "encode_" #name, \
+                                                    "Pack quaternions (along the final axis) into " #size "-bit codes\n\n" \
+                                                    "See `quaternion.encode_rotors` for the most useful form.", \
+                                                    0, "(4)->()");      \
+    tmp_ufunc2 = PyUFunc_FromFuncAndDataAndSignature(decode_##name##_loops, float_gufunc_data, \
+                                                     decode_##name##_types, 1, 1, 1, PyUFunc_None, \
+                                                     "decode_" #name, \
+                                                     "Unpack " #size "-bit codes into unit quaternions (along the final axis)\n\n" \
+                                                     "See `quaternion.decode_rotors` for the most useful form.", \
+                                                     0, "()->(4)");     \
+    PyDict_SetItem(rotor_encoding_gufuncs, PyLong_FromLong(size), Py_BuildValue("(NN)", tmp_ufunc, tmp_ufunc2))
+  REGISTER_ROTOR_ENCODING_GUFUNCS(rotor32, 32);
+  REGISTER_ROTOR_ENCODING_GUFUNCS(rotor48, 48);
+  REGISTER_ROTOR_ENCODING_GUFUNCS(rotor64, 64);
+  PyModule_AddObject(module, "_rotor_encoding_gufuncs", rotor_encoding_gufuncs);
+
+  // Create the ufuncs used by `QuaternionArray`, which are private to
+  // this module
+  tmp_ufunc = PyUFunc_FromFuncAndData(soa_multiply_loops, float_gufunc_data, soa_binary_types, 1, 8, 4,
+                                      PyUFunc_None, "_soa_multiply",
+                                      "Multiply quaternions given as separate arrays of components", 0);
+  PyModule_AddObject(module, "_soa_multiply", tmp_ufunc);
+  tmp_ufunc = PyUFunc_FromFuncAndData(soa_divide_loops, float_gufunc_data, soa_binary_types, 1, 8, 4,
+                                      PyUFunc_None, "_soa_divide",
+                                      "Divide quaternions given as separate arrays of components", 0);
+  PyModule_AddObject(module, "_soa_divide", tmp_ufunc);
+
+  // Add the inverse derivative of the exponential map, on 3-vectors, to
+  // the module as `quaternion._dexp_inverse`
+  tmp_ufunc = PyUFunc_FromFuncAndDataAndSignature(dexp_inverse_loops, float_gufunc_data,
+                                                  float_binary_gufunc_types, 1, 2, 1, PyUFunc_None,
+                                                  "_dexp_inverse",
+                                                  "Inverse derivative of the exponential map at L, applied to w", 0,
+                                                  "(3),(3)->(3)");
+  PyModule_AddObject(module, "_dexp_inverse", tmp_ufunc);
+
+  // Create the private gufuncs behind `quaternion.calculus`
+  tmp_ufunc = PyUFunc_FromFuncAndDataAndSignature(derivative_loops, float_gufunc_data,
+                                                  float_binary_gufunc_types, 1, 2, 1, PyUFunc_None,
+                                                  "_derivative",
+                                                  "Fourth-order derivative of f with respect to t", 0,
+                                                  "(n),(n)->(n)");
+  PyModule_AddObject(module, "_derivative", tmp_ufunc);
+  tmp_ufunc = PyUFunc_FromFuncAndDataAndSignature(indefinite_integral_loops, float_gufunc_data,
+                                                  float_binary_gufunc_types, 1, 2, 1, PyUFunc_None,
+                                                  "_indefinite_integral",
+                                                  "Cumulative trapezoidal integral of f with respect to t", 0,
+                                                  "(n),(n)->(n)");
+  PyModule_AddObject(module, "_indefinite_integral", tmp_ufunc);
+  tmp_ufunc = PyUFunc_FromFuncAndDataAndSignature(definite_integral_loops, float_gufunc_data,
+                                                  float_binary_gufunc_types, 1, 2, 1, PyUFunc_None,
+                                                  "_definite_integral",
+                                                  "Trapezoidal integral of f with respect to t", 0,
+                                                  "(n),(n)->()");
+  PyModule_AddObject(module, "_definite_integral", tmp_ufunc);
+  tmp_ufunc = PyUFunc_FromFuncAndDataAndSignature(frame_from_angular_velocity_integrand_loops, float_gufunc_data,
+                                                  float_binary_gufunc_types, 1, 2, 1, PyUFunc_None,
+                                                  "_frame_from_angular_velocity_integrand",
+                                                  "Derivative of the rotation vector rfrak of a frame with angular "
+                                                  "velocity Omega", 0,
+                                                  "(3),(3)->(3)");
+  PyModule_AddObject(module, "_frame_from_angular_velocity_integrand", tmp_ufunc);
 
   // Add the constant `_QUATERNION_EPS` to the module as `quaternion._eps`
   PyModule_AddObject(module, "_eps", PyFloat_FromDouble(_QUATERNION_EPS));
+  PyModule_AddIntConstant(module, "_gyro_block", QUATERNION_GYRO_BLOCK);
+
+  // Add the basis constants, created once here.  These are ordinary
+  // (mutable) quaternion objects, so results of arithmetic are never
+  // shared with them.
+  {
+    quaternion zero = {0.0, 0.0, 0.0, 0.0}, one = {1.0, 0.0, 0.0, 0.0};
+    quaternion x = {0.0, 1.0, 0.0, 0.0}, y = {0.0, 0.0, 1.0, 0.0}, z = {0.0, 0.0, 0.0, 1.0};
+    PyModule_AddObject(module, "zero", PyQuaternion_FromQuaternion(zero));
+    PyModule_AddObject(module, "one", PyQuaternion_FromQuaternion(one));
+    PyModule_AddObject(module, "x", PyQuaternion_FromQuaternion(x));
+    PyModule_AddObject(module, "y", PyQuaternion_FromQuaternion(y));
+    PyModule_AddObject(module, "z", PyQuaternion_FromQuaternion(z));
+  }
  
   // Finally, add this quaternion object to the quaternion module itself
   PyModule_AddObject(module, "quaternion", (PyObject *)&PyQuaternion_Type);
+  Py_INCREF(&PyQuaternionF_Type);
+  PyModule_AddObject(module, "quaternionf", (PyObject *)&PyQuaternionF_Type);
 
 
 #if PY_MAJOR_VERSION >= 3
@@ -38,6 +38,204 @@ quaternion_create_from_euler_angles(double alpha, double beta, double gamma) {
   return r;
 }
 
+quaternion
+quaternion_create_from_rotation_matrix(const double m[]) {
+  // Markley's algorithm [J. Guidance, Vol. 31, No. 2, p. 440], for a
+  // row-major matrix: build the column of 4*q*q_i that belongs to the
+  // largest of the diagonal elements and the trace, which is the most
+  // accurate, and normalize it
+  const double trace = m[0] + m[4] + m[8];
+  double n;
+  quaternion r;
+  if(m[0] >= m[4] && m[0] >= m[8] && m[0] >= trace) {
+    r.w = m[7] - m[5];
+    r.x = 1 + m[0] - m[4] - m[8];
+    r.y = m[1] + m[3];
+    r.z = m[2] + m[6];
+  } else if(m[4] >= m[8] && m[4] >= trace) {
+    r.w = m[2] - m[6];
+    r.x = m[3] + m[1];
+    r.y = 1 - m[0] + m[4] - m[8];
+    r.z = m[5] + m[7];
+  } else if(m[8] >= trace) {
+    r.w = m[3] - m[1];
+    r.x = m[6] + m[2];
+    r.y = m[7] + m[5];
+    r.z = 1 - m[0] - m[4] + m[8];
+  } else {
+    r.w = 1 + trace;
+    r.x = m[7] - m[5];
+    r.y = m[2] - m[6];
+    r.z = m[3] - m[1];
+  }
+  n = sqrt(r.w*r.w + r.x*r.x + r.y*r.y + r.z*r.z);
+  r.w /= n;
+  r.x /= n;
+  r.y /= n;
+  r.z /= n;
+  return r;
+}
+
+// Find the eigenvector of the symmetric 4x4 matrix `a` with the largest
+// eigenvalue by cyclic Jacobi rotations, which are accurate even for
+// nearly degenerate eigenvalues.  The matrix is overwritten.
+static void
+_quaternion_symmetric4_largest_eigenvector(double a[4][4], double v[4])
+{
+  double V[4][4] = {{1, 0, 0, 0}, {0, 1, 0, 0}, {0, 0, 1, 0}, {0, 0, 0, 1}};
+  int sweep, p, q, k;
+  for(sweep = 0; sweep < 50; sweep++) {
+    double off = 0.0;
+    for(p = 0; p < 3; p++) {
+      for(q = p+1; q < 4; q++) {
+        off += fabs(a[p][q]);
+      }
+    }
+    if(off != off) {
+      v[0] = v[1] = v[2] = v[3] = off;
+      return;
+    }
+    if(off == 0.0) {
+      break;
+    }
+    for(p = 0; p < 3; p++) {
+      for(q = p+1; q < 4; q++) {
+        const double g = 100.0 * fabs(a[p][q]);
+        double theta, t, c, s;
+        // Once an element is negligible next to both diagonal elements,
+        // rotating would not change them; just zero it
+        if(sweep > 3 && fabs(a[p][p]) + g == fabs(a[p][p]) && fabs(a[q][q]) + g == fabs(a[q][q])) {
+          a[p][q] = a[q][p] = 0.0;
+          continue;
+        }
+        if(a[p][q] == 0.0) {
+          continue;
+        }
+        theta = (a[q][q] - a[p][p]) / (2 * a[p][q]);
+        t = (fabs(theta) > 1e150) ? 1 / (2 * theta)
+          : ((theta >= 0) ? 1 : -1) / (fabs(theta) + sqrt(theta*theta + 1));
+        c = 1 / sqrt(t*t + 1);
+        s = t * c;
+        for(k = 0; k < 4; k++) {
+          const double akp = a[k][p], akq = a[k][q];
+          a[k][p] = c*akp - s*akq;
+          a[k][q] = s*akp + c*akq;
+        }
+        for(k = 0; k < 4; k++) {
+          const double apk = a[p][k], aqk = a[q][k];
+          a[p][k] = c*apk - s*aqk;
+          a[q][k] = s*apk + c*aqk;
+        }
+        for(k = 0; k < 4; k++) {
+          const double vkp = V[k][p], vkq = V[k][q];
+          V[k][p] = c*vkp - s*vkq;
+          V[k][q] = s*vkp + c*vkq;
+        }
+      }
+    }
+  }
+  p = 0;
+  for(k = 1; k < 4; k++) {
+    if(a[k][k] > a[p][p]) {
+      p = k;
+    }
+  }
+  for(k = 0; k < 4; k++) {
+    v[k] = V[k][p];
+  }
+}
+
+quaternion
+quaternion_create_from_nonorthogonal_rotation_matrix(const double m[]) {
+  // Bar-Itzhack's algorithm [J. Guidance, Vol. 23, No. 6, p. 1085], for
+  // a row-major matrix: the rotor is the eigenvector of `K3` with the
+  // largest eigenvalue, in Bar-Itzhack's conventions (scalar last, and
+  // conjugated relative to ours).
+  //
+  // For a rotation matrix, the eigenvalues of `K3` are 1 and -1/3 (three
+  // times), and they are only perturbed by errors in the matrix.  So
+  // power iteration with `(K3 + 1/3)^4` -- starting from Markley's
+  // solution, which is already close -- converges very quickly: each
+  // step reduces the error by the fourth power of the ratio between the
+  // error in the matrix and 4/3, and one step is usually enough to reach
+  // machine precision.  Since `K3` has
+  // zero trace, the other eigenvalues are bounded by the Frobenius norm
+  // of `K3` after removing the converged one; when that bound does not
+  // prove that it is the largest, or the iteration does not converge,
+  // the full Jacobi solution is used instead.
+  double K3[4][4], M2[4][4], M4[4][4], v[4], Kv[4], norm2 = 0.0;
+  quaternion r = quaternion_create_from_rotation_matrix(m);
+  int iteration, i, j, k;
+  K3[0][0] = (m[0] - m[4] - m[8]) / 3.0;
+  K3[0][1] = K3[1][0] = (m[3] + m[1]) / 3.0;
+  K3[0][2] = K3[2][0] = (m[6] + m[2]) / 3.0;
+  K3[0][3] = K3[3][0] = (m[5] - m[7]) / 3.0;
+  K3[1][1] = (m[4] - m[0] - m[8]) / 3.0;
+  K3[1][2] = K3[2][1] = (m[7] + m[5]) / 3.0;
+  K3[1][3] = K3[3][1] = (m[6] - m[2]) / 3.0;
+  K3[2][2] = (m[8] - m[0] - m[4]) / 3.0;
+  K3[2][3] = K3[3][2] = (m[1] - m[3]) / 3.0;
+  K3[3][3] = (m[0] + m[4] + m[8]) / 3.0;
+  for(i = 0; i < 4; i++) {
+    for(j = 0; j < 4; j++) {
+      norm2 += K3[i][j] * K3[i][j];
+    }
+  }
+  v[0] = -r.x;
+  v[1] = -r.y;
+  v[2] = -r.z;
+  v[3] = r.w;
+  for(iteration = 0; iteration < 8; iteration++) {
+    double lambda = 0.0, residual2 = 0.0, Kv_norm2 = 0.0;
+    for(i = 0; i < 4; i++) {
+      Kv[i] = K3[i][0]*v[0] + K3[i][1]*v[1] + K3[i][2]*v[2] + K3[i][3]*v[3];
+      lambda += v[i] * Kv[i];
+    }
+    for(i = 0; i < 4; i++) {
+      residual2 += (Kv[i] - lambda*v[i]) * (Kv[i] - lambda*v[i]);
+    }
+    if(residual2 <= 64 * DBL_EPSILON * DBL_EPSILON * norm2) {
+      if(lambda >= 0 && 2*lambda*lambda >= norm2) {
+        r.w = v[3];
+        r.x = -v[0];
+        r.y = -v[1];
+        r.z = -v[2];
+        return r;
+      }
+      break;
+    }
+    if(iteration == 0) {
+      for(i = 0; i < 4; i++) {
+        for(j = 0; j < 4; j++) {
+          M2[i][j] = 0.0;
+          for(k = 0; k < 4; k++) {
+            M2[i][j] += (K3[i][k] + (i == k) / 3.0) * (K3[k][j] + (k == j) / 3.0);
+          }
+        }
+      }
+      for(i = 0; i < 4; i++) {
+        for(j = 0; j < 4; j++) {
+          M4[i][j] = M2[i][0]*M2[0][j] + M2[i][1]*M2[1][j] + M2[i][2]*M2[2][j] + M2[i][3]*M2[3][j];
+        }
+      }
+    }
+    for(i = 0; i < 4; i++) {
+      Kv[i] = M4[i][0]*v[0] + M4[i][1]*v[1] + M4[i][2]*v[2] + M4[i][3]*v[3];
+      Kv_norm2 += Kv[i] * Kv[i];
+    }
+    Kv_norm2 = sqrt(Kv_norm2);
+    for(i = 0; i < 4; i++) {
+      v[i] = Kv[i] / Kv_norm2;
+    }
+  }
+  _quaternion_symmetric4_largest_eigenvector(K3, v);
+  r.w = v[3];
+  r.x = -v[0];
+  r.y = -v[1];
+  r.z = -v[2];
+  return r;
+}
+
 quaternion
 quaternion_sqrt(quaternion q)
 {
@@ -121,6 +319,110 @@ quaternion_exp(quaternion q)
   }
 }
 
+// The generator log(+/-q2/q1) used by `slerp(q1, q2, tau)`, so that the
+// result is exp(tau * generator) * q1
+static quaternion
+_slerp_generator(quaternion q1, quaternion q2)
+{
+  if(quaternion_rotor_chordal_distance(q1,q2)<=1.414213562373096) {
+    return quaternion_log(quaternion_divide(q2,q1));
+  } else {
+    return quaternion_log(quaternion_divide(quaternion_negative(q2),q1));
+  }
+}
+
+// For pure quaternions L = phi*n and w, the derivative of the
+// exponential, d/dt exp(L) exp(-L) = dexp_L(dL/dt), is
+//   dexp_L(w) = w_par + sin(2phi)/(2phi) w_perp + sin(phi)^2/phi n x w_perp,
+// with inverse
+//   dexp_L^{-1}(w) = w_par + phi/tan(phi) w_perp - phi n x w_perp,
+// where w_par and w_perp are the parts of w parallel and perpendicular
+// to n.  The scalar parts of L and w are ignored.
+static quaternion
+_quaternion_dexp(quaternion L, quaternion w, int inverse)
+{
+  double phi = sqrt(L.x*L.x + L.y*L.y + L.z*L.z);
+  if(phi <= DBL_MIN) {
+    quaternion r = {0.0, w.x, w.y, w.z};
+    return r;
+  } else {
+    double nx = L.x/phi, ny = L.y/phi, nz = L.z/phi;
+    double dot = nx*w.x + ny*w.y + nz*w.z;
+    double px = w.x - dot*nx, py = w.y - dot*ny, pz = w.z - dot*nz;
+    double c_perp, c_cross;
+    if(inverse) {
+      c_perp = phi/tan(phi);
+      c_cross = -phi;
+    } else {
+      c_perp = sin(2*phi)/(2*phi);
+      c_cross = sin(phi)*sin(phi)/phi;
+    }
+    {
+      quaternion r = {0.0,
+                      dot*nx + c_perp*px + c_cross*(ny*pz - nz*py),
+                      dot*ny + c_perp*py + c_cross*(nz*px - nx*pz),
+                      dot*nz + c_perp*pz + c_cross*(nx*py - ny*px)};
+      return r;
+    }
+  }
+}
+
+quaternion
+quaternion_dexp_inverse(quaternion L, quaternion w)
+{
+  return _quaternion_dexp(L, w, 1);
+}
+
+quaternion
+quaternion_rkmk4_step(quaternion R, double h, quaternion Omega_0, quaternion Omega_half, quaternion Omega_1)
+{
+  /* Writing R(t) = exp(theta(t)) R(t_0), the pure quaternion theta obeys
+       dtheta/dt = dexp_theta^{-1}(Omega/2),
+     with theta(t_0) = 0, which is integrated over one step by the
+     classical Runge-Kutta method.  Since Omega depends only on time,
+     the second and third stages evaluate it at the same time. */
+  quaternion k1 = quaternion_multiply_scalar(Omega_0, h/2);
+  quaternion k2 = _quaternion_dexp(quaternion_multiply_scalar(k1, 0.5),
+                                   quaternion_multiply_scalar(Omega_half, h/2), 1);
+  quaternion k3 = _quaternion_dexp(quaternion_multiply_scalar(k2, 0.5),
+                                   quaternion_multiply_scalar(Omega_half, h/2), 1);
+  quaternion k4 = _quaternion_dexp(k3, quaternion_multiply_scalar(Omega_1, h/2), 1);
+  quaternion theta = {0.0,
+                      (k1.x + 2*k2.x + 2*k3.x + k4.x)/6,
+                      (k1.y + 2*k2.y + 2*k3.y + k4.y)/6,
+                      (k1.z + 2*k2.z + 2*k3.z + k4.z)/6};
+  return quaternion_normalized(quaternion_multiply(quaternion_exp(theta), R));
+}
+
+quaternion
+squad_angular_velocity(double tau_i, quaternion q_i, quaternion a_i, quaternion b_ip1, quaternion q_ip1)
+{
+  /* Writing P = slerp(q_i, q_ip1, tau) = exp(tau*Lp)*q_i and
+     Q = slerp(a_i, b_ip1, tau) = exp(tau*Lq)*a_i, squad is
+     S = exp(h*L)*P, with h = 2*tau*(1-tau) and L = log(+/-Q/P).  Then
+       (dS/dtau) S^{-1} = dexp_{hL}(dh/dtau*L + h*dL/dtau) + exp(hL) Lp exp(-hL),
+     where
+       dL/dtau = dexp_L^{-1}((d(Q/P)/dtau) (Q/P)^{-1}) = dexp_L^{-1}(Lq - (Q/P) Lp (Q/P)^{-1}). */
+  quaternion Lp = _slerp_generator(q_i, q_ip1);
+  quaternion Lq = _slerp_generator(a_i, b_ip1);
+  quaternion P = quaternion_multiply(quaternion_exp(quaternion_multiply_scalar(Lp, tau_i)), q_i);
+  quaternion Q = quaternion_multiply(quaternion_exp(quaternion_multiply_scalar(Lq, tau_i)), a_i);
+  quaternion X = quaternion_divide(Q, P);
+  quaternion L = _slerp_generator(P, Q);
+  double h = 2*tau_i*(1-tau_i);
+  double hdot = 2 - 4*tau_i;
+  quaternion Ldot = _quaternion_dexp(L, quaternion_subtract(Lq, quaternion_multiply(quaternion_multiply(X, Lp),
+                                                                                    quaternion_inverse(X))), 1);
+  quaternion M = quaternion_multiply_scalar(L, h);
+  quaternion Mdot = quaternion_add(quaternion_multiply_scalar(L, hdot), quaternion_multiply_scalar(Ldot, h));
+  quaternion E = quaternion_exp(M);
+  quaternion r = quaternion_add(_quaternion_dexp(M, Mdot, 0),
+                                quaternion_multiply(quaternion_multiply(E, Lp), quaternion_inverse(E)));
+  r = quaternion_multiply_scalar(r, 2.0);
+  r.w = 0.0;
+  return r;
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -35,9 +35,71 @@ extern "C" {
     double z;
   } quaternion;
 
+  // Single-precision storage for quaternions.  Apart from the ring
+  // operations defined here, there is no separate arithmetic for this
+  // type: values are widened to `quaternion` (exactly), passed to the
+  // functions below, and the results rounded.
+  typedef struct {
+    float w;
+    float x;
+    float y;
+    float z;
+  } quaternionf;
+  static NPY_INLINE quaternion quaternion_create_from_quaternionf(quaternionf q) {
+    quaternion r = {q.w, q.x, q.y, q.z};
+    return r;
+  }
+  static NPY_INLINE quaternionf quaternionf_create_from_quaternion(quaternion q) {
+    quaternionf r = {(float)q.w, (float)q.x, (float)q.y, (float)q.z};
+    return r;
+  }
+  static NPY_INLINE quaternionf quaternionf_add(quaternionf q1, quaternionf q2) {
+    quaternionf r = {q1.w+q2.w, q1.x+q2.x, q1.y+q2.y, q1.z+q2.z};
+    return r;
+  }
+  static NPY_INLINE quaternionf quaternionf_scalar_add(float s, quaternionf q) {
+    quaternionf r = {s+q.w, q.x, q.y, q.z};
+    return r;
+  }
+  static NPY_INLINE quaternionf quaternionf_add_scalar(quaternionf q, float s) {
+    quaternionf r = {s+q.w, q.x, q.y, q.z};
+    return r;
+  }
+  static NPY_INLINE quaternionf quaternionf_subtract(quaternionf q1, quaternionf q2) {
+    quaternionf r = {q1.w-q2.w, q1.x-q2.x, q1.y-q2.y, q1.z-q2.z};
+    return r;
+  }
+  static NPY_INLINE quaternionf quaternionf_scalar_subtract(float s, quaternionf q) {
+    quaternionf r = {s-q.w, -q.x, -q.y, -q.z};
+    return r;
+  }
+  static NPY_INLINE quaternionf quaternionf_subtract_scalar(quaternionf q, float s) {
+    quaternionf r = {q.w-s, q.x, q.y, q.z};
+    return r;
+  }
+  static NPY_INLINE quaternionf quaternionf_multiply(quaternionf q1, quaternionf q2) {
+    quaternionf r = {
+      q1.w*q2.w - q1.x*q2.x - q1.y*q2.y - q1.z*q2.z,
+      q1.w*q2.x + q1.x*q2.w + q1.y*q2.z - q1.z*q2.y,
+      q1.w*q2.y - q1.x*q2.z + q1.y*q2.w + q1.z*q2.x,
+      q1.w*q2.z + q1.x*q2.y - q1.y*q2.x + q1.z*q2.w,
+    };
+    return r;
+  }
+  static NPY_INLINE quaternionf quaternionf_scalar_multiply(float s, quaternionf q) {
+    quaternionf r = {s*q.w, s*q.x, s*q.y, s*q.z};
+    return r;
+  }
+  static NPY_INLINE quaternionf quaternionf_multiply_scalar(quaternionf q, float s) {
+    quaternionf r = {s*q.w, s*q.x, s*q.y, s*q.z};
+    return r;
+  }
+
   // Constructor-ish
   quaternion quaternion_create_from_spherical_coords(double vartheta, double varphi);
   quaternion quaternion_create_from_euler_angles(double alpha, double beta, double gamma);
+  quaternion quaternion_create_from_rotation_matrix(const double m[]);
+  quaternion quaternion_create_from_nonorthogonal_rotation_matrix(const double m[]);
 
   // Unary bool returners
   static NPY_INLINE int quaternion_isnan(quaternion q) {
@@ -246,11 +308,27 @@ extern "C" {
   static NPY_INLINE void quaternion_rotate_vector_and_normalize(quaternion q, double v[], double vprime[]) {
     // This applies the algorithm described above, but also includes normalization of the quaternion.
     double w[3];
-    double m = q.x*q.x+q.y*q.y+q.z*q.z;
+    double m = q.w*q.w+q.x*q.x+q.y*q.y+q.z*q.z;
     _sv_plus_rxv(q, v, w);
     _v_plus_2rxvprime_over_m(q, v, w, 2/m, vprime);
     return;
   }
+  static NPY_INLINE void quaternion_as_rotation_matrix(quaternion q, double m[]) {
+    // The row-major matrix that rotates column vectors as `q` does.  The
+    // quaternion need not be normalized, but a zero quaternion divides
+    // by zero, raising the floating-point flag that numpy checks.
+    const double s = 2 / (q.w*q.w + q.x*q.x + q.y*q.y + q.z*q.z);
+    m[0] = 1 - s*(q.y*q.y + q.z*q.z);
+    m[1] = s*(q.x*q.y - q.z*q.w);
+    m[2] = s*(q.x*q.z + q.y*q.w);
+    m[3] = s*(q.x*q.y + q.z*q.w);
+    m[4] = 1 - s*(q.x*q.x + q.z*q.z);
+    m[5] = s*(q.y*q.z - q.x*q.w);
+    m[6] = s*(q.x*q.z - q.y*q.w);
+    m[7] = s*(q.y*q.z + q.x*q.w);
+    m[8] = 1 - s*(q.x*q.x + q.y*q.y);
+    return;
+  }
 
   // Quaternion-quaternion/quaternion-scalar binary quaternion returners
   static NPY_INLINE quaternion quaternion_add(quaternion q1, quaternion q2) {
@@ -322,6 +400,80 @@ extern "C" {
     };
     return r;
   }
+  static NPY_INLINE quaternion quaternion_create_from_euler_angles_sequence(int i, int j, int k,
+                                                                            double alpha, double beta, double gamma) {
+    // The rotor `exp(alpha*e_i/2) * exp(beta*e_j/2) * exp(gamma*e_k/2)`,
+    // where the axes are numbered 1, 2, 3 for x, y, z, matching the
+    // indices of the components.
+    quaternion a = {cos(alpha/2), 0, 0, 0}, b = {cos(beta/2), 0, 0, 0}, c = {cos(gamma/2), 0, 0, 0};
+    (&a.w)[i] = sin(alpha/2);
+    (&b.w)[j] = sin(beta/2);
+    (&c.w)[k] = sin(gamma/2);
+    return quaternion_multiply(quaternion_multiply(a, b), c);
+  }
+  static NPY_INLINE void quaternion_as_euler_angles_sequence(quaternion q, int i, int j, int k, double angles[]) {
+    // The inverse of the above, by the method of Bernardes and Viollet
+    // [PLoS ONE 17(11): e0276302], which handles all twelve sequences
+    // with the same few operations.  That method finds the angles of
+    // the factors in the opposite order, so the axes are reversed.
+    const double* const p = &q.w;
+    const int proper = (i == k);
+    const int third = proper ? 6 - i - j : i;
+    const int sign = (k - j) * (j - third) * (third - k) / 2;
+    double a, b, c, d, half_sum, half_difference;
+    if(proper) {
+      a = p[0];
+      b = p[k];
+      c = p[j];
+      d = p[third] * sign;
+    } else {
+      a = p[0] - p[j];
+      b = p[k] + p[third] * sign;
+      c = p[j] + p[0];
+      d = p[third] * sign - p[k];
+    }
+    angles[1] = 2 * atan2(sqrt(c*c + d*d), sqrt(a*a + b*b));
+    half_sum = atan2(b, a);
+    half_difference = atan2(d, c);
+    angles[0] = half_sum + half_difference;
+    angles[2] = half_sum - half_difference;
+    if(!proper) {
+      angles[0] *= sign;
+      angles[1] -= M_PI / 2;
+    }
+    return;
+  }
+  static NPY_INLINE quaternion quaternion_create_from_rotation_vector(const double v[]) {
+    // The rotor `exp(v/2)`, using a series for sin(theta)/theta at small
+    // angles
+    const double theta = sqrt(v[0]*v[0] + v[1]*v[1] + v[2]*v[2]) / 2;
+    const double theta2 = theta * theta;
+    const double s = (theta < 1.0e-3) ? (1 - theta2 / 6 * (1 - theta2 / 20)) / 2 : sin(theta) / (2 * theta);
+    quaternion r = {cos(theta), s*v[0], s*v[1], s*v[2]};
+    return r;
+  }
+  static NPY_INLINE void quaternion_as_rotation_vector(quaternion q, double v[]) {
+    // The vector part of `2*log(q/|q|)`, using a series for atan(t)/t at
+    // small angles.  Rotations by nearly 2*pi, which have no unique
+    // logarithm, give the same arbitrary choice as `quaternion_log`.
+    const double b = sqrt(q.x*q.x + q.y*q.y + q.z*q.z);
+    double f;
+    if(q.w > 0 && b < 1.0e-3 * q.w) {
+      const double t2 = (b / q.w) * (b / q.w);
+      f = 2 * (1 - t2 * (1.0 / 3.0 - t2 / 5)) / q.w;
+    } else if(q.w < 0 && b <= -_QUATERNION_EPS * q.w) {
+      v[0] = 2 * M_PI;
+      v[1] = 0.0;
+      v[2] = 0.0;
+      return;
+    } else {
+      f = 2 * atan2(b, q.w) / b;  // NaN for zero or NaN quaternions
+    }
+    v[0] = f * q.x;
+    v[1] = f * q.y;
+    v[2] = f * q.z;
+    return;
+  }
   static NPY_INLINE void quaternion_inplace_multiply(quaternion* q1a, quaternion q2) {
     quaternion q1 = {q1a->w, q1a->x, q1a->y, q1a->z};
     q1a->w = q1.w*q2.w - q1.x*q2.x - q1.y*q2.y - q1.z*q2.z;
@@ -470,11 +622,51 @@ extern "C" {
       return quaternion_multiply( quaternion_power_scalar(quaternion_divide(quaternion_negative(q2),q1), tau), q1);
     }
   }
+  static NPY_INLINE quaternion slerp_unit(quaternion q1, quaternion q2, double tau) {
+    /* Equivalent to `slerp` when q1 and q2 have unit norm, using the
+       sin-weighted form instead of a division, log, and exp.  The angle
+       theta between q1 and (+/-)q2 is found from the chordal distances,
+       which is accurate even for nearby rotors. */
+    double d = quaternion_rotor_chordal_distance(q1,q2);
+    double s = quaternion_absolute(quaternion_add(q1,q2));
+    double sign = 1.0;
+    double theta, w1, w2;
+    if(!(d<=1.414213562373096)) {
+      double tmp = d; d = s; s = tmp;
+      sign = -1.0;
+    }
+    theta = 2*atan2(d, s);
+    if(theta == 0.0) {
+      w1 = 1.0 - tau;
+      w2 = sign * tau;
+    } else {
+      double sin_theta = sin(theta);
+      w1 = sin((1.0-tau)*theta) / sin_theta;
+      w2 = sign * sin(tau*theta) / sin_theta;
+    }
+    {
+      quaternion r = {w1*q1.w + w2*q2.w, w1*q1.x + w2*q2.x, w1*q1.y + w2*q2.y, w1*q1.z + w2*q2.z};
+      return r;
+    }
+  }
   static NPY_INLINE quaternion squad_evaluate(double tau_i, quaternion q_i, quaternion a_i, quaternion b_ip1, quaternion q_ip1) {
     return slerp(slerp(q_i, q_ip1, tau_i),
                  slerp(a_i, b_ip1, tau_i),
                  2*tau_i*(1-tau_i));
   }
+  // Twice the derivative of `squad_evaluate` with respect to tau_i, times
+  // the inverse of the result; for unit rotors, this is a pure quaternion
+  // whose vector part divided by the time step is the angular velocity
+  quaternion squad_angular_velocity(double tau_i, quaternion q_i, quaternion a_i, quaternion b_ip1, quaternion q_ip1);
+  // The inverse of the derivative of the exponential map at the pure
+  // quaternion L, applied to the pure quaternion w; the scalar parts
+  // are ignored
+  quaternion quaternion_dexp_inverse(quaternion L, quaternion w);
+  // One step of length h of the fourth-order Runge-Kutta-Munthe-Kaas
+  // method for dR/dt = Omega R / 2, where the angular velocity Omega
+  // (a pure quaternion) depends only on time, and is given at the
+  // beginning, middle, and end of the step.  The result is normalized.
+  quaternion quaternion_rkmk4_step(quaternion R, double h, quaternion Omega_0, quaternion Omega_half, quaternion Omega_1);
 
 
 #ifdef __cplusplus
@@ -0,0 +1,401 @@
+# Copyright (c) 2017, Michael Boyle
+# See LICENSE file for details: <https://github.com/moble/quaternion/blob/master/LICENSE>
+
+from __future__ import division, print_function, absolute_import
+
+import numpy as np
+
+from .numpy_quaternion import quaternion, _soa_multiply, _soa_divide
+
+
+# The vector components of real numbers
+_zero = 0.0
+
+
+def _as_components(a):
+    """Return the components of `a` as a tuple (w, x, y, z)
+
+    Quaternions (scalars, arrays, and `QuaternionArray`s) give their four
+    components; real numbers give `_zero` for the vector components, and
+    anything else gives None.  Each element of the tuple may be an array or
+    a scalar, and they need not have the same shape, but they broadcast
+    together.  Nothing is copied.
+
+    """
+    if isinstance(a, QuaternionArray):
+        return tuple(a.components)
+    if isinstance(a, quaternion):
+        return (a.w, a.x, a.y, a.z)
+    a = np.asarray(a)
+    if a.dtype == np.dtype(quaternion):
+        f = a.view((np.double, 4))
+        return (f[..., 0], f[..., 1], f[..., 2], f[..., 3])
+    if a.dtype.kind in 'biuf':
+        return (a, _zero, _zero, _zero)
+    return None
+
+
+def _is_real(a):
+    return a[1] is _zero and a[2] is _zero and a[3] is _zero
+
+
+def _shape(a, b=None):
+    """Return the shape of the result of an operation on components"""
+    # All the components of a quaternion have the same shape, except that
+    # the vector components of real numbers are scalars
+    shape = np.shape(a[0])
+    if b is None or np.shape(b[0]) == shape:
+        return shape
+    return np.broadcast(a[0], b[0]).shape
+
+
+def _new(shape, out=None):
+    if out is None:
+        r = QuaternionArray.__new__(QuaternionArray)
+        r.components = np.empty((4,) + shape)
+        return r
+    if not isinstance(out, QuaternionArray):
+        raise TypeError("Output of a quaternion operation must be a QuaternionArray; got {0}".format(type(out)))
+    return out
+
+
+def _add(a, b, out=None):
+    r = _new(_shape(a, b), out)
+    for i in range(4):
+        np.add(a[i], b[i], out=r.components[i])
+    return r
+
+
+def _subtract(a, b, out=None):
+    r = _new(_shape(a, b), out)
+    for i in range(4):
+        np.subtract(a[i], b[i], out=r.components[i])
+    return r
+
+
+def _multiply(a, b, out=None):
+    r = _new(_shape(a, b), out)
+    if _is_real(a) or _is_real(b):
+        s, q = (a[0], b) if _is_real(a) else (b[0], a)
+        for i in range(4):
+            np.multiply(q[i], s, out=r.components[i])
+        return r
+    _soa_multiply(*(a + b), out=tuple(r.components))
+    return r
+
+
+def _divide(a, b, out=None):
+    r = _new(_shape(a, b), out)
+    if _is_real(b):
+        for i in range(4):
+            np.divide(a[i], b[0], out=r.components[i])
+    else:
+        _soa_divide(*(a + b), out=tuple(r.components))
+    return r
+
+
+def _conjugate(a, out=None):
+    r = _new(_shape(a), out)
+    np.copyto(r.components[0], a[0])
+    for i in range(1, 4):
+        np.negative(a[i], out=r.components[i])
+    return r
+
+
+def _negative(a, out=None):
+    r = _new(_shape(a), out)
+    for i in range(4):
+        np.negative(a[i], out=r.components[i])
+    return r
+
+
+def _positive(a, out=None):
+    r = _new(_shape(a), out)
+    for i in range(4):
+        np.copyto(r.components[i], a[i])
+    return r
+
+
+def _norm(a, out=None):
+    aw, ax, ay, az = a
+    return np.add(aw*aw + ax*ax, ay*ay + az*az, out=out)
+
+
+def _absolute(a, out=None):
+    return np.sqrt(_norm(a), out=out)
+
+
+def _normalized(a, out=None):
+    n = _absolute(a)
+    r = _new(_shape(a), out)
+    for i in range(4):
+        np.divide(a[i], n, out=r.components[i])
+    return r
+
+
+def _reciprocal(a, out=None):
+    return _divide((1.0, _zero, _zero, _zero), a, out)
+
+
+def _square(a, out=None):
+    return _multiply(a, a, out)
+
+
+def _equal(a, b, out=None):
+    r = np.logical_and(np.equal(a[0], b[0]), np.equal(a[1], b[1]), out=out)
+    for i in range(2, 4):
+        np.logical_and(r, np.equal(a[i], b[i]), out=r)
+    return r
+
+
+def _not_equal(a, b, out=None):
+    return np.logical_not(_equal(a, b), out=out)
+
+
+def _any_of(test):
+    def f(a, out=None):
+        r = np.logical_or(test(a[0]), test(a[1]), out=out)
+        for i in range(2, 4):
+            np.logical_or(r, test(a[i]), out=r)
+        return r
+    return f
+
+
+def _isfinite(a, out=None):
+    r = np.logical_and(np.isfinite(a[0]), np.isfinite(a[1]), out=out)
+    for i in range(2, 4):
+        np.logical_and(r, np.isfinite(a[i]), out=r)
+    return r
+
+
+# The ufuncs that act directly on the components.  Each is elementwise
+# arithmetic on whole rows, which numpy's own loops run at full SIMD
+# width; any other ufunc is applied to an array of `quaternion`.
+_component_ufuncs = {
+    np.add: _add,
+    np.subtract: _subtract,
+    np.multiply: _multiply,
+    np.divide: _divide,
+    np.true_divide: _divide,
+    np.conjugate: _conjugate,
+    np.negative: _negative,
+    np.positive: _positive,
+    np.norm: _norm,
+    np.absolute: _absolute,
+    np.normalized: _normalized,
+    np.reciprocal: _reciprocal,
+    np.square: _square,
+    np.equal: _equal,
+    np.not_equal: _not_equal,
+    np.isnan: _any_of(np.isnan),
+    np.isinf: _any_of(np.isinf),
+    np.isfinite: _isfinite,
+}
+
+
+class QuaternionArray(np.lib.mixins.NDArrayOperatorsMixin):
+    """Array of quaternions stored as separate arrays of components
+
+    An array of the `quaternion` dtype stores each quaternion's four
+    components next to each other in memory.  This class instead stores
+    all the `w` components in one contiguous array, followed by all the
+    `x` components, and so on.  The `w`, `x`, `y`, `z`, and `vec`
+    attributes are views of those arrays, so code that only needs some
+    of the components reads only those, and elementwise arithmetic runs
+    on whole contiguous arrays of floats.
+
+    The object supports the same operators as arrays of quaternions,
+    and numpy's ufuncs.  Addition, subtraction, multiplication,
+    division, negation, conjugation, `norm`, `absolute`, `normalized`,
+    `reciprocal`, `square`, equality, and the `isnan`-style tests act
+    directly on the components; any other ufunc is evaluated on an
+    array of quaternions, and its quaternion output converted back.
+
+    Parameters
+    ----------
+    a: array_like or QuaternionArray
+        If this is a float array, its first axis (which must have size
+        4) indexes the components.  Anything else is converted to an
+        array of quaternions, whose components are copied.
+    copy: bool, optional
+        If False (the default), a float array of components is used
+        without copying, when possible.
+
+    """
+
+    def __init__(self, a, copy=False):
+        if isinstance(a, QuaternionArray):
+            a = a.components
+        a = np.asarray(a)
+        if a.dtype == np.dtype(quaternion):
+            a = np.ascontiguousarray(np.moveaxis(a.view((np.double, 4)), -1, 0))
+        elif a.dtype.kind in 'biuf':
+            a = np.array(a, dtype=np.double, copy=copy)
+        else:
+            a = np.array(a, dtype=np.quaternion)
+            a = np.ascontiguousarray(np.moveaxis(a.view((np.double, 4)), -1, 0))
+        if a.ndim < 1 or a.shape[0] != 4:
+            raise ValueError("The first axis of the components must have size 4; got shape {0}".format(a.shape))
+        self.components = a
+
+    @classmethod
+    def from_quat_array(cls, q):
+        """Copy an array of quaternions into a new QuaternionArray"""
+        return cls(np.asarray(q, dtype=np.quaternion))
+
+    def as_quat_array(self):
+        """Copy the components into a new array of quaternions"""
+        return np.ascontiguousarray(np.moveaxis(self.components, 0, -1)).view(np.quaternion)[..., 0]
+
+    def __array__(self, dtype=None):
+        q = self.as_quat_array()
+        return q if dtype is None else q.astype(dtype)
+
+    @property
+    def w(self):
+        return self.components[0]
+
+    @w.setter
+    def w(self, value):
+        self.components[0] = value
+
+    @property
+    def x(self):
+        return self.components[1]
+
+    @x.setter
+    def x(self, value):
+        self.components[1] = value
+
+    @property
+    def y(self):
+        return self.components[2]
+
+    @y.setter
+    def y(self, value):
+        self.components[2] = value
+
+    @property
+    def z(self):
+        return self.components[3]
+
+    @z.setter
+    def z(self, value):
+        self.components[3] = value
+
+    @property
+    def vec(self):
+        """View of the vector components, with the vector index first"""
+        return self.components[1:]
+
+    @vec.setter
+    def vec(self, value):
+        self.components[1:] = value
+
+    real = w
+    imag = vec
+
+    @property
+    def shape(self):
+        return self.components.shape[1:]
+
+    @property
+    def ndim(self):
+        return self.components.ndim - 1
+
+    @property
+    def size(self):
+        return self.w.size
+
+    @property
+    def dtype(self):
+        return np.dtype(quaternion)
+
+    def __len__(self):
+        return len(self.w)
+
+    def __getitem__(self, index):
+        if not isinstance(index, tuple):
+            index = (index,)
+        c = self.components[(slice(None),) + index]
+        if c.ndim == 1:
+            return quaternion(*c)
+        return QuaternionArray(c)
+
+    def __setitem__(self, index, value):
+        if not isinstance(index, tuple):
+            index = (index,)
+        components = _as_components(value)
+        if components is None:
+            raise TypeError("Cannot assign {0} to a QuaternionArray".format(type(value)))
+        for i in range(4):
+            self.components[(i,) + index] = components[i]
+
+    def __iter__(self):
+        for i in range(len(self)):
+            yield self[i]
+
+    def __repr__(self):
+        return "QuaternionArray({0!r})".format(self.as_quat_array())
+
+    def __str__(self):
+        return str(self.as_quat_array())
+
+    def copy(self):
+        return QuaternionArray(self.components, copy=True)
+
+    def reshape(self, *shape):
+        if len(shape) == 1 and isinstance(shape[0], (tuple, list)):
+            shape = tuple(shape[0])
+        return QuaternionArray(self.components.reshape((4,) + shape))
+
+    def conjugate(self):
+        return _conjugate(tuple(self.components))
+
+    conj = conjugate
+
+    def norm(self):
+        return _norm(tuple(self.components))
+
+    def absolute(self):
+        return _absolute(tuple(self.components))
+
+    abs = absolute
+
+    def normalized(self):
+        return _normalized(tuple(self.components))
+
+    def inverse(self):
+        return _reciprocal(tuple(self.components))
+
+    def exp(self):
+        return np.exp(self)
+
+    def log(self):
+        return np.log(self)
+
+    def __array_ufunc__(self, ufunc, method, *inputs, **kwargs):
+        out = kwargs.pop('out', None)
+        if out is not None:
+            if len(out) != 1:
+                return NotImplemented
+            out = out[0]
+        if method == '__call__' and ufunc in _component_ufuncs and not kwargs:
+            components = [_as_components(a) for a in inputs]
+            if all(c is not None for c in components):
+                result = _component_ufuncs[ufunc](*components, out=out)
+                if isinstance(out, QuaternionArray) or out is None:
+                    return result
+                return out
+        # Anything else is evaluated on arrays of quaternions
+        inputs = [a.as_quat_array() if isinstance(a, QuaternionArray) else a for a in inputs]
+        result = getattr(ufunc, method)(*inputs, **kwargs)
+        if isinstance(result, np.ndarray) and result.dtype == np.dtype(quaternion) and result.ndim > 0:
+            result = QuaternionArray(result)
+        if out is None:
+            return result
+        if isinstance(out, QuaternionArray):
+            out[...] = result
+        else:
+            out[...] = np.asarray(result)
+        return out
@@ -0,0 +1,472 @@
+// Copyright (c) 2017, Michael Boyle
+// See LICENSE file for details: <https://github.com/moble/quaternion/blob/master/LICENSE>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+
+#include "quaternion_simd.h"
+#include "quaternion_simd_math.h"
+
+// The vector kernels are compiled for x86 with compilers that let
+// individual functions target instruction sets beyond the baseline
+// used for the rest of the file, and that expose the intrinsics
+// regardless of the command-line flags.
+#if (defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)) \
+  && ((defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))) \
+      || defined(__clang__) || (defined(_MSC_VER) && _MSC_VER >= 1910))
+  #define _QUATERNION_SIMD_X86
+  #include <immintrin.h>
+  #if defined(_MSC_VER) && !defined(__clang__)
+    #include <intrin.h>
+  #endif
+#endif
+
+
+// The arithmetic below is written once in terms of generic `mul`,
+// `add`, `sub`, `div`, and `sqrt` operations, so that it can be
+// instantiated for any vector width.  The order of operations
+// precisely follows the scalar functions in `quaternion.h`.
+#define _QUATERNION_SIMD_NORM(mul, add, w, x, y, z)                     \
+  add(add(add(mul(w, w), mul(x, x)), mul(y, y)), mul(z, z))
+#define _QUATERNION_SIMD_MULTIPLY(mul, add, sub, aw, ax, ay, az, bw, bx, by, bz, rw, rx, ry, rz) \
+  rw = sub(sub(sub(mul(aw, bw), mul(ax, bx)), mul(ay, by)), mul(az, bz)); \
+  rx = sub(add(add(mul(aw, bx), mul(ax, bw)), mul(ay, bz)), mul(az, by)); \
+  ry = add(add(sub(mul(aw, by), mul(ax, bz)), mul(ay, bw)), mul(az, bx)); \
+  rz = add(sub(add(mul(aw, bz), mul(ax, by)), mul(ay, bx)), mul(az, bw));
+#define _QUATERNION_SIMD_DIVIDE(mul, add, sub, div, aw, ax, ay, az, bw, bx, by, bz, rw, rx, ry, rz) \
+  {                                                                     \
+    const VEC bnorm = _QUATERNION_SIMD_NORM(mul, add, bw, bx, by, bz);  \
+    rw = div(add(add(add(mul(aw, bw), mul(ax, bx)), mul(ay, by)), mul(az, bz)), bnorm); \
+    rx = div(add(sub(sub(mul(ax, bw), mul(aw, bx)), mul(ay, bz)), mul(az, by)), bnorm); \
+    ry = div(sub(add(sub(mul(ax, bz), mul(aw, by)), mul(ay, bw)), mul(az, bx)), bnorm); \
+    rz = div(add(sub(mul(ay, bx), add(mul(aw, bz), mul(ax, by))), mul(az, bw)), bnorm); \
+  }
+
+
+// The batched transcendental kernels work on blocks of this many
+// quaternions, stored by component
+#define _QUATERNION_SIMD_BLOCK 16
+typedef struct {
+  double w[_QUATERNION_SIMD_BLOCK];
+  double x[_QUATERNION_SIMD_BLOCK];
+  double y[_QUATERNION_SIMD_BLOCK];
+  double z[_QUATERNION_SIMD_BLOCK];
+} _quaternion_simd_block;
+
+
+// Instantiate the kernels once for each instruction set
+#define _QUATERNION_SIMD_SUFFIX baseline
+#define _QUATERNION_SIMD_TARGET
+#include "quaternion_simd_kernels.h"
+#undef _QUATERNION_SIMD_TARGET
+#undef _QUATERNION_SIMD_SUFFIX
+
+#if defined(_QUATERNION_SIMD_X86)
+
+  #if defined(_MSC_VER) && !defined(__clang__)
+    #define _QUATERNION_SIMD_TARGET_AVX2
+    #define _QUATERNION_SIMD_TARGET_AVX512
+  #else
+    #define _QUATERNION_SIMD_TARGET_AVX2 __attribute__((target("avx2,fma")))
+    #define _QUATERNION_SIMD_TARGET_AVX512 __attribute__((target("avx512f,avx2,fma")))
+  #endif
+
+  #define _QUATERNION_SIMD_SUFFIX avx2
+  #define _QUATERNION_SIMD_TARGET _QUATERNION_SIMD_TARGET_AVX2
+  #define _QUATERNION_SIMD_USE_AVX2
+  #include "quaternion_simd_kernels.h"
+  #undef _QUATERNION_SIMD_USE_AVX2
+  #undef _QUATERNION_SIMD_TARGET
+  #undef _QUATERNION_SIMD_SUFFIX
+
+  #define _QUATERNION_SIMD_SUFFIX avx512
+  #define _QUATERNION_SIMD_TARGET _QUATERNION_SIMD_TARGET_AVX512
+  #define _QUATERNION_SIMD_USE_AVX512
+  #include "quaternion_simd_kernels.h"
+  #undef _QUATERNION_SIMD_USE_AVX512
+  #undef _QUATERNION_SIMD_TARGET
+  #undef _QUATERNION_SIMD_SUFFIX
+
+#endif
+
+
+// Query the CPU (and the operating system's support for saving the
+// extended registers) for the features the kernels need
+quaternion_cpu_features
+quaternion_simd_cpu_features(void)
+{
+  quaternion_cpu_features features = {0, 0, 0, 0, 0};
+#if defined(_QUATERNION_SIMD_X86)
+  #if defined(_MSC_VER) && !defined(__clang__)
+  int info[4];
+  int max_id;
+  int os_ymm = 0, os_zmm = 0;
+  __cpuid(info, 0);
+  max_id = info[0];
+  if(max_id >= 1) {
+    __cpuid(info, 1);
+    features.sse2 = (info[3] >> 26) & 1;
+    if((info[2] >> 27) & 1) {  // OSXSAVE
+      const unsigned __int64 xcr0 = _xgetbv(0);
+      os_ymm = (xcr0 & 0x06) == 0x06;
+      os_zmm = (xcr0 & 0xe6) == 0xe6;
+    }
+    features.avx = os_ymm && ((info[2] >> 28) & 1);
+    features.fma = os_ymm && ((info[2] >> 12) & 1);
+  }
+  if(max_id >= 7) {
+    __cpuidex(info, 7, 0);
+    features.avx2 = os_ymm && ((info[1] >> 5) & 1);
+    features.avx512f = os_zmm && ((info[1] >> 16) & 1);
+  }
+  #else
+  __builtin_cpu_init();
+  features.sse2 = __builtin_cpu_supports("sse2") != 0;
+  features.avx = __builtin_cpu_supports("avx") != 0;
+  features.avx2 = __builtin_cpu_supports("avx2") != 0;
+  features.fma = __builtin_cpu_supports("fma") != 0;
+  features.avx512f = __builtin_cpu_supports("avx512f") != 0;
+  #endif
+#endif
+  return features;
+}
+
+
+// The table of kernels currently in use
+typedef struct {
+  void (*norm)(const quaternion*, double*, ptrdiff_t);
+  void (*absolute)(const quaternion*, double*, ptrdiff_t);
+  void (*conjugate)(const quaternion*, quaternion*, ptrdiff_t);
+  void (*normalized)(const quaternion*, quaternion*, ptrdiff_t);
+  void (*add)(const quaternion*, const quaternion*, quaternion*, ptrdiff_t);
+  void (*multiply)(const quaternion*, const quaternion*, quaternion*, ptrdiff_t);
+  void (*divide)(const quaternion*, const quaternion*, quaternion*, ptrdiff_t);
+  void (*multiply_components)(const double* const*, const double* const*, double* const*, ptrdiff_t);
+  void (*divide_components)(const double* const*, const double* const*, double* const*, ptrdiff_t);
+  void (*copyswap)(char*, ptrdiff_t, const char*, ptrdiff_t, ptrdiff_t, int, int);
+  void (*exp)(const char*, ptrdiff_t, char*, ptrdiff_t, ptrdiff_t, const int);
+  void (*log)(const char*, ptrdiff_t, char*, ptrdiff_t, ptrdiff_t, const int);
+  void (*power)(const char*, ptrdiff_t, const char*, ptrdiff_t, char*, ptrdiff_t, ptrdiff_t, const int);
+  void (*power_scalar)(const char*, ptrdiff_t, const char*, ptrdiff_t, char*, ptrdiff_t, ptrdiff_t, const int);
+  void (*slerp)(const char*, ptrdiff_t, const char*, ptrdiff_t, const char*, ptrdiff_t, char*, ptrdiff_t,
+                ptrdiff_t, const int);
+  void (*squad)(const char*, ptrdiff_t, const char*, ptrdiff_t, const char*, ptrdiff_t, const char*, ptrdiff_t,
+                const char*, ptrdiff_t, char*, ptrdiff_t, ptrdiff_t, const int);
+  void (*slerp_unit)(const char*, ptrdiff_t, const char*, ptrdiff_t, const char*, ptrdiff_t, char*, ptrdiff_t,
+                     ptrdiff_t, const int);
+  void (*slerp_unit_segment)(const char*, const char*, const char*, ptrdiff_t, char*, ptrdiff_t, ptrdiff_t, const int);
+  void (*from_euler_angles)(const char*, const char*, const char*, ptrdiff_t, char*, ptrdiff_t, ptrdiff_t, ptrdiff_t,
+                            int, int, int, const int);
+  void (*as_euler_angles)(const char*, ptrdiff_t, ptrdiff_t, char*, char*, char*, ptrdiff_t, ptrdiff_t,
+                          int, int, int, const int);
+  void (*from_rotation_vector)(const char*, ptrdiff_t, ptrdiff_t, char*, ptrdiff_t, ptrdiff_t, ptrdiff_t, const int);
+  void (*as_rotation_vector)(const char*, ptrdiff_t, ptrdiff_t, char*, ptrdiff_t, ptrdiff_t, ptrdiff_t, const int);
+  void (*encode_rotors)(const char*, ptrdiff_t, ptrdiff_t, char*, ptrdiff_t, ptrdiff_t, ptrdiff_t, int);
+  void (*decode_rotors)(const char*, ptrdiff_t, ptrdiff_t, char*, ptrdiff_t, ptrdiff_t, ptrdiff_t, int);
+  void (*gyro_propagate)(const char*, ptrdiff_t, ptrdiff_t, ptrdiff_t, const double*, double, int, quaternion*,
+                         char*, ptrdiff_t);
+} _quaternion_simd_table;
+
+#define _QUATERNION_SIMD_TABLE(suffix) {                \
+    quaternion_norm_contiguous_##suffix,                \
+    quaternion_absolute_contiguous_##suffix,            \
+    quaternion_conjugate_contiguous_##suffix,           \
+    quaternion_normalized_contiguous_##suffix,          \
+    quaternion_add_contiguous_##suffix,                 \
+    quaternion_multiply_contiguous_##suffix,            \
+    quaternion_divide_contiguous_##suffix,              \
+    quaternion_multiply_components_##suffix,            \
+    quaternion_divide_components_##suffix,              \
+    quaternion_copyswap_batch_##suffix,                 \
+    quaternion_exp_batch_##suffix,                      \
+    quaternion_log_batch_##suffix,                      \
+    quaternion_power_batch_##suffix,                    \
+    quaternion_power_scalar_batch_##suffix,             \
+    quaternion_slerp_batch_##suffix,                    \
+    quaternion_squad_batch_##suffix,                    \
+    quaternion_slerp_unit_batch_##suffix,               \
+    quaternion_slerp_unit_segment_batch_##suffix,       \
+    quaternion_from_euler_angles_batch_##suffix,        \
+    quaternion_as_euler_angles_batch_##suffix,          \
+    quaternion_from_rotation_vector_batch_##suffix,     \
+    quaternion_as_rotation_vector_batch_##suffix,       \
+    quaternion_encode_rotors_batch_##suffix,            \
+    quaternion_decode_rotors_batch_##suffix,            \
+    quaternion_gyro_propagate_block_##suffix            \
+  }
+
+static const _quaternion_simd_table _quaternion_simd_tables[] = {
+  _QUATERNION_SIMD_TABLE(baseline),
+#if defined(_QUATERNION_SIMD_X86)
+  _QUATERNION_SIMD_TABLE(avx2),
+  _QUATERNION_SIMD_TABLE(avx512),
+#endif
+};
+
+static const char* _quaternion_simd_level_names[] = {"baseline", "avx2", "avx512"};
+
+static int _quaternion_simd_level = QUATERNION_SIMD_BASELINE;
+static int _quaternion_simd_fast = 0;
+// The kernels are reached through a single pointer to one of the
+// constant tables above, so that changing the level is one pointer
+// store: a loop running on another thread (with the GIL released)
+// reads either the old table or the new one, never a mixture of both.
+static const _quaternion_simd_table* volatile _quaternion_simd_dispatch =
+  &_quaternion_simd_tables[QUATERNION_SIMD_BASELINE];
+
+
+const char*
+quaternion_simd_level_name(int level)
+{
+  if(level < QUATERNION_SIMD_BASELINE || level > QUATERNION_SIMD_AVX512) {
+    return NULL;
+  }
+  return _quaternion_simd_level_names[level];
+}
+
+int
+quaternion_simd_supported_level(void)
+{
+#if defined(_QUATERNION_SIMD_X86)
+  const quaternion_cpu_features features = quaternion_simd_cpu_features();
+  if(features.avx512f && features.avx2 && features.fma) {
+    return QUATERNION_SIMD_AVX512;
+  }
+  if(features.avx2 && features.fma) {
+    return QUATERNION_SIMD_AVX2;
+  }
+#endif
+  return QUATERNION_SIMD_BASELINE;
+}
+
+int
+quaternion_simd_get_level(void)
+{
+  return _quaternion_simd_level;
+}
+
+int
+quaternion_simd_set_level(int level)
+{
+  if(level < QUATERNION_SIMD_BASELINE || level > quaternion_simd_supported_level()) {
+    return -1;
+  }
+  _quaternion_simd_dispatch = &_quaternion_simd_tables[level];
+  _quaternion_simd_level = level;
+  return 0;
+}
+
+int
+quaternion_simd_get_fast(void)
+{
+  return _quaternion_simd_fast;
+}
+
+void
+quaternion_simd_set_fast(int fast)
+{
+  _quaternion_simd_fast = (fast != 0);
+}
+
+void
+quaternion_simd_init(void)
+{
+  // The environment variable QUATERNION_SIMD may lower (but not raise)
+  // the level chosen automatically
+  int level = quaternion_simd_supported_level();
+  const char* requested = getenv("QUATERNION_SIMD");
+  if(requested != NULL) {
+    int i;
+    for(i=QUATERNION_SIMD_BASELINE; i<level; ++i) {
+      if(strcmp(requested, _quaternion_simd_level_names[i]) == 0) {
+        level = i;
+        break;
+      }
+    }
+  }
+  quaternion_simd_set_level(level);
+}
+
+
+void
+quaternion_norm_contiguous(const quaternion* q, double* r, ptrdiff_t n)
+{
+  _quaternion_simd_dispatch->norm(q, r, n);
+}
+
+void
+quaternion_absolute_contiguous(const quaternion* q, double* r, ptrdiff_t n)
+{
+  _quaternion_simd_dispatch->absolute(q, r, n);
+}
+
+void
+quaternion_conjugate_contiguous(const quaternion* q, quaternion* r, ptrdiff_t n)
+{
+  _quaternion_simd_dispatch->conjugate(q, r, n);
+}
+
+void
+quaternion_normalized_contiguous(const quaternion* q, quaternion* r, ptrdiff_t n)
+{
+  _quaternion_simd_dispatch->normalized(q, r, n);
+}
+
+void
+quaternion_add_contiguous(const quaternion* q1, const quaternion* q2, quaternion* r, ptrdiff_t n)
+{
+  _quaternion_simd_dispatch->add(q1, q2, r, n);
+}
+
+void
+quaternion_multiply_contiguous(const quaternion* q1, const quaternion* q2, quaternion* r, ptrdiff_t n)
+{
+  _quaternion_simd_dispatch->multiply(q1, q2, r, n);
+}
+
+void
+quaternion_divide_contiguous(const quaternion* q1, const quaternion* q2, quaternion* r, ptrdiff_t n)
+{
+  _quaternion_simd_dispatch->divide(q1, q2, r, n);
+}
+
+void
+quaternion_multiply_components(const double* const* a, const double* const* b, double* const* r, ptrdiff_t n)
+{
+  _quaternion_simd_dispatch->multiply_components(a, b, r, n);
+}
+
+void
+quaternion_divide_components(const double* const* a, const double* const* b, double* const* r, ptrdiff_t n)
+{
+  _quaternion_simd_dispatch->divide_components(a, b, r, n);
+}
+
+void
+quaternion_copyswap_batch(char* dst, ptrdiff_t dst_step, const char* src, ptrdiff_t src_step,
+                          ptrdiff_t n, int swap, int size)
+{
+  _quaternion_simd_dispatch->copyswap(dst, dst_step, src, src_step, n, swap, size);
+}
+
+void
+quaternion_exp_batch(const char* q, ptrdiff_t q_step, char* r, ptrdiff_t r_step, ptrdiff_t n)
+{
+  _quaternion_simd_dispatch->exp(q, q_step, r, r_step, n, _quaternion_simd_fast);
+}
+
+void
+quaternion_log_batch(const char* q, ptrdiff_t q_step, char* r, ptrdiff_t r_step, ptrdiff_t n)
+{
+  _quaternion_simd_dispatch->log(q, q_step, r, r_step, n, _quaternion_simd_fast);
+}
+
+void
+quaternion_power_batch(const char* q, ptrdiff_t q_step, const char* p, ptrdiff_t p_step,
+                       char* r, ptrdiff_t r_step, ptrdiff_t n)
+{
+  _quaternion_simd_dispatch->power(q, q_step, p, p_step, r, r_step, n, _quaternion_simd_fast);
+}
+
+void
+quaternion_power_scalar_batch(const char* q, ptrdiff_t q_step, const char* s, ptrdiff_t s_step,
+                              char* r, ptrdiff_t r_step, ptrdiff_t n)
+{
+  _quaternion_simd_dispatch->power_scalar(q, q_step, s, s_step, r, r_step, n, _quaternion_simd_fast);
+}
+
+void
+quaternion_slerp_batch(const char* q1, ptrdiff_t q1_step, const char* q2, ptrdiff_t q2_step,
+                       const char* tau, ptrdiff_t tau_step, char* r, ptrdiff_t r_step, ptrdiff_t n)
+{
+  _quaternion_simd_dispatch->slerp(q1, q1_step, q2, q2_step, tau, tau_step, r, r_step, n, _quaternion_simd_fast);
+}
+
+void
+quaternion_squad_batch(const char* tau, ptrdiff_t tau_step, const char* q_i, ptrdiff_t q_i_step,
+                       const char* a_i, ptrdiff_t a_i_step, const char* b_ip1, ptrdiff_t b_ip1_step,
+                       const char* q_ip1, ptrdiff_t q_ip1_step, char* r, ptrdiff_t r_step, ptrdiff_t n)
+{
+  _quaternion_simd_dispatch->squad(tau, tau_step, q_i, q_i_step, a_i, a_i_step, b_ip1, b_ip1_step,
+                                  q_ip1, q_ip1_step, r, r_step, n, _quaternion_simd_fast);
+}
+
+void
+quaternion_slerp_unit_batch(const char* q1, ptrdiff_t q1_step, const char* q2, ptrdiff_t q2_step,
+                            const char* tau, ptrdiff_t tau_step, char* r, ptrdiff_t r_step, ptrdiff_t n)
+{
+  _quaternion_simd_dispatch->slerp_unit(q1, q1_step, q2, q2_step, tau, tau_step, r, r_step, n, _quaternion_simd_fast);
+}
+
+void
+quaternion_slerp_unit_segment_batch(const char* q1, const char* q2, const char* tau, ptrdiff_t tau_step,
+                                    char* r, ptrdiff_t r_step, ptrdiff_t n)
+{
+  _quaternion_simd_dispatch->slerp_unit_segment(q1, q2, tau, tau_step, r, r_step, n, _quaternion_simd_fast);
+}
+
+void
+quaternion_from_euler_angles_batch(const char* alpha, const char* beta, const char* gamma, ptrdiff_t angle_step,
+                                   char* r, ptrdiff_t r_step, ptrdiff_t r_component_step, ptrdiff_t n,
+                                   int i, int j, int k)
+{
+  _quaternion_simd_dispatch->from_euler_angles(alpha, beta, gamma, angle_step, r, r_step, r_component_step, n,
+                                              i, j, k, _quaternion_simd_fast);
+}
+
+void
+quaternion_as_euler_angles_batch(const char* q, ptrdiff_t q_step, ptrdiff_t q_component_step,
+                                 char* alpha, char* beta, char* gamma, ptrdiff_t angle_step, ptrdiff_t n,
+                                 int i, int j, int k)
+{
+  _quaternion_simd_dispatch->as_euler_angles(q, q_step, q_component_step, alpha, beta, gamma, angle_step, n,
+                                            i, j, k, _quaternion_simd_fast);
+}
+
+void
+quaternion_from_rotation_vector_batch(const char* v, ptrdiff_t v_step, ptrdiff_t v_component_step,
+                                      char* r, ptrdiff_t r_step, ptrdiff_t r_component_step, ptrdiff_t n)
+{
+  _quaternion_simd_dispatch->from_rotation_vector(v, v_step, v_component_step, r, r_step, r_component_step, n,
+                                                 _quaternion_simd_fast);
+}
+
+void
+quaternion_as_rotation_vector_batch(const char* q, ptrdiff_t q_step, ptrdiff_t q_component_step,
+                                    char* r, ptrdiff_t r_step, ptrdiff_t r_component_step, ptrdiff_t n)
+{
+  _quaternion_simd_dispatch->as_rotation_vector(q, q_step, q_component_step, r, r_step, r_component_step, n,
+                                               _quaternion_simd_fast);
+}
+
+void
+quaternion_encode_rotors_batch(const char* q, ptrdiff_t q_step, ptrdiff_t q_component_step,
+                               char* codes, ptrdiff_t code_step, ptrdiff_t code_size, ptrdiff_t n, int bits)
+{
+  _quaternion_simd_dispatch->encode_rotors(q, q_step, q_component_step, codes, code_step, code_size, n, bits);
+}
+
+void
+quaternion_decode_rotors_batch(const char* codes, ptrdiff_t code_step, ptrdiff_t code_size,
+                               char* r, ptrdiff_t r_step, ptrdiff_t r_component_step, ptrdiff_t n, int bits)
+{
+  _quaternion_simd_dispatch->decode_rotors(codes, code_step, code_size, r, r_step, r_component_step, n, bits);
+}
+
+void
+quaternion_gyro_propagate_block(const char* v, ptrdiff_t v_step, ptrdiff_t v_component_step, ptrdiff_t n,
+                                const double* previous, double dt, int coning, quaternion* R,
+                                char* r, ptrdiff_t r_step)
+{
+  _quaternion_simd_dispatch->gyro_propagate(v, v_step, v_component_step, n, previous, dt, coning, R, r, r_step);
+}
+
+
+#ifdef __cplusplus
+}
+#endif
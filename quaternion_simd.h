@@ -0,0 +1,162 @@
+// Copyright (c) 2017, Michael Boyle
+// See LICENSE file for details: <https://github.com/moble/quaternion/blob/master/LICENSE>
+
+#ifndef __QUATERNION_SIMD_H__
+#define __QUATERNION_SIMD_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+  #include <stddef.h>
+
+  #include "quaternion.h"
+
+  // These functions apply the corresponding functions from
+  // `quaternion.h` to `n` contiguous quaternions.  Each is compiled
+  // several times -- for the baseline instruction set, for AVX2 with
+  // FMA, and for AVX-512 -- and calls are forwarded to the best version
+  // the CPU supports, as chosen by `quaternion_simd_init`.  The vector
+  // versions load blocks of 4 or 8 quaternions, transpose them in
+  // registers so that each register holds one component of every
+  // quaternion in the block, and process them lane-wise; any remainder
+  // is handled one quaternion at a time.  The operations are performed
+  // in the same order as the scalar functions, so the results agree
+  // with them to within rounding, and are identical unless the compiler
+  // contracts products and sums into fused multiply-adds.  Output arrays
+  // may be identical to (but must not otherwise overlap) the input
+  // arrays.
+
+  // Unary float returners
+  void quaternion_norm_contiguous(const quaternion* q, double* r, ptrdiff_t n);
+  void quaternion_absolute_contiguous(const quaternion* q, double* r, ptrdiff_t n);
+
+  // Unary quaternion returners
+  void quaternion_conjugate_contiguous(const quaternion* q, quaternion* r, ptrdiff_t n);
+  void quaternion_normalized_contiguous(const quaternion* q, quaternion* r, ptrdiff_t n);
+
+  // Quaternion-quaternion binary quaternion returners
+  void quaternion_add_contiguous(const quaternion* q1, const quaternion* q2, quaternion* r, ptrdiff_t n);
+  void quaternion_multiply_contiguous(const quaternion* q1, const quaternion* q2, quaternion* r, ptrdiff_t n);
+  void quaternion_divide_contiguous(const quaternion* q1, const quaternion* q2, quaternion* r, ptrdiff_t n);
+  // The same, for quaternions stored as four contiguous arrays of
+  // components, `a[0]` holding the `w` components, and so on.  The output
+  // arrays may be identical to the input arrays.
+  void quaternion_multiply_components(const double* const* a, const double* const* b, double* const* r, ptrdiff_t n);
+  void quaternion_divide_components(const double* const* a, const double* const* b, double* const* r, ptrdiff_t n);
+
+  // Copy `n` quaternions with components of `size` (4 or 8) bytes,
+  // byte-swapping each component if `swap` is nonzero, as numpy's
+  // `copyswapn`.  The arrays need not be aligned, and a NULL `src`
+  // swaps `dst` in place.
+  void quaternion_copyswap_batch(char* dst, ptrdiff_t dst_step, const char* src, ptrdiff_t src_step,
+                                 ptrdiff_t n, int swap, int size);
+
+  // These functions apply the corresponding functions from
+  // `quaternion.h` to `n` quaternions (and scalars) spaced by the given
+  // steps in bytes, like the inner loops of numpy ufuncs.  They are
+  // dispatched like the functions above, and evaluate the elementary
+  // functions with the polynomial approximations in
+  // `quaternion_simd_math.h`, so the results differ from those of the
+  // scalar functions by a few ulp -- or by relative errors up to about
+  // 2e-13 when `quaternion_simd_set_fast(1)` has been called.  Elements
+  // outside the domain of the approximations (including non-finite and
+  // real or zero quaternions) are passed to the scalar functions.  The
+  // output may be identical to (but must not otherwise overlap) the
+  // inputs.
+  void quaternion_exp_batch(const char* q, ptrdiff_t q_step, char* r, ptrdiff_t r_step, ptrdiff_t n);
+  void quaternion_log_batch(const char* q, ptrdiff_t q_step, char* r, ptrdiff_t r_step, ptrdiff_t n);
+  void quaternion_power_batch(const char* q, ptrdiff_t q_step, const char* p, ptrdiff_t p_step,
+                              char* r, ptrdiff_t r_step, ptrdiff_t n);
+  void quaternion_power_scalar_batch(const char* q, ptrdiff_t q_step, const char* s, ptrdiff_t s_step,
+                                     char* r, ptrdiff_t r_step, ptrdiff_t n);
+  void quaternion_slerp_batch(const char* q1, ptrdiff_t q1_step, const char* q2, ptrdiff_t q2_step,
+                              const char* tau, ptrdiff_t tau_step, char* r, ptrdiff_t r_step, ptrdiff_t n);
+  void quaternion_squad_batch(const char* tau, ptrdiff_t tau_step, const char* q_i, ptrdiff_t q_i_step,
+                              const char* a_i, ptrdiff_t a_i_step, const char* b_ip1, ptrdiff_t b_ip1_step,
+                              const char* q_ip1, ptrdiff_t q_ip1_step, char* r, ptrdiff_t r_step, ptrdiff_t n);
+  // `slerp_unit` for each element, and for a single pair of rotors at
+  // many values of tau
+  void quaternion_slerp_unit_batch(const char* q1, ptrdiff_t q1_step, const char* q2, ptrdiff_t q2_step,
+                                   const char* tau, ptrdiff_t tau_step, char* r, ptrdiff_t r_step, ptrdiff_t n);
+  void quaternion_slerp_unit_segment_batch(const char* q1, const char* q2, const char* tau, ptrdiff_t tau_step,
+                                           char* r, ptrdiff_t r_step, ptrdiff_t n);
+  // Quaternions from Euler angles in the sequence of axes `(i, j, k)`,
+  // and the inverse, as in `quaternion_create_from_euler_angles_sequence`
+  // and `quaternion_as_euler_angles_sequence`.  The quaternions are read
+  // or written as four doubles separated by the component step.  A NULL
+  // `gamma` is taken as zero, and is not written by the inverse.
+  void quaternion_from_euler_angles_batch(const char* alpha, const char* beta, const char* gamma, ptrdiff_t angle_step,
+                                          char* r, ptrdiff_t r_step, ptrdiff_t r_component_step, ptrdiff_t n,
+                                          int i, int j, int k);
+  void quaternion_as_euler_angles_batch(const char* q, ptrdiff_t q_step, ptrdiff_t q_component_step,
+                                        char* alpha, char* beta, char* gamma, ptrdiff_t angle_step, ptrdiff_t n,
+                                        int i, int j, int k);
+  // Unit quaternions from rotation vectors, and the inverse, as in
+  // `quaternion_create_from_rotation_vector` and
+  // `quaternion_as_rotation_vector`, with the same component steps
+  void quaternion_from_rotation_vector_batch(const char* v, ptrdiff_t v_step, ptrdiff_t v_component_step,
+                                             char* r, ptrdiff_t r_step, ptrdiff_t r_component_step, ptrdiff_t n);
+  void quaternion_as_rotation_vector_batch(const char* q, ptrdiff_t q_step, ptrdiff_t q_component_step,
+                                           char* r, ptrdiff_t r_step, ptrdiff_t r_component_step, ptrdiff_t n);
+  // Unit quaternions packed into unsigned integers of `code_size` (4 or
+  // 8) bytes by the smallest-three scheme, with `bits` bits for each of
+  // the three smallest components, and the inverse.  The quaternions
+  // must be nonzero and finite, but need not be normalized.
+  void quaternion_encode_rotors_batch(const char* q, ptrdiff_t q_step, ptrdiff_t q_component_step,
+                                      char* codes, ptrdiff_t code_step, ptrdiff_t code_size, ptrdiff_t n, int bits);
+  void quaternion_decode_rotors_batch(const char* codes, ptrdiff_t code_step, ptrdiff_t code_size,
+                                      char* r, ptrdiff_t r_step, ptrdiff_t r_component_step, ptrdiff_t n, int bits);
+  // Propagate the attitude `R` through one block of `n` (at most
+  // QUATERNION_GYRO_BLOCK) body-frame gyro samples, read as three
+  // doubles separated by the component step.  Each sample times `dt`
+  // is an increment, corrected for coning with the one before it if
+  // `coning` is nonzero (`previous` is the sample before the block);
+  // the attitude after each sample is written to `r`.  Rotors of
+  // increments are multiplied in groups, so the results depend on the
+  // position of each sample within its block.  After a full block, `R`
+  // is replaced by the normalized final attitude, which is also written
+  // as the last output; after a partial block, its value is undefined.
+  #define QUATERNION_GYRO_BLOCK 256
+  void quaternion_gyro_propagate_block(const char* v, ptrdiff_t v_step, ptrdiff_t v_component_step, ptrdiff_t n,
+                                       const double* previous, double dt, int coning, quaternion* R,
+                                       char* r, ptrdiff_t r_step);
+
+  // Accuracy mode of the batched functions: 0 (the default) for errors of
+  // a few ulp, or 1 for faster, lower-degree polynomials
+  int quaternion_simd_get_fast(void);
+  void quaternion_simd_set_fast(int fast);
+
+  // Dispatch levels, in order of preference
+  #define QUATERNION_SIMD_BASELINE 0
+  #define QUATERNION_SIMD_AVX2 1
+  #define QUATERNION_SIMD_AVX512 2
+
+  typedef struct {
+    int sse2;
+    int avx;
+    int avx2;
+    int fma;
+    int avx512f;
+  } quaternion_cpu_features;
+
+  // CPU features usable by this process (all zero on non-x86 machines)
+  quaternion_cpu_features quaternion_simd_cpu_features(void);
+  // Highest level that is both compiled in and supported by the CPU
+  int quaternion_simd_supported_level(void);
+  // Choose the level automatically; call once, before any kernel is used
+  void quaternion_simd_init(void);
+  // Current level, or change it; returns -1 if the level is unsupported.
+  // The change is a single pointer store, so it may be made while loops
+  // run on other threads: each kernel call uses either the old kernels
+  // or the new ones.
+  int quaternion_simd_get_level(void);
+  int quaternion_simd_set_level(int level);
+  // Name of a level ("baseline", "avx2", or "avx512"), or NULL
+  const char* quaternion_simd_level_name(int level);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __QUATERNION_SIMD_H__
@@ -0,0 +1,1525 @@
+// Copyright (c) 2017, Michael Boyle
+// See LICENSE file for details: <https://github.com/moble/quaternion/blob/master/LICENSE>
+
+// This file is a template, included several times by `quaternion_simd.c`
+// to compile the same kernels for different instruction sets.  Before
+// each inclusion, the including file defines
+//
+//   _QUATERNION_SIMD_SUFFIX  appended to the name of each kernel
+//   _QUATERNION_SIMD_TARGET  function attribute selecting the target
+//
+// and optionally one of `_QUATERNION_SIMD_USE_AVX512` or
+// `_QUATERNION_SIMD_USE_AVX2` to select the vector code; otherwise,
+// only the scalar loops are compiled.  Everything defined here is
+// static, and every macro is undefined at the end of this file.
+
+#define _QUATERNION_SIMD_CAT2(a, b) a##_##b
+#define _QUATERNION_SIMD_CAT(a, b) _QUATERNION_SIMD_CAT2(a, b)
+#define _QUATERNION_SIMD_NAME(name) _QUATERNION_SIMD_CAT(name, _QUATERNION_SIMD_SUFFIX)
+
+
+#if defined(_QUATERNION_SIMD_USE_AVX512)
+
+  #define VEC __m512d
+  #define _QUATERNION_SIMD_WIDTH 8
+  #define _mul _mm512_mul_pd
+  #define _add _mm512_add_pd
+  #define _sub _mm512_sub_pd
+  #define _div _mm512_div_pd
+  #define _sqrt _mm512_sqrt_pd
+  #define _loadu _mm512_loadu_pd
+  #define _storeu _mm512_storeu_pd
+  #define _xor(a, b) _mm512_castsi512_pd(_mm512_xor_si512(_mm512_castpd_si512(a), _mm512_castpd_si512(b)))
+
+  // Load eight quaternions, and transpose so that each output register
+  // holds one component of all eight
+  static NPY_INLINE _QUATERNION_SIMD_TARGET void
+  _QUATERNION_SIMD_NAME(_quaternion_simd_load)(const quaternion* q, VEC* w, VEC* x, VEC* y, VEC* z) {
+    const double* d = (const double*) q;
+    const __m512i even = _mm512_set_epi64(13, 9, 12, 8, 5, 1, 4, 0);
+    const __m512i odd = _mm512_set_epi64(15, 11, 14, 10, 7, 3, 6, 2);
+    const VEC r0 = _loadu(d), r1 = _loadu(d+8), r2 = _loadu(d+16), r3 = _loadu(d+24);
+    const VEC t0 = _mm512_unpacklo_pd(r0, r1);  // w0 w2 y0 y2 w1 w3 y1 y3
+    const VEC t1 = _mm512_unpackhi_pd(r0, r1);  // x0 x2 z0 z2 x1 x3 z1 z3
+    const VEC t2 = _mm512_unpacklo_pd(r2, r3);  // w4 w6 y4 y6 w5 w7 y5 y7
+    const VEC t3 = _mm512_unpackhi_pd(r2, r3);  // x4 x6 z4 z6 x5 x7 z5 z7
+    *w = _mm512_permutex2var_pd(t0, even, t2);
+    *y = _mm512_permutex2var_pd(t0, odd, t2);
+    *x = _mm512_permutex2var_pd(t1, even, t3);
+    *z = _mm512_permutex2var_pd(t1, odd, t3);
+  }
+
+  // Invert the transposition above, and store eight quaternions
+  static NPY_INLINE _QUATERNION_SIMD_TARGET void
+  _QUATERNION_SIMD_NAME(_quaternion_simd_store)(quaternion* q, VEC w, VEC x, VEC y, VEC z) {
+    double* d = (double*) q;
+    const __m512i low = _mm512_set_epi64(11, 9, 3, 1, 10, 8, 2, 0);
+    const __m512i high = _mm512_set_epi64(15, 13, 7, 5, 14, 12, 6, 4);
+    const VEC t0 = _mm512_permutex2var_pd(w, low, y);  // w0 w2 y0 y2 w1 w3 y1 y3
+    const VEC t2 = _mm512_permutex2var_pd(w, high, y);  // w4 w6 y4 y6 w5 w7 y5 y7
+    const VEC t1 = _mm512_permutex2var_pd(x, low, z);  // x0 x2 z0 z2 x1 x3 z1 z3
+    const VEC t3 = _mm512_permutex2var_pd(x, high, z);  // x4 x6 z4 z6 x5 x7 z5 z7
+    _storeu(d, _mm512_unpacklo_pd(t0, t1));
+    _storeu(d+8, _mm512_unpackhi_pd(t0, t1));
+    _storeu(d+16, _mm512_unpacklo_pd(t2, t3));
+    _storeu(d+24, _mm512_unpackhi_pd(t2, t3));
+  }
+
+  // Sign mask that negates the vector parts of two quaternions
+  #define _QUATERNION_SIMD_CONJUGATE_MASK                                 \
+    _mm512_castsi512_pd(_mm512_set_epi64((long long)0x8000000000000000ULL, (long long)0x8000000000000000ULL, \
+                                         (long long)0x8000000000000000ULL, 0, \
+                                         (long long)0x8000000000000000ULL, (long long)0x8000000000000000ULL, \
+                                         (long long)0x8000000000000000ULL, 0))
+
+#elif defined(_QUATERNION_SIMD_USE_AVX2)
+
+  #define VEC __m256d
+  #define _QUATERNION_SIMD_WIDTH 4
+  #define _mul _mm256_mul_pd
+  #define _add _mm256_add_pd
+  #define _sub _mm256_sub_pd
+  #define _div _mm256_div_pd
+  #define _sqrt _mm256_sqrt_pd
+  #define _loadu _mm256_loadu_pd
+  #define _storeu _mm256_storeu_pd
+  #define _xor _mm256_xor_pd
+
+  // Load four quaternions, and transpose so that each output register
+  // holds one component of all four
+  static NPY_INLINE _QUATERNION_SIMD_TARGET void
+  _QUATERNION_SIMD_NAME(_quaternion_simd_load)(const quaternion* q, VEC* w, VEC* x, VEC* y, VEC* z) {
+    const double* d = (const double*) q;
+    const VEC r0 = _loadu(d), r1 = _loadu(d+4), r2 = _loadu(d+8), r3 = _loadu(d+12);
+    const VEC t0 = _mm256_unpacklo_pd(r0, r1);  // w0 w1 y0 y1
+    const VEC t1 = _mm256_unpackhi_pd(r0, r1);  // x0 x1 z0 z1
+    const VEC t2 = _mm256_unpacklo_pd(r2, r3);  // w2 w3 y2 y3
+    const VEC t3 = _mm256_unpackhi_pd(r2, r3);  // x2 x3 z2 z3
+    *w = _mm256_permute2f128_pd(t0, t2, 0x20);
+    *y = _mm256_permute2f128_pd(t0, t2, 0x31);
+    *x = _mm256_permute2f128_pd(t1, t3, 0x20);
+    *z = _mm256_permute2f128_pd(t1, t3, 0x31);
+  }
+
+  // Invert the transposition above, and store four quaternions
+  static NPY_INLINE _QUATERNION_SIMD_TARGET void
+  _QUATERNION_SIMD_NAME(_quaternion_simd_store)(quaternion* q, VEC w, VEC x, VEC y, VEC z) {
+    double* d = (double*) q;
+    const VEC t0 = _mm256_permute2f128_pd(w, y, 0x20);  // w0 w1 y0 y1
+    const VEC t2 = _mm256_permute2f128_pd(w, y, 0x31);  // w2 w3 y2 y3
+    const VEC t1 = _mm256_permute2f128_pd(x, z, 0x20);  // x0 x1 z0 z1
+    const VEC t3 = _mm256_permute2f128_pd(x, z, 0x31);  // x2 x3 z2 z3
+    _storeu(d, _mm256_unpacklo_pd(t0, t1));
+    _storeu(d+4, _mm256_unpackhi_pd(t0, t1));
+    _storeu(d+8, _mm256_unpacklo_pd(t2, t3));
+    _storeu(d+12, _mm256_unpackhi_pd(t2, t3));
+  }
+
+  // Sign mask that negates the vector part of one quaternion
+  #define _QUATERNION_SIMD_CONJUGATE_MASK _mm256_set_pd(-0.0, -0.0, -0.0, 0.0)
+
+#endif
+
+
+static _QUATERNION_SIMD_TARGET void
+_QUATERNION_SIMD_NAME(quaternion_norm_contiguous)(const quaternion* q, double* r, ptrdiff_t n)
+{
+  ptrdiff_t i = 0;
+#if defined(_QUATERNION_SIMD_WIDTH)
+  for(; i+_QUATERNION_SIMD_WIDTH<=n; i+=_QUATERNION_SIMD_WIDTH) {
+    VEC w, x, y, z;
+    _QUATERNION_SIMD_NAME(_quaternion_simd_load)(q+i, &w, &x, &y, &z);
+    _storeu(r+i, _QUATERNION_SIMD_NORM(_mul, _add, w, x, y, z));
+  }
+#endif
+  for(; i<n; ++i) {
+    r[i] = quaternion_norm(q[i]);
+  }
+}
+
+static _QUATERNION_SIMD_TARGET void
+_QUATERNION_SIMD_NAME(quaternion_absolute_contiguous)(const quaternion* q, double* r, ptrdiff_t n)
+{
+  ptrdiff_t i = 0;
+#if defined(_QUATERNION_SIMD_WIDTH)
+  for(; i+_QUATERNION_SIMD_WIDTH<=n; i+=_QUATERNION_SIMD_WIDTH) {
+    VEC w, x, y, z;
+    _QUATERNION_SIMD_NAME(_quaternion_simd_load)(q+i, &w, &x, &y, &z);
+    _storeu(r+i, _sqrt(_QUATERNION_SIMD_NORM(_mul, _add, w, x, y, z)));
+  }
+#endif
+  for(; i<n; ++i) {
+    r[i] = quaternion_absolute(q[i]);
+  }
+}
+
+static _QUATERNION_SIMD_TARGET void
+_QUATERNION_SIMD_NAME(quaternion_conjugate_contiguous)(const quaternion* q, quaternion* r, ptrdiff_t n)
+{
+  // No transposition is needed; this just flips sign bits in place
+  ptrdiff_t i = 0;
+#if defined(_QUATERNION_SIMD_WIDTH)
+  const VEC mask = _QUATERNION_SIMD_CONJUGATE_MASK;
+  const double* d = (const double*) q;
+  double* e = (double*) r;
+  for(; i+_QUATERNION_SIMD_WIDTH<=n; i+=_QUATERNION_SIMD_WIDTH) {
+    ptrdiff_t j;
+    VEC s[4];
+    for(j=0; j<4; ++j) {
+      s[j] = _xor(_loadu(d+4*i+j*_QUATERNION_SIMD_WIDTH), mask);
+    }
+    for(j=0; j<4; ++j) {
+      _storeu(e+4*i+j*_QUATERNION_SIMD_WIDTH, s[j]);
+    }
+  }
+#endif
+  for(; i<n; ++i) {
+    r[i] = quaternion_conjugate(q[i]);
+  }
+}
+
+static _QUATERNION_SIMD_TARGET void
+_QUATERNION_SIMD_NAME(quaternion_normalized_contiguous)(const quaternion* q, quaternion* r, ptrdiff_t n)
+{
+  ptrdiff_t i = 0;
+#if defined(_QUATERNION_SIMD_WIDTH)
+  for(; i+_QUATERNION_SIMD_WIDTH<=n; i+=_QUATERNION_SIMD_WIDTH) {
+    VEC w, x, y, z, q_abs;
+    _QUATERNION_SIMD_NAME(_quaternion_simd_load)(q+i, &w, &x, &y, &z);
+    q_abs = _sqrt(_QUATERNION_SIMD_NORM(_mul, _add, w, x, y, z));
+    _QUATERNION_SIMD_NAME(_quaternion_simd_store)(r+i, _div(w, q_abs), _div(x, q_abs), _div(y, q_abs), _div(z, q_abs));
+  }
+#endif
+  for(; i<n; ++i) {
+    r[i] = quaternion_normalized(q[i]);
+  }
+}
+
+static _QUATERNION_SIMD_TARGET void
+_QUATERNION_SIMD_NAME(quaternion_add_contiguous)(const quaternion* q1, const quaternion* q2, quaternion* r, ptrdiff_t n)
+{
+  // No transposition is needed; this is just componentwise addition
+  ptrdiff_t i = 0;
+#if defined(_QUATERNION_SIMD_WIDTH)
+  const double* d1 = (const double*) q1;
+  const double* d2 = (const double*) q2;
+  double* e = (double*) r;
+  for(; i+_QUATERNION_SIMD_WIDTH<=n; i+=_QUATERNION_SIMD_WIDTH) {
+    ptrdiff_t j;
+    VEC s[4];
+    for(j=0; j<4; ++j) {
+      s[j] = _add(_loadu(d1+4*i+j*_QUATERNION_SIMD_WIDTH), _loadu(d2+4*i+j*_QUATERNION_SIMD_WIDTH));
+    }
+    for(j=0; j<4; ++j) {
+      _storeu(e+4*i+j*_QUATERNION_SIMD_WIDTH, s[j]);
+    }
+  }
+#endif
+  for(; i<n; ++i) {
+    r[i] = quaternion_add(q1[i], q2[i]);
+  }
+}
+
+static _QUATERNION_SIMD_TARGET void
+_QUATERNION_SIMD_NAME(quaternion_multiply_contiguous)(const quaternion* q1, const quaternion* q2, quaternion* r, ptrdiff_t n)
+{
+  ptrdiff_t i = 0;
+#if defined(_QUATERNION_SIMD_WIDTH)
+  for(; i+_QUATERNION_SIMD_WIDTH<=n; i+=_QUATERNION_SIMD_WIDTH) {
+    VEC aw, ax, ay, az, bw, bx, by, bz, rw, rx, ry, rz;
+    _QUATERNION_SIMD_NAME(_quaternion_simd_load)(q1+i, &aw, &ax, &ay, &az);
+    _QUATERNION_SIMD_NAME(_quaternion_simd_load)(q2+i, &bw, &bx, &by, &bz);
+    _QUATERNION_SIMD_MULTIPLY(_mul, _add, _sub, aw, ax, ay, az, bw, bx, by, bz, rw, rx, ry, rz);
+    _QUATERNION_SIMD_NAME(_quaternion_simd_store)(r+i, rw, rx, ry, rz);
+  }
+#endif
+  for(; i<n; ++i) {
+    r[i] = quaternion_multiply(q1[i], q2[i]);
+  }
+}
+
+static _QUATERNION_SIMD_TARGET void
+_QUATERNION_SIMD_NAME(quaternion_divide_contiguous)(const quaternion* q1, const quaternion* q2, quaternion* r, ptrdiff_t n)
+{
+  ptrdiff_t i = 0;
+#if defined(_QUATERNION_SIMD_WIDTH)
+  for(; i+_QUATERNION_SIMD_WIDTH<=n; i+=_QUATERNION_SIMD_WIDTH) {
+    VEC aw, ax, ay, az, bw, bx, by, bz, rw, rx, ry, rz;
+    _QUATERNION_SIMD_NAME(_quaternion_simd_load)(q1+i, &aw, &ax, &ay, &az);
+    _QUATERNION_SIMD_NAME(_quaternion_simd_load)(q2+i, &bw, &bx, &by, &bz);
+    _QUATERNION_SIMD_DIVIDE(_mul, _add, _sub, _div, aw, ax, ay, az, bw, bx, by, bz, rw, rx, ry, rz);
+    _QUATERNION_SIMD_NAME(_quaternion_simd_store)(r+i, rw, rx, ry, rz);
+  }
+#endif
+  for(; i<n; ++i) {
+    r[i] = quaternion_divide(q1[i], q2[i]);
+  }
+}
+
+// The same, for quaternions stored as four contiguous arrays of
+// components, which need no shuffling.  The output arrays may be
+// identical to (but must not otherwise overlap) the input arrays.
+#define _QUATERNION_SIMD_COMPONENTS_KERNEL(name, SIMD_OP, ...)          \
+  static _QUATERNION_SIMD_TARGET void                                   \
+  _QUATERNION_SIMD_NAME(quaternion_##name##_components)(const double* const* a, const double* const* b, \
+                                                        double* const* r, ptrdiff_t n) \
+  {                                                                     \
+    ptrdiff_t i = 0;                                                    \
+    _QUATERNION_SIMD_COMPONENTS_VECTOR_LOOP(SIMD_OP, __VA_ARGS__)       \
+    for(; i<n; ++i) {                                                   \
+      const quaternion qa = {a[0][i], a[1][i], a[2][i], a[3][i]};       \
+      const quaternion qb = {b[0][i], b[1][i], b[2][i], b[3][i]};       \
+      const quaternion qr = quaternion_##name(qa, qb);                  \
+      r[0][i] = qr.w;                                                   \
+      r[1][i] = qr.x;                                                   \
+      r[2][i] = qr.y;                                                   \
+      r[3][i] = qr.z;                                                   \
+    }                                                                   \
+  }
+#if defined(_QUATERNION_SIMD_WIDTH)
+  #define _QUATERNION_SIMD_COMPONENTS_VECTOR_LOOP(SIMD_OP, ...)         \
+    for(; i+_QUATERNION_SIMD_WIDTH<=n; i+=_QUATERNION_SIMD_WIDTH) {     \
+      VEC aw = _loadu(a[0]+i), ax = _loadu(a[1]+i), ay = _loadu(a[2]+i), az = _loadu(a[3]+i); \
+      VEC bw = _loadu(b[0]+i), bx = _loadu(b[1]+i), by = _loadu(b[2]+i), bz = _loadu(b[3]+i); \
+      VEC rw, rx, ry, rz;                                               \
+      SIMD_OP(__VA_ARGS__, aw, ax, ay, az, bw, bx, by, bz, rw, rx, ry, rz); \
+      _storeu(r[0]+i, rw);                                              \
+      _storeu(r[1]+i, rx);                                              \
+      _storeu(r[2]+i, ry);                                              \
+      _storeu(r[3]+i, rz);                                              \
+    }
+#else
+  #define _QUATERNION_SIMD_COMPONENTS_VECTOR_LOOP(SIMD_OP, ...)
+#endif
+_QUATERNION_SIMD_COMPONENTS_KERNEL(multiply, _QUATERNION_SIMD_MULTIPLY, _mul, _add, _sub)
+_QUATERNION_SIMD_COMPONENTS_KERNEL(divide, _QUATERNION_SIMD_DIVIDE, _mul, _add, _sub, _div)
+#undef _QUATERNION_SIMD_COMPONENTS_VECTOR_LOOP
+#undef _QUATERNION_SIMD_COMPONENTS_KERNEL
+
+// Copy `n` quaternions whose four components each have `size` (4 or 8)
+// bytes, reversing the bytes of every component if `swap` is nonzero.
+// Neither array need be aligned.  A NULL `src` swaps `dst` in place;
+// otherwise, the arrays must be identical or must not overlap.  When
+// both are contiguous, the components are swapped in one pass over the
+// whole array, which the compiler vectorizes with byte shuffles.
+#define _QUATERNION_SIMD_SWAP(bits)                                     \
+  static NPY_INLINE _QUATERNION_SIMD_TARGET void                        \
+  _QUATERNION_SIMD_NAME(_qs_swap##bits)(char* dst, const char* src, ptrdiff_t m) \
+  {                                                                     \
+    ptrdiff_t i;                                                        \
+    for(i=0; i<m; ++i) {                                                \
+      uint##bits##_t u;                                                 \
+      memcpy(&u, src + i*(bits/8), bits/8);                             \
+      u = _qsm_bswap##bits(u);                                          \
+      memcpy(dst + i*(bits/8), &u, bits/8);                             \
+    }                                                                   \
+  }                                                                     \
+  static NPY_INLINE _QUATERNION_SIMD_TARGET void                        \
+  _QUATERNION_SIMD_NAME(_qs_swap##bits##_in_place)(char* dst, ptrdiff_t m) \
+  {                                                                     \
+    ptrdiff_t i;                                                        \
+    for(i=0; i<m; ++i) {                                                \
+      uint##bits##_t u;                                                 \
+      memcpy(&u, dst + i*(bits/8), bits/8);                             \
+      u = _qsm_bswap##bits(u);                                          \
+      memcpy(dst + i*(bits/8), &u, bits/8);                             \
+    }                                                                   \
+  }
+_QUATERNION_SIMD_SWAP(32)
+_QUATERNION_SIMD_SWAP(64)
+#undef _QUATERNION_SIMD_SWAP
+
+static _QUATERNION_SIMD_TARGET void
+_QUATERNION_SIMD_NAME(quaternion_copyswap_batch)(char* dst, ptrdiff_t dst_step, const char* src, ptrdiff_t src_step,
+                                                 ptrdiff_t n, int swap, int size)
+{
+  const ptrdiff_t element = 4*size;
+  ptrdiff_t i;
+  if(src == NULL || (src == dst && src_step == dst_step)) {
+    if(!swap) {
+      return;
+    }
+    if(dst_step == element) {
+      if(size == 8) {
+        _QUATERNION_SIMD_NAME(_qs_swap64_in_place)(dst, 4*n);
+      } else {
+        _QUATERNION_SIMD_NAME(_qs_swap32_in_place)(dst, 4*n);
+      }
+    } else {
+      for(i=0; i<n; ++i) {
+        if(size == 8) {
+          _QUATERNION_SIMD_NAME(_qs_swap64_in_place)(dst + i*dst_step, 4);
+        } else {
+          _QUATERNION_SIMD_NAME(_qs_swap32_in_place)(dst + i*dst_step, 4);
+        }
+      }
+    }
+  } else if(dst_step == element && src_step == element) {
+    if(!swap) {
+      memcpy(dst, src, n*element);
+    } else if(size == 8) {
+      _QUATERNION_SIMD_NAME(_qs_swap64)(dst, src, 4*n);
+    } else {
+      _QUATERNION_SIMD_NAME(_qs_swap32)(dst, src, 4*n);
+    }
+  } else if(!swap) {
+    if(size == 8) {
+      for(i=0; i<n; ++i) {
+        memcpy(dst + i*dst_step, src + i*src_step, 32);
+      }
+    } else {
+      for(i=0; i<n; ++i) {
+        memcpy(dst + i*dst_step, src + i*src_step, 16);
+      }
+    }
+  } else {
+    for(i=0; i<n; ++i) {
+      if(size == 8) {
+        _QUATERNION_SIMD_NAME(_qs_swap64)(dst + i*dst_step, src + i*src_step, 4);
+      } else {
+        _QUATERNION_SIMD_NAME(_qs_swap32)(dst + i*dst_step, src + i*src_step, 4);
+      }
+    }
+  }
+}
+
+
+// The remaining kernels evaluate transcendental functions on blocks of
+// _QUATERNION_SIMD_BLOCK quaternions, which are copied from (possibly
+// strided) memory into component arrays.  The loops over the lanes of
+// a block are written in scalar C, and vectorized by the compiler for
+// the targeted instruction set.  Each lane carries a `bad` flag, set
+// when its arguments are outside the domain of the approximations in
+// `quaternion_simd_math.h`; those lanes are overwritten with harmless
+// values (so that they cannot raise floating-point exceptions), and the
+// final result for that element is computed by the scalar function.
+
+#define _QS_BLOCK _QUATERNION_SIMD_BLOCK
+#define _QS_UNIT 0.5  // Each component of a harmless unit quaternion
+
+// Copy `m` quaternions into a block, padding the remaining lanes
+static NPY_INLINE _QUATERNION_SIMD_TARGET void
+_QUATERNION_SIMD_NAME(_qs_gather)(const char* q, ptrdiff_t step, ptrdiff_t m, _quaternion_simd_block* b)
+{
+  ptrdiff_t j;
+  for(j=0; j<m; ++j) {
+    const quaternion* p = (const quaternion*)(q + j*step);
+    b->w[j] = p->w;
+    b->x[j] = p->x;
+    b->y[j] = p->y;
+    b->z[j] = p->z;
+  }
+  for(; j<_QS_BLOCK; ++j) {
+    b->w[j] = b->x[j] = b->y[j] = b->z[j] = _QS_UNIT;
+  }
+}
+
+// Copy `m` doubles into a block, padding the remaining lanes
+static NPY_INLINE _QUATERNION_SIMD_TARGET void
+_QUATERNION_SIMD_NAME(_qs_gather_double)(const char* s, ptrdiff_t step, ptrdiff_t m, double* d)
+{
+  ptrdiff_t j;
+  for(j=0; j<m; ++j) {
+    d[j] = *(const double*)(s + j*step);
+  }
+  for(; j<_QS_BLOCK; ++j) {
+    d[j] = _QS_UNIT;
+  }
+}
+
+// Replace a block's lanes with exp of those lanes
+_QSM_INLINE _QUATERNION_SIMD_TARGET void
+_QUATERNION_SIMD_NAME(_qs_exp_lanes)(_quaternion_simd_block* q, const double* vnorm, const int fast)
+{
+  int j;
+  for(j=0; j<_QS_BLOCK; ++j) {
+    double s, c, e, es;
+    const int big = vnorm[j] > _QUATERNION_EPS;
+    _qsm_sincos(vnorm[j], &s, &c, fast);
+    e = _qsm_exp(q->w[j], fast);
+    es = e * (s / (big ? vnorm[j] : 1.0));
+    q->w[j] = big ? e * c : e;
+    q->x[j] = big ? es * q->x[j] : 0.0;
+    q->y[j] = big ? es * q->y[j] : 0.0;
+    q->z[j] = big ? es * q->z[j] : 0.0;
+  }
+}
+static NPY_INLINE _QUATERNION_SIMD_TARGET void
+_QUATERNION_SIMD_NAME(_qs_exp_block)(_quaternion_simd_block* q, int64_t* bad, const int fast)
+{
+  int j;
+  double vnorm[_QS_BLOCK];
+  for(j=0; j<_QS_BLOCK; ++j) {
+    const int64_t ok = !bad[j]
+      && _qsm_abs_less(q->w[j], _QSM_EXP_MAX) && _qsm_abs_less(q->x[j], 0.5*_QSM_SINCOS_MAX)
+      && _qsm_abs_less(q->y[j], 0.5*_QSM_SINCOS_MAX) && _qsm_abs_less(q->z[j], 0.5*_QSM_SINCOS_MAX);
+    bad[j] = !ok;
+    q->w[j] = ok ? q->w[j] : 0.0;
+    q->x[j] = ok ? q->x[j] : 0.0;
+    q->y[j] = ok ? q->y[j] : 0.0;
+    q->z[j] = ok ? q->z[j] : 0.0;
+  }
+  for(j=0; j<_QS_BLOCK; ++j) {
+    vnorm[j] = sqrt(q->x[j]*q->x[j] + q->y[j]*q->y[j] + q->z[j]*q->z[j]);
+  }
+  if(fast) {
+    _QUATERNION_SIMD_NAME(_qs_exp_lanes)(q, vnorm, 1);
+  } else {
+    _QUATERNION_SIMD_NAME(_qs_exp_lanes)(q, vnorm, 0);
+  }
+}
+
+// Replace a block's lanes with log of those lanes
+_QSM_INLINE _QUATERNION_SIMD_TARGET void
+_QUATERNION_SIMD_NAME(_qs_log_lanes)(_quaternion_simd_block* q, const double* b, const double* norm, const int fast)
+{
+  int j;
+  for(j=0; j<_QS_BLOCK; ++j) {
+    const double f = _qsm_atan2(b[j], q->w[j], fast) / b[j];
+    q->w[j] = _qsm_log(norm[j], fast) / 2.0;
+    q->x[j] = f * q->x[j];
+    q->y[j] = f * q->y[j];
+    q->z[j] = f * q->z[j];
+  }
+}
+static NPY_INLINE _QUATERNION_SIMD_TARGET void
+_QUATERNION_SIMD_NAME(_qs_log_block)(_quaternion_simd_block* q, int64_t* bad, const int fast)
+{
+  int j;
+  double b[_QS_BLOCK], norm[_QS_BLOCK];
+  for(j=0; j<_QS_BLOCK; ++j) {
+    const int64_t ok = !bad[j]
+      && _qsm_abs_less(q->w[j], 1.0e150) && _qsm_abs_less(q->x[j], 1.0e150)
+      && _qsm_abs_less(q->y[j], 1.0e150) && _qsm_abs_less(q->z[j], 1.0e150);
+    bad[j] = !ok;
+    q->w[j] = ok ? q->w[j] : _QS_UNIT;
+    q->x[j] = ok ? q->x[j] : _QS_UNIT;
+    q->y[j] = ok ? q->y[j] : _QS_UNIT;
+    q->z[j] = ok ? q->z[j] : _QS_UNIT;
+  }
+  for(j=0; j<_QS_BLOCK; ++j) {
+    b[j] = sqrt(q->x[j]*q->x[j] + q->y[j]*q->y[j] + q->z[j]*q->z[j]);
+  }
+  for(j=0; j<_QS_BLOCK; ++j) {
+    // Quaternions that are (nearly) real, or too small, take a special branch
+    const int64_t ok = !bad[j] && b[j] > _QUATERNION_EPS*fabs(q->w[j]);
+    norm[j] = q->w[j]*q->w[j] + b[j]*b[j];
+    bad[j] = !(ok && norm[j] >= DBL_MIN);
+    q->w[j] = bad[j] ? _QS_UNIT : q->w[j];
+    q->x[j] = bad[j] ? _QS_UNIT : q->x[j];
+    q->y[j] = bad[j] ? _QS_UNIT : q->y[j];
+    q->z[j] = bad[j] ? _QS_UNIT : q->z[j];
+    b[j] = bad[j] ? 0.8660254037844386 : b[j];
+    norm[j] = bad[j] ? 1.0 : norm[j];
+  }
+  if(fast) {
+    _QUATERNION_SIMD_NAME(_qs_log_lanes)(q, b, norm, 1);
+  } else {
+    _QUATERNION_SIMD_NAME(_qs_log_lanes)(q, b, norm, 0);
+  }
+}
+
+// Replace a block's lanes with the lanes raised to the powers `s`
+static NPY_INLINE _QUATERNION_SIMD_TARGET void
+_QUATERNION_SIMD_NAME(_qs_power_scalar_block)(_quaternion_simd_block* q, const double* s, int64_t* bad, const int fast)
+{
+  int j;
+  _QUATERNION_SIMD_NAME(_qs_log_block)(q, bad, fast);
+  for(j=0; j<_QS_BLOCK; ++j) {
+    const int64_t ok = !bad[j] && _qsm_abs_less(s[j], 1.0e150);
+    const double sj = ok ? s[j] : 1.0;
+    bad[j] = !ok;
+    q->w[j] *= sj;
+    q->x[j] *= sj;
+    q->y[j] *= sj;
+    q->z[j] *= sj;
+  }
+  _QUATERNION_SIMD_NAME(_qs_exp_block)(q, bad, fast);
+}
+
+// Replace the block `q1` with slerp(q1, q2, tau); `q2` is overwritten
+static NPY_INLINE _QUATERNION_SIMD_TARGET void
+_QUATERNION_SIMD_NAME(_qs_slerp_block)(_quaternion_simd_block* q1, _quaternion_simd_block* q2,
+                                       const double* tau, int64_t* bad, const int fast)
+{
+  int j;
+  double d[_QS_BLOCK];
+  for(j=0; j<_QS_BLOCK; ++j) {
+    const int64_t ok = !bad[j]
+      && _qsm_abs_less(q1->w[j], 1.0e150) && _qsm_abs_less(q1->x[j], 1.0e150)
+      && _qsm_abs_less(q1->y[j], 1.0e150) && _qsm_abs_less(q1->z[j], 1.0e150)
+      && _qsm_abs_less(q2->w[j], 1.0e150) && _qsm_abs_less(q2->x[j], 1.0e150)
+      && _qsm_abs_less(q2->y[j], 1.0e150) && _qsm_abs_less(q2->z[j], 1.0e150)
+      && _qsm_abs_less(tau[j], 1.0e150)
+      && (q1->w[j]*q1->w[j] + q1->x[j]*q1->x[j] + q1->y[j]*q1->y[j] + q1->z[j]*q1->z[j]) >= DBL_MIN;
+    bad[j] = !ok;
+    q1->w[j] = ok ? q1->w[j] : _QS_UNIT;
+    q1->x[j] = ok ? q1->x[j] : _QS_UNIT;
+    q1->y[j] = ok ? q1->y[j] : _QS_UNIT;
+    q1->z[j] = ok ? q1->z[j] : _QS_UNIT;
+    q2->w[j] = ok ? q2->w[j] : _QS_UNIT;
+    q2->x[j] = ok ? q2->x[j] : _QS_UNIT;
+    q2->y[j] = ok ? q2->y[j] : _QS_UNIT;
+    q2->z[j] = ok ? q2->z[j] : _QS_UNIT;
+  }
+  for(j=0; j<_QS_BLOCK; ++j) {
+    const double dw = q1->w[j]-q2->w[j], dx = q1->x[j]-q2->x[j], dy = q1->y[j]-q2->y[j], dz = q1->z[j]-q2->z[j];
+    d[j] = sqrt(dw*dw + dx*dx + dy*dy + dz*dz);
+  }
+  for(j=0; j<_QS_BLOCK; ++j) {
+    // Replace q2 with (+/-q2)/q1, choosing the sign as in `slerp`
+    const double sign = (d[j] <= 1.414213562373096) ? 1.0 : -1.0;
+    const double aw = sign*q2->w[j], ax = sign*q2->x[j], ay = sign*q2->y[j], az = sign*q2->z[j];
+    const double bw = q1->w[j], bx = q1->x[j], by = q1->y[j], bz = q1->z[j];
+    const double bnorm = bw*bw + bx*bx + by*by + bz*bz;
+    q2->w[j] = (  aw*bw + ax*bx + ay*by + az*bz) / bnorm;
+    q2->x[j] = (- aw*bx + ax*bw - ay*bz + az*by) / bnorm;
+    q2->y[j] = (- aw*by + ax*bz + ay*bw - az*bx) / bnorm;
+    q2->z[j] = (- aw*bz - ax*by + ay*bx + az*bw) / bnorm;
+  }
+  _QUATERNION_SIMD_NAME(_qs_power_scalar_block)(q2, tau, bad, fast);
+  for(j=0; j<_QS_BLOCK; ++j) {
+    // Multiply q1 on the left by the power
+    const double aw = q2->w[j], ax = q2->x[j], ay = q2->y[j], az = q2->z[j];
+    const double bw = q1->w[j], bx = q1->x[j], by = q1->y[j], bz = q1->z[j];
+    q1->w[j] = aw*bw - ax*bx - ay*by - az*bz;
+    q1->x[j] = aw*bx + ax*bw + ay*bz - az*by;
+    q1->y[j] = aw*by - ax*bz + ay*bw + az*bx;
+    q1->z[j] = aw*bz + ax*by - ay*bx + az*bw;
+  }
+}
+
+// Replace the block `q1` with slerp_unit(q1, q2, tau); `q2` is overwritten
+_QSM_INLINE _QUATERNION_SIMD_TARGET void
+_QUATERNION_SIMD_NAME(_qs_slerp_unit_lanes)(_quaternion_simd_block* q1, const _quaternion_simd_block* q2,
+                                            const double* tau, const double* dm, const double* dp, const int fast)
+{
+  int j;
+  for(j=0; j<_QS_BLOCK; ++j) {
+    // Choose the sign of q2 as in `slerp`, and find the angle from the chordal distances
+    const int flip = !(dm[j] <= 1.414213562373096);
+    const double d = flip ? dp[j] : dm[j];
+    const double s = flip ? dm[j] : dp[j];
+    const double sign = flip ? -1.0 : 1.0;
+    const int zero = !(d > 0.0);
+    const double theta = zero ? 0.0 : 2*_qsm_atan2(zero ? 1.0 : d, s, fast);
+    const double sin_theta = zero ? 1.0 : _qsm_sin(theta, fast);
+    const double w1 = zero ? 1.0 - tau[j] : _qsm_sin((1.0-tau[j])*theta, fast) / sin_theta;
+    const double w2 = sign * (zero ? tau[j] : _qsm_sin(tau[j]*theta, fast) / sin_theta);
+    q1->w[j] = w1*q1->w[j] + w2*q2->w[j];
+    q1->x[j] = w1*q1->x[j] + w2*q2->x[j];
+    q1->y[j] = w1*q1->y[j] + w2*q2->y[j];
+    q1->z[j] = w1*q1->z[j] + w2*q2->z[j];
+  }
+}
+static NPY_INLINE _QUATERNION_SIMD_TARGET void
+_QUATERNION_SIMD_NAME(_qs_slerp_unit_block)(_quaternion_simd_block* q1, _quaternion_simd_block* q2,
+                                            double* tau, int64_t* bad, const int fast)
+{
+  int j;
+  double dm[_QS_BLOCK], dp[_QS_BLOCK];
+  for(j=0; j<_QS_BLOCK; ++j) {
+    const int64_t ok = !bad[j]
+      && _qsm_abs_less(q1->w[j], 1.0e150) && _qsm_abs_less(q1->x[j], 1.0e150)
+      && _qsm_abs_less(q1->y[j], 1.0e150) && _qsm_abs_less(q1->z[j], 1.0e150)
+      && _qsm_abs_less(q2->w[j], 1.0e150) && _qsm_abs_less(q2->x[j], 1.0e150)
+      && _qsm_abs_less(q2->y[j], 1.0e150) && _qsm_abs_less(q2->z[j], 1.0e150)
+      && _qsm_abs_less(tau[j], 1.0e4);
+    bad[j] = !ok;
+    q1->w[j] = ok ? q1->w[j] : _QS_UNIT;
+    q1->x[j] = ok ? q1->x[j] : _QS_UNIT;
+    q1->y[j] = ok ? q1->y[j] : _QS_UNIT;
+    q1->z[j] = ok ? q1->z[j] : _QS_UNIT;
+    q2->w[j] = ok ? q2->w[j] : _QS_UNIT;
+    q2->x[j] = ok ? q2->x[j] : _QS_UNIT;
+    q2->y[j] = ok ? q2->y[j] : _QS_UNIT;
+    q2->z[j] = ok ? q2->z[j] : _QS_UNIT;
+    tau[j] = ok ? tau[j] : _QS_UNIT;
+  }
+  for(j=0; j<_QS_BLOCK; ++j) {
+    const double dw = q1->w[j]-q2->w[j], dx = q1->x[j]-q2->x[j], dy = q1->y[j]-q2->y[j], dz = q1->z[j]-q2->z[j];
+    dm[j] = sqrt(dw*dw + dx*dx + dy*dy + dz*dz);
+  }
+  for(j=0; j<_QS_BLOCK; ++j) {
+    const double sw = q1->w[j]+q2->w[j], sx = q1->x[j]+q2->x[j], sy = q1->y[j]+q2->y[j], sz = q1->z[j]+q2->z[j];
+    dp[j] = sqrt(sw*sw + sx*sx + sy*sy + sz*sz);
+  }
+  if(fast) {
+    _QUATERNION_SIMD_NAME(_qs_slerp_unit_lanes)(q1, q2, tau, dm, dp, 1);
+  } else {
+    _QUATERNION_SIMD_NAME(_qs_slerp_unit_lanes)(q1, q2, tau, dm, dp, 0);
+  }
+}
+
+// Store the weights of q1 and q2 in the w and x lanes of `b`
+_QSM_INLINE _QUATERNION_SIMD_TARGET void
+_QUATERNION_SIMD_NAME(_qs_slerp_unit_weights)(const double* tau, const double theta, const double inv_sin_theta,
+                                              const double sign, _quaternion_simd_block* b, const int fast)
+{
+  int j;
+  for(j=0; j<_QS_BLOCK; ++j) {
+    b->w[j] = _qsm_sin((1.0-tau[j])*theta, fast) * inv_sin_theta;
+    b->x[j] = sign * _qsm_sin(tau[j]*theta, fast) * inv_sin_theta;
+  }
+}
+
+// Store the first `m` lanes of a block, or the result of the scalar
+// function for lanes that are bad
+#define _QS_SCATTER(FALLBACK)                                           \
+  for(j=0; j<m; ++j) {                                                  \
+    quaternion* out = (quaternion*)(r + (i+j)*r_step);                  \
+    if(bad[j]) {                                                        \
+      *out = FALLBACK;                                                  \
+    } else {                                                            \
+      out->w = b.w[j];                                                  \
+      out->x = b.x[j];                                                  \
+      out->y = b.y[j];                                                  \
+      out->z = b.z[j];                                                  \
+    }                                                                   \
+  }
+#define _QS_Q(p, step) (*(const quaternion*)((p) + (i+j)*(step)))
+#define _QS_D(p, step) (*(const double*)((p) + (i+j)*(step)))
+
+static _QUATERNION_SIMD_TARGET void
+_QUATERNION_SIMD_NAME(quaternion_exp_batch)(const char* q, ptrdiff_t q_step, char* r, ptrdiff_t r_step,
+                                            ptrdiff_t n, const int fast)
+{
+  ptrdiff_t i, j;
+  for(i=0; i<n; i+=_QS_BLOCK) {
+    const ptrdiff_t m = (n-i < _QS_BLOCK) ? n-i : _QS_BLOCK;
+    _quaternion_simd_block b;
+    int64_t bad[_QS_BLOCK] = {0};
+    _QUATERNION_SIMD_NAME(_qs_gather)(q + i*q_step, q_step, m, &b);
+    _QUATERNION_SIMD_NAME(_qs_exp_block)(&b, bad, fast);
+    _QS_SCATTER(quaternion_exp(_QS_Q(q, q_step)))
+  }
+}
+
+static _QUATERNION_SIMD_TARGET void
+_QUATERNION_SIMD_NAME(quaternion_log_batch)(const char* q, ptrdiff_t q_step, char* r, ptrdiff_t r_step,
+                                            ptrdiff_t n, const int fast)
+{
+  ptrdiff_t i, j;
+  for(i=0; i<n; i+=_QS_BLOCK) {
+    const ptrdiff_t m = (n-i < _QS_BLOCK) ? n-i : _QS_BLOCK;
+    _quaternion_simd_block b;
+    int64_t bad[_QS_BLOCK] = {0};
+    _QUATERNION_SIMD_NAME(_qs_gather)(q + i*q_step, q_step, m, &b);
+    _QUATERNION_SIMD_NAME(_qs_log_block)(&b, bad, fast);
+    _QS_SCATTER(quaternion_log(_QS_Q(q, q_step)))
+  }
+}
+
+static _QUATERNION_SIMD_TARGET void
+_QUATERNION_SIMD_NAME(quaternion_power_scalar_batch)(const char* q, ptrdiff_t q_step, const char* s, ptrdiff_t s_step,
+                                                     char* r, ptrdiff_t r_step, ptrdiff_t n, const int fast)
+{
+  ptrdiff_t i, j;
+  for(i=0; i<n; i+=_QS_BLOCK) {
+    const ptrdiff_t m = (n-i < _QS_BLOCK) ? n-i : _QS_BLOCK;
+    _quaternion_simd_block b;
+    double sb[_QS_BLOCK];
+    int64_t bad[_QS_BLOCK] = {0};
+    _QUATERNION_SIMD_NAME(_qs_gather)(q + i*q_step, q_step, m, &b);
+    _QUATERNION_SIMD_NAME(_qs_gather_double)(s + i*s_step, s_step, m, sb);
+    _QUATERNION_SIMD_NAME(_qs_power_scalar_block)(&b, sb, bad, fast);
+    _QS_SCATTER(quaternion_power_scalar(_QS_Q(q, q_step), _QS_D(s, s_step)))
+  }
+}
+
+static _QUATERNION_SIMD_TARGET void
+_QUATERNION_SIMD_NAME(quaternion_power_batch)(const char* q, ptrdiff_t q_step, const char* p, ptrdiff_t p_step,
+                                              char* r, ptrdiff_t r_step, ptrdiff_t n, const int fast)
+{
+  ptrdiff_t i, j;
+  for(i=0; i<n; i+=_QS_BLOCK) {
+    const ptrdiff_t m = (n-i < _QS_BLOCK) ? n-i : _QS_BLOCK;
+    _quaternion_simd_block b, c;
+    int64_t bad[_QS_BLOCK] = {0};
+    _QUATERNION_SIMD_NAME(_qs_gather)(q + i*q_step, q_step, m, &b);
+    _QUATERNION_SIMD_NAME(_qs_gather)(p + i*p_step, p_step, m, &c);
+    _QUATERNION_SIMD_NAME(_qs_log_block)(&b, bad, fast);
+    for(j=0; j<_QS_BLOCK; ++j) {
+      // Multiply log(q) (on the right) by p
+      const int64_t ok = !bad[j]
+        && _qsm_abs_less(c.w[j], 1.0e150) && _qsm_abs_less(c.x[j], 1.0e150)
+        && _qsm_abs_less(c.y[j], 1.0e150) && _qsm_abs_less(c.z[j], 1.0e150);
+      const double aw = b.w[j], ax = b.x[j], ay = b.y[j], az = b.z[j];
+      const double bw = ok ? c.w[j] : 1.0, bx = ok ? c.x[j] : 0.0, by = ok ? c.y[j] : 0.0, bz = ok ? c.z[j] : 0.0;
+      bad[j] = !ok;
+      b.w[j] = aw*bw - ax*bx - ay*by - az*bz;
+      b.x[j] = aw*bx + ax*bw + ay*bz - az*by;
+      b.y[j] = aw*by - ax*bz + ay*bw + az*bx;
+      b.z[j] = aw*bz + ax*by - ay*bx + az*bw;
+    }
+    _QUATERNION_SIMD_NAME(_qs_exp_block)(&b, bad, fast);
+    _QS_SCATTER(quaternion_power(_QS_Q(q, q_step), _QS_Q(p, p_step)))
+  }
+}
+
+static _QUATERNION_SIMD_TARGET void
+_QUATERNION_SIMD_NAME(quaternion_slerp_batch)(const char* q1, ptrdiff_t q1_step, const char* q2, ptrdiff_t q2_step,
+                                              const char* tau, ptrdiff_t tau_step, char* r, ptrdiff_t r_step,
+                                              ptrdiff_t n, const int fast)
+{
+  ptrdiff_t i, j;
+  for(i=0; i<n; i+=_QS_BLOCK) {
+    const ptrdiff_t m = (n-i < _QS_BLOCK) ? n-i : _QS_BLOCK;
+    _quaternion_simd_block b, c;
+    double t[_QS_BLOCK];
+    int64_t bad[_QS_BLOCK] = {0};
+    _QUATERNION_SIMD_NAME(_qs_gather)(q1 + i*q1_step, q1_step, m, &b);
+    _QUATERNION_SIMD_NAME(_qs_gather)(q2 + i*q2_step, q2_step, m, &c);
+    _QUATERNION_SIMD_NAME(_qs_gather_double)(tau + i*tau_step, tau_step, m, t);
+    _QUATERNION_SIMD_NAME(_qs_slerp_block)(&b, &c, t, bad, fast);
+    _QS_SCATTER(slerp(_QS_Q(q1, q1_step), _QS_Q(q2, q2_step), _QS_D(tau, tau_step)))
+  }
+}
+
+static _QUATERNION_SIMD_TARGET void
+_QUATERNION_SIMD_NAME(quaternion_slerp_unit_batch)(const char* q1, ptrdiff_t q1_step, const char* q2, ptrdiff_t q2_step,
+                                                   const char* tau, ptrdiff_t tau_step, char* r, ptrdiff_t r_step,
+                                                   ptrdiff_t n, const int fast)
+{
+  ptrdiff_t i, j;
+  for(i=0; i<n; i+=_QS_BLOCK) {
+    const ptrdiff_t m = (n-i < _QS_BLOCK) ? n-i : _QS_BLOCK;
+    _quaternion_simd_block b, c;
+    double t[_QS_BLOCK];
+    int64_t bad[_QS_BLOCK] = {0};
+    _QUATERNION_SIMD_NAME(_qs_gather)(q1 + i*q1_step, q1_step, m, &b);
+    _QUATERNION_SIMD_NAME(_qs_gather)(q2 + i*q2_step, q2_step, m, &c);
+    _QUATERNION_SIMD_NAME(_qs_gather_double)(tau + i*tau_step, tau_step, m, t);
+    _QUATERNION_SIMD_NAME(_qs_slerp_unit_block)(&b, &c, t, bad, fast);
+    _QS_SCATTER(slerp_unit(_QS_Q(q1, q1_step), _QS_Q(q2, q2_step), _QS_D(tau, tau_step)))
+  }
+}
+
+// The same, for a single pair of rotors and many values of tau, so that
+// the angle between the rotors is only found once
+static _QUATERNION_SIMD_TARGET void
+_QUATERNION_SIMD_NAME(quaternion_slerp_unit_segment_batch)(const char* q1p, const char* q2p,
+                                                           const char* tau, ptrdiff_t tau_step,
+                                                           char* r, ptrdiff_t r_step, ptrdiff_t n, const int fast)
+{
+  const quaternion q1 = *(const quaternion*)q1p, q2 = *(const quaternion*)q2p;
+  double d, s, sign = 1.0, theta = 0.0, inv_sin_theta = 1.0;
+  int zero;
+  ptrdiff_t i, j;
+  if(!(_qsm_abs_less(q1.w, 1.0e150) && _qsm_abs_less(q1.x, 1.0e150)
+       && _qsm_abs_less(q1.y, 1.0e150) && _qsm_abs_less(q1.z, 1.0e150)
+       && _qsm_abs_less(q2.w, 1.0e150) && _qsm_abs_less(q2.x, 1.0e150)
+       && _qsm_abs_less(q2.y, 1.0e150) && _qsm_abs_less(q2.z, 1.0e150))) {
+    for(i=0; i<n; ++i) {
+      *(quaternion*)(r + i*r_step) = slerp_unit(q1, q2, *(const double*)(tau + i*tau_step));
+    }
+    return;
+  }
+  d = quaternion_rotor_chordal_distance(q1, q2);
+  s = quaternion_absolute(quaternion_add(q1, q2));
+  if(!(d <= 1.414213562373096)) {
+    const double tmp = d; d = s; s = tmp;
+    sign = -1.0;
+  }
+  zero = !(d > 0.0);
+  if(!zero) {
+    theta = 2*atan2(d, s);
+    inv_sin_theta = 1.0 / sin(theta);
+  }
+  for(i=0; i<n; i+=_QS_BLOCK) {
+    const ptrdiff_t m = (n-i < _QS_BLOCK) ? n-i : _QS_BLOCK;
+    _quaternion_simd_block b;
+    double t[_QS_BLOCK];
+    int64_t bad[_QS_BLOCK] = {0};
+    _QUATERNION_SIMD_NAME(_qs_gather_double)(tau + i*tau_step, tau_step, m, t);
+    for(j=0; j<_QS_BLOCK; ++j) {
+      bad[j] = !_qsm_abs_less(t[j], 1.0e4);
+      t[j] = bad[j] ? _QS_UNIT : t[j];
+    }
+    if(zero) {
+      for(j=0; j<_QS_BLOCK; ++j) {
+        b.w[j] = 1.0 - t[j];
+        b.x[j] = sign * t[j];
+      }
+    } else if(fast) {
+      _QUATERNION_SIMD_NAME(_qs_slerp_unit_weights)(t, theta, inv_sin_theta, sign, &b, 1);
+    } else {
+      _QUATERNION_SIMD_NAME(_qs_slerp_unit_weights)(t, theta, inv_sin_theta, sign, &b, 0);
+    }
+    for(j=0; j<_QS_BLOCK; ++j) {
+      const double w1 = b.w[j], w2 = b.x[j];
+      b.w[j] = w1*q1.w + w2*q2.w;
+      b.x[j] = w1*q1.x + w2*q2.x;
+      b.y[j] = w1*q1.y + w2*q2.y;
+      b.z[j] = w1*q1.z + w2*q2.z;
+    }
+    _QS_SCATTER(slerp_unit(q1, q2, _QS_D(tau, tau_step)))
+  }
+}
+
+static _QUATERNION_SIMD_TARGET void
+_QUATERNION_SIMD_NAME(quaternion_squad_batch)(const char* tau, ptrdiff_t tau_step,
+                                              const char* q_i, ptrdiff_t q_i_step, const char* a_i, ptrdiff_t a_i_step,
+                                              const char* b_ip1, ptrdiff_t b_ip1_step, const char* q_ip1, ptrdiff_t q_ip1_step,
+                                              char* r, ptrdiff_t r_step, ptrdiff_t n, const int fast)
+{
+  ptrdiff_t i, j;
+  for(i=0; i<n; i+=_QS_BLOCK) {
+    const ptrdiff_t m = (n-i < _QS_BLOCK) ? n-i : _QS_BLOCK;
+    _quaternion_simd_block b, c, a;
+    double t[_QS_BLOCK], t2[_QS_BLOCK];
+    int64_t bad[_QS_BLOCK] = {0}, bad_a[_QS_BLOCK] = {0};
+    _QUATERNION_SIMD_NAME(_qs_gather_double)(tau + i*tau_step, tau_step, m, t);
+    _QUATERNION_SIMD_NAME(_qs_gather)(q_i + i*q_i_step, q_i_step, m, &b);
+    _QUATERNION_SIMD_NAME(_qs_gather)(q_ip1 + i*q_ip1_step, q_ip1_step, m, &c);
+    _QUATERNION_SIMD_NAME(_qs_slerp_block)(&b, &c, t, bad, fast);
+    _QUATERNION_SIMD_NAME(_qs_gather)(a_i + i*a_i_step, a_i_step, m, &a);
+    _QUATERNION_SIMD_NAME(_qs_gather)(b_ip1 + i*b_ip1_step, b_ip1_step, m, &c);
+    _QUATERNION_SIMD_NAME(_qs_slerp_block)(&a, &c, t, bad_a, fast);
+    for(j=0; j<_QS_BLOCK; ++j) {
+      bad[j] = bad[j] || bad_a[j];
+      t2[j] = 2*t[j]*(1-t[j]);
+    }
+    _QUATERNION_SIMD_NAME(_qs_slerp_block)(&b, &a, t2, bad, fast);
+    _QS_SCATTER(squad_evaluate(_QS_D(tau, tau_step), _QS_Q(q_i, q_i_step), _QS_Q(a_i, a_i_step),
+                               _QS_Q(b_ip1, b_ip1_step), _QS_Q(q_ip1, q_ip1_step)))
+  }
+}
+
+// Euler angles in the sequence of axes `(i, j, k)`, numbered as in
+// `quaternion_create_from_euler_angles_sequence`, with a common step
+// for the angles and a separate step between the components of each
+// quaternion.  A NULL `gamma` is taken as zero.  The sines and cosines
+// are found on the lanes; the products, which depend on the axes, are
+// formed element by element.
+_QSM_INLINE _QUATERNION_SIMD_TARGET void
+_QUATERNION_SIMD_NAME(_qs_half_sincos_lanes)(const double* angle, double* s, double* c, const int fast)
+{
+  int j;
+  for(j=0; j<_QS_BLOCK; ++j) {
+    const double h = 0.5 * angle[j];
+    double sj, cj;
+    _qsm_sincos(fabs(h), &sj, &cj, fast);
+    s[j] = _qsm_double(_qsm_bits(sj) ^ (_qsm_bits(h) & 0x8000000000000000ULL));
+    c[j] = cj;
+  }
+}
+
+static _QUATERNION_SIMD_TARGET void
+_QUATERNION_SIMD_NAME(quaternion_from_euler_angles_batch)(const char* alpha, const char* beta, const char* gamma,
+                                                          ptrdiff_t angle_step, char* r, ptrdiff_t r_step,
+                                                          ptrdiff_t r_component_step, ptrdiff_t n,
+                                                          int i_axis, int j_axis, int k_axis, const int fast)
+{
+  ptrdiff_t i, j;
+  for(i=0; i<n; i+=_QS_BLOCK) {
+    const ptrdiff_t m = (n-i < _QS_BLOCK) ? n-i : _QS_BLOCK;
+    double angle[3][_QS_BLOCK], s[3][_QS_BLOCK], c[3][_QS_BLOCK];
+    int64_t bad[_QS_BLOCK];
+    int a;
+    _QUATERNION_SIMD_NAME(_qs_gather_double)(alpha + i*angle_step, angle_step, m, angle[0]);
+    _QUATERNION_SIMD_NAME(_qs_gather_double)(beta + i*angle_step, angle_step, m, angle[1]);
+    if(gamma) {
+      _QUATERNION_SIMD_NAME(_qs_gather_double)(gamma + i*angle_step, angle_step, m, angle[2]);
+    } else {
+      for(j=0; j<_QS_BLOCK; ++j) {
+        angle[2][j] = 0.0;
+      }
+    }
+    for(j=0; j<_QS_BLOCK; ++j) {
+      const int64_t ok = _qsm_abs_less(angle[0][j], 2*_QSM_SINCOS_MAX)
+        && _qsm_abs_less(angle[1][j], 2*_QSM_SINCOS_MAX) && _qsm_abs_less(angle[2][j], 2*_QSM_SINCOS_MAX);
+      bad[j] = !ok;
+      angle[0][j] = ok ? angle[0][j] : 0.0;
+      angle[1][j] = ok ? angle[1][j] : 0.0;
+      angle[2][j] = ok ? angle[2][j] : 0.0;
+    }
+    for(a=0; a<3; ++a) {
+      if(fast) {
+        _QUATERNION_SIMD_NAME(_qs_half_sincos_lanes)(angle[a], s[a], c[a], 1);
+      } else {
+        _QUATERNION_SIMD_NAME(_qs_half_sincos_lanes)(angle[a], s[a], c[a], 0);
+      }
+    }
+    for(j=0; j<m; ++j) {
+      char* out = r + (i+j)*r_step;
+      quaternion q;
+      if(bad[j]) {
+        q = quaternion_create_from_euler_angles_sequence(i_axis, j_axis, k_axis, _QS_D(alpha, angle_step),
+                                                         _QS_D(beta, angle_step),
+                                                         gamma ? _QS_D(gamma, angle_step) : 0.0);
+      } else {
+        quaternion qa = {c[0][j], 0, 0, 0}, qb = {c[1][j], 0, 0, 0}, qc = {c[2][j], 0, 0, 0};
+        (&qa.w)[i_axis] = s[0][j];
+        (&qb.w)[j_axis] = s[1][j];
+        (&qc.w)[k_axis] = s[2][j];
+        q = quaternion_multiply(quaternion_multiply(qa, qb), qc);
+      }
+      *(double*)(out) = q.w;
+      *(double*)(out + r_component_step) = q.x;
+      *(double*)(out + 2*r_component_step) = q.y;
+      *(double*)(out + 3*r_component_step) = q.z;
+    }
+  }
+}
+
+// The inverse, by the method of `quaternion_as_euler_angles_sequence`.
+// Each of the three angles is an atan2 of a pair of numbers; lanes where
+// either pair is zero (the gimbal-lock cases) or too large to square are
+// left to the scalar function.
+_QSM_INLINE _QUATERNION_SIMD_TARGET void
+_QUATERNION_SIMD_NAME(_qs_euler_angles_lanes)(double (*abcd)[_QS_BLOCK], const double* r_ab, const double* r_cd,
+                                              double (*angle)[_QS_BLOCK], const int fast)
+{
+  int j;
+  for(j=0; j<_QS_BLOCK; ++j) {
+    const double a = abcd[0][j], b = abcd[1][j], c = abcd[2][j], d = abcd[3][j];
+    const uint64_t sign_b = _qsm_bits(b) & 0x8000000000000000ULL, sign_d = _qsm_bits(d) & 0x8000000000000000ULL;
+    const double half_sum = _qsm_double(_qsm_bits(_qsm_atan2(fabs(b), a, fast)) ^ sign_b);
+    const double half_difference = _qsm_double(_qsm_bits(_qsm_atan2(fabs(d), c, fast)) ^ sign_d);
+    angle[1][j] = 2 * _qsm_atan2(r_cd[j], r_ab[j], fast);
+    angle[0][j] = half_sum + half_difference;
+    angle[2][j] = half_sum - half_difference;
+  }
+}
+
+static _QUATERNION_SIMD_TARGET void
+_QUATERNION_SIMD_NAME(quaternion_as_euler_angles_batch)(const char* q, ptrdiff_t q_step, ptrdiff_t q_component_step,
+                                                        char* alpha, char* beta, char* gamma, ptrdiff_t angle_step,
+                                                        ptrdiff_t n, int i_axis, int j_axis, int k_axis, const int fast)
+{
+  const int proper = (i_axis == k_axis);
+  const int third = proper ? 6 - i_axis - j_axis : i_axis;
+  const int sign = (k_axis - j_axis) * (j_axis - third) * (third - k_axis) / 2;
+  ptrdiff_t i, j;
+  for(i=0; i<n; i+=_QS_BLOCK) {
+    const ptrdiff_t m = (n-i < _QS_BLOCK) ? n-i : _QS_BLOCK;
+    double abcd[4][_QS_BLOCK], r_ab[_QS_BLOCK], r_cd[_QS_BLOCK], angle[3][_QS_BLOCK];
+    int64_t bad[_QS_BLOCK];
+    for(j=0; j<m; ++j) {
+      const char* e = q + (i+j)*q_step;
+      const double p0 = *(const double*)(e), pj = *(const double*)(e + j_axis*q_component_step);
+      const double pk = *(const double*)(e + k_axis*q_component_step);
+      const double pt = *(const double*)(e + third*q_component_step) * sign;
+      abcd[0][j] = proper ? p0 : p0 - pj;
+      abcd[1][j] = proper ? pk : pk + pt;
+      abcd[2][j] = proper ? pj : pj + p0;
+      abcd[3][j] = proper ? pt : pt - pk;
+    }
+    for(; j<_QS_BLOCK; ++j) {
+      abcd[0][j] = abcd[1][j] = abcd[2][j] = abcd[3][j] = _QS_UNIT;
+    }
+    for(j=0; j<_QS_BLOCK; ++j) {
+      const double a = abcd[0][j], b = abcd[1][j], c = abcd[2][j], d = abcd[3][j];
+      const int64_t ok = _qsm_abs_less(a, 1.0e150) && _qsm_abs_less(b, 1.0e150)
+        && _qsm_abs_less(c, 1.0e150) && _qsm_abs_less(d, 1.0e150)
+        && (a*a + b*b > 0.0) && (c*c + d*d > 0.0);
+      bad[j] = !ok;
+      abcd[0][j] = ok ? a : _QS_UNIT;
+      abcd[1][j] = ok ? b : _QS_UNIT;
+      abcd[2][j] = ok ? c : _QS_UNIT;
+      abcd[3][j] = ok ? d : _QS_UNIT;
+    }
+    for(j=0; j<_QS_BLOCK; ++j) {
+      r_ab[j] = sqrt(abcd[0][j]*abcd[0][j] + abcd[1][j]*abcd[1][j]);
+      r_cd[j] = sqrt(abcd[2][j]*abcd[2][j] + abcd[3][j]*abcd[3][j]);
+    }
+    if(fast) {
+      _QUATERNION_SIMD_NAME(_qs_euler_angles_lanes)(abcd, r_ab, r_cd, angle, 1);
+    } else {
+      _QUATERNION_SIMD_NAME(_qs_euler_angles_lanes)(abcd, r_ab, r_cd, angle, 0);
+    }
+    for(j=0; j<m; ++j) {
+      double angles[3];
+      if(bad[j]) {
+        const char* e = q + (i+j)*q_step;
+        const quaternion qj = {*(const double*)(e), *(const double*)(e + q_component_step),
+                               *(const double*)(e + 2*q_component_step), *(const double*)(e + 3*q_component_step)};
+        quaternion_as_euler_angles_sequence(qj, i_axis, j_axis, k_axis, angles);
+      } else {
+        angles[0] = angle[0][j];
+        angles[1] = angle[1][j];
+        angles[2] = angle[2][j];
+        if(!proper) {
+          angles[0] *= sign;
+          angles[1] -= M_PI / 2;
+        }
+      }
+      *(double*)(alpha + (i+j)*angle_step) = angles[0];
+      *(double*)(beta + (i+j)*angle_step) = angles[1];
+      if(gamma) {
+        *(double*)(gamma + (i+j)*angle_step) = angles[2];
+      }
+    }
+  }
+}
+
+// Rotation vectors, read or written as three doubles separated by a
+// component step, and quaternions likewise with four.  These are the
+// functions `quaternion_create_from_rotation_vector` and
+// `quaternion_as_rotation_vector`, including their small-angle series;
+// the lanes that would need any other branch are left to those.
+_QSM_INLINE _QUATERNION_SIMD_TARGET void
+_QUATERNION_SIMD_NAME(_qs_from_rotation_vector_lanes)(double (*v)[_QS_BLOCK], const double* half_vnorm,
+                                                      _quaternion_simd_block* q, const int fast)
+{
+  int j;
+  for(j=0; j<_QS_BLOCK; ++j) {
+    const double theta = half_vnorm[j];
+    const double theta2 = theta * theta;
+    const int small = theta < 1.0e-3;
+    double s, c;
+    _qsm_sincos(theta, &s, &c, fast);
+    s = small ? 0.5 * (1 - theta2 / 6 * (1 - theta2 / 20)) : s / (2 * (small ? 1.0 : theta));
+    q->w[j] = c;
+    q->x[j] = s * v[0][j];
+    q->y[j] = s * v[1][j];
+    q->z[j] = s * v[2][j];
+  }
+}
+
+static _QUATERNION_SIMD_TARGET void
+_QUATERNION_SIMD_NAME(quaternion_from_rotation_vector_batch)(const char* v, ptrdiff_t v_step, ptrdiff_t v_component_step,
+                                                             char* r, ptrdiff_t r_step, ptrdiff_t r_component_step,
+                                                             ptrdiff_t n, const int fast)
+{
+  ptrdiff_t i, j;
+  for(i=0; i<n; i+=_QS_BLOCK) {
+    const ptrdiff_t m = (n-i < _QS_BLOCK) ? n-i : _QS_BLOCK;
+    _quaternion_simd_block b;
+    double vector[3][_QS_BLOCK], half_vnorm[_QS_BLOCK];
+    int64_t bad[_QS_BLOCK];
+    int a;
+    for(a=0; a<3; ++a) {
+      _QUATERNION_SIMD_NAME(_qs_gather_double)(v + i*v_step + a*v_component_step, v_step, m, vector[a]);
+    }
+    for(j=0; j<_QS_BLOCK; ++j) {
+      const int64_t ok = _qsm_abs_less(vector[0][j], _QSM_SINCOS_MAX)
+        && _qsm_abs_less(vector[1][j], _QSM_SINCOS_MAX) && _qsm_abs_less(vector[2][j], _QSM_SINCOS_MAX);
+      bad[j] = !ok;
+      vector[0][j] = ok ? vector[0][j] : 0.0;
+      vector[1][j] = ok ? vector[1][j] : 0.0;
+      vector[2][j] = ok ? vector[2][j] : 0.0;
+    }
+    for(j=0; j<_QS_BLOCK; ++j) {
+      half_vnorm[j] = 0.5 * sqrt(vector[0][j]*vector[0][j] + vector[1][j]*vector[1][j] + vector[2][j]*vector[2][j]);
+    }
+    if(fast) {
+      _QUATERNION_SIMD_NAME(_qs_from_rotation_vector_lanes)(vector, half_vnorm, &b, 1);
+    } else {
+      _QUATERNION_SIMD_NAME(_qs_from_rotation_vector_lanes)(vector, half_vnorm, &b, 0);
+    }
+    for(j=0; j<m; ++j) {
+      char* out = r + (i+j)*r_step;
+      quaternion q = {b.w[j], b.x[j], b.y[j], b.z[j]};
+      if(bad[j]) {
+        const char* in = v + (i+j)*v_step;
+        const double vj[3] = {*(const double*)(in), *(const double*)(in + v_component_step),
+                              *(const double*)(in + 2*v_component_step)};
+        q = quaternion_create_from_rotation_vector(vj);
+      }
+      *(double*)(out) = q.w;
+      *(double*)(out + r_component_step) = q.x;
+      *(double*)(out + 2*r_component_step) = q.y;
+      *(double*)(out + 3*r_component_step) = q.z;
+    }
+  }
+}
+
+_QSM_INLINE _QUATERNION_SIMD_TARGET void
+_QUATERNION_SIMD_NAME(_qs_as_rotation_vector_lanes)(_quaternion_simd_block* q, const double* vnorm, const int fast)
+{
+  int j;
+  for(j=0; j<_QS_BLOCK; ++j) {
+    const double w = q->w[j], b = vnorm[j];
+    const int small = w > 0 && b < 1.0e-3 * w;
+    const double t = b / (small ? w : 1.0);
+    const double t2 = t * t;
+    const double f = small ? 2 * (1 - t2 * (1.0 / 3.0 - t2 / 5)) / (small ? w : 1.0)
+      : 2 * _qsm_atan2(b, w, fast) / (small ? 1.0 : b);
+    q->x[j] *= f;
+    q->y[j] *= f;
+    q->z[j] *= f;
+  }
+}
+
+static _QUATERNION_SIMD_TARGET void
+_QUATERNION_SIMD_NAME(quaternion_as_rotation_vector_batch)(const char* q, ptrdiff_t q_step, ptrdiff_t q_component_step,
+                                                           char* r, ptrdiff_t r_step, ptrdiff_t r_component_step,
+                                                           ptrdiff_t n, const int fast)
+{
+  ptrdiff_t i, j;
+  for(i=0; i<n; i+=_QS_BLOCK) {
+    const ptrdiff_t m = (n-i < _QS_BLOCK) ? n-i : _QS_BLOCK;
+    _quaternion_simd_block b;
+    double vnorm[_QS_BLOCK];
+    int64_t bad[_QS_BLOCK];
+    for(j=0; j<m; ++j) {
+      const char* in = q + (i+j)*q_step;
+      b.w[j] = *(const double*)(in);
+      b.x[j] = *(const double*)(in + q_component_step);
+      b.y[j] = *(const double*)(in + 2*q_component_step);
+      b.z[j] = *(const double*)(in + 3*q_component_step);
+    }
+    for(; j<_QS_BLOCK; ++j) {
+      b.w[j] = b.x[j] = b.y[j] = b.z[j] = _QS_UNIT;
+    }
+    for(j=0; j<_QS_BLOCK; ++j) {
+      // Besides huge and non-finite components, the scalar function
+      // handles rotations by nearly 2*pi, and zero quaternions
+      const double w = b.w[j];
+      const double b2 = b.x[j]*b.x[j] + b.y[j]*b.y[j] + b.z[j]*b.z[j];
+      const int64_t ok = _qsm_abs_less(w, 1.0e150) && _qsm_abs_less(b.x[j], 1.0e150)
+        && _qsm_abs_less(b.y[j], 1.0e150) && _qsm_abs_less(b.z[j], 1.0e150)
+        && (w > 0 || b2 > _QUATERNION_EPS * _QUATERNION_EPS * w * w);
+      bad[j] = !ok;
+      b.w[j] = ok ? w : _QS_UNIT;
+      b.x[j] = ok ? b.x[j] : _QS_UNIT;
+      b.y[j] = ok ? b.y[j] : _QS_UNIT;
+      b.z[j] = ok ? b.z[j] : _QS_UNIT;
+    }
+    for(j=0; j<_QS_BLOCK; ++j) {
+      vnorm[j] = sqrt(b.x[j]*b.x[j] + b.y[j]*b.y[j] + b.z[j]*b.z[j]);
+    }
+    if(fast) {
+      _QUATERNION_SIMD_NAME(_qs_as_rotation_vector_lanes)(&b, vnorm, 1);
+    } else {
+      _QUATERNION_SIMD_NAME(_qs_as_rotation_vector_lanes)(&b, vnorm, 0);
+    }
+    for(j=0; j<m; ++j) {
+      char* out = r + (i+j)*r_step;
+      double v[3] = {b.x[j], b.y[j], b.z[j]};
+      if(bad[j]) {
+        const char* in = q + (i+j)*q_step;
+        const quaternion qj = {*(const double*)(in), *(const double*)(in + q_component_step),
+                               *(const double*)(in + 2*q_component_step), *(const double*)(in + 3*q_component_step)};
+        quaternion_as_rotation_vector(qj, v);
+      }
+      *(double*)(out) = v[0];
+      *(double*)(out + r_component_step) = v[1];
+      *(double*)(out + 2*r_component_step) = v[2];
+    }
+  }
+}
+
+// Rotors packed into integers of `code_size` (4 or 8) bytes by the
+// "smallest-three" scheme: since q and -q are the same rotation, the
+// sign is chosen to make the largest component positive, in which case
+// it is determined by the other three.  The low two bits of the code
+// hold the index of the largest component, and each group of `bits`
+// above them holds one of the remaining components, in order.  Those
+// components lie in [-1/sqrt(2), 1/sqrt(2)], which is divided into
+// 2^bits-2 equal steps, so that zero is represented exactly and the
+// largest value of each group is unused.  The quaternions need not be
+// normalized, but
+// must be nonzero and finite; any other input gives an unspecified code.
+_QSM_INLINE _QUATERNION_SIMD_TARGET void
+_QUATERNION_SIMD_NAME(_qs_encode_rotors_lanes)(const _quaternion_simd_block* q, const double* inv_absolute,
+                                               uint64_t* code, const int bits)
+{
+  const uint64_t mask = (1 << bits) - 1;
+  const double levels = (double)(mask - 1);
+  const double scale = levels / _QSM_SQRT2;
+  int j;
+  for(j=0; j<_QS_BLOCK; ++j) {
+    const double w = q->w[j], x = q->x[j], y = q->y[j], z = q->z[j];
+    const double aw = fabs(w), ax = fabs(x), ay = fabs(y), az = fabs(z);
+    const int64_t x_largest = ax > aw;
+    const double a_wx = x_largest ? ax : aw, c_wx = x_largest ? x : w;
+    const int64_t z_largest = az > ay;
+    const double a_yz = z_largest ? az : ay, c_yz = z_largest ? z : y;
+    const int64_t yz_largest = a_yz > a_wx;
+    // (Written without branches, which would stop the compiler from
+    // vectorizing this loop)
+    const uint64_t index = x_largest + yz_largest * (2 + z_largest - x_largest);
+    const double largest = yz_largest ? c_yz : c_wx;
+    // Scale by 1/|q|, with the sign of the largest component
+    const double f = _qsm_double(_qsm_bits(inv_absolute[j] * scale) ^ (_qsm_bits(largest) & 0x8000000000000000ULL));
+    // Each component other than the largest now maps into [0, levels],
+    // up to rounding that cannot reach the neighbouring integers
+    const double uw = w * f + 0.5 * levels, ux = x * f + 0.5 * levels;
+    const double uy = y * f + 0.5 * levels, uz = z * f + 0.5 * levels;
+    const double u0 = index == 0 ? ux : uw;
+    const double u1 = index <= 1 ? uy : ux;
+    const double u2 = index <= 2 ? uz : uy;
+    code[j] = index
+      | (((_qsm_bits(u0 + _QSM_ROUND_MAGIC) - _QSM_ROUND_MAGIC_BITS) & mask) << 2)
+      | (((_qsm_bits(u1 + _QSM_ROUND_MAGIC) - _QSM_ROUND_MAGIC_BITS) & mask) << (2 + bits))
+      | (((_qsm_bits(u2 + _QSM_ROUND_MAGIC) - _QSM_ROUND_MAGIC_BITS) & mask) << (2 + 2*bits));
+  }
+}
+
+static _QUATERNION_SIMD_TARGET void
+_QUATERNION_SIMD_NAME(quaternion_encode_rotors_batch)(const char* q, ptrdiff_t q_step, ptrdiff_t q_component_step,
+                                                      char* codes, ptrdiff_t code_step, ptrdiff_t code_size,
+                                                      ptrdiff_t n, int bits)
+{
+  ptrdiff_t i, j;
+  for(i=0; i<n; i+=_QS_BLOCK) {
+    const ptrdiff_t m = (n-i < _QS_BLOCK) ? n-i : _QS_BLOCK;
+    _quaternion_simd_block b;
+    double inv_absolute[_QS_BLOCK];
+    uint64_t code[_QS_BLOCK];
+    for(j=0; j<m; ++j) {
+      const char* in = q + (i+j)*q_step;
+      b.w[j] = *(const double*)(in);
+      b.x[j] = *(const double*)(in + q_component_step);
+      b.y[j] = *(const double*)(in + 2*q_component_step);
+      b.z[j] = *(const double*)(in + 3*q_component_step);
+    }
+    for(; j<_QS_BLOCK; ++j) {
+      b.w[j] = b.x[j] = b.y[j] = b.z[j] = _QS_UNIT;
+    }
+    for(j=0; j<_QS_BLOCK; ++j) {
+      inv_absolute[j] = sqrt(b.w[j]*b.w[j] + b.x[j]*b.x[j] + b.y[j]*b.y[j] + b.z[j]*b.z[j]);
+    }
+    for(j=0; j<_QS_BLOCK; ++j) {
+      inv_absolute[j] = 1 / inv_absolute[j];
+    }
+    _QUATERNION_SIMD_NAME(_qs_encode_rotors_lanes)(&b, inv_absolute, code, bits);
+    if(code_size == 4) {
+      for(j=0; j<m; ++j) {
+        *(uint32_t*)(codes + (i+j)*code_step) = (uint32_t)code[j];
+      }
+    } else {
+      for(j=0; j<m; ++j) {
+        *(uint64_t*)(codes + (i+j)*code_step) = code[j];
+      }
+    }
+  }
+}
+
+_QSM_INLINE _QUATERNION_SIMD_TARGET void
+_QUATERNION_SIMD_NAME(_qs_decode_rotors_lanes)(const uint64_t* code, _quaternion_simd_block* q, double* largest2,
+                                               const int bits)
+{
+  const uint64_t mask = (1 << bits) - 1;
+  const double step = _QSM_SQRT2 / (double)(mask - 1);
+  const double offset = _QSM_ROUND_MAGIC + (double)((mask - 1) / 2);
+  int j;
+  for(j=0; j<_QS_BLOCK; ++j) {
+    const uint64_t c = code[j];
+    const double c0 = (_qsm_double(((c >> 2) & mask) | _QSM_ROUND_MAGIC_BITS) - offset) * step;
+    const double c1 = (_qsm_double(((c >> (2 + bits)) & mask) | _QSM_ROUND_MAGIC_BITS) - offset) * step;
+    const double c2 = (_qsm_double(((c >> (2 + 2*bits)) & mask) | _QSM_ROUND_MAGIC_BITS) - offset) * step;
+    // Temporarily store the three components in the order they were
+    // encoded; `largest2` is the square of the one that was dropped
+    q->x[j] = c0;
+    q->y[j] = c1;
+    q->z[j] = c2;
+    largest2[j] = 1 - (c0*c0 + c1*c1 + c2*c2);
+    largest2[j] = largest2[j] > 0 ? largest2[j] : 0;
+  }
+}
+
+_QSM_INLINE _QUATERNION_SIMD_TARGET void
+_QUATERNION_SIMD_NAME(_qs_place_rotors_lanes)(const uint64_t* code, _quaternion_simd_block* q, const double* largest)
+{
+  int j;
+  for(j=0; j<_QS_BLOCK; ++j) {
+    const uint64_t index = code[j] & 3;
+    const double l = largest[j], c0 = q->x[j], c1 = q->y[j], c2 = q->z[j];
+    q->w[j] = index == 0 ? l : c0;
+    q->x[j] = index == 0 ? c0 : (index == 1 ? l : c1);
+    q->y[j] = index <= 1 ? c1 : (index == 2 ? l : c2);
+    q->z[j] = index == 3 ? l : c2;
+  }
+}
+
+static _QUATERNION_SIMD_TARGET void
+_QUATERNION_SIMD_NAME(quaternion_decode_rotors_batch)(const char* codes, ptrdiff_t code_step, ptrdiff_t code_size,
+                                                      char* r, ptrdiff_t r_step, ptrdiff_t r_component_step,
+                                                      ptrdiff_t n, int bits)
+{
+  ptrdiff_t i, j;
+  for(i=0; i<n; i+=_QS_BLOCK) {
+    const ptrdiff_t m = (n-i < _QS_BLOCK) ? n-i : _QS_BLOCK;
+    _quaternion_simd_block b;
+    double largest[_QS_BLOCK];
+    uint64_t code[_QS_BLOCK];
+    if(code_size == 4) {
+      for(j=0; j<m; ++j) {
+        code[j] = *(const uint32_t*)(codes + (i+j)*code_step);
+      }
+    } else {
+      for(j=0; j<m; ++j) {
+        code[j] = *(const uint64_t*)(codes + (i+j)*code_step);
+      }
+    }
+    for(; j<_QS_BLOCK; ++j) {
+      code[j] = 0;
+    }
+    _QUATERNION_SIMD_NAME(_qs_decode_rotors_lanes)(code, &b, largest, bits);
+    for(j=0; j<_QS_BLOCK; ++j) {
+      largest[j] = sqrt(largest[j]);
+    }
+    _QUATERNION_SIMD_NAME(_qs_place_rotors_lanes)(code, &b, largest);
+    for(j=0; j<m; ++j) {
+      char* out = r + (i+j)*r_step;
+      *(double*)(out) = b.w[j];
+      *(double*)(out + r_component_step) = b.x[j];
+      *(double*)(out + 2*r_component_step) = b.y[j];
+      *(double*)(out + 3*r_component_step) = b.z[j];
+    }
+  }
+}
+
+// Correct a block of increments for coning with the previous ones
+_QSM_INLINE _QUATERNION_SIMD_TARGET void
+_QUATERNION_SIMD_NAME(_qs_coning_lanes)(double* d0, double* d1, double* d2,
+                                        const double* p0, const double* p1, const double* p2)
+{
+  int j;
+  for(j=0; j<_QS_BLOCK; ++j) {
+    const double a0 = d0[j], a1 = d1[j], a2 = d2[j];
+    d0[j] = a0 + (p1[j]*a2 - p2[j]*a1) * (1.0 / 12);
+    d1[j] = a1 + (p2[j]*a0 - p0[j]*a2) * (1.0 / 12);
+    d2[j] = a2 + (p0[j]*a1 - p1[j]*a0) * (1.0 / 12);
+  }
+}
+
+// Propagate an attitude through one block of gyro increments, as
+// described in `quaternion_simd.h`.  The block is split into groups of
+// `_QS_GROUP` consecutive samples, one group to each lane, so sample
+// `l*_QS_GROUP+k` is stored in lane `l` of block `k`.  The rotors of
+// the increments are multiplied within every group at once, so that
+// only one product per group is left in the sequential chain through
+// the block; each output is then the attitude at the start of its
+// group times the partial product within the group.  The rotors come
+// from the series for cos and sinc in the squared half-angle, which
+// are exact to roundoff below `_QS_GYRO_MAX_ANGLE`; larger increments
+// go to `quaternion_create_from_rotation_vector`.
+#define _QS_GROUP (QUATERNION_GYRO_BLOCK / _QS_BLOCK)
+#define _QS_GYRO_MAX_ANGLE 0.2
+static _QUATERNION_SIMD_TARGET void
+_QUATERNION_SIMD_NAME(quaternion_gyro_propagate_block)(const char* v, ptrdiff_t v_step, ptrdiff_t v_component_step,
+                                                       ptrdiff_t n, const double* previous, double dt, int coning,
+                                                       quaternion* R, char* r, ptrdiff_t r_step)
+{
+  ptrdiff_t k, l;
+  int a;
+  double sample[3][QUATERNION_GYRO_BLOCK], d[3][_QS_GROUP][_QS_BLOCK], first[3][_QS_BLOCK];
+  _quaternion_simd_block p[_QS_GROUP];
+  quaternion start[_QS_BLOCK];
+  int64_t bad[_QS_GROUP][_QS_BLOCK];
+  int64_t any_bad = 0;
+  for(k=0; k<n; ++k) {
+    const char* in = v + k*v_step;
+    sample[0][k] = *(const double*)(in);
+    sample[1][k] = *(const double*)(in + v_component_step);
+    sample[2][k] = *(const double*)(in + 2*v_component_step);
+  }
+  for(; k<QUATERNION_GYRO_BLOCK; ++k) {
+    sample[0][k] = sample[1][k] = sample[2][k] = 0.0;
+  }
+  for(a=0; a<3; ++a) {
+    for(k=0; k<_QS_GROUP; ++k) {
+      for(l=0; l<_QS_BLOCK; ++l) {
+        d[a][k][l] = dt * sample[a][l*_QS_GROUP+k];
+      }
+    }
+  }
+  // Apply the coning correction in place, working backwards through
+  // each group so that the previous increment is still uncorrected
+  if(coning) {
+    for(a=0; a<3; ++a) {
+      first[a][0] = dt * previous[a];
+      for(l=1; l<_QS_BLOCK; ++l) {
+        first[a][l] = d[a][_QS_GROUP-1][l-1];
+      }
+    }
+    for(k=_QS_GROUP-1; k>0; --k) {
+      _QUATERNION_SIMD_NAME(_qs_coning_lanes)(d[0][k], d[1][k], d[2][k], d[0][k-1], d[1][k-1], d[2][k-1]);
+    }
+    _QUATERNION_SIMD_NAME(_qs_coning_lanes)(d[0][0], d[1][0], d[2][0], first[0], first[1], first[2]);
+  }
+  for(k=0; k<_QS_GROUP; ++k) {
+    for(l=0; l<_QS_BLOCK; ++l) {
+      const double phi0 = d[0][k][l], phi1 = d[1][k][l], phi2 = d[2][k][l];
+      const double x2 = (phi0*phi0 + phi1*phi1 + phi2*phi2) * 0.25;
+      const double s = 0.5 + x2 * (-1.0 / 12 + x2 * (1.0 / 240 + x2 * (-1.0 / 10080 + x2 * (1.0 / 725760))));
+      bad[k][l] = !(x2 < _QS_GYRO_MAX_ANGLE * _QS_GYRO_MAX_ANGLE / 4);
+      any_bad |= bad[k][l];
+      p[k].w[l] = 1 + x2 * (-1.0 / 2 + x2 * (1.0 / 24 + x2 * (-1.0 / 720 + x2 * (1.0 / 40320))));
+      p[k].x[l] = s * phi0;
+      p[k].y[l] = s * phi1;
+      p[k].z[l] = s * phi2;
+    }
+  }
+  if(any_bad) {
+    for(k=0; k<_QS_GROUP; ++k) {
+      for(l=0; l<_QS_BLOCK; ++l) {
+        if(bad[k][l]) {
+          const double phi[3] = {d[0][k][l], d[1][k][l], d[2][k][l]};
+          const quaternion q = quaternion_create_from_rotation_vector(phi);
+          p[k].w[l] = q.w;
+          p[k].x[l] = q.x;
+          p[k].y[l] = q.y;
+          p[k].z[l] = q.z;
+        }
+      }
+    }
+  }
+  for(k=1; k<_QS_GROUP; ++k) {
+    for(l=0; l<_QS_BLOCK; ++l) {
+      const double aw = p[k-1].w[l], ax = p[k-1].x[l], ay = p[k-1].y[l], az = p[k-1].z[l];
+      const double bw = p[k].w[l], bx = p[k].x[l], by = p[k].y[l], bz = p[k].z[l];
+      p[k].w[l] = aw*bw - ax*bx - ay*by - az*bz;
+      p[k].x[l] = aw*bx + ax*bw + ay*bz - az*by;
+      p[k].y[l] = aw*by - ax*bz + ay*bw + az*bx;
+      p[k].z[l] = aw*bz + ax*by - ay*bx + az*bw;
+    }
+  }
+  for(l=0; l<_QS_BLOCK; ++l) {
+    const quaternion group = {p[_QS_GROUP-1].w[l], p[_QS_GROUP-1].x[l], p[_QS_GROUP-1].y[l], p[_QS_GROUP-1].z[l]};
+    start[l] = *R;
+    *R = quaternion_multiply(*R, group);
+  }
+  *R = quaternion_normalized(*R);
+  for(k=0; k<_QS_GROUP; ++k) {
+    for(l=0; l<_QS_BLOCK; ++l) {
+      const double aw = start[l].w, ax = start[l].x, ay = start[l].y, az = start[l].z;
+      const double bw = p[k].w[l], bx = p[k].x[l], by = p[k].y[l], bz = p[k].z[l];
+      p[k].w[l] = aw*bw - ax*bx - ay*by - az*bz;
+      p[k].x[l] = aw*bx + ax*bw + ay*bz - az*by;
+      p[k].y[l] = aw*by - ax*bz + ay*bw + az*bx;
+      p[k].z[l] = aw*bz + ax*by - ay*bx + az*bw;
+    }
+  }
+  for(l=0; l<_QS_BLOCK; ++l) {
+    for(k=0; k<_QS_GROUP && l*_QS_GROUP+k<n; ++k) {
+      quaternion* out = (quaternion*)(r + (l*_QS_GROUP+k)*r_step);
+      out->w = p[k].w[l];
+      out->x = p[k].x[l];
+      out->y = p[k].y[l];
+      out->z = p[k].z[l];
+    }
+  }
+  if(n == QUATERNION_GYRO_BLOCK) {
+    *(quaternion*)(r + (n-1)*r_step) = *R;
+  }
+}
+#undef _QS_GYRO_MAX_ANGLE
+#undef _QS_GROUP
+
+#undef _QS_D
+#undef _QS_Q
+#undef _QS_SCATTER
+#undef _QS_UNIT
+#undef _QS_BLOCK
+
+
+#undef VEC
+#undef _QUATERNION_SIMD_WIDTH
+#undef _mul
+#undef _add
+#undef _sub
+#undef _div
+#undef _sqrt
+#undef _loadu
+#undef _storeu
+#undef _xor
+#undef _QUATERNION_SIMD_CONJUGATE_MASK
+#undef _QUATERNION_SIMD_NAME
+#undef _QUATERNION_SIMD_CAT
+#undef _QUATERNION_SIMD_CAT2
@@ -0,0 +1,275 @@
+// Copyright (c) 2017, Michael Boyle
+// See LICENSE file for details: <https://github.com/moble/quaternion/blob/master/LICENSE>
+
+#ifndef __QUATERNION_SIMD_MATH_H__
+#define __QUATERNION_SIMD_MATH_H__
+
+// Branch-free polynomial approximations of the elementary functions
+// used by the batched quaternion kernels.  They are meant to be
+// inlined into loops over blocks of lanes, which the compiler then
+// vectorizes for whichever instruction set the calling function
+// targets.  Integer manipulations of the floating-point bit patterns
+// replace the usual float-to-int conversions, since those do not
+// vectorize on AVX2.
+//
+// These functions do *not* handle special values, and must only be
+// given arguments in the stated ranges; the callers check each lane
+// and recompute any others with the standard scalar functions.
+//
+// The polynomials are near-minimax (Chebyshev) fits.  The maximum
+// errors, measured over 10^8 random arguments against extended-precision
+// results, are
+//
+//                          accurate    fast
+//   _qsm_exp(x)            1 ulp       9 ulp
+//   _qsm_sincos(v)         2.5 ulp     123 ulp
+//   _qsm_log(x)            1 ulp       663 ulp
+//   _qsm_atan2(b, w)       2.5 ulp     746 ulp
+//
+// where the sine and cosine are measured relative to their magnitude
+// (and are within 1.5 ulp in accurate mode for v <= 100).  The "fast"
+// errors correspond to relative errors of at most 1.7e-13.
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+  #define _QSM_INLINE static __forceinline
+#elif defined(__GNUC__) || defined(__clang__)
+  #define _QSM_INLINE static inline __attribute__((always_inline))
+#else
+  #define _QSM_INLINE static NPY_INLINE
+#endif
+
+// 1.5 * 2^52; adding this to |x| < 2^51 rounds x to an integer, which
+// can then be read from the low bits of the result
+#define _QSM_ROUND_MAGIC 6755399441055744.0
+#define _QSM_ROUND_MAGIC_BITS 0x4338000000000000ULL
+
+#define _QSM_LOG2E 1.4426950408889634
+#define _QSM_LN2_HI 0.6931471806019545  // 32 significant bits
+#define _QSM_LN2_LO -4.2009150726810846e-11
+#define _QSM_TWO_OVER_PI 0.6366197723675814
+#define _QSM_PIO2_1 1.5707963267341256  // 33 significant bits
+#define _QSM_PIO2_2 6.077100506303966e-11  // 33 significant bits
+#define _QSM_PIO2_3 2.0222662487959506e-21
+#define _QSM_PIO4_HI 0.7853981633974483  // 50 significant bits
+#define _QSM_PIO4_LO 3.061616997868383e-17
+#define _QSM_TAN_PIO8 0.41421356237309503
+#define _QSM_SQRT2 1.4142135623730951
+
+// Largest arguments accepted by the functions below
+#define _QSM_EXP_MAX 700.0
+#define _QSM_SINCOS_MAX 1.0e5
+
+_QSM_INLINE uint64_t _qsm_bits(double d) { uint64_t u; memcpy(&u, &d, sizeof(u)); return u; }
+_QSM_INLINE double _qsm_double(uint64_t u) { double d; memcpy(&d, &u, sizeof(d)); return d; }
+
+// Reverse the order of the bytes
+#if defined(__GNUC__) || defined(__clang__)
+  _QSM_INLINE uint32_t _qsm_bswap32(uint32_t u) { return __builtin_bswap32(u); }
+  _QSM_INLINE uint64_t _qsm_bswap64(uint64_t u) { return __builtin_bswap64(u); }
+#elif defined(_MSC_VER)
+  _QSM_INLINE uint32_t _qsm_bswap32(uint32_t u) { return _byteswap_ulong(u); }
+  _QSM_INLINE uint64_t _qsm_bswap64(uint64_t u) { return _byteswap_uint64(u); }
+#else
+  _QSM_INLINE uint32_t _qsm_bswap32(uint32_t u) {
+    u = ((u & 0x00ff00ffU) << 8) | ((u >> 8) & 0x00ff00ffU);
+    return (u << 16) | (u >> 16);
+  }
+  _QSM_INLINE uint64_t _qsm_bswap64(uint64_t u) {
+    return ((uint64_t)_qsm_bswap32((uint32_t)u) << 32) | _qsm_bswap32((uint32_t)(u >> 32));
+  }
+#endif
+
+// True if d is neither infinite nor NaN, without touching the FPU
+_QSM_INLINE int _qsm_isfinite(double d) {
+  return (_qsm_bits(d) & 0x7ff0000000000000ULL) != 0x7ff0000000000000ULL;
+}
+// True if |d| < limit (for finite, positive limit), without raising
+// floating-point exceptions for NaN
+_QSM_INLINE int _qsm_abs_less(double d, double limit) {
+  return (int64_t)(_qsm_bits(d) & 0x7fffffffffffffffULL) < (int64_t)_qsm_bits(limit);
+}
+
+
+// exp(x) for |x| <= _QSM_EXP_MAX
+_QSM_INLINE double _qsm_exp(double x, const int fast)
+{
+  const double nd_magic = x * _QSM_LOG2E + _QSM_ROUND_MAGIC;
+  const uint64_t n_bits = _qsm_bits(nd_magic) - _QSM_ROUND_MAGIC_BITS;
+  const double nd = nd_magic - _QSM_ROUND_MAGIC;
+  const double r = (x - nd * _QSM_LN2_HI) - nd * _QSM_LN2_LO;
+  const double scale = _qsm_double((n_bits + 1023) << 52);
+  double p;
+  // p approximates (e^r - 1 - r) / r^2
+  if(fast) {
+    p = 2.761379555451986e-07;
+    p = p * r + 2.7625102005388108e-06;
+    p = p * r + 2.4801536409064087e-05;
+    p = p * r + 0.0001984120875699232;
+    p = p * r + 0.0013888888905871347;
+    p = p * r + 0.008333333353717156;
+    p = p * r + 0.041666666666651364;
+    p = p * r + 0.16666666666648303;
+    p = p * r + 0.5;
+  } else {
+    p = 2.0914679376583935e-09;
+    p = p * r + 2.510520637395701e-08;
+    p = p * r + 2.7557273661348637e-07;
+    p = p * r + 2.7557255425746435e-06;
+    p = p * r + 2.4801587325533363e-05;
+    p = p * r + 0.00019841269874800493;
+    p = p * r + 0.0013888888888883752;
+    p = p * r + 0.008333333333326141;
+    p = p * r + 0.04166666666666667;
+    p = p * r + 0.1666666666666667;
+    p = p * r + 0.5;
+  }
+  return (1.0 + (r + r * r * p)) * scale;
+}
+
+// sin(v) and cos(v) for 0 <= v <= _QSM_SINCOS_MAX
+_QSM_INLINE void _qsm_sincos(double v, double* s, double* c, const int fast)
+{
+  // Reduce to |r| <= pi/4 with a three-part Cody-Waite reduction,
+  // which is accurate for the restricted range of v
+  const double kd_magic = v * _QSM_TWO_OVER_PI + _QSM_ROUND_MAGIC;
+  const uint64_t k = _qsm_bits(kd_magic);
+  const double kd = kd_magic - _QSM_ROUND_MAGIC;
+  const double r = ((v - kd * _QSM_PIO2_1) - kd * _QSM_PIO2_2) - kd * _QSM_PIO2_3;
+  const double z = r * r;
+  const double hz = 0.5 * z;
+  const double one_minus_hz = 1.0 - hz;
+  double ps, pc, sr, cr;
+  // ps approximates (sin(r)/r - 1) / z, and pc approximates (cos(r) - 1 + z/2) / z^2
+  if(fast) {
+    ps = -2.4805636241834762e-08;
+    ps = ps * z + 2.755599092956532e-06;
+    ps = ps * z + -0.00019841266916985966;
+    ps = ps * z + 0.008333333331079223;
+    ps = ps * z + -0.16666666666663885;
+    pc = 2.0700600483433117e-09;
+    pc = pc * z + -2.7556369695573007e-07;
+    pc = pc * z + 2.4801585210990515e-05;
+    pc = pc * z + -0.0013888888887277342;
+    pc = pc * z + 0.04166666666666468;
+  } else {
+    ps = 1.5918129294866608e-10;
+    ps = ps * z + -2.5051131845003624e-08;
+    ps = ps * z + 2.755731610255244e-06;
+    ps = ps * z + -0.00019841269836758574;
+    ps = ps * z + 0.008333333333330948;
+    ps = ps * z + -0.16666666666666666;
+    pc = -1.1382632425521717e-11;
+    pc = pc * z + 2.08761462684032e-09;
+    pc = pc * z + -2.7557317271729793e-07;
+    pc = pc * z + 2.480158729876569e-05;
+    pc = pc * z + -0.0013888888888887398;
+    pc = pc * z + 0.041666666666666664;
+  }
+  sr = r + r * z * ps;
+  // Recover the bits lost in 1 - z/2
+  cr = one_minus_hz + (((1.0 - one_minus_hz) - hz) + z * z * pc);
+  // Select and negate according to the quadrant k mod 4
+  {
+    const uint64_t swap = k & 1;
+    const double s0 = swap ? cr : sr;
+    const double c0 = swap ? sr : cr;
+    *s = _qsm_double(_qsm_bits(s0) ^ ((k & 2) << 62));
+    *c = _qsm_double(_qsm_bits(c0) ^ (((k + 1) & 2) << 62));
+  }
+}
+
+// sin(v) for |v| <= _QSM_SINCOS_MAX
+_QSM_INLINE double _qsm_sin(double v, const int fast)
+{
+  double s, c;
+  _qsm_sincos(fabs(v), &s, &c, fast);
+  return _qsm_double(_qsm_bits(s) ^ (_qsm_bits(v) & 0x8000000000000000ULL));
+}
+
+// log(x) for normal, positive, finite x
+_QSM_INLINE double _qsm_log(double x, const int fast)
+{
+  // Write x = m * 2^e with sqrt(2)/2 <= m < sqrt(2)
+  const uint64_t ix = _qsm_bits(x);
+  const double e0 = _qsm_double(0x4330000000000000ULL | (ix >> 52)) - (4503599627370496.0 + 1023.0);
+  const double m0 = _qsm_double((ix & 0x000fffffffffffffULL) | 0x3ff0000000000000ULL);
+  const int big = m0 > _QSM_SQRT2;
+  const double m = big ? 0.5 * m0 : m0;
+  const double e = big ? e0 + 1.0 : e0;
+  // log(m) = log(1+f) = 2 atanh(s), with s = f / (2+f)
+  const double f = m - 1.0;
+  const double s = f / (2.0 + f);
+  const double z = s * s;
+  const double hfsq = 0.5 * f * f;
+  double p, R;
+  // p approximates (2 atanh(s)/s - 2) / z
+  if(fast) {
+    p = 0.19362653714202008;
+    p = p * z + 0.22191400830308503;
+    p = p * z + 0.2857175453591449;
+    p = p * z + 0.3999999879733759;
+    p = p * z + 0.6666666666737509;
+  } else {
+    p = 0.14616449685043406;
+    p = p * z + 0.15331721600556042;
+    p = p * z + 0.18182889125261723;
+    p = p * z + 0.2222221113479508;
+    p = p * z + 0.28571428625975487;
+    p = p * z + 0.39999999999899505;
+    p = p * z + 0.666666666666667;
+  }
+  R = z * p;
+  return e * _QSM_LN2_HI - ((hfsq - (s * (hfsq + R) + e * _QSM_LN2_LO)) - f);
+}
+
+// atan2(b, w) for finite b > 0 and finite w
+_QSM_INLINE double _qsm_atan2(double b, double w, const int fast)
+{
+  const double a = fabs(w);
+  const int neg = _qsm_bits(w) >> 63;
+  const int big = b > a;
+  const double num = big ? a : b;
+  const double den = big ? b : a;
+  // Reduce num/den from [0, 1] to [-tan(pi/8), tan(pi/8)] using
+  // atan(t) = pi/4 + atan((t-1)/(t+1))
+  const int reduce = num > _QSM_TAN_PIO8 * den;
+  const double t = reduce ? (num - den) / (num + den) : num / den;
+  const double z = t * t;
+  double p, at, ci, sign;
+  // p approximates (atan(t)/t - 1) / z
+  if(fast) {
+    p = 0.03295679541870136;
+    p = p * z + -0.06027307460946675;
+    p = p * z + 0.07604800046078292;
+    p = p * z + -0.09084101895346429;
+    p = p * z + 0.11110819716745676;
+    p = p * z + -0.142857081103604;
+    p = p * z + 0.19999999949854794;
+    p = p * z + -0.33333333333266196;
+  } else {
+    p = -0.01917688711906226;
+    p = p * z + 0.03923165829558719;
+    p = p * z + -0.0508544973794026;
+    p = p * z + 0.0585814891280221;
+    p = p * z + -0.06664511447381948;
+    p = p * z + 0.07692183190826087;
+    p = p * z + -0.09090904578123903;
+    p = p * z + 0.11111111015256361;
+    p = p * z + -0.14285714284666542;
+    p = p * z + 0.1999999999999552;
+    p = p * z + -0.3333333333333333;
+  }
+  at = t + t * z * p;
+  // The result is ci*pi/4 + sign*at, where ci is an integer in [0, 4]
+  {
+    const double off = reduce ? 1.0 : 0.0;
+    ci = neg ? (big ? 2.0 + off : 4.0 - off) : (big ? 2.0 - off : off);
+    sign = (neg != big) ? -1.0 : 1.0;
+  }
+  return ci * _QSM_PIO4_HI + (sign * at + ci * _QSM_PIO4_LO);
+}
+
+#endif // __QUATERNION_SIMD_MATH_H__
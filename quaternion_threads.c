@@ -0,0 +1,156 @@
+// Copyright (c) 2017, Michael Boyle
+// See LICENSE file for details: <https://github.com/moble/quaternion/blob/master/LICENSE>
+
+#include <Python.h>
+#include <pythread.h>
+#include <stdlib.h>
+
+#include "quaternion_threads.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The threads and locks are those of the Python runtime, which wraps
+// the native ones on each platform.  Its locks may be released by a
+// thread other than the one that acquired them, so each is used as a
+// binary semaphore: a worker waits on its `start` lock until a piece of
+// work is posted, and releases its `done` lock when the piece is
+// finished.  The pool lock is held by the thread using the workers.
+typedef struct {
+  PyThread_type_lock start;
+  PyThread_type_lock done;
+  quaternion_parallel_task task;
+  void* context;
+  ptrdiff_t begin;
+  ptrdiff_t end;
+} _quaternion_worker;
+
+static _quaternion_worker _quaternion_workers[QUATERNION_MAX_THREADS-1];
+static int _quaternion_num_workers = 0;
+static int _quaternion_num_threads = 1;
+static PyThread_type_lock _quaternion_pool_lock = NULL;
+
+static void
+_quaternion_worker_main(void* arg)
+{
+  _quaternion_worker* worker = (_quaternion_worker*)arg;
+  for(;;) {
+    PyThread_acquire_lock(worker->start, WAIT_LOCK);
+    worker->task(worker->context, worker->begin, worker->end);
+    PyThread_release_lock(worker->done);
+  }
+}
+
+// Start workers until there are `num_workers`; returns the number running
+static int
+_quaternion_start_workers(int num_workers)
+{
+  while(_quaternion_num_workers < num_workers) {
+    _quaternion_worker* worker = &_quaternion_workers[_quaternion_num_workers];
+    worker->start = PyThread_allocate_lock();
+    worker->done = PyThread_allocate_lock();
+    if(worker->start == NULL || worker->done == NULL) {
+      break;
+    }
+    PyThread_acquire_lock(worker->start, WAIT_LOCK);
+    PyThread_acquire_lock(worker->done, WAIT_LOCK);
+    if((long)PyThread_start_new_thread(_quaternion_worker_main, worker) == -1) {
+      break;
+    }
+    ++_quaternion_num_workers;
+  }
+  return _quaternion_num_workers;
+}
+
+void
+quaternion_parallel_for(ptrdiff_t n, ptrdiff_t grain, quaternion_parallel_task task, void* context)
+{
+  ptrdiff_t chunk, begin;
+  int i, num_pieces;
+  if(_quaternion_num_threads < 2 || grain < 1 || n < 2*grain
+     || _quaternion_pool_lock == NULL || !PyThread_acquire_lock(_quaternion_pool_lock, NOWAIT_LOCK)) {
+    task(context, 0, n);
+    return;
+  }
+  num_pieces = _quaternion_num_threads;
+  if(num_pieces > _quaternion_num_workers+1) {
+    num_pieces = _quaternion_num_workers+1;
+  }
+  if(num_pieces > n/grain) {
+    num_pieces = (int)(n/grain);
+  }
+  chunk = (n + num_pieces - 1) / num_pieces;
+  chunk = ((chunk + QUATERNION_PARALLEL_ALIGN - 1) / QUATERNION_PARALLEL_ALIGN) * QUATERNION_PARALLEL_ALIGN;
+  for(i=1, begin=chunk; i<num_pieces && begin<n; ++i, begin+=chunk) {
+    _quaternion_worker* worker = &_quaternion_workers[i-1];
+    worker->task = task;
+    worker->context = context;
+    worker->begin = begin;
+    worker->end = (begin + chunk < n) ? begin + chunk : n;
+    PyThread_release_lock(worker->start);
+  }
+  num_pieces = i;
+  task(context, 0, (chunk < n) ? chunk : n);
+  for(i=1; i<num_pieces; ++i) {
+    PyThread_acquire_lock(_quaternion_workers[i-1].done, WAIT_LOCK);
+  }
+  PyThread_release_lock(_quaternion_pool_lock);
+}
+
+void
+quaternion_threads_init(void)
+{
+  const char* requested = getenv("QUATERNION_NUM_THREADS");
+  _quaternion_pool_lock = PyThread_allocate_lock();
+  if(requested != NULL) {
+    char* end;
+    long num_threads = strtol(requested, &end, 10);
+    if(end != requested && *end == '\0' && num_threads >= 1 && num_threads <= QUATERNION_MAX_THREADS) {
+      quaternion_threads_set_num((int)num_threads);
+    }
+  }
+}
+
+int
+quaternion_threads_get_num(void)
+{
+  return _quaternion_num_threads;
+}
+
+int
+quaternion_threads_set_num(int num_threads)
+{
+  int started;
+  if(num_threads < 1 || num_threads > QUATERNION_MAX_THREADS || _quaternion_pool_lock == NULL) {
+    return -1;
+  }
+  // Wait for any loop that is using the workers to finish
+  Py_BEGIN_ALLOW_THREADS
+  PyThread_acquire_lock(_quaternion_pool_lock, WAIT_LOCK);
+  Py_END_ALLOW_THREADS
+  started = _quaternion_start_workers(num_threads-1);
+  if(started >= num_threads-1) {
+    _quaternion_num_threads = num_threads;
+  }
+  PyThread_release_lock(_quaternion_pool_lock);
+  return (started >= num_threads-1) ? 0 : -1;
+}
+
+void
+quaternion_threads_after_fork(void)
+{
+  // The old locks may have been held by threads that no longer exist,
+  // so they are abandoned along with the workers
+  int num_threads = _quaternion_num_threads;
+  _quaternion_num_workers = 0;
+  _quaternion_num_threads = 1;
+  _quaternion_pool_lock = PyThread_allocate_lock();
+  if(num_threads > 1) {
+    quaternion_threads_set_num(num_threads);
+  }
+}
+
+#ifdef __cplusplus
+}
+#endif
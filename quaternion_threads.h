@@ -0,0 +1,55 @@
+// Copyright (c) 2017, Michael Boyle
+// See LICENSE file for details: <https://github.com/moble/quaternion/blob/master/LICENSE>
+
+#ifndef __QUATERNION_THREADS_H__
+#define __QUATERNION_THREADS_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+  #include <stddef.h>
+
+  // A small pool of worker threads that share the loops over large
+  // arrays.  It is disabled (one thread) by default.  The threads are
+  // started when the number is raised, and are then reused by every
+  // call; lowering the number just leaves the extra threads idle.  The
+  // workers never touch Python objects, so they may run while the GIL
+  // is released.
+
+  // Largest number of threads that may be requested
+  #define QUATERNION_MAX_THREADS 256
+
+  // Work splits are multiples of this many elements, so that every
+  // element falls at the same position within the blocks of the
+  // vectorized kernels as it would in a single call.  The results are
+  // therefore identical for any number of threads.
+  #define QUATERNION_PARALLEL_ALIGN 16
+
+  // A task computes the elements in [start, stop)
+  typedef void (*quaternion_parallel_task)(void* context, ptrdiff_t start, ptrdiff_t stop);
+
+  // Run `task` over [0, n), split into contiguous pieces of at least
+  // `grain` elements, one per thread.  The calling thread does the
+  // first piece, and waits for the others.  If the pool is disabled or
+  // already in use by another thread, or n < 2*grain, `task` is simply
+  // called once for the whole range.
+  void quaternion_parallel_for(ptrdiff_t n, ptrdiff_t grain, quaternion_parallel_task task, void* context);
+
+  // Read the number of threads from the environment variable
+  // QUATERNION_NUM_THREADS, if it is set; call once, with the GIL held
+  void quaternion_threads_init(void);
+  // Current number of threads (including the calling thread), or change
+  // it; returns -1 if the number is out of range or the threads could
+  // not be started.  Call with the GIL held.
+  int quaternion_threads_get_num(void);
+  int quaternion_threads_set_num(int num_threads);
+  // Forget the workers, which do not exist in a child process after
+  // `fork`, and start new ones
+  void quaternion_threads_after_fork(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __QUATERNION_THREADS_H__
@@ -0,0 +1,176 @@
+# Copyright (c) 2017, Michael Boyle
+# See LICENSE file for details: <https://github.com/moble/quaternion/blob/master/LICENSE>
+
+from __future__ import division, print_function, absolute_import
+
+import numpy as np
+
+from .numpy_quaternion import quaternion, _rotor_encoding_gufuncs
+
+
+# Bits stored for each of the three smallest components, keyed by the size
+# of the code; the remaining two bits give the index of the largest
+_component_bits = {32: 10, 48: 15, 64: 20}
+
+# The largest angle (in radians) of the rotation taking any unit rotor to
+# its decoded value, keyed by the size of the code.  Each stored component
+# is rounded to the nearest of 2**bits-1 levels spanning [-1/sqrt(2),
+# 1/sqrt(2)], so it changes by at most sqrt(2)/(2**bits-2)/2; the largest
+# component is at least 1/2, so recomputing it from the other three at
+# most doubles the resulting distance on the unit sphere, and the angle of
+# a rotation is twice the distance between its rotors.
+max_angular_error = dict((size, 2 * np.sqrt(6) / (2**bits - 2)) for size, bits in _component_bits.items())
+
+
+def _rotor_encoding_gufunc(bits, inverse):
+    """Return the gufunc encoding (inverse=0) or decoding (inverse=1) rotors"""
+    try:
+        return _rotor_encoding_gufuncs[bits][inverse]
+    except (KeyError, TypeError):
+        raise ValueError("Unknown rotor encoding {0!r}; expected one of {1}".format(
+            bits, ", ".join(str(b) for b in sorted(_rotor_encoding_gufuncs))))
+
+
+def _default_bits(codes):
+    if codes.dtype == np.uint32:
+        return 32
+    if codes.dtype == np.uint64:
+        return 64
+    raise TypeError("Rotor codes must be uint32 or uint64; got dtype {0}".format(codes.dtype))
+
+
+def encode_rotors(q, bits=32):
+    """Pack rotors into unsigned integers
+
+    Each rotor (unit quaternion) is stored by the "smallest-three" scheme.
+    Because q and -q represent the same rotation, the sign is chosen to
+    make the component with the largest magnitude positive, so that it
+    can be recomputed from the other three.  The code holds the index of
+    that component in two bits, followed by the other three components,
+    each quantized uniformly over [-1/sqrt(2), 1/sqrt(2)], with zero
+    represented exactly.
+
+    Parameters
+    ----------
+    q: array of quaternions
+        Nonzero, finite quaternions, which need not be normalized.
+    bits: {32, 48, 64}, optional
+        Size of each code.  The 32-bit codes are stored as `uint32`, and
+        the others as `uint64`; 48-bit codes leave the top 16 bits zero,
+        so that they can be truncated to 6 bytes.  The components are
+        stored with 10, 15, and 20 bits respectively.
+
+    Returns
+    -------
+    codes: array of uint32 or uint64
+        Same shape as the input.  Decoding gives back a rotor that
+        differs from the normalized input by a rotation through at most
+        `max_angular_error[bits]` radians: about 4.8e-3, 1.5e-4, and
+        4.7e-6 for the three sizes.  The decoded rotor may have the
+        opposite sign to the input.
+
+    """
+    q = np.asarray(q, dtype=np.quaternion)
+    return _rotor_encoding_gufunc(bits, 0)(q.view((np.double, 4)))
+
+
+def decode_rotors(codes, bits=None):
+    """Unpack rotors stored by `encode_rotors`
+
+    Parameters
+    ----------
+    codes: array of uint32 or uint64
+    bits: {32, 48, 64}, optional
+        Size of each code.  By default, this is 32 for `uint32` codes and
+        64 for `uint64`, so it must be given for 48-bit codes.
+
+    Returns
+    -------
+    q: array of quaternions
+        Unit quaternions, with the same shape as the input, or a single
+        `quaternion` for a single code.
+
+    """
+    codes = np.asarray(codes)
+    if bits is None:
+        bits = _default_bits(codes)
+    q = _rotor_encoding_gufunc(bits, 1)(codes).view(np.quaternion)[..., 0]
+    return q[()] if q.ndim == 0 else q
+
+
+class EncodedRotorArray(object):
+    """Array of rotors stored as codes from `encode_rotors`
+
+    This holds only the integer codes, which take 4 or 8 bytes for each
+    rotor rather than 32, and decodes them when they are accessed.
+    Indexing decodes only the selected elements, giving a `quaternion` or
+    an array of quaternions, and `np.asarray` decodes everything.
+
+    Parameters
+    ----------
+    codes: array of uint32 or uint64
+    bits: {32, 48, 64}, optional
+        Size of each code, as in `decode_rotors`.
+
+    """
+
+    def __init__(self, codes, bits=None):
+        codes = np.asarray(codes)
+        if bits is None:
+            bits = _default_bits(codes)
+        _rotor_encoding_gufunc(bits, 1)
+        self.codes = codes
+        self.bits = bits
+
+    @classmethod
+    def from_quat_array(cls, q, bits=32):
+        """Encode an array of quaternions into a new EncodedRotorArray"""
+        return cls(encode_rotors(q, bits), bits)
+
+    def as_quat_array(self):
+        """Decode all the rotors into a new array of quaternions"""
+        return decode_rotors(self.codes, self.bits)
+
+    def __array__(self, dtype=None):
+        q = self.as_quat_array()
+        return q if dtype is None else q.astype(dtype)
+
+    @property
+    def max_angular_error(self):
+        return max_angular_error[self.bits]
+
+    @property
+    def shape(self):
+        return self.codes.shape
+
+    @property
+    def ndim(self):
+        return self.codes.ndim
+
+    @property
+    def size(self):
+        return self.codes.size
+
+    @property
+    def nbytes(self):
+        return self.codes.nbytes
+
+    @property
+    def dtype(self):
+        return np.dtype(quaternion)
+
+    def __len__(self):
+        return len(self.codes)
+
+    def __getitem__(self, index):
+        return decode_rotors(self.codes[index], self.bits)
+
+    def __setitem__(self, index, value):
+        self.codes[index] = encode_rotors(value, self.bits)
+
+    def __iter__(self):
+        for i in range(len(self)):
+            yield self[i]
+
+    def __repr__(self):
+        return "EncodedRotorArray({0!r}, bits={1})".format(self.codes, self.bits)
@@ -0,0 +1,364 @@
+# Copyright (c) 2017, Michael Boyle
+# See LICENSE file for details: <https://github.com/moble/quaternion/blob/master/LICENSE>
+
+"""Chunked on-disk storage for long time-series of rotors
+
+A file holds a single time-series, split into chunks of consecutive
+samples.  Each chunk stores its times as raw little-endian float64, and
+its rotors either raw (as the components of the `quaternion` dtype) or
+through a codec; an index at the end of the file records the time range
+and location of every chunk.  The layout is
+
+    header       64 bytes: magic, version, number of chunks, index offset
+    chunks       for each chunk, its times then its rotors, each starting
+                 on a 64-byte boundary
+    index        one `_index_dtype` record per chunk
+
+The codecs are
+
+    None         rotors stored raw, so that they can be memory-mapped
+    'zlib'       raw rotors compressed with zlib
+    'rotor32'    rotors packed by `encode_rotors` into 32, 48, or 64 bits
+    'rotor48'
+    'rotor64'
+
+and may differ between chunks.  The times are never compressed, so that
+they can always be searched in place.
+
+"""
+
+from __future__ import division, print_function, absolute_import
+
+import mmap
+import struct
+import zlib
+
+import numpy as np
+
+from .rotor_encoding import encode_rotors, decode_rotors
+
+
+_magic = b'NPQTSERS'
+_version = 1
+_header = struct.Struct('<8sIIQQ')
+_header_size = 64
+_alignment = 64
+
+_index_dtype = np.dtype([('start', '<i8'), ('length', '<i8'), ('t_first', '<f8'), ('t_last', '<f8'),
+                         ('codec', '<i8'), ('t_offset', '<i8'), ('R_offset', '<i8'), ('R_nbytes', '<i8')])
+
+_codec_ids = {None: 0, 'zlib': 1, 'rotor32': 2, 'rotor48': 3, 'rotor64': 4}
+_codec_bits = {2: 32, 3: 48, 4: 64}
+_code_bytes = {32: 4, 48: 6, 64: 8}
+
+
+def _codec_id(codec):
+    try:
+        return _codec_ids[codec]
+    except (KeyError, TypeError):
+        raise ValueError("Unknown codec {0!r}; expected one of {1}".format(
+            codec, ", ".join(repr(c) for c in sorted(_codec_ids, key=_codec_ids.get))))
+
+
+def _encode_chunk(R, codec_id):
+    """Return the bytes storing the rotors `R` with the given codec"""
+    if codec_id == 0:
+        return R.tobytes()
+    if codec_id == 1:
+        return zlib.compress(R.tobytes())
+    bits = _codec_bits[codec_id]
+    codes = encode_rotors(R, bits)
+    if bits != 48:
+        return codes.tobytes()
+    return codes.astype('<u8').view(np.uint8).reshape(-1, 8)[:, :_code_bytes[bits]].tobytes()
+
+
+def _decode_chunk(buf, length, codec_id):
+    """Return the rotors stored in `buf` with the given codec"""
+    if codec_id == 0:
+        return buf.view(np.quaternion)
+    if codec_id == 1:
+        return np.frombuffer(zlib.decompress(buf), dtype=np.quaternion)
+    bits = _codec_bits[codec_id]
+    if bits == 32:
+        return decode_rotors(buf.view('<u4'), bits)
+    if bits == 64:
+        return decode_rotors(buf.view('<u8'), bits)
+    codes = np.zeros((length, 8), dtype=np.uint8)
+    codes[:, :_code_bytes[bits]] = buf.reshape(length, _code_bytes[bits])
+    return decode_rotors(codes.view('<u8')[:, 0], bits)
+
+
+class RotorTimeSeriesWriter(object):
+    """Write a time-series of rotors to a chunked file
+
+    The data are appended in pieces, so that the whole series never needs
+    to be in memory at once.  Each call to `append` writes its samples as
+    one or more chunks of at most `chunk_size` samples; the index is
+    written by `close`, which is also called when the writer is used as a
+    context manager.
+
+    Parameters
+    ----------
+    path: str
+        Name of the file to create.  Any existing file is overwritten.
+    chunk_size: int, optional
+        Largest number of samples in each chunk.  Readers load whole
+        chunks, so this sets the granularity of random access.
+    codec: {None, 'zlib', 'rotor32', 'rotor48', 'rotor64'}, optional
+        Default codec for the rotors; see the module documentation.
+
+    Example
+    -------
+    >>> with RotorTimeSeriesWriter('rotors.qts', codec='rotor64') as w:
+    ...     for t, R in pieces:
+    ...         w.append(t, R)
+
+    """
+
+    def __init__(self, path, chunk_size=2**20, codec=None):
+        if chunk_size < 1:
+            raise ValueError("chunk_size must be positive; got {0}".format(chunk_size))
+        self.chunk_size = int(chunk_size)
+        self.codec = codec
+        _codec_id(codec)
+        self._index = []
+        self._length = 0
+        self._t_last = -np.inf
+        self._file = open(path, 'wb')
+        self._file.write(b'\0' * _header_size)
+
+    def _write_aligned(self, data):
+        offset = self._file.tell()
+        padding = -offset % _alignment
+        self._file.write(b'\0' * padding)
+        self._file.write(data)
+        return offset + padding
+
+    def append(self, t, R, codec=None):
+        """Append samples, which must follow any that are already written
+
+        Parameters
+        ----------
+        t: array of float
+            Sorted times of the samples
+        R: array of quaternions
+            Rotors at those times
+        codec: optional
+            Codec for these chunks, overriding the writer's default
+
+        """
+        t = np.ascontiguousarray(t, dtype='<f8')
+        R = np.ascontiguousarray(R, dtype=np.quaternion)
+        if t.ndim != 1 or R.shape != t.shape:
+            raise ValueError("t and R must be one-dimensional with the same length; got shapes {0} and {1}".format(
+                t.shape, R.shape))
+        if t.size == 0:
+            return
+        if t[0] < self._t_last or np.any(np.diff(t) < 0):
+            raise ValueError("Times must be sorted, and follow those already written")
+        codec_id = _codec_id(self.codec if codec is None else codec)
+        for i in range(0, len(t), self.chunk_size):
+            t_chunk, R_chunk = t[i:i+self.chunk_size], R[i:i+self.chunk_size]
+            t_offset = self._write_aligned(t_chunk.tobytes())
+            data = _encode_chunk(R_chunk, codec_id)
+            R_offset = self._write_aligned(data)
+            self._index.append((self._length, len(t_chunk), t_chunk[0], t_chunk[-1], codec_id,
+                                t_offset, R_offset, len(data)))
+            self._length += len(t_chunk)
+        self._t_last = t[-1]
+
+    def close(self):
+        """Write the index and header, and close the file"""
+        if self._file is None:
+            return
+        index = np.array(self._index, dtype=_index_dtype)
+        index_offset = self._write_aligned(index.tobytes())
+        self._file.seek(0)
+        self._file.write(_header.pack(_magic, _version, 0, len(index), index_offset))
+        self._file.close()
+        self._file = None
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *args):
+        self.close()
+
+
+def write_rotor_time_series(path, t, R, chunk_size=2**20, codec=None):
+    """Write the time-series (t, R) to a chunked file
+
+    See `RotorTimeSeriesWriter` for the parameters, and for writing series
+    that do not fit in memory.
+
+    """
+    with RotorTimeSeriesWriter(path, chunk_size, codec) as writer:
+        writer.append(t, R)
+
+
+class RotorTimeSeriesFile(object):
+    """Read a chunked time-series of rotors written by `RotorTimeSeriesWriter`
+
+    The file is memory-mapped, so opening it reads only the header and
+    index.  Times, and rotors stored without a codec, are returned as
+    read-only views of the mapped file; other rotors are decoded when
+    their chunk is accessed.  Interpolation with `squad` or `slerp` only
+    touches the chunks containing the samples it needs, so that a short
+    range of output times can be evaluated from a file much larger than
+    memory.  The data are assumed to be little-endian, as written.
+
+    Parameters
+    ----------
+    path: str
+        Name of the file to open
+
+    Attributes
+    ----------
+    index: structured array
+        One record for each chunk, giving the position `start` of its
+        first sample in the whole series, its number of samples `length`,
+        its first and last times `t_first` and `t_last`, and its codec.
+
+    """
+
+    def __init__(self, path):
+        with open(path, 'rb') as f:
+            self._mmap = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+        magic, version, _, n_chunks, index_offset = _header.unpack_from(self._mmap, 0)
+        if magic != _magic:
+            raise ValueError("{0} is not a rotor time-series file".format(path))
+        if version != _version:
+            raise ValueError("Unsupported version {0} of rotor time-series file {1}".format(version, path))
+        self.index = np.frombuffer(self._mmap, dtype=_index_dtype, count=n_chunks, offset=index_offset)
+        self._chunk_starts = np.ascontiguousarray(self.index['start'])
+        self._chunk_t_first = np.ascontiguousarray(self.index['t_first'])
+
+    def __len__(self):
+        return int(self.index['start'][-1] + self.index['length'][-1]) if len(self.index) else 0
+
+    @property
+    def n_chunks(self):
+        return len(self.index)
+
+    @property
+    def t_range(self):
+        """First and last times in the series"""
+        return self.index['t_first'][0], self.index['t_last'][-1]
+
+    def chunk_times(self, i):
+        """Times of the samples in chunk `i`, as a view of the file"""
+        record = self.index[i]
+        return np.frombuffer(self._mmap, dtype='<f8', count=record['length'], offset=record['t_offset'])
+
+    def chunk_rotors(self, i):
+        """Rotors in chunk `i`, as a view of the file when stored without a codec"""
+        record = self.index[i]
+        buf = np.frombuffer(self._mmap, dtype=np.uint8, count=record['R_nbytes'], offset=record['R_offset'])
+        return _decode_chunk(buf, record['length'], record['codec'])
+
+    def chunk(self, i):
+        """Return the times and rotors (t, R) in chunk `i`"""
+        return self.chunk_times(i), self.chunk_rotors(i)
+
+    def chunks_for_samples(self, start, stop):
+        """Return the range of chunks containing samples start through stop-1"""
+        first = np.searchsorted(self._chunk_starts, start, side='right') - 1
+        last = np.searchsorted(self._chunk_starts, stop - 1, side='right') - 1
+        return range(max(first, 0), last + 1)
+
+    def load(self, start=0, stop=None):
+        """Return the times and rotors (t, R) of samples start through stop-1
+
+        Only the chunks containing those samples are read.  When they all
+        lie in one chunk stored without a codec, the results are views of
+        the file; otherwise, they are copied into new arrays.
+
+        """
+        n = len(self)
+        stop = n if stop is None else stop
+        start, stop, _ = slice(start, stop).indices(n)
+        if stop <= start:
+            return np.empty(0), np.empty(0, dtype=np.quaternion)
+        t, R = [], []
+        for i in self.chunks_for_samples(start, stop):
+            offset = self._chunk_starts[i]
+            lo, hi = max(start - offset, 0), min(stop - offset, self.index['length'][i])
+            t.append(self.chunk_times(i)[lo:hi])
+            R.append(self.chunk_rotors(i)[lo:hi])
+        if len(t) == 1:
+            return t[0], R[0]
+        return np.concatenate(t), np.concatenate(R)
+
+    def sample_index(self, t):
+        """Return the index of the last sample at or before each time `t`
+
+        This is -1 for times before the first sample.  Only the chunks
+        whose time ranges include `t` are read.
+
+        """
+        t = np.asarray(t, dtype=np.float64)
+        chunks = np.searchsorted(self._chunk_t_first, t, side='right') - 1
+        i = np.full(t.shape, -1, dtype=np.int64)
+        for c in np.unique(chunks[chunks >= 0]):
+            in_chunk = (chunks == c)
+            i[in_chunk] = self._chunk_starts[c] + np.searchsorted(self.chunk_times(c), t[in_chunk], side='right') - 1
+        return i
+
+    def _load_for_times(self, t_out, before, after):
+        """Load the samples needed to interpolate to `t_out`
+
+        This is every sample from `before` samples preceding the segment
+        containing min(t_out), through `after` samples following the
+        segment containing max(t_out).
+
+        """
+        i_min, i_max = self.sample_index([np.min(t_out), np.max(t_out)])
+        return self.load(max(i_min - before, 0), min(max(i_max, 0) + after + 1, len(self)))
+
+    def slerp(self, t_out):
+        """Interpolate linearly between the rotors bracketing each of `t_out`
+
+        Times outside the series extrapolate its first or last segment.
+
+        """
+        t_out = np.asarray(t_out, dtype=np.float64)
+        if t_out.size == 0:
+            return np.empty(t_out.shape, dtype=np.quaternion)
+        t_in, R_in = self._load_for_times(t_out, 0, 1)
+        i = np.clip(np.searchsorted(t_in, t_out, side='right') - 1, 0, max(len(t_in) - 2, 0))
+        j = np.minimum(i + 1, len(t_in) - 1)
+        tau = (t_out - t_in[i]) / np.where(j > i, t_in[j] - t_in[i], 1.0)
+        return np.slerp_vectorized(R_in[i], R_in[j], tau)
+
+    def squad(self, t_out):
+        """Interpolate the rotors to `t_out` with squad
+
+        The results are the same as those of `SquadInterpolator` built
+        from the whole series, but only the chunks holding the segments
+        containing `t_out` (and two samples on either side, needed for
+        the control points) are read.
+
+        """
+        t_out = np.asarray(t_out, dtype=np.float64)
+        if t_out.size == 0:
+            return np.empty(t_out.shape, dtype=np.quaternion)
+        t_in, R_in = self._load_for_times(t_out, 1, 2)
+        if len(t_in) < 2:
+            raise ValueError("At least two points are needed to interpolate; got {0}".format(len(t_in)))
+        R_in = np.ascontiguousarray(R_in)
+        t_in = np.ascontiguousarray(t_in, dtype=np.float64)
+        A, B = np.squad_coefficients_vectorized(R_in, t_in)
+        R_out = np.squad_interpolate_vectorized(R_in, t_in, A, B, t_out.ravel())
+        return R_out.reshape(t_out.shape)
+
+    def close(self):
+        """Release the memory map; views returned earlier keep it open"""
+        self.index = self._chunk_starts = self._chunk_t_first = None
+        self._mmap = None
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *args):
+        self.close()
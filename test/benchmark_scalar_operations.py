@@ -0,0 +1,56 @@
+#!/usr/bin/env python
+
+"""Time the per-operation latency of `quaternion` scalars
+
+Python-level loops that work on one quaternion at a time are dominated
+by the cost of creating, checking, and destroying scalar objects, rather
+than by the arithmetic.  This script measures that overhead for the
+most common scalar operations, reporting the best of several repeats in
+nanoseconds per operation.  Run it before and after a change to the
+scalar type to see the difference:
+
+    python test/benchmark_scalar_operations.py
+
+"""
+
+from __future__ import print_function, division, absolute_import
+import timeit
+import numpy as np
+import quaternion
+
+
+setup = """
+import numpy as np
+import quaternion
+q1 = np.quaternion(1.0, 2.0, 3.0, 4.0)
+q2 = np.quaternion(0.5, -0.5, 0.25, -0.25)
+s = 1.5
+"""
+
+statements = [
+    ("np.quaternion(1.0, 2.0, 3.0, 4.0)", "construct from four floats"),
+    ("np.quaternion(2.0, 3.0, 4.0)", "construct from three floats"),
+    ("q1 + q2", "quaternion + quaternion"),
+    ("q1 - q2", "quaternion - quaternion"),
+    ("q1 * q2", "quaternion * quaternion"),
+    ("q1 / q2", "quaternion / quaternion"),
+    ("q1 * s", "quaternion * float"),
+    ("s * q1", "float * quaternion"),
+    ("q1 / s", "quaternion / float"),
+    ("q1 * q2 * q1.conjugate()", "rotate (two products and a conjugate)"),
+    ("-q1", "negative"),
+    ("q1.normalized()", "normalized"),
+    ("quaternion.one * q1", "module constant * quaternion"),
+]
+
+
+def main(number=200000, repeat=7):
+    print("{0:>10}  {1}".format("ns/op", "operation"))
+    for statement, description in statements:
+        timer = timeit.Timer(statement, setup=setup)
+        best = min(timer.repeat(repeat=repeat, number=number)) / number
+        print("{0:10.1f}  {1}".format(best * 1e9, description))
+
+
+if __name__ == "__main__":
+    main()
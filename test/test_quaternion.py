@@ -130,7 +130,45 @@ def test_quaternion_members():
     assert Q.z == 4.4
 
 
+def test_quaternion_scalar_fast_paths():
+    # The constructor accepts anything convertible to float, and nothing else
+    assert np.quaternion(1, np.float32(2), np.int64(3), 4.0) == np.quaternion(1.0, 2.0, 3.0, 4.0)
+    for args in [(), (1.0,), (1.0, 2.0), (1.0, 2.0, 3.0, 4.0, 5.0), (1.0, 2.0, 'x')]:
+        with pytest.raises(TypeError, match='three or four float arguments'):
+            np.quaternion(*args)
+    with pytest.raises(TypeError, match='no keyword arguments'):
+        np.quaternion(1.0, 2.0, 3.0, w=4.0)
+
+    # Subclasses are constructed, destroyed, and checked like the base type
+    class Subquaternion(np.quaternion):
+        pass
+    for i in range(1000):
+        s = Subquaternion(1.0, 2.0, 3.0, 4.0)
+        assert type(s) is Subquaternion and s == np.quaternion(1.0, 2.0, 3.0, 4.0)
+    q = np.quaternion(1.0, 2.0, 3.0, 4.0)
+    assert type(s * s) is np.quaternion and s * s == q * q and s * 2.0 == q * 2.0
+
+    # Reused objects never carry over components, and results never alias their inputs
+    q1 = np.quaternion(1.0, 2.0, 3.0, 4.0)
+    q2 = np.quaternion(0.5, -0.5, 0.25, -0.25)
+    for i in range(1000):
+        assert np.quaternion(1.0, 2.0, 3.0) == np.quaternion(0.0, 1.0, 2.0, 3.0)
+        p = q1 * q2
+        assert p is not q1 and p is not q2
+    assert q1 + q2 == np.quaternion(1.5, 1.5, 3.25, 3.75)
+    assert q1 - q2 == np.quaternion(0.5, 2.5, 2.75, 4.25)
+    assert q1 * q2 == np.quaternion(1.75, -1.25, 0.25, 3.75)
+    s1, s2 = Subquaternion(1.0, 2.0, 3.0, 4.0), Subquaternion(0.5, -0.5, 0.25, -0.25)
+    for op in [operator.add, operator.sub, operator.mul, operator.truediv]:
+        assert op(q1, q2) == op(s1, s2) and op(q1, 3.0) == op(s1, 3.0) and op(3.0, q1) == op(3.0, s1)
+    assert q1 * 2.0 == 2.0 * q1 == np.quaternion(2.0, 4.0, 6.0, 8.0)
+    assert q1 / 2.0 == np.quaternion(0.5, 1.0, 1.5, 2.0)
+    assert q1 * np.float64(2.0) == q1 * 2 == np.quaternion(2.0, 4.0, 6.0, 8.0)
+    assert quaternion.one * q1 == q1 and quaternion.one == np.quaternion(1.0, 0.0, 0.0, 0.0)
+
+
 def test_constants():
+    assert quaternion.zero == np.quaternion(0.0, 0.0, 0.0, 0.0)
     assert quaternion.one == np.quaternion(1.0, 0.0, 0.0, 0.0)
     assert quaternion.x == np.quaternion(0.0, 1.0, 0.0, 0.0)
     assert quaternion.y == np.quaternion(0.0, 0.0, 1.0, 0.0)
@@ -210,16 +248,13 @@ def test_as_rotation_matrix(Rs):
     # Simply test that this function succeeds and returns the right shape
     assert quaternion.as_rotation_matrix(Rs.reshape((2, 5, 10))).shape == (2, 5, 10, 3, 3)
 
+    # Non-contiguous input
+    assert np.array_equal(quaternion.as_rotation_matrix(Rs[::3]), quaternion.as_rotation_matrix(Rs)[::3])
 
-def test_from_rotation_matrix(Rs):
-    try:
-        from scipy import linalg
-        have_linalg = True
-    except ImportError:
-        have_linalg = False
 
+def test_from_rotation_matrix(Rs):
     for nonorthogonal in [True, False]:
-        if nonorthogonal and have_linalg:
+        if nonorthogonal:
             rot_mat_eps = 10*eps
         else:
             rot_mat_eps = 5*eps
@@ -239,6 +274,32 @@ def test_from_rotation_matrix(Rs):
             d = quaternion.rotation_intrinsic_distance(R3, R4)
             assert d < rot_mat_eps, (R3, R4, d)  # Can't use allclose here; we don't care about rotor sign
 
+    # Each branch of Markley's algorithm, and non-contiguous matrices
+    for R in [quaternion.x, quaternion.y, quaternion.z, quaternion.one]:
+        R2 = quaternion.from_rotation_matrix(quaternion.as_rotation_matrix(np.array([R])), nonorthogonal=False)
+        assert quaternion.rotation_intrinsic_distance(R, R2[0]) < 5*eps
+    m = quaternion.as_rotation_matrix(Rs)
+    m_strided = np.swapaxes(np.swapaxes(m, 1, 2).copy(), 1, 2)
+    assert np.array_equal(quaternion.as_float_array(quaternion.from_rotation_matrix(m_strided, nonorthogonal=False)),
+                          quaternion.as_float_array(quaternion.from_rotation_matrix(m, nonorthogonal=False)))
+
+    # Bar-Itzhack's algorithm finds the nearest orthogonal matrix to a noisy one
+    np.random.seed(1234)
+    noisy = m + 1e-3 * np.random.normal(size=m.shape)
+    u, s, vh = np.linalg.svd(noisy)
+    nearest = np.matmul(u, vh)
+    R = quaternion.from_rotation_matrix(noisy)
+    assert np.allclose(quaternion.as_rotation_matrix(R), nearest, atol=1e-12)
+    assert np.allclose(np.norm(R), 1.0, atol=4*eps)
+    R2 = quaternion.from_rotation_matrix(noisy[0])
+    assert quaternion.rotation_intrinsic_distance(R2, R[0]) < 5*eps
+    # For arbitrary matrices, it finds the rotation nearest to each
+    arbitrary = np.random.normal(size=(1000, 3, 3))
+    u, s, vh = np.linalg.svd(arbitrary)
+    u[..., 2] *= np.linalg.det(np.matmul(u, vh))[..., np.newaxis]
+    nearest = np.matmul(u, vh)
+    assert np.allclose(quaternion.as_rotation_matrix(quaternion.from_rotation_matrix(arbitrary)), nearest, atol=1e-10)
+
 
 def test_as_rotation_vector():
     np.random.seed(1234)
@@ -265,6 +326,25 @@ def test_from_rotation_vector():
     assert allclose(quats, quats2)
 
 
+def test_rotation_vector_small_angles():
+    np.random.seed(1234)
+    n_tests = 1000
+    # Angles spanning the small-angle series and the transition from it
+    vecs = np.random.normal(size=(n_tests, 3))
+    vecs *= 10.0 ** np.random.uniform(-12, 0.5, size=(n_tests, 1)) / np.linalg.norm(vecs, axis=-1, keepdims=True)
+    quats = np.exp(quaternion.as_quat_array(np.insert(vecs / 2, 0, 0.0, axis=-1)))
+    assert np.max(np.abs(quaternion.as_float_array(quaternion.from_rotation_vector(vecs) - quats))) < 2 * eps
+    # The quaternions need not be normalized
+    norms = 10.0 ** np.random.uniform(-3, 3, size=n_tests)
+    vecs2 = quaternion.as_rotation_vector(quats * norms)
+    assert np.all(np.abs(vecs2 - vecs) <= 8 * eps * np.abs(vecs).max(axis=-1, keepdims=True))
+    assert np.array_equal(quaternion.as_rotation_vector(quaternion.one), [0.0, 0.0, 0.0])
+    # Strided input and output
+    rot = np.empty((n_tests, 6))[:, ::2]
+    rot[...] = vecs
+    assert np.array_equal(quaternion.from_rotation_vector(rot), quaternion.from_rotation_vector(vecs))
+
+
 def test_rotate_vectors(Rs):
     np.random.seed(1234)
     # Test (1)*(1)
@@ -319,6 +399,27 @@ def test_rotate_vectors(Rs):
                            [vprime.vec for vprime in quats * quaternion.quaternion(*vec) * ~quats],
                            rtol=1e-15, atol=1e-15)
     assert quats.shape + vecs.shape == vecsprime.shape, ("Out of shape!", quats.shape, vecs.shape, vecsprime.shape)
+    # Test (N)*(1) with a zero rotor
+    Rs0 = Rs.copy()
+    Rs0[Rs.shape[0]//2] = quaternion.zero
+    with pytest.raises(ZeroDivisionError):
+        quaternion.rotate_vectors(Rs0, np.random.rand(3))
+
+
+def test_rotate_vector_ufuncs(Rs):
+    np.random.seed(1234)
+    vecs = np.random.rand(Rs.shape[0], 3)
+    expected = np.array([(R * quaternion.quaternion(*v) * ~R).vec for R, v in zip(Rs, vecs)])
+    # Pairwise rotation of one vector per rotor
+    assert np.allclose(np.rotate_vector(Rs, vecs), expected, rtol=1e-15, atol=1e-15)
+    assert np.allclose(np.rotate_vector_and_normalize(Rs, vecs), expected, rtol=1e-15, atol=1e-15)
+    assert np.allclose(np.rotate_vector_and_normalize(1.1*Rs, vecs), expected, rtol=1e-15, atol=2e-15)
+    # Broadcasting, and non-contiguous vector axes
+    vecs_T = np.asfortranarray(vecs)
+    assert np.allclose(np.rotate_vector(Rs, vecs_T), expected, rtol=1e-15, atol=1e-15)
+    assert np.rotate_vector(Rs[:, np.newaxis], vecs[np.newaxis, :5]).shape == Rs.shape + (5, 3)
+    with pytest.raises(ValueError):
+        np.rotate_vector(Rs, np.random.rand(Rs.shape[0], 4))
 
 
 def test_allclose(Qs):
@@ -415,6 +516,29 @@ def test_as_euler_angles():
         assert d < 6e3*eps, ((alpha, beta, gamma), R1, R2, d)  # Can't use allclose here; we don't care about rotor sign
 
 
+def test_euler_angle_conventions():
+    np.random.seed(1843)
+    angles = np.random.uniform(-np.pi, np.pi, size=(5000, 3))
+    # Include the gimbal-lock cases, which are passed to the scalar code
+    angles[:4, 1] = [0.0, np.pi, np.pi/2, -np.pi/2]
+    basis = {'x': quaternion.x, 'y': quaternion.y, 'z': quaternion.z}
+    for convention in ['zyz', 'xyx', 'xzx', 'yxy', 'yzy', 'zxz', 'xyz', 'xzy', 'yxz', 'yzx', 'zxy', 'zyx']:
+        e1, e2, e3 = [basis[axis] for axis in convention]
+        R1 = (np.exp(e1 * angles[:, 0] / 2) * np.exp(e2 * angles[:, 1] / 2) * np.exp(e3 * angles[:, 2] / 2))
+        R2 = quaternion.from_euler_angles(angles, convention=convention)
+        assert np.max(np.abs(quaternion.as_float_array(R1 - R2))) < 4 * eps, convention
+        # Separate (and strided) arrays of angles give the same result
+        R3 = quaternion.from_euler_angles(angles[:, 0], angles[::-1, 1][::-1], angles[:, 2], convention=convention)
+        assert np.array_equal(R2, R3), convention
+        R4 = quaternion.from_euler_angles(quaternion.as_euler_angles(R1, convention=convention), convention=convention)
+        d = quaternion.rotation_intrinsic_distance(R1, R4)
+        assert np.max(d) < 6e3*eps, convention
+    with pytest.raises(ValueError):
+        quaternion.as_euler_angles(quaternion.one, convention='zzz')
+    with pytest.raises(ValueError):
+        quaternion.from_euler_angles(0.1, 0.2, 0.3, convention='abc')
+
+
 # Unary bool returners
 def test_quaternion_nonzero(Qs):
     assert not Qs[q_0].nonzero()  # Do this one explicitly, to not use circular logic
@@ -1036,6 +1160,31 @@ def test_slerp(Rs):
                             verbose=True)
 
 
+def test_slerp_unit():
+    np.random.seed(1234)
+    f = quaternion.as_float_array
+    q1 = np.normalized(quaternion.as_quat_array(np.random.normal(size=(103, 4))))
+    q2 = np.normalized(quaternion.as_quat_array(np.random.normal(size=(103, 4))))
+    # Include identical, antipodal, and nearby pairs
+    q2[:5] = q1[:5]
+    q2[5:10] = -q1[5:10]
+    q2[10:15] = np.normalized(q1[10:15] + quaternion.quaternion(0, 1.e-9, 0, 0))
+    tau = np.random.uniform(-0.5, 1.5, size=103)
+    # The closed form must agree with the general slerp for unit rotors
+    assert np.allclose(f(np.slerp_unit_vectorized(q1, q2, tau)), f(np.slerp_vectorized(q1, q2, tau)),
+                       atol=1.e-14, rtol=1.e-14)
+    # The segment-wise version must agree with the broadcast elementwise version
+    tau = np.linspace(-0.25, 1.25, num=37)
+    expected = np.slerp_vectorized(q1[:, np.newaxis], q2[:, np.newaxis], tau)
+    assert np.slerp_unit_segment_vectorized(q1, q2, tau).shape == (103, 37)
+    assert np.allclose(f(np.slerp_unit_segment_vectorized(q1, q2, tau)), f(expected), atol=1.e-14, rtol=1.e-14)
+    assert np.allclose(f(np.slerp_unit_vectorized(q1[:, np.newaxis], q2[:, np.newaxis], tau)), f(expected),
+                       atol=1.e-14, rtol=1.e-14)
+    assert np.allclose(f(quaternion.slerp(q1[20], q2[20], 0.0, 1.0, tau)), f(expected[20]), atol=1.e-14, rtol=1.e-14)
+    # Non-finite values follow the scalar function
+    assert np.all(np.isnan(f(np.slerp_unit_vectorized(q1[:3], q2[:3], np.nan))))
+
+
 @pytest.mark.skipif(os.environ.get('FAST'), reason="Takes ~2 seconds")
 def test_squad(Rs):
     from quaternion import slerp_evaluate
@@ -1076,6 +1225,136 @@ def test_squad(Rs):
         # assert False # Test unequal input time steps, and correct squad output [0,-2,-1]
 
 
+def test_squad_coefficients():
+    np.random.seed(1234)
+    f = quaternion.as_float_array
+    t_in = np.sort(np.random.uniform(0.0, 10.0, size=53))
+    R_in = np.normalized(quaternion.as_quat_array(np.cumsum(np.random.normal(scale=0.1, size=(53, 4)), axis=0)
+                                                  + [1, 0, 0, 0]))
+    # Compare to the expressions for the control points, with the ends extended by reflection
+    A = R_in * np.exp((- np.log((~R_in) * np.roll(R_in, -1))
+                       + np.log((~np.roll(R_in, 1)) * R_in) * ((np.roll(t_in, -1) - t_in) / (t_in - np.roll(t_in, 1)))
+                       ) * 0.25)
+    B = np.roll(R_in, -1) * np.exp((np.log((~np.roll(R_in, -1)) * np.roll(R_in, -2))
+                                    * ((np.roll(t_in, -1) - t_in) / (np.roll(t_in, -2) - np.roll(t_in, -1)))
+                                    - np.log((~R_in) * np.roll(R_in, -1))) * -0.25)
+    A[0], A[-1], B[-2], B[-1] = R_in[0], R_in[-1], R_in[-1], R_in[-1] * (~R_in[-2]) * R_in[-1]
+    A_c, B_c = quaternion.squad_coefficients(R_in, t_in)
+    assert np.allclose(f(A_c), f(A), atol=1.e-14, rtol=1.e-14)
+    assert np.allclose(f(B_c), f(B), atol=1.e-14, rtol=1.e-14)
+    # Several series at once, along the final axis
+    A_c, B_c = quaternion.squad_coefficients(np.array([R_in, R_in[::-1]]), np.array([t_in, t_in]))
+    assert A_c.shape == B_c.shape == (2, 53)
+    assert np.array_equal(f(A_c[0]), f(quaternion.squad_coefficients(R_in, t_in)[0]))
+    # Trivial series
+    A_c, B_c = quaternion.squad_coefficients(R_in[:1], t_in[:1])
+    assert A_c[0] == R_in[0] and B_c[0] == R_in[0]
+    assert quaternion.squad_coefficients(R_in[:0], t_in[:0])[0].shape == (0,)
+
+
+def test_squad_interpolator():
+    np.random.seed(1234)
+    f = quaternion.as_float_array
+    t_in = np.sort(np.random.uniform(0.0, 10.0, size=41))
+    R_in = np.normalized(quaternion.as_quat_array(np.cumsum(np.random.normal(scale=0.3, size=(41, 4)), axis=0)
+                                                  + [1, 0, 0, 0]))
+    interpolator = quaternion.SquadInterpolator(R_in, t_in)
+    # Same as `squad`, for sorted and unsorted times, including beyond the last input
+    t_out = np.linspace(t_in[0], t_in[-1] + 0.5, 1001)
+    R_out = quaternion.squad(R_in, t_in, t_out)
+    assert np.array_equal(f(interpolator(t_out)), f(R_out))
+    permutation = np.random.permutation(len(t_out))
+    assert np.array_equal(f(interpolator(t_out[permutation])), f(R_out[permutation]))
+    assert interpolator(t_out[500]) == R_out[500]
+    # Angular velocity, compared to centered differences
+    t_out = np.linspace(t_in[0] + 0.01, t_in[-1] + 0.4, 777)
+    h = 1.e-6
+    Rdot = (interpolator(t_out + h) - interpolator(t_out - h)) / (2 * h)
+    Omega = 2 * f(Rdot * ~interpolator(t_out))[:, 1:]
+    Omega_c = interpolator.angular_velocity(t_out)
+    assert Omega_c.shape == (777, 3)
+    assert np.allclose(Omega_c, Omega, atol=1.e-6, rtol=1.e-6)
+    assert interpolator.angular_velocity(t_out[5]).shape == (3,)
+    with pytest.raises(ValueError):
+        quaternion.SquadInterpolator(R_in[:1], t_in[:1])
+    with pytest.raises(ValueError):
+        quaternion.SquadInterpolator(R_in, t_in[:-1])
+
+
+def test_rotor_time_series_file(tmpdir):
+    np.random.seed(1234)
+    f = quaternion.as_float_array
+    t_in = np.cumsum(np.random.uniform(0.5, 1.5, size=1000))
+    R_in = quaternion.from_rotation_vector(np.cumsum(np.random.normal(scale=0.05, size=(1000, 3)), axis=0))
+    path = str(tmpdir.join('rotors.qts'))
+    with quaternion.RotorTimeSeriesWriter(path, chunk_size=64) as writer:
+        writer.append(t_in[:500], R_in[:500])
+        writer.append(t_in[500:], R_in[500:], codec='zlib')
+        with pytest.raises(ValueError):
+            writer.append(t_in[:10], R_in[:10])
+    with quaternion.RotorTimeSeriesFile(path) as series:
+        assert len(series) == 1000 and series.n_chunks == 16
+        assert series.t_range == (t_in[0], t_in[-1])
+        # Uncompressed chunks are views of the file
+        t, R = series.chunk(1)
+        assert not t.flags.owndata and not R.flags.owndata and R.dtype == np.quaternion
+        assert np.array_equal(t, t_in[64:128]) and np.array_equal(f(R), f(R_in[64:128]))
+        t, R = series.load()
+        assert np.array_equal(t, t_in) and np.array_equal(f(R), f(R_in))
+        t, R = series.load(490, 510)
+        assert np.array_equal(t, t_in[490:510]) and np.array_equal(f(R), f(R_in[490:510]))
+        assert np.array_equal(series.sample_index([t_in[0] - 1, t_in[0], t_in[700] + 1e-9, t_in[-1] + 1]),
+                              [-1, 0, 700, 999])
+        # Interpolation only needs the chunks around `t_out`
+        interpolator = quaternion.SquadInterpolator(R_in, t_in)
+        for t_out in [np.linspace(t_in[300], t_in[310], 101), np.linspace(t_in[0] - 1, t_in[-1] + 1, 1001)]:
+            assert np.array_equal(f(series.squad(t_out)), f(interpolator(t_out)))
+            assert np.array_equal(f(quaternion.squad(series, None, t_out)), f(interpolator(t_out)))
+        t_out = np.linspace(t_in[300], t_in[310], 101)
+        i = np.searchsorted(t_in, t_out, side='right') - 1
+        R_out = quaternion.slerp(R_in[i], R_in[i + 1], t_in[i], t_in[i + 1], t_out)
+        assert np.allclose(f(series.slerp(t_out)), f(R_out), rtol=0.0, atol=4*eps)
+    # Lossy codecs
+    for codec in ['rotor32', 'rotor48', 'rotor64']:
+        quaternion.write_rotor_time_series(path, t_in, R_in, chunk_size=100, codec=codec)
+        series = quaternion.RotorTimeSeriesFile(path)
+        t, R = series.load()
+        assert np.array_equal(t, t_in)
+        assert np.array_equal(f(R), f(quaternion.decode_rotors(quaternion.encode_rotors(R_in, int(codec[5:])),
+                                                                int(codec[5:]))))
+    with pytest.raises(ValueError):
+        quaternion.write_rotor_time_series(path, t_in, R_in, codec='gzip')
+
+
+def test_byteswapped_and_unaligned_data(tmpdir):
+    np.random.seed(1234)
+    f = np.random.normal(size=(1001, 4))
+    for dtype, float_dtype in [(np.quaternion, np.float64), (np.quaternionf, np.float32)]:
+        q = quaternion.as_quat_array(f.astype(float_dtype))
+        swapped = np.dtype(dtype).newbyteorder('S')
+        # Foreign-endian buffers and files
+        b = np.frombuffer(f.astype(float_dtype).byteswap().tobytes(), dtype=swapped)
+        assert np.array_equal(b.astype(dtype), q)
+        assert np.array_equal(b[::3].astype(dtype), q[::3])
+        path = str(tmpdir.join('swapped.bin'))
+        b.tofile(path)
+        assert np.array_equal(np.fromfile(path, dtype=swapped).astype(dtype), q)
+        c = b.copy()
+        c.byteswap(inplace=True)
+        assert np.array_equal(c.view(dtype), q)
+        z = np.zeros(3, dtype=swapped)
+        z[1] = quaternion.x
+        assert np.array_equal(z.nonzero()[0], [1])
+        # Unaligned fields of packed records
+        for byteorder in ['=', 'S']:
+            record = np.dtype([('t', 'u1'), ('q', np.dtype(dtype).newbyteorder(byteorder))], align=False)
+            r = np.zeros(len(q), dtype=record)
+            r['q'] = q
+            assert np.array_equal(r['q'].astype(dtype), q)
+            assert np.array_equal(r['q'].copy(), q)
+            assert np.array_equal(np.nonzero(r['q'])[0], np.nonzero(q)[0])
+
+
 @pytest.mark.xfail
 def test_arrfuncs():
     # nonzero
@@ -1203,6 +1482,392 @@ def test_ufuncs(Rs, Qs):
                        np.zeros(Qs[Qs_finitenonzero].shape), atol=1.e-14, rtol=1.e-15)
 
 
+def test_contiguous_ufuncs():
+    "Check that contiguous (block-wise) and strided loops agree"
+    np.random.seed(1234)
+    f = quaternion.as_float_array
+    for N in [0, 1, 3, 4, 7, 8, 9, 17, 1000]:
+        q1 = quaternion.as_quat_array(np.random.normal(size=(N, 4)))
+        q2 = quaternion.as_quat_array(np.random.normal(size=(N, 4)))
+        # Interleaving with a second array forces the strided loops
+        s1 = np.empty(2*N, dtype=np.quaternion)
+        s1[::2] = q1
+        s2 = np.empty(2*N, dtype=np.quaternion)
+        s2[::2] = q2
+        for ufunc in [np.norm, np.absolute]:
+            assert np.allclose(ufunc(q1), ufunc(s1[::2]), atol=1.e-14, rtol=1.e-15)
+        for ufunc in [np.conjugate, np.normalized]:
+            assert np.allclose(f(ufunc(q1)), f(ufunc(s1[::2])), atol=1.e-14, rtol=1.e-15)
+        for ufunc in [np.add, np.multiply, np.divide, np.true_divide, np.floor_divide]:
+            assert np.allclose(f(ufunc(q1, q2)), f(ufunc(s1[::2], s2[::2])), atol=1.e-14, rtol=1.e-15)
+        # In-place operation, and the overlapping operands used by accumulate
+        q3 = q1.copy()
+        np.multiply(q3, q2, out=q3)
+        assert np.allclose(f(q3), f(q1 * q2), atol=1.e-14, rtol=1.e-15)
+        r1 = np.normalized(q1[:20])
+        assert np.allclose(f(np.multiply.accumulate(r1)), f(np.multiply.accumulate(np.normalized(s1[:40:2]))),
+                           atol=1.e-14, rtol=1.e-15)
+
+
+def test_dispatch():
+    features = quaternion._cpu_features()
+    assert set(features) == {'sse2', 'avx', 'avx2', 'fma', 'avx512f'}
+    info = quaternion._dispatch_info()
+    assert {'norm', 'absolute', 'conjugate', 'normalized', 'add', 'multiply', 'divide'} <= set(info)
+    assert {'from_euler_angles_zyz_vectorized', 'as_euler_angles_xyz_vectorized',
+            'from_spherical_coords_vectorized', 'as_spherical_coords_vectorized',
+            'from_rotation_vector_vectorized', 'as_rotation_vector_vectorized',
+            '_soa_multiply', '_soa_divide',
+            'encode_rotor32', 'decode_rotor48', 'encode_rotor64', 'gyro_propagate_vectorized'} <= set(info)
+    level = info['multiply']
+    if features['avx512f'] and features['avx2'] and features['fma'] and 'QUATERNION_SIMD' not in os.environ:
+        assert level == 'avx512'
+    with pytest.raises(ValueError):
+        quaternion._set_dispatch('no_such_level')
+    # Every supported level must agree with the strided loops
+    np.random.seed(1234)
+    f = quaternion.as_float_array
+    q1 = quaternion.as_quat_array(np.random.normal(size=(103, 4)))
+    q2 = quaternion.as_quat_array(np.random.normal(size=(103, 4)))
+    s1, s2 = np.repeat(q1, 2)[::2], np.repeat(q2, 2)[::2]
+    try:
+        for name in ['baseline', 'avx2', 'avx512']:
+            try:
+                quaternion._set_dispatch(name)
+            except ValueError:
+                continue
+            assert quaternion._dispatch_info()['multiply'] == name
+            for ufunc in [np.norm, np.absolute]:
+                assert np.allclose(ufunc(q1), ufunc(s1), atol=1.e-14, rtol=1.e-15)
+            for ufunc in [np.conjugate, np.normalized]:
+                assert np.allclose(f(ufunc(q1)), f(ufunc(s1)), atol=1.e-14, rtol=1.e-15)
+            for ufunc in [np.add, np.multiply, np.divide]:
+                assert np.allclose(f(ufunc(q1, q2)), f(ufunc(s1, s2)), atol=1.e-14, rtol=1.e-15)
+    finally:
+        quaternion._set_dispatch(level)
+
+def test_batched_transcendentals():
+    # The vectorized exp/log/power/slerp/squad loops must agree with the scalar functions
+    np.random.seed(1234)
+    f = quaternion.as_float_array
+    q1 = quaternion.as_quat_array(np.random.normal(size=(103, 4)) * np.random.choice([1.e-3, 1., 3.], size=(103, 1)))
+    q2 = quaternion.as_quat_array(np.random.normal(size=(103, 4)))
+    s = np.random.normal(size=103)
+    tau = np.random.uniform(-0.5, 1.5, size=103)
+    r1, r2, r3, r4 = [np.normalized(quaternion.as_quat_array(np.random.normal(size=(103, 4)))) for i in range(4)]
+    # Special values, which are handed to the scalar functions
+    special = quaternion.as_quat_array([[0, 0, 0, 0], [1, 0, 0, 0], [-1, 0, 0, 0], [2.5, 0, 0, 0],
+                                        [0, 1.e-20, 0, 0], [1.e-200, 1.e-200, 0, 0], [-3, 1.e-17, 0, 0],
+                                        [np.nan, 0, 0, 0], [1.e200, 1, 1, 1], [3, 1.e6, 0, 0]])
+    expected = [
+        (np.exp, (q1,), lambda a: a.exp()),
+        (np.log, (q1,), lambda a: a.log()),
+        (np.power, (q1, q2), lambda a, b: a ** b),
+        (np.power, (q1, s), lambda a, b: a ** b),
+        (np.slerp_vectorized, (r1, r2, tau), quaternion.slerp_evaluate),
+        (np.squad_vectorized, (tau, r1, r2, r3, r4), quaternion.squad_evaluate),
+    ]
+    level = quaternion._dispatch_info()['exp']
+    accuracy = quaternion.get_accuracy()
+    assert accuracy == 'accurate'
+    with pytest.raises(ValueError):
+        quaternion.set_accuracy('sloppy')
+    try:
+        for name in ['baseline', 'avx2', 'avx512']:
+            try:
+                quaternion._set_dispatch(name)
+            except ValueError:
+                continue
+            for mode, tol in [('accurate', 1.e-13), ('fast', 1.e-11)]:
+                assert quaternion.set_accuracy(mode) in ['accurate', 'fast']
+                for ufunc, args, scalar in expected:
+                    result = np.array([scalar(*a) for a in zip(*args)])
+                    assert np.allclose(f(ufunc(*args)), f(result), atol=tol, rtol=tol)
+                    strided = [np.repeat(a, 2)[::2] for a in args]
+                    assert np.allclose(f(ufunc(*strided)), f(result), atol=tol, rtol=tol)
+                with np.errstate(all='ignore'):
+                    for ufunc in [np.exp, np.log]:
+                        result = np.array([ufunc(a) for a in special])
+                        assert np.array_equal(f(ufunc(special)), f(result), equal_nan=True)
+                    a = q1.copy()
+                    np.exp(a, out=a)
+                    assert np.allclose(f(a), f(np.exp(q1)), atol=tol, rtol=tol)
+    finally:
+        quaternion._set_dispatch(level)
+        quaternion.set_accuracy(accuracy)
+
+
+def test_num_threads():
+    # Loops split among threads must give exactly the same results as a single thread
+    np.random.seed(1234)
+    f = quaternion.as_float_array
+    n = 100003
+    q1 = quaternion.as_quat_array(np.random.normal(size=(n, 4)))
+    q2 = quaternion.as_quat_array(np.random.normal(size=(n, 4)))
+    tau = np.random.uniform(size=n)
+    operations = [lambda: q1 * q2, lambda: q1 / q2, lambda: q1 + q2, lambda: np.conjugate(q1),
+                  lambda: np.normalized(q1), lambda: np.abs(q1), lambda: np.exp(q1), lambda: np.log(q1),
+                  lambda: q1 ** q2, lambda: q1 ** 0.3, lambda: np.slerp_vectorized(q1, q2, tau),
+                  lambda: np.squad_vectorized(tau, q1, q2, q2, q1), lambda: np.multiply.accumulate(q1[:1000])]
+    num_threads = quaternion.get_num_threads()
+    try:
+        assert quaternion.set_num_threads(1) == num_threads
+        expected = [op() for op in operations]
+        assert quaternion.set_num_threads(4) == 1
+        assert quaternion.get_num_threads() == 4
+        for op, result in zip(operations, expected):
+            assert np.array_equal(f(op()) if result.dtype == np.quaternion else op(),
+                                  f(result) if result.dtype == np.quaternion else result)
+        a = q1.copy()
+        np.exp(a, out=a)
+        assert np.array_equal(f(a), f(expected[6]))
+        with pytest.raises(ValueError):
+            quaternion.set_num_threads(0)
+        with pytest.raises(ValueError):
+            quaternion.set_num_threads(100000)
+    finally:
+        quaternion.set_num_threads(num_threads)
+
+
+def test_product():
+    np.random.seed(1234)
+    f = quaternion.as_float_array
+    q = np.normalized(quaternion.as_quat_array(np.random.normal(size=(5000, 4))))
+    # reduce and accumulate must multiply in order, exactly as a simple loop does
+    expected = [q[0]]
+    for q_i in q[1:]:
+        expected.append(expected[-1] * q_i)
+    expected = np.array(expected)
+    assert np.multiply.reduce(q) == expected[-1]
+    assert np.array_equal(f(np.multiply.accumulate(q)), f(expected))
+    assert np.array_equal(f(np.multiply.accumulate(q[::-3])[-1:]), f([np.multiply.reduce(q[::-3])]))
+    assert np.add.reduce(q) == quaternion.as_quat_array(np.cumsum(f(q), axis=0)[-1])
+    assert np.array_equal(f(np.add.accumulate(q)), np.cumsum(f(q), axis=0))
+    assert quaternion.product(q) == expected[-1]
+    assert np.array_equal(f(quaternion.cumulative_product(q)), f(expected))
+    assert quaternion.product(q[:0]) == quaternion.one
+    # Other axes, which numpy may reduce with the vectorized elementwise loops
+    Q = q.reshape(10, 20, 25)
+    assert np.allclose(f(quaternion.product(Q, axis=1)), f(np.multiply.reduce(Q, axis=1)), atol=1e-14)
+    assert np.allclose(f(quaternion.cumulative_product(Q, axis=0)), f(np.multiply.accumulate(Q, axis=0)),
+                       atol=1e-14)
+    # Renormalization
+    R = quaternion.cumulative_product(q, renormalize=1)
+    assert np.allclose(f(R), f(expected), atol=1e-12)
+    assert np.max(np.abs(np.norm(R) - 1)) < 1e-15
+    # Tree mode, which must not depend on the number of threads
+    num_threads = quaternion.get_num_threads()
+    try:
+        for tree in [True, 7, 1000]:
+            quaternion.set_num_threads(1)
+            P = quaternion.product(q, tree=tree)
+            C = quaternion.cumulative_product(q, tree=tree)
+            assert np.allclose(f(P), f(expected[-1]), atol=1e-12)
+            assert np.allclose(f(C), f(expected), atol=1e-12)
+            quaternion.set_num_threads(3)
+            assert quaternion.product(q, tree=tree) == P
+            assert np.array_equal(f(quaternion.cumulative_product(q, tree=tree)), f(C))
+    finally:
+        quaternion.set_num_threads(num_threads)
+    with pytest.raises(ValueError):
+        quaternion.product(q, tree=1)
+
+
+def test_mean_rotor_in_intrinsic_metric():
+    from quaternion.means import mean_rotor_in_intrinsic_metric
+    np.random.seed(1234)
+    f = quaternion.as_float_array
+    R0 = np.quaternion(1, 2, 3, 4).normalized()
+    R = R0 * quaternion.from_rotation_vector(np.random.normal(scale=0.3, size=(1000, 3)))
+    # The mean is the point where the average logarithm relative to the mean vanishes
+    mean = mean_rotor_in_intrinsic_metric(R)
+    assert type(mean) == np.quaternion
+    assert np.max(np.abs(f(np.log(mean.conjugate() * R)).mean(axis=0))) < 1e-13
+    assert abs(mean.norm() - 1) < 1e-15
+    # Rotations about a single axis average their angles
+    angles = np.array([0.1, 0.2, 0.6, -0.3])
+    assert quaternion.isclose(mean_rotor_in_intrinsic_metric(np.exp(quaternion.z * angles / 2)),
+                              np.exp(quaternion.z * angles.mean() / 2), rtol=1e-14)
+    # Weights and time steps
+    weights = np.random.uniform(size=4)
+    assert quaternion.isclose(mean_rotor_in_intrinsic_metric(np.exp(quaternion.z * angles / 2), weights=weights),
+                              np.exp(quaternion.z * np.average(angles, weights=weights) / 2), rtol=1e-14)
+    t = np.array([0.0, 1.0, 3.0, 3.5])
+    assert quaternion.isclose(mean_rotor_in_intrinsic_metric(np.exp(quaternion.z * angles / 2), t=t),
+                              np.exp(quaternion.z * np.average(angles, weights=[0.5, 1.5, 1.25, 0.25]) / 2),
+                              rtol=1e-14)
+    # Other axes of N-dimensional arrays are averaged independently, shared among threads
+    Q = R.reshape(10, 25, 4)
+    for axis in range(3):
+        means = mean_rotor_in_intrinsic_metric(Q, axis=axis)
+        assert means.shape == Q.shape[:axis] + Q.shape[axis+1:]
+        assert means[1, 2] == mean_rotor_in_intrinsic_metric(np.moveaxis(Q, axis, -1)[1, 2])
+    num_threads = quaternion.get_num_threads()
+    try:
+        quaternion.set_num_threads(3)
+        assert np.array_equal(f(mean_rotor_in_intrinsic_metric(Q, axis=1)),
+                              f([[mean_rotor_in_intrinsic_metric(Q[i, :, j]) for j in range(4)] for i in range(10)]))
+    finally:
+        quaternion.set_num_threads(num_threads)
+    # Degenerate cases
+    assert quaternion.isclose(mean_rotor_in_intrinsic_metric(R[:1]), R[0])
+    with pytest.warns(RuntimeWarning):
+        mean_rotor_in_intrinsic_metric(R, max_iterations=1)
+    with pytest.raises(ValueError):
+        mean_rotor_in_intrinsic_metric(R, t=t)
+    with pytest.raises(ValueError):
+        mean_rotor_in_intrinsic_metric(R[:0])
+    with pytest.raises(ValueError):
+        mean_rotor_in_intrinsic_metric(R[:4], weights=np.zeros(4))
+    weights = np.ones(Q.shape)
+    weights[3, :, 2] = 0.0
+    with pytest.raises(ValueError):
+        mean_rotor_in_intrinsic_metric(Q, axis=1, weights=weights)
+
+def test_quaternionf():
+    np.random.seed(1234)
+    f = quaternion.as_float_array
+    a = np.random.normal(size=(1000, 4)).astype(np.float32)
+    qf = quaternion.as_quat_array(a)
+    assert qf.dtype == np.dtype(quaternion.quaternionf)
+    assert qf.itemsize == 16
+    assert f(qf).dtype == np.float32
+    assert np.shares_memory(f(qf), a)
+    assert np.array_equal(f(qf), a)
+    # Casts: widening is exact and safe; narrowing rounds each component
+    q = qf.astype(np.quaternion)
+    assert np.can_cast(quaternion.quaternionf, np.quaternion)
+    assert not np.can_cast(np.quaternion, quaternion.quaternionf)
+    assert np.array_equal(f(q), a.astype(np.float64))
+    assert np.array_equal(f(np.exp(q).astype(quaternion.quaternionf)), f(np.exp(q)).astype(np.float32))
+    assert np.array_equal(f(np.ones(3, dtype=np.float32).astype(quaternion.quaternionf)),
+                          [[1, 0, 0, 0]]*3)
+    # Operations computed in double precision give the correctly rounded result
+    def rounded(x):
+        return f(x).astype(np.float32)
+    for ufunc in [np.exp, np.log, np.normalized, np.conjugate, np.negative, np.sqrt_of_rotor]:
+        assert ufunc(qf).dtype == np.dtype(quaternion.quaternionf)
+        assert np.array_equal(f(ufunc(qf)), rounded(ufunc(q)))
+    for ufunc in [np.norm, np.absolute]:
+        assert ufunc(qf).dtype == np.float32
+        assert np.array_equal(ufunc(qf), ufunc(q).astype(np.float32))
+    assert np.array_equal(f(qf / qf[::-1]), rounded(q / q[::-1]))
+    assert np.array_equal(f(qf ** 1.5), rounded(q ** 1.5))
+    assert np.array_equal(qf == qf[::-1], q == q[::-1])
+    assert np.array_equal(np.rotor_intrinsic_distance(qf, qf[::-1]),
+                          np.rotor_intrinsic_distance(q, q[::-1]).astype(np.float32))
+    # Addition, subtraction, and multiplication are computed in single precision
+    for ufunc in [np.add, np.subtract, np.multiply]:
+        assert ufunc(qf, qf[::-1]).dtype == np.dtype(quaternion.quaternionf)
+        assert ufunc(qf, np.float32(2)).dtype == np.dtype(quaternion.quaternionf)
+        assert np.allclose(f(ufunc(qf, qf[::-1])), f(ufunc(q, q[::-1])), rtol=1e-6, atol=1e-6)
+        assert np.allclose(f(ufunc(qf[::2], 2.5)), f(ufunc(q[::2], 2.5)), rtol=1e-6, atol=1e-6)
+        assert np.allclose(f(ufunc(2.5, qf[::2])), f(ufunc(2.5, q[::2])), rtol=1e-6, atol=1e-6)
+    assert np.array_equal(f(qf + qf[::-1]), a + a[::-1])
+    # Mixing with double precision promotes to `quaternion`
+    assert (qf * q).dtype == np.dtype(np.quaternion)
+    assert (q * qf).dtype == np.dtype(np.quaternion)
+    assert (qf * np.ones(len(qf))).dtype == np.dtype(np.quaternion)
+    # Reductions and in-place operations
+    expected = qf[:1]
+    for i in range(1, 20):
+        expected = expected * qf[i:i+1]
+    assert np.multiply.reduce(qf[:20]) == expected[0]
+    assert np.multiply.accumulate(qf[:20])[-1] == expected[0]
+    b = qf.copy()
+    b *= qf[::-1]
+    assert np.array_equal(f(b), f(qf * qf[::-1]))
+    # Scalars and element access
+    s = quaternion.quaternionf(1, 2, 3, 4)
+    assert (s.w, s.x, s.y, s.z) == (1, 2, 3, 4)
+    assert s.as_quaternion() == np.quaternion(1, 2, 3, 4)
+    b[0] = np.quaternion(1.5, 2, 3, 4)
+    assert b[0] == np.quaternion(1.5, 2, 3, 4)
+    assert np.array_equal(f(qf.byteswap().byteswap()), a)
+
+
+def test_quaternion_array():
+    np.random.seed(1234)
+    f = quaternion.as_float_array
+    q1 = quaternion.as_quat_array(np.random.normal(size=(100, 4)))
+    q2 = quaternion.as_quat_array(np.random.normal(size=(100, 4)))
+    a1, a2 = quaternion.QuaternionArray(q1), quaternion.QuaternionArray(q2)
+    assert a1.shape == q1.shape and a1.components.shape == (4, 100) and a1.components.flags['C_CONTIGUOUS']
+    assert np.array_equal(a1.as_quat_array(), q1)
+    assert np.array_equal(np.asarray(a1), q1)
+    # Component views share memory
+    assert np.array_equal(a1.w, f(q1)[:, 0]) and np.array_equal(a1.vec, f(q1)[:, 1:].T)
+    b = a1.copy()
+    b.vec[...] = 0.0
+    b.x = 1.0
+    assert np.array_equal(f(np.asarray(b)), np.column_stack((f(q1)[:, 0], np.ones(100), np.zeros(100), np.zeros(100))))
+    assert np.array_equal(np.asarray(a1), q1)
+    # Arithmetic agrees with the dtype, with every kind of operand
+    for op in [operator.add, operator.sub, operator.mul, operator.truediv]:
+        for x, y in [(a1, a2), (a1, q2), (q1, a2), (a1, q2[3]), (q1[3], a2), (a1, 1.7), (2.3, a2), (a1[::2], a2[1::2])]:
+            expected = op(np.asarray(x) if isinstance(x, quaternion.QuaternionArray) else x,
+                          np.asarray(y) if isinstance(y, quaternion.QuaternionArray) else y)
+            result = op(x, y)
+            assert isinstance(result, quaternion.QuaternionArray)
+            assert np.allclose(f(np.asarray(result)), f(expected), rtol=4*eps, atol=40*eps), (op, x, y)
+    b = a1.copy()
+    b *= a2
+    b += 1.0
+    b /= a2
+    assert np.allclose(f(np.asarray(b)), f((q1 * q2 + 1.0) / q2), rtol=10*eps, atol=10*eps)
+    assert np.allclose(f(np.asarray(-a1)), f(-q1), rtol=0.0, atol=0.0)
+    assert np.array_equal(f(np.asarray(a1.conjugate())), f(np.conjugate(q1)))
+    assert np.allclose(a1.norm(), np.norm(q1), rtol=2*eps, atol=0.0)
+    assert np.allclose(abs(a1), np.absolute(q1), rtol=2*eps, atol=0.0)
+    assert np.allclose(f(np.asarray(a1.inverse())), f(1 / q1), rtol=2*eps, atol=0.0)
+    assert np.array_equal(a1 == a1, np.ones(100, dtype=bool)) and not np.any(a1 != a1)
+    # Other ufuncs are applied to arrays of quaternions
+    assert np.array_equal(f(np.asarray(np.exp(a1))), f(np.exp(q1)))
+    assert np.array_equal(f(np.asarray(a1 ** 2.5)), f(q1 ** 2.5))
+    assert np.array_equal(np.rotor_intrinsic_distance(a1, a2), np.rotor_intrinsic_distance(q1, q2))
+    # Indexing
+    assert a1[3] == q1[3]
+    assert np.array_equal(np.asarray(a1[10:20]), q1[10:20])
+    b = a1.copy()
+    b[10:20] = q2[10:20]
+    b[0] = quaternion.one
+    assert np.array_equal(np.asarray(b)[10:20], q2[10:20]) and b[0] == quaternion.one
+
+
+def test_rotor_encoding():
+    from quaternion.rotor_encoding import max_angular_error
+    np.random.seed(1234)
+    q = quaternion.as_quat_array(np.random.normal(size=(100000, 4)))
+    # Include components that tie for the largest magnitude
+    q[:4] = [quaternion.quaternion(1, 1, 0, 0), quaternion.quaternion(-1, 1, 1, 1),
+             quaternion.quaternion(0, 0, -1, 1), quaternion.z]
+    r = np.normalized(q)
+    for bits, dtype in [(32, np.uint32), (48, np.uint64), (64, np.uint64)]:
+        codes = quaternion.encode_rotors(q, bits)
+        assert codes.dtype == dtype and codes.shape == q.shape
+        if bits == 48:
+            assert np.all(codes >> np.uint64(48) == 0)
+        decoded = quaternion.decode_rotors(codes, bits)
+        assert decoded.shape == q.shape
+        assert np.allclose(np.norm(decoded), 1.0, rtol=0.0, atol=4*eps)
+        # Either sign is the same rotation
+        error = np.minimum(quaternion.rotor_intrinsic_distance(r, decoded),
+                           quaternion.rotor_intrinsic_distance(r, -decoded))
+        assert np.max(error) < max_angular_error[bits], bits
+        # The identity and rotations by pi are exact
+        for b in [quaternion.one, quaternion.x, quaternion.y, quaternion.z]:
+            assert quaternion.decode_rotors(quaternion.encode_rotors(b, bits), bits) == b
+    with pytest.raises(ValueError):
+        quaternion.encode_rotors(q, 16)
+    e = quaternion.EncodedRotorArray.from_quat_array(q)
+    assert len(e) == len(q) and e.nbytes == 4 * len(q)
+    assert np.array_equal(np.asarray(e), quaternion.decode_rotors(e.codes))
+    assert e[10] == quaternion.decode_rotors(e.codes[10:11])[0]
+    assert np.array_equal(e[10:20], np.asarray(e)[10:20])
+    e[0] = quaternion.x
+    assert e[0] == quaternion.x
+
+
 def test_numpy_array_conversion(Qs):
     "Check conversions between array as quaternions and array as floats"
     # First, just check 1-d array
@@ -1304,6 +1969,208 @@ def test_integrate_angular_velocity():
     phi_Delta = np.array([quaternion.rotation_intrinsic_distance(e, a) for e, a in zip(R_exact, R_approx)])
     assert np.max(phi_Delta) < 1e-4, np.max(phi_Delta)
 
+    # The Lie-group integrator, with each form of Omega, is fourth order and preserves the norm
+    errors = []
+    for N in [2000, 4000]:
+        t = np.linspace(0.0, t2, N)
+        v = np.array([Omega_tot(ti) for ti in t])
+        R_exact = np.array([R(ti) for ti in t])
+        for Omega in [v, Omega_tot, lambda t, R: Omega_tot(t)]:
+            R_approx = quaternion.integrate_angular_velocity_rkmk4(Omega, t, R0=R(t0))
+            assert np.max(np.abs(np.norm(R_approx) - 1)) < 4e-15
+            errors.append(np.max(quaternion.rotation_intrinsic_distance(R_exact, R_approx)))
+    assert all(e_N / e_2N > 12 for e_N, e_2N in zip(errors[:3], errors[3:])), errors
+    assert max(errors[3:]) < 1e-5, errors
+
+    # Many trajectories at once, shared among threads, match single trajectories
+    np.random.seed(1234)
+    t = np.cumsum(np.random.uniform(0.5, 1.5, size=300))
+    v = np.random.normal(scale=0.1, size=(7, 5, 300, 3))
+    R0 = quaternion.from_rotation_vector(np.random.normal(size=(5, 3)))
+    num_threads = quaternion.get_num_threads()
+    try:
+        quaternion.set_num_threads(3)
+        R_batch = quaternion.integrate_angular_velocity_rkmk4(v, t, R0)
+    finally:
+        quaternion.set_num_threads(num_threads)
+    assert R_batch.shape == (7, 5, 300)
+    assert np.array_equal(quaternion.as_float_array(R_batch[3, 2]),
+                          quaternion.as_float_array(quaternion.integrate_angular_velocity_rkmk4(v[3, 2], t, R0[2])))
+    # ...including functions of orientation, which are called for all trajectories together
+    w = np.random.normal(size=(5, 3))
+    R_func = quaternion.integrate_angular_velocity_rkmk4(lambda t, R: w, t[:20], R0)
+    assert R_func.shape == (5, 20)
+    assert quaternion.allclose(R_func[:, -1], quaternion.from_rotation_vector(w * (t[19] - t[0])) * R0, rtol=0, atol=1e-14)
+    with pytest.raises(ValueError):
+        quaternion.integrate_angular_velocity_rkmk4(v, t[:-1])
+
+
+def test_integrate_gyro_increments():
+    # Classic coning motion, with exact delta-angles from Gauss-Legendre quadrature of the body rates
+    beta, Omega, dt, N = 0.1, 2 * np.pi * 5, 1e-3, 2000
+
+    def R(t):
+        return quaternion.from_rotation_vector(beta * np.stack([np.cos(Omega*t), np.sin(Omega*t), 0*t], axis=-1))
+
+    def omega(t, h=1e-6):
+        return quaternion.as_float_array(2 * np.conjugate(R(t)) * (R(t+h) - R(t-h)) / (2*h))[..., 1:]
+
+    x, w = np.polynomial.legendre.leggauss(6)
+    t = dt * np.arange(N)
+    increments = np.sum(omega(t[:, np.newaxis] + dt * (x + 1) / 2) * w[:, np.newaxis] * dt / 2, axis=1)
+    R_exact = R(t + dt)
+    R_gyro = quaternion.integrate_gyro_increments(increments, R(0.0))
+    assert np.max(quaternion.rotation_intrinsic_distance(R_exact, R_gyro)) < 1e-7
+    R_gyro = quaternion.integrate_gyro_increments(increments, R(0.0), coning=False)
+    assert np.max(quaternion.rotation_intrinsic_distance(R_exact, R_gyro)) > 1e-5
+    # Rates times dt are the same as delta-angles
+    R_rates = quaternion.integrate_gyro_increments(increments / dt, R(0.0), dt=dt, coning=False)
+    assert quaternion.allclose(R_rates, R_gyro, rtol=0, atol=1e-13)
+
+    # Each step agrees with the exponential map, including for large angles
+    np.random.seed(1234)
+    for scale in [0.01, 1.0]:
+        samples = np.random.normal(scale=scale, size=(600, 3))
+        phi = samples + np.cross(np.vstack((np.zeros(3), samples[:-1])), samples) / 12
+        R_steps = np.multiply.accumulate(quaternion.from_rotation_vector(phi))
+        R_gyro = quaternion.integrate_gyro_increments(samples)
+        assert quaternion.allclose(R_gyro, R_steps, rtol=0, atol=1e-13)
+        assert np.max(np.abs(np.norm(R_gyro) - 1)) < 1e-14
+
+    # Chunks of any size give exactly the same results as the whole stream, for many streams at once
+    samples = np.random.normal(scale=0.01, size=(4, 3000, 3))
+    R0 = quaternion.from_rotation_vector(np.random.normal(size=(4, 3)))
+    R_whole = quaternion.integrate_gyro_increments(samples, R0)
+    assert R_whole.shape == (4, 3000)
+    integrator = quaternion.GyroIntegrator(R0)
+    edges = [0, 0, 1, 17, 256, 300, 900, 901, 2000, 3000]
+    R_chunks = np.concatenate([integrator(samples[:, i:j]) for i, j in zip(edges[:-1], edges[1:])], axis=-1)
+    assert np.array_equal(quaternion.as_float_array(R_chunks), quaternion.as_float_array(R_whole))
+    assert np.array_equal(quaternion.as_float_array(integrator.R), quaternion.as_float_array(R_whole[:, -1]))
+    with pytest.raises(ValueError):
+        integrator(samples[..., :2])
+
+    # The integrator keeps no references to the caller's buffers or to the arrays it returns
+    integrator = quaternion.GyroIntegrator(R0)
+    buffer = np.empty((4, 300, 3))
+    R_chunks = []
+    for i in range(0, 3000, 300):
+        buffer[...] = samples[:, i:i+300]
+        R_chunk = integrator(buffer)
+        R_chunks.append(R_chunk.copy())
+        R_chunk[...] = quaternion.one
+        buffer[...] = np.nan
+    R_chunks = np.concatenate(R_chunks, axis=-1)
+    assert np.array_equal(quaternion.as_float_array(R_chunks), quaternion.as_float_array(R_whole))
+
+
+def test_angular_velocity():
+    w = np.array([0.3, -0.2, 0.5])
+    R0 = quaternion.from_rotation_vector([0.1, 0.2, 0.3])
+    np.random.seed(1234)
+    for t in [np.linspace(0.0, 2.0, 50), np.sort(np.random.uniform(0.0, 2.0, size=50))]:
+        # Constant angular velocity w in the inertial frame, and R-bar w R in the body frame
+        R = quaternion.from_rotation_vector(t[:, np.newaxis] * w) * R0
+        Omega_body = quaternion.as_float_array(np.conjugate(R) * np.quaternion(0, *w) * R)[:, 1:]
+        assert np.allclose(quaternion.angular_velocity(R, t), w, rtol=0, atol=1e-8)
+        assert np.allclose(quaternion.angular_velocity(R, t, body=True), Omega_body, rtol=0, atol=1e-8)
+
+    # Fourth-order convergence with smoothly varying steps
+    def R(t):
+        return quaternion.from_rotation_vector(np.sin(t)[:, np.newaxis] * w)
+    errors = []
+    for n in [200, 400]:
+        u = np.linspace(0.0, 1.0, n)
+        t = 3 * (u + 0.1 * np.sin(2 * np.pi * u))
+        h = 1e-6
+        Omega = quaternion.as_float_array((R(t+h) - R(t-h)) / h * np.conjugate(R(t)))[:, 1:]
+        errors.append(np.max(np.abs(quaternion.angular_velocity(R(t), t) - Omega)))
+    assert errors[0] / errors[1] > 12, errors
+
+    # Any axis of a multi-dimensional array, and short series
+    t = np.linspace(0.0, 2.0, 50)
+    R_many = quaternion.from_rotation_vector(np.random.normal(size=(4, 50, 3, 3)))
+    Omega = quaternion.angular_velocity(R_many, t, axis=1)
+    assert Omega.shape == (4, 50, 3, 3)
+    assert np.array_equal(Omega[2, :, 1], quaternion.angular_velocity(R_many[2, :, 1], t))
+    assert np.array_equal(quaternion.angular_velocity(np.moveaxis(R_many, 1, -1), t, axis=-1),
+                          np.moveaxis(Omega, 1, -2))
+    for n in [1, 2, 3, 4]:
+        t = np.linspace(0.0, 1.0, n)
+        R = quaternion.from_rotation_vector(t[:, np.newaxis] * w)
+        assert np.allclose(quaternion.angular_velocity(R, t), w if n > 1 else 0.0, rtol=0, atol=0.01)
+    with pytest.raises(ValueError):
+        quaternion.angular_velocity(R_many, t, axis=1)
+
+
+def test_calculus():
+    from quaternion.quaternion_time_series import frame_from_angular_velocity_integrand
+    np.random.seed(1234)
+    t = np.sort(np.random.uniform(0.0, 2.0, size=200))
+    f = np.array([np.sin(t), np.cos(t), t**2]).T
+    dfdt = np.array([np.cos(t), -np.sin(t), 2*t]).T
+    Sfdt = np.array([np.cos(t[0]) - np.cos(t), np.sin(t) - np.sin(t[0]), (t**3 - t[0]**3) / 3]).T
+    assert np.allclose(quaternion.derivative(f, t), dfdt, rtol=0, atol=1e-4)
+    assert np.allclose(quaternion.indefinite_integral(f, t), Sfdt, rtol=0, atol=1e-3)
+    assert np.allclose(quaternion.definite_integral(f, t), Sfdt[-1], rtol=0, atol=1e-3)
+    assert np.allclose(quaternion.definite_integral(f, t), np.trapz(f, t, axis=0), rtol=1e-14, atol=0)
+
+    # Any axis of float, complex, and quaternion arrays
+    f_many = np.random.normal(size=(3, 200, 2, 4))
+    for function in [quaternion.derivative, quaternion.indefinite_integral]:
+        result = function(f_many, t, axis=1)
+        assert result.shape == f_many.shape
+        assert np.array_equal(result[1, :, 0], function(f_many[1, :, 0], t))
+        assert np.array_equal(function(np.moveaxis(f_many, 1, -1), t, axis=-1), np.moveaxis(result, 1, -1))
+        assert np.array_equal(function(f_many[..., 0] + 1j * f_many[..., 1], t, axis=1),
+                              result[..., 0] + 1j * result[..., 1])
+        assert np.array_equal(quaternion.as_float_array(function(quaternion.as_quat_array(f_many), t, axis=1)),
+                              result)
+    assert quaternion.definite_integral(f_many, t, axis=1).shape == (3, 2, 4)
+    assert np.allclose(quaternion.derivative(f[:4], t[:4]), dfdt[:4], rtol=0, atol=1e-2)
+    with pytest.raises(ValueError):
+        quaternion.derivative(f_many, t, axis=0)
+
+    # Output arrays, and long series, which must not depend on the number of threads
+    q_many = quaternion.as_quat_array(f_many)
+    out = np.empty_like(q_many)
+    assert quaternion.indefinite_integral(q_many, t, axis=1, out=out) is out
+    assert np.array_equal(quaternion.as_float_array(out), quaternion.indefinite_integral(f_many, t, axis=1))
+    out = np.empty((3, 2), dtype=complex)
+    assert quaternion.definite_integral(f_many[..., 0] + 1j * f_many[..., 1], t, axis=1, out=out) is out
+    t = np.sort(np.random.uniform(0.0, 2.0, size=100000))
+    f_long = np.random.normal(size=(t.size, 4))
+    num_threads = quaternion.get_num_threads()
+    try:
+        quaternion.set_num_threads(1)
+        Sfdt = quaternion.indefinite_integral(f_long, t)
+        assert np.allclose(Sfdt[1:], np.cumsum((f_long[1:] + f_long[:-1]) * (np.diff(t) / 2)[:, np.newaxis], axis=0),
+                           rtol=0, atol=1e-12)
+        assert np.array_equal(quaternion.definite_integral(f_long, t), Sfdt[-1])
+        assert np.array_equal(quaternion.indefinite_integral(f_long.T.copy(), t, axis=1), Sfdt.T)
+        quaternion.set_num_threads(3)
+        assert np.array_equal(quaternion.indefinite_integral(f_long, t), Sfdt)
+        assert np.array_equal(quaternion.definite_integral(f_long, t), Sfdt[-1])
+    finally:
+        quaternion.set_num_threads(num_threads)
+
+    # The chordal mean, which integrates the rotors over time
+    from quaternion.means import mean_rotor_in_chordal_metric
+    R = quaternion.from_rotation_vector(np.random.normal(scale=0.1, size=(100, 3)))
+    t = np.linspace(0.0, 1.0, 100)
+    assert mean_rotor_in_chordal_metric(R) == np.add.reduce(R).normalized()
+    assert quaternion.isclose(mean_rotor_in_chordal_metric(R, t),
+                              quaternion.as_quat_array(np.trapz(quaternion.as_float_array(R), t, axis=0)).normalized(),
+                              rtol=1e-14)
+
+    # The integrand for the rotation vector of a rotating frame
+    rfrak, Omega = np.array([0.1, 0.2, 0.3]), np.array([1.0, 2.0, -1.0])
+    mag, hat, half = np.linalg.norm(rfrak), rfrak / np.linalg.norm(rfrak), Omega / 2
+    expected = ((half - hat * np.dot(hat, half)) * (mag / np.tan(mag)) + hat * np.dot(hat, half)
+                + np.cross(half, rfrak))
+    assert np.allclose(frame_from_angular_velocity_integrand(rfrak, Omega), expected, rtol=0, atol=1e-15)
+    assert np.array_equal(frame_from_angular_velocity_integrand(np.zeros(3), Omega), half)
+
 
 if __name__ == '__main__':
     print("The tests should be run automatically via pytest (pip install pytest)")